@@ -15,8 +15,14 @@ int SM9_sign_test()
 
     unsigned char* IDA = "Cuiyan";
     unsigned char* message = "This is a test message!";//ǩϢ
-    int mlen = strlen(message), tmp; //ǩϢ
+    int mlen = strlen(message), tmp, i; //ǩϢ
     big ks;
+    SM9_SIGN_KEY key;
+    SM9_VERIFY_KEY vkey;
+    SM9_SIGN_MSG batch[4];
+    SM9_SIGNATURE sig[4];
+    SM9_VERIFY_ITEM vitems[4];
+    int vret[4];
     clock_t start, finish;//ʱ
     start = clock();
 
@@ -39,9 +45,55 @@ int SM9_sign_test()
 
   
         printf("\n******************* SM9 verification algorithm *************************\n");
-        tmp = SM9_signVerify(h, S, hid, IDA, message, mlen, Ppub);
+        tmp = SM9_verify_key_init(&vkey, Ppub);
         if (tmp != 0)
             return tmp;
+        tmp = SM9_signVerify(&vkey, h, S, hid, IDA, message, mlen);
+        if (tmp != 0)
+        {
+            SM9_verify_key_free(&vkey);
+            return tmp;
+        }
+
+        printf("\n******************* SM9 batch signature *************************\n");
+        for (i = 0; i < 4; i++)
+        {
+            batch[i].msg = message;
+            batch[i].len = mlen - i;
+        }
+        tmp = SM9_sign_key_init(&key, dSA, Ppub);
+        if (tmp != 0)
+        {
+            SM9_verify_key_free(&vkey);
+            return tmp;
+        }
+        tmp = SM9_sign_batch(&key, batch, 4, sig);
+        SM9_sign_key_free(&key);
+        if (tmp != 0)
+        {
+            SM9_verify_key_free(&vkey);
+            return tmp;
+        }
+
+        printf("\n******************* SM9 batch verification *************************\n");
+        for (i = 0; i < 4; i++)
+        {
+            vitems[i].IDA = IDA;
+            vitems[i].msg = batch[i].msg;
+            vitems[i].len = batch[i].len;
+            vitems[i].sig = sig[i];
+        }
+        tmp = SM9_signVerify_batch(&vkey, hid, vitems, 4, vret);
+        if (tmp != 0)
+        {
+            SM9_verify_key_free(&vkey);
+            return tmp;
+        }
+        vitems[2].len--; //a bad signature is found among good ones
+        tmp = SM9_signVerify_batch(&vkey, hid, vitems, 4, vret);
+        SM9_verify_key_free(&vkey);
+        if (tmp != SM9_DATA_MEMCMP_ERR || vret[0] || vret[1] || vret[2] != SM9_DATA_MEMCMP_ERR || vret[3])
+            return SM9_DATA_MEMCMP_ERR;
 
  
 
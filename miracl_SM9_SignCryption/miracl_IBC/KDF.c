@@ -9,194 +9,109 @@ The codes were slightly modified to pass the check of C complier.
 
 #include <string.h>
 #include "KDF.h"
+#include "SM3_mb.h"
+
+/* rotated round constants, SM3_Tj[j] = T_j <<< (j mod 32), shared with SM3_mb.c */
+const uint32_t SM3_Tj[64] = {
+	0x79cc4519, 0xf3988a32, 0xe7311465, 0xce6228cb, 0x9cc45197, 0x3988a32f, 0x7311465e, 0xe6228cbc,
+	0xcc451979, 0x988a32f3, 0x311465e7, 0x6228cbce, 0xc451979c, 0x88a32f39, 0x11465e73, 0x228cbce6,
+	0x9d8a7a87, 0x3b14f50f, 0x7629ea1e, 0xec53d43c, 0xd8a7a879, 0xb14f50f3, 0x629ea1e7, 0xc53d43ce,
+	0x8a7a879d, 0x14f50f3b, 0x29ea1e76, 0x53d43cec, 0xa7a879d8, 0x4f50f3b1, 0x9ea1e762, 0x3d43cec5,
+	0x7a879d8a, 0xf50f3b14, 0xea1e7629, 0xd43cec53, 0xa879d8a7, 0x50f3b14f, 0xa1e7629e, 0x43cec53d,
+	0x879d8a7a, 0x0f3b14f5, 0x1e7629ea, 0x3cec53d4, 0x79d8a7a8, 0xf3b14f50, 0xe7629ea1, 0xcec53d43,
+	0x9d8a7a87, 0x3b14f50f, 0x7629ea1e, 0xec53d43c, 0xd8a7a879, 0xb14f50f3, 0x629ea1e7, 0xc53d43ce,
+	0x8a7a879d, 0x14f50f3b, 0x29ea1e76, 0x53d43cec, 0xa7a879d8, 0x4f50f3b1, 0x9ea1e762, 0x3d43cec5
+};
+
+/* one round of CF, the caller rotates the register names instead of moving
+   the values: after the round A holds B', D holds A', E holds F' and H holds E' */
+#define SM3_ROUND(A, B, C, D, E, F, G, H, FF, GG, j)            \
+	do                                                          \
+	{                                                           \
+		uint32_t A12 = SM3_rotl32(A, 12);                       \
+		uint32_t SS1 = SM3_rotl32(A12 + E + SM3_Tj[j], 7);      \
+		uint32_t SS2 = SS1 ^ A12;                               \
+		D = FF(A, B, C) + D + SS2 + (W[j] ^ W[(j) + 4]);        \
+		H = GG(E, F, G) + H + SS1 + W[j];                       \
+		B = SM3_rotl32(B, 9);                                   \
+		F = SM3_rotl32(F, 19);                                  \
+		H = SM3_p0(H);                                          \
+	} while (0)
+
+#define SM3_ROUND4(FF, GG, j)                                   \
+	SM3_ROUND(A, B, C, D, E, F, G, H, FF, GG, (j));             \
+	SM3_ROUND(D, A, B, C, H, E, F, G, FF, GG, (j) + 1);         \
+	SM3_ROUND(C, D, A, B, G, H, E, F, FF, GG, (j) + 2);         \
+	SM3_ROUND(B, C, D, A, F, G, H, E, FF, GG, (j) + 3)
 
-/****************************************************************
-Function:       BiToW
-Description:    calculate W from Bi
-Calls:
-Called By:      SM3_compress
-Input:          Bi[16]    //a block of a message
-Output:         W[68]
-Return:         null
-Others:
-****************************************************************/
-void BiToW(unsigned long Bi[], unsigned long W[])
-{
-	int i;
-	unsigned long tmp;
-
-	for (i = 0; i <= 15; i++)
-	{
-		W[i] = Bi[i];
-	}
-	for (i = 16; i <= 67; i++)
-	{
-		tmp = W[i - 16] ^ W[i - 9] ^ SM3_rotl32(W[i - 3], 15);
-		W[i] = SM3_p1(tmp) ^ (SM3_rotl32(W[i - 13], 7)) ^ W[i - 6];
-	}
-}
-
-/*****************************************************************
-Function:       WToW1
-Description:    calculate W1 from W
-Calls:
-Called By:      SM3_compress
-Input:          W[68]
-Output:         W1[64]
-Return:         null
-Others:
-*****************************************************************/
-void WToW1(unsigned long W[], unsigned long W1[])
-{
-	int i;
-	for (i = 0; i <= 63; i++)
-	{
-		W1[i] = W[i] ^ W[i + 4];
-	}
-}
-
-/******************************************************************
-Function:       CF
-Description:    calculate the CF compress function and update V
+/******************************************************************************
+Function:       SM3_compress_blocks
+Description:    the SM3 core: message expansion and CF function of GM/T 0004-2012,
+compress n consecutive 64-byte blocks into the chaining value V
 Calls:
-Called By:      SM3_compress
-Input:          W[68]
-W1[64]
-V[8]
-Output:         V[8]
+Called By:      SM3_compress, SM3_process
+Input:          uint32_t V[8]
+const unsigned char *blocks  //n*64 bytes, no alignment needed
+size_t n
+Output:         uint32_t V[8]
 Return:         null
-Others:
-********************************************************************/
-void CF(unsigned long W[], unsigned long W1[], unsigned long V[])
+Others:         words are read big-endian straight from the input, so the
+input is never modified
+*******************************************************************************/
+void SM3_compress_blocks(uint32_t V[8], const unsigned char *blocks, size_t n)
 {
-	unsigned long SS1;
-	unsigned long SS2;
-	unsigned long TT1;
-	unsigned long TT2;
-	unsigned long A, B, C, D, E, F, G, H;
-	unsigned long T = SM3_T1;
-	unsigned long FF;
-	unsigned long GG;
+	uint32_t W[68];
+	uint32_t A, B, C, D, E, F, G, H;
+	uint32_t tmp;
 	int j;
 
-	//reg init,set ABCDEFGH=V0
-	A = V[0];
-	B = V[1];
-	C = V[2];
-	D = V[3];
-	E = V[4];
-	F = V[5];
-	G = V[6];
-	H = V[7];
-
-	for (j = 0; j <= 63; j++)
+	while (n--)
 	{
-		//SS1
-		if (j == 0)
-		{
-			T = SM3_T1;
-		}
-		else if (j == 16)
-		{
-			T = SM3_rotl32(SM3_T2, 16);
-		}
-		else
-		{
-			T = SM3_rotl32(T, 1);
-		}
-		SS1 = SM3_rotl32((SM3_rotl32(A, 12) + E + T), 7);
-
-		//SS2
-		SS2 = SS1 ^ SM3_rotl32(A, 12);
-
-		//TT1
-		if (j <= 15)
-		{
-			FF = SM3_ff0(A, B, C);
-		}
-
-		else
-		{
-			FF = SM3_ff1(A, B, C);
-		}
-		TT1 = FF + D + SS2 + *W1;
-		W1++;
-
-		//TT2
-		if (j <= 15)
-		{
-			GG = SM3_gg0(E, F, G);
-		}
-		else
+		for (j = 0; j < 16; j++)
+			W[j] = SM3_LOAD32(blocks + 4 * j);
+		for (j = 16; j < 68; j++)
 		{
-			GG = SM3_gg1(E, F, G);
+			tmp = W[j - 16] ^ W[j - 9] ^ SM3_rotl32(W[j - 3], 15);
+			W[j] = SM3_p1(tmp) ^ SM3_rotl32(W[j - 13], 7) ^ W[j - 6];
 		}
-		TT2 = GG + H + SS1 + *W;
-		W++;
-
-		//D
-		D = C;
-
-		//C
-		C = SM3_rotl32(B, 9);
-
-		//B
-		B = A;
-
-		//A
-		A = TT1;
-
-		//H
-		H = G;
-
-		//G
-		G = SM3_rotl32(F, 19);
-
-		//F
-		F = E;
 
-		//E
-		E = SM3_p0(TT2);
-	}
-
-	//update V
-	V[0] = A ^ V[0];
-	V[1] = B ^ V[1];
-	V[2] = C ^ V[2];
-	V[3] = D ^ V[3];
-	V[4] = E ^ V[4];
-	V[5] = F ^ V[5];
-	V[6] = G ^ V[6];
-	V[7] = H ^ V[7];
-}
-
-/******************************************************************************
-Function:       BigEndian
-Description:    unsigned int endian converse.GM/T 0004-2012 requires to use big-endian.
-if CPU uses little-endian, BigEndian function is a necessary
-call to change the little-endian format into big-endian format.
-Calls:
-Called By:      SM3_compress, SM3_done
-Input:          src[bytelen]
-bytelen
-Output:         des[bytelen]
-Return:         null
-Others:         src and des could implies the same address
-*******************************************************************************/
-void BigEndian(unsigned char src[], unsigned int bytelen, unsigned char des[])
-{
-	unsigned char tmp = 0;
-	unsigned long i = 0;
-
-	for (i = 0; i < bytelen / 4; i++)
-	{
-		tmp = des[4 * i];
-		des[4 * i] = src[4 * i + 3];
-		src[4 * i + 3] = tmp;
-
-		tmp = des[4 * i + 1];
-		des[4 * i + 1] = src[4 * i + 2];
-		des[4 * i + 2] = tmp;
+		A = V[0];
+		B = V[1];
+		C = V[2];
+		D = V[3];
+		E = V[4];
+		F = V[5];
+		G = V[6];
+		H = V[7];
+
+		SM3_ROUND4(SM3_ff0, SM3_gg0, 0);
+		SM3_ROUND4(SM3_ff0, SM3_gg0, 4);
+		SM3_ROUND4(SM3_ff0, SM3_gg0, 8);
+		SM3_ROUND4(SM3_ff0, SM3_gg0, 12);
+		SM3_ROUND4(SM3_ff1, SM3_gg1, 16);
+		SM3_ROUND4(SM3_ff1, SM3_gg1, 20);
+		SM3_ROUND4(SM3_ff1, SM3_gg1, 24);
+		SM3_ROUND4(SM3_ff1, SM3_gg1, 28);
+		SM3_ROUND4(SM3_ff1, SM3_gg1, 32);
+		SM3_ROUND4(SM3_ff1, SM3_gg1, 36);
+		SM3_ROUND4(SM3_ff1, SM3_gg1, 40);
+		SM3_ROUND4(SM3_ff1, SM3_gg1, 44);
+		SM3_ROUND4(SM3_ff1, SM3_gg1, 48);
+		SM3_ROUND4(SM3_ff1, SM3_gg1, 52);
+		SM3_ROUND4(SM3_ff1, SM3_gg1, 56);
+		SM3_ROUND4(SM3_ff1, SM3_gg1, 60);
+
+		//update V
+		V[0] ^= A;
+		V[1] ^= B;
+		V[2] ^= C;
+		V[3] ^= D;
+		V[4] ^= E;
+		V[5] ^= F;
+		V[6] ^= G;
+		V[7] ^= H;
+
+		blocks += 64;
 	}
 }
 
@@ -212,7 +127,8 @@ Others:
 *******************************************************************************/
 void SM3_init(SM3_STATE *md)
 {
-	md->curlen = md->length = 0;
+	md->curlen = 0;
+	md->length = 0;
 	md->state[0] = SM3_IVA;
 	md->state[1] = SM3_IVB;
 	md->state[2] = SM3_IVC;
@@ -225,12 +141,9 @@ void SM3_init(SM3_STATE *md)
 
 /******************************************************************************
 Function:       SM3_compress
-Description:    compress a single block of message
-Calls:          BigEndian
-BiToW
-WToW1
-CF
-Called By:      SM3_256
+Description:    compress the single block of message held in md->buf
+Calls:          SM3_compress_blocks
+Called By:      SM3_process, SM3_done
 Input:          SM3_STATE *md
 Output:         SM3_STATE *md
 Return:         null
@@ -238,44 +151,59 @@ Others:
 *******************************************************************************/
 void SM3_compress(SM3_STATE *md)
 {
-	unsigned long W[68];
-	unsigned long W1[64];
-
-	//if CPU uses little-endian, BigEndian function is a necessary call
-	BigEndian(md->buf, 64, md->buf);
-
-	BiToW((unsigned long *)md->buf, W);
-	WToW1(W, W1);
-	CF(W, W1, md->state);
+	SM3_compress_blocks(md->state, md->buf, 1);
 }
 
 /******************************************************************************
 Function:       SM3_process
-Description:    compress the first (len/64) blocks of message
-Calls:          SM3_compress
+Description:    absorb len bytes of message. Bytes left from the last call are
+completed to a block first, then all whole blocks are compressed straight
+from buf and only the tail is copied into md->buf
+Calls:          SM3_compress, SM3_compress_blocks
 Called By:      SM3_256
 Input:          SM3_STATE *md
 unsigned char buf[len]  //the input message
-int len                 //bytelen of message
+size_t len              //bytelen of message
 Output:         SM3_STATE *md
 Return:         null
-Others:
+Others:         may be called any number of times, the bit length is kept in 64 bits
 *******************************************************************************/
-void SM3_process(SM3_STATE *md, unsigned char *buf, int len)
+void SM3_process(SM3_STATE *md, unsigned char *buf, size_t len)
 {
-	while (len--)
+	size_t n, rest = len;
+
+	if (len == 0)
+		return;
+
+	if (md->curlen)
 	{
-		/* copy byte */
-		md->buf[md->curlen] = *buf++;
-		md->curlen++;
+		n = 64 - md->curlen;
+		if (n > rest)
+			n = rest;
+		memcpy(md->buf + md->curlen, buf, n);
+		md->curlen += (uint32_t)n;
+		buf += n;
+		rest -= n;
+		if (md->curlen < 64)
+			return;
+		SM3_compress(md);
+		md->length += 512;
+		md->curlen = 0;
+	}
 
-		/* is 64 bytes full? */
-		if (md->curlen == 64)
-		{
-			SM3_compress(md);
-			md->length += 512;
-			md->curlen = 0;
-		}
+	n = rest / 64;
+	if (n)
+	{
+		SM3_compress_blocks(md->state, buf, n);
+		md->length += (uint64_t)n << 9;
+		buf += n * 64;
+		rest -= n * 64;
+	}
+
+	if (rest)
+	{
+		memcpy(md->buf, buf, rest);
+		md->curlen = (uint32_t)rest;
 	}
 }
 
@@ -292,14 +220,12 @@ Others:
 void SM3_done(SM3_STATE *md, unsigned char hash[])
 {
 	int i;
-	unsigned char tmp = 0;
 
 	/* increase the bit length of the message */
-	md->length += md->curlen << 3;
+	md->length += (uint64_t)md->curlen << 3;
 
 	/* append the '1' bit */
-	md->buf[md->curlen] = 0x80;
-	md->curlen++;
+	md->buf[md->curlen++] = 0x80;
 
 	/* if the length is currently above 56 bytes, appends zeros till
 	it reaches 64 bytes, compress the current block, creat a new
@@ -307,39 +233,20 @@ void SM3_done(SM3_STATE *md, unsigned char hash[])
 	*/
 	if (md->curlen > 56)
 	{
-		for (; md->curlen < 64;)
-		{
-			md->buf[md->curlen] = 0;
-			md->curlen++;
-		}
+		memset(md->buf + md->curlen, 0, 64 - md->curlen);
 		SM3_compress(md);
 		md->curlen = 0;
 	}
 
-	/* if the length is less than 56 bytes, pad upto 56 bytes of zeroes */
-	for (; md->curlen < 56;)
-	{
-		md->buf[md->curlen] = 0;
-		md->curlen++;
-	}
-
-	/* since all messages are under 2^32 bits we mark the top bits zero */
-	for (i = 56; i < 60; i++)
-	{
-		md->buf[i] = 0;
-	}
-
-	/* append length */
-	md->buf[63] = md->length & 0xff;
-	md->buf[62] = (md->length >> 8) & 0xff;
-	md->buf[61] = (md->length >> 16) & 0xff;
-	md->buf[60] = (md->length >> 24) & 0xff;
-
+	/* pad upto 56 bytes of zeroes and append the 64-bit length */
+	memset(md->buf + md->curlen, 0, 56 - md->curlen);
+	SM3_STORE32(md->buf + 56, (uint32_t)(md->length >> 32));
+	SM3_STORE32(md->buf + 60, (uint32_t)md->length);
 	SM3_compress(md);
 
 	/* copy output */
-	memcpy(hash, md->state, SM3_len / 8);
-	BigEndian(hash, SM3_len / 8, hash); //if CPU uses little-endian, BigEndian function is a necessary call
+	for (i = 0; i < 8; i++)
+		SM3_STORE32(hash + 4 * i, md->state[i]);
 }
 
 /******************************************************************************
@@ -350,12 +257,12 @@ SM3_process
 SM3_done
 Called By:
 Input:          unsigned char buf[len]  //the input message
-int len                 //bytelen of the message
+size_t len              //bytelen of the message
 Output:         unsigned char hash[32]
 Return:         null
 Others:
 *******************************************************************************/
-void SM3_256(unsigned char buf[], int len, unsigned char hash[])
+void SM3_256(unsigned char buf[], size_t len, unsigned char hash[])
 {
 	SM3_STATE md;
 	SM3_init(&md);
@@ -365,80 +272,143 @@ void SM3_256(unsigned char buf[], int len, unsigned char hash[])
 
 /******************************************************************************
 Function:       SM3_KDF
-Description:    key derivation function
-Calls:          SM3_init
-SM3_process
-SM3_done
+Description:    key derivation function, counter blocks are hashed in SIMD
+lanes and long keystreams are split over threads
+Calls:          SM3_KDF_mt
 Called By:
 Input:          
 unsigned char Z[zlen]
-unsigned short zlen          //bytelen of Z
-unsigned short klen          //bytelen of K
+size_t zlen                  //bytelen of Z
+size_t klen                  //bytelen of K
 Output:         unsigned char K[klen]        //shared secret key
 Return:         null
 Others:
 *******************************************************************************/
-void SM3_KDF(unsigned char Z[], unsigned short zlen, unsigned short klen, unsigned char K[])
+void SM3_KDF(unsigned char Z[], size_t zlen, size_t klen, unsigned char K[])
 {
-	unsigned short i, j, t;
-	unsigned int bitklen;
-	SM3_STATE md;
-	unsigned char Ha[SM2_NUMWORD];
-	unsigned char ct[4] = { 0, 0, 0, 1 };
-
-	bitklen = klen * 8;
+	//s2-s4: K=Hv(Z||1)||Hv(Z||2)||..., the counter blocks are independent
+	SM3_KDF_mt(Z, zlen, 1, K, klen);
+}
 
-	if (bitklen % SM2_NUMBITS)
-		t = bitklen / SM2_NUMBITS + 1;
-	else
-		t = bitklen / SM2_NUMBITS;
+/******************************************************************************
+Function:       SM3_KDF_init
+Description:    start a streaming KDF, Z is then given to SM3_KDF_absorb
+Calls:          SM3_init
+Called By:
+Input:          SM3_KDF_CTX *kdf
+Output:         SM3_KDF_CTX *kdf
+Return:         null
+Others:
+*******************************************************************************/
+void SM3_KDF_init(SM3_KDF_CTX *kdf)
+{
+	SM3_init(&kdf->mid);
+	kdf->ct = 1;
+	kdf->used = 32;
+}
 
-	//s4:   K=Ha1||Ha2||...
-	for (i = 1; i < t; i++)
-	{
-		//s2:   Hai=Hv(Z||ct)
-		SM3_init(&md);
-		SM3_process(&md, Z, zlen);
-		SM3_process(&md, ct, 4);
-		SM3_done(&md, Ha);
+/******************************************************************************
+Function:       SM3_KDF_absorb
+Description:    append len bytes to Z, only before the first SM3_KDF_squeeze
+Calls:          SM3_process
+Called By:
+Input:          SM3_KDF_CTX *kdf
+const unsigned char *buf
+size_t len
+Output:         SM3_KDF_CTX *kdf
+Return:         null
+Others:         Z may be given in any number of pieces and is never buffered
+*******************************************************************************/
+void SM3_KDF_absorb(SM3_KDF_CTX *kdf, const unsigned char *buf, size_t len)
+{
+	SM3_process(&kdf->mid, (unsigned char *)buf, len);
+}
 
-		memcpy((K + SM2_NUMWORD * (i - 1)), Ha, SM2_NUMWORD);
+/******************************************************************************
+Function:       SM3_KDF_squeeze
+Description:    give out the next len bytes of the keystream KDF(Z), so that
+successive calls produce the same bytes as one SM3_KDF of the total length
+Calls:          SM3_KDF_resume
+Called By:
+Input:          SM3_KDF_CTX *kdf
+size_t len
+Output:         unsigned char K[len]
+Return:         null
+Others:         whole blocks are computed straight into K, with SIMD lanes and
+threads for long requests. Bytes of a block not given out are kept for the
+next call
+*******************************************************************************/
+void SM3_KDF_squeeze(SM3_KDF_CTX *kdf, unsigned char K[], size_t len)
+{
+	size_t n;
 
-		if (ct[3] == 0xff)
-		{
-			ct[3] = 0;
-			if (ct[2] == 0xff)
-			{
-				ct[2] = 0;
-				if (ct[1] == 0xff)
-				{
-					ct[1] = 0;
-					ct[0]++;
-				}
-				else
-					ct[1]++;
-			}
-			else
-				ct[2]++;
-		}
-		else
-			ct[3]++;
+	if (kdf->used < 32)
+	{
+		n = 32 - kdf->used;
+		if (n > len)
+			n = len;
+		memcpy(K, kdf->block + kdf->used, n);
+		kdf->used += (uint32_t)n;
+		K += n;
+		len -= n;
 	}
 
-	//s3:  klen/v???????????
-	SM3_init(&md);
-	SM3_process(&md, Z, zlen);
-	SM3_process(&md, ct, 4);
-	SM3_done(&md, Ha);
+	n = len / 32;
+	if (n)
+	{
+		SM3_KDF_resume(&kdf->mid, kdf->ct, K, 32 * n);
+		kdf->ct += (uint32_t)n;
+		K += 32 * n;
+		len -= 32 * n;
+	}
 
-	if (bitklen % SM2_NUMBITS)
+	if (len)
 	{
-		i = (SM2_NUMBITS - bitklen + SM2_NUMBITS * (bitklen / SM2_NUMBITS)) / 8;
-		j = (bitklen - SM2_NUMBITS * (bitklen / SM2_NUMBITS)) / 8;
-		memcpy((K + SM2_NUMWORD * (t - 1)), Ha, j);
+		SM3_KDF_resume(&kdf->mid, kdf->ct, kdf->block, 32);
+		kdf->ct++;
+		memcpy(K, kdf->block, len);
+		kdf->used = (uint32_t)len;
 	}
-	else
+}
+
+
+/******************************************************************************
+Function:       SM3_KDF_xor
+Description:    out = in XOR key stream, and the plaintext is absorbed into a
+second hash at the same time: in for encryption, out for decryption. The
+message is walked once in chunks that stay in cache between the key stream,
+the XOR and the hash, instead of one pass for each
+Calls:          SM3_KDF_squeeze, SM3_KDF_absorb
+Called By:      Signcrypt, Unsigncrypt
+Input:          SM3_KDF_CTX *kdf    //key stream, Z absorbed
+SM3_KDF_CTX *hash   //H2 of the plaintext, NULL for no hash
+const unsigned char in[len]
+size_t len
+int hash_out        //0: hash in, 1: hash out
+Output:         unsigned char out[len]
+SM3_KDF_CTX *kdf, SM3_KDF_CTX *hash
+Return:         null
+Others:         in and out must not overlap. A chunk of SM3_KDF_XOR_CHUNK
+bytes is far below SM3_KDF_THREAD_MIN, so the key stream is squeezed in the
+calling thread and no thread is started per chunk. The hash of the
+plaintext is serial anyway and bounds the speed of the walk
+*******************************************************************************/
+void SM3_KDF_xor(SM3_KDF_CTX *kdf, SM3_KDF_CTX *hash, const unsigned char in[], unsigned char out[],
+	size_t len, int hash_out)
+{
+	size_t chunk, n, i;
+
+	chunk = SM3_KDF_XOR_CHUNK;
+	while (len)
 	{
-		memcpy((K + SM2_NUMWORD * (t - 1)), Ha, SM2_NUMWORD);
+		n = len < chunk ? len : chunk;
+		SM3_KDF_squeeze(kdf, out, n);
+		for (i = 0; i < n; i++)
+			out[i] ^= in[i];
+		if (hash)
+			SM3_KDF_absorb(hash, hash_out ? out : in, n);
+		in += n;
+		out += n;
+		len -= n;
 	}
 }
\ No newline at end of file
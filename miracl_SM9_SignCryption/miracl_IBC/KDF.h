@@ -17,29 +17,38 @@ Sep 24,2016
 Description:
 This headfile provides KDF function needed in SM2 algorithm
 Function List:
-1.SM3_256        //calls SM3_init, SM3_process and SM3_done to calculate hash value
-2.SM3_init       //init the SM3 state
-3.SM3_process    //compress the the first len/64 blocks of the message
-4.SM3_done       //compress the rest message and output the hash value
-5.SM3_compress   //called by SM3_process and SM3_done, compress a single block of message
-6.BiToW          //called by SM3_compress,to calculate W from Bi
-7.WToW1          //called by SM3_compress, calculate W' from W
-8.CF             //called by SM3_compress, to calculate CF function.
-9.BigEndian      //called by SM3_compress and SM3_done.GM/T 0004-2012 requires to use
-big-endian.
-//if CPU uses little-endian, BigEndian function is a necessary call to
-change the
-//little-endian format into big-endian format.
-10.SM3_KDF       //calls SM3_init, SM3_process and SM3_done to generate key stream
+1.SM3_256             //calls SM3_init, SM3_process and SM3_done to calculate hash value
+2.SM3_init            //init the SM3 state
+3.SM3_process         //absorb the message, whole blocks are compressed straight from the input
+4.SM3_done            //compress the rest message and output the hash value
+5.SM3_compress        //called by SM3_process and SM3_done, compress the block held in md->buf
+6.SM3_compress_blocks //the SM3 core, compress n blocks of 64 bytes into the chaining value
+7.SM3_KDF             //calls SM3_KDF_mt of SM3_mb.c to generate key stream
+8.SM3_KDF_init        //start a streaming KDF
+9.SM3_KDF_absorb      //feed Z to a streaming KDF
+10.SM3_KDF_squeeze    //give out the next bytes of the key stream
+11.SM3_KDF_xor        //XOR with the key stream and hash the plaintext in one pass
 History:
 1. Date:   Sep 18,2016
 Modification: Adding notes to all the functions
+2. Date:   Oct 19,2026
+Modification: block-oriented core on uint32_t words, big-endian words are loaded
+with bswap, rotated T constants are precomputed and the rounds are unrolled
+3. Date:   Oct 19,2026
+Modification: SM3_KDF hashes the counter blocks in the lanes of the
+multi-buffer SM3 and splits long keystreams over threads
+4. Date:   Oct 19,2026
+Modification: size_t lengths for SM3_process, SM3_256 and SM3_KDF, streaming
+KDF with SM3_KDF_init, SM3_KDF_absorb and SM3_KDF_squeeze
+5. Date:   Oct 19,2026
+Modification: SM3_KDF_xor, key stream XOR fused with the hash of the plaintext
 ************************************************************************/
 
 #ifndef HEADER_KDF_H
 #define HEADER_KDF_H
 
 #include <string.h>
+#include <stdint.h>
 
 #define SM2_WORDSIZE 8
 #define SM2_NUMBITS 256
@@ -58,30 +67,56 @@ Modification: Adding notes to all the functions
 #define SM3_IVH 0xb0fb0e4e
 
 /* Various logical functions */
-#define SM3_p1(x) (x ^ SM3_rotl32(x, 15) ^ SM3_rotl32(x, 23))
-#define SM3_p0(x) (x ^ SM3_rotl32(x, 9) ^ SM3_rotl32(x, 17))
-#define SM3_ff0(a, b, c) (a ^ b ^ c)
-#define SM3_ff1(a, b, c) ((a & b) | (a & c) | (b & c))
-#define SM3_gg0(e, f, g) (e ^ f ^ g)
-#define SM3_gg1(e, f, g) ((e & f) | ((~e) & g))
-#define SM3_rotl32(x, n) (((x) << n) | ((x) >> (32 - n)))
-#define SM3_rotr32(x, n) (((x) >> n) | ((x) << (32 - n)))
+#define SM3_p1(x) ((x) ^ SM3_rotl32((x), 15) ^ SM3_rotl32((x), 23))
+#define SM3_p0(x) ((x) ^ SM3_rotl32((x), 9) ^ SM3_rotl32((x), 17))
+#define SM3_ff0(a, b, c) ((a) ^ (b) ^ (c))
+#define SM3_ff1(a, b, c) (((a) & (b)) | ((a) & (c)) | ((b) & (c)))
+#define SM3_gg0(e, f, g) ((e) ^ (f) ^ (g))
+#define SM3_gg1(e, f, g) (((e) & (f)) | ((~(e)) & (g)))
+#define SM3_rotl32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define SM3_rotr32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/* big-endian word load and store, compiled to a single bswap */
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#define SM3_LOAD32(p) _byteswap_ulong(*(const uint32_t *)(p))
+#define SM3_STORE32(p, v) (*(uint32_t *)(p) = _byteswap_ulong(v))
+#else
+#define SM3_LOAD32(p) (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
+#define SM3_STORE32(p, v) ((p)[0] = (unsigned char)((v) >> 24), (p)[1] = (unsigned char)((v) >> 16), \
+	(p)[2] = (unsigned char)((v) >> 8), (p)[3] = (unsigned char)(v))
+#endif
 
 typedef struct
 {
-	unsigned long state[8];
-	unsigned long length;
-	unsigned long curlen;
+	uint32_t state[8];
+	uint64_t length;   //bit length of the compressed blocks
+	uint32_t curlen;   //bytes waiting in buf
 	unsigned char buf[64];
 } SM3_STATE;
 
-void CF(unsigned long Wj[], unsigned long Wj1[], unsigned long V[]);
-void BigEndian(unsigned char src[], unsigned int bytelen, unsigned char des[]);
+//streaming KDF: Z is absorbed once, the key stream is squeezed in pieces
+typedef struct
+{
+	SM3_STATE mid;            //state that has absorbed Z
+	uint32_t ct;              //counter of the next block
+	uint32_t used;            //bytes of block already given out
+	unsigned char block[32];  //last block computed
+} SM3_KDF_CTX;
+
+extern const uint32_t SM3_Tj[64];
+
 void SM3_init(SM3_STATE *md);
+void SM3_compress_blocks(uint32_t V[8], const unsigned char *blocks, size_t n);
 void SM3_compress(SM3_STATE *md);
-void SM3_process(SM3_STATE *md, unsigned char *buf, int len);
+void SM3_process(SM3_STATE *md, unsigned char *buf, size_t len);
 void SM3_done(SM3_STATE *md, unsigned char hash[]);
-void SM3_256(unsigned char buf[], int len, unsigned char hash[]);
-void SM3_KDF(unsigned char Z[], unsigned short zlen, unsigned short klen, unsigned char K[]);
+void SM3_256(unsigned char buf[], size_t len, unsigned char hash[]);
+void SM3_KDF(unsigned char Z[], size_t zlen, size_t klen, unsigned char K[]);
+void SM3_KDF_init(SM3_KDF_CTX *kdf);
+void SM3_KDF_absorb(SM3_KDF_CTX *kdf, const unsigned char *buf, size_t len);
+void SM3_KDF_squeeze(SM3_KDF_CTX *kdf, unsigned char K[], size_t len);
+void SM3_KDF_xor(SM3_KDF_CTX *kdf, SM3_KDF_CTX *hash, const unsigned char in[], unsigned char out[],
+	size_t len, int hash_out);
 
 #endif
\ No newline at end of file
@@ -7,17 +7,17 @@ http://www.scctc.org.cn/Upload/accessory/20175/201755105494041082.pdf .
 The codes were slightly modified to pass the check of C complier.
 *************************************************************/
 
+#include <stdlib.h>
+#include <string.h>
 #include "zzn12_operation.h"
 #include "miracl.h"
 #include "R-ate.h"
 
-miracl *mip;
-
 /****************************************************************
 Function:       q_power_frobenius
 Description:    F is frobenius_constant X
 see ake12bnx.cpp for details in MIRACL c++ source file
-Calls:          MIRACL functions
+Calls:          MIRACL functions,SM9_arena_mark,SM9_tmp,SM9_arena_release
 Called By:      fast_pairing
 Input:          ecn2 A,zzn2 F
 Output:         zzn2 A
@@ -28,16 +28,19 @@ void q_power_frobenius(ecn2 A, zzn2 F)
 {
 	// Fast multiplication of A by q (for Trace-Zero group members only)
 	zzn2 x, y, z, w, r;
-	x.a = mirvar(0);
-	x.b = mirvar(0);
-	y.a = mirvar(0);
-	y.b = mirvar(0);
-	z.a = mirvar(0);
-	z.b = mirvar(0);
-	w.a = mirvar(0);
-	w.b = mirvar(0);
-	r.a = mirvar(0);
-	r.b = mirvar(0);
+	int mark;
+
+	mark = SM9_arena_mark();
+	x.a = SM9_tmp();
+	x.b = SM9_tmp();
+	y.a = SM9_tmp();
+	y.b = SM9_tmp();
+	z.a = SM9_tmp();
+	z.b = SM9_tmp();
+	w.a = SM9_tmp();
+	w.b = SM9_tmp();
+	r.a = SM9_tmp();
+	r.b = SM9_tmp();
 
 	ecn2_get(&A, &x, &y, &z);
 	zzn2_copy(&F, &r); //r=F
@@ -51,6 +54,7 @@ void q_power_frobenius(ecn2 A, zzn2 F)
 	zzn2_mul(&w, &y, &y);
 	zzn2_conj(&z, &z);
 	ecn2_setxyz(&x, &y, &z, &A);
+	SM9_arena_release(mark);
 }
 
 /****************************************************************
@@ -131,8 +135,8 @@ P is a point of order q in G1. Q(x,y) is a point of order q in G2.
 Note that P is a point on the sextic twist of the curve over Fp^2,
 Q(x,y) is a point on the curve over the base field Fp
 see ake12bnx.cpp for details in MIRACL c++ source file
-Calls:          MIRACL functions,zzn12_init,g,q_power_frobenius
-zzn12_copy,zzn12_conj,zzn12_div,zzn12_powq,zzn12_inverse
+Calls:          MIRACL functions,zzn12_tmp,g,q_power_frobenius
+zzn12_conj,final_exp,SM9_arena_mark,SM9_tmp,SM9_arena_release
 Called By:      ecap
 Input:          ecn2 P,big Qx,big Qy,big x,zzn2 X
 Output:         zzn12 *r
@@ -142,36 +146,29 @@ Others:
 ****************************************************************/
 BOOL fast_pairing(ecn2 P, big Qx, big Qy, big x, zzn2 X, zzn12 *r)
 {
-	int i, nb;
-	big n, zero, negify_x;
+	int i, nb, mark, step;
+	big n, zero;
 	ecn2 A, KA;
-	zzn12 t0, x0, x1, x2, x3, x4, x5, res;
+	zzn12 res;
 
-	zero = mirvar(0);
-	n = mirvar(0);
-	negify_x = mirvar(0);
-	A.x.a = mirvar(0);
-	A.x.b = mirvar(0);
-	A.y.a = mirvar(0);
-	A.y.b = mirvar(0);
-	A.z.a = mirvar(0);
-	A.z.b = mirvar(0);
+	mark = SM9_arena_mark();
+	zero = SM9_tmp();
+	n = SM9_tmp();
+	A.x.a = SM9_tmp();
+	A.x.b = SM9_tmp();
+	A.y.a = SM9_tmp();
+	A.y.b = SM9_tmp();
+	A.z.a = SM9_tmp();
+	A.z.b = SM9_tmp();
 	A.marker = MR_EPOINT_INFINITY;
-	KA.x.a = mirvar(0);
-	KA.x.b = mirvar(0);
-	KA.y.a = mirvar(0);
-	KA.y.b = mirvar(0);
-	KA.z.a = mirvar(0);
-	KA.z.b = mirvar(0);
+	KA.x.a = SM9_tmp();
+	KA.x.b = SM9_tmp();
+	KA.y.a = SM9_tmp();
+	KA.y.b = SM9_tmp();
+	KA.z.a = SM9_tmp();
+	KA.z.b = SM9_tmp();
 	KA.marker = MR_EPOINT_INFINITY;
-	zzn12_init(&t0);
-	zzn12_init(&x0);
-	zzn12_init(&x1);
-	zzn12_init(&x2);
-	zzn12_init(&x3);
-	zzn12_init(&x4);
-	zzn12_init(&x5);
-	zzn12_init(&res);
+	zzn12_tmp(&res);
 
 	premult(x, 6, n);
 	incr(n, 2, n);               //n=(6*x+2);
@@ -188,9 +185,11 @@ BOOL fast_pairing(ecn2 P, big Qx, big Qy, big x, zzn2 X, zzn12 *r)
 	for (i = nb - 2; i >= 0; i--)
 	{
 		zzn12_mul(res, res, &res);
+		step = SM9_arena_mark(); //the line values of one step
 		zzn12_mul(res, g(&A, &A, Qx, Qy), &res);
 		if (mr_testbit(n, i))
 			zzn12_mul(res, g(&A, &P, Qx, Qy), &res);
+		SM9_arena_release(step);
 	}
 	// Combining ideas due to Longa, Aranha et al. and Naehrig
 	ecn2_copy(&P, &KA);
@@ -206,7 +205,70 @@ BOOL fast_pairing(ecn2 P, big Qx, big Qy, big x, zzn2 X, zzn12 *r)
 	zzn12_mul(res, g(&A, &KA, Qx, Qy), &res);
 
 	if (zzn4_iszero(&res.a) && zzn4_iszero(&res.b) && zzn4_iszero(&res.c))
+	{
+		SM9_arena_release(mark);
 		return FALSE;
+	}
+
+	final_exp(res, x, X, r);
+	return SM9_arena_release(mark);
+}
+
+/****************************************************************
+Function:       final_exp
+Description:    final exponentiation of the R-ate pairing, r=res^((p^12-1)/N):
+final_exp_easy, final_exp_frob, the three powers of -x, then final_exp_hard
+see ake12bnx.cpp for details in MIRACL c++ source file
+Calls:          MIRACL functions,zzn12_tmp,zzn12_pow,final_exp_easy,
+final_exp_frob,final_exp_hard,SM9_arena_mark,SM9_tmp,SM9_arena_release
+Called By:      fast_pairing,ecap_fixed
+Input:          zzn12 res        //value of the Miller loop, not zero
+big x,zzn2 X
+Output:         zzn12 *r
+Return:         NULL
+Others:         SM9_ecap_pool runs the same steps on the threads of a pool
+****************************************************************/
+void final_exp(zzn12 res, big x, zzn2 X, zzn12 *r)
+{
+	big negify_x;
+	zzn12 e, x0, x2, x4, t0;
+	int mark;
+
+	mark = SM9_arena_mark();
+	negify_x = SM9_tmp();
+	zzn12_tmp(&e);
+	zzn12_tmp(&x0);
+
+	final_exp_easy(res, X, &e);
+	final_exp_frob(e, X, &x0);
+	negify(x, negify_x);
+	x4 = zzn12_pow(e, negify_x); //negify_x=-x   x is sparse.
+	x2 = zzn12_pow(x4, negify_x);
+	t0 = zzn12_pow(x2, negify_x);
+	final_exp_hard(e, x0, x4, x2, t0, X, r);
+	SM9_arena_release(mark);
+}
+
+/****************************************************************
+Function:       final_exp_easy
+Description:    easy part of the final exponentiation, r=res^((p^6-1)*(p^2+1)),
+r is unitary
+Calls:          MIRACL functions,zzn12_tmp,zzn12_copy,zzn12_conj,zzn12_div,
+zzn12_powq,zzn12_mul,SM9_arena_mark,SM9_arena_release
+Called By:      final_exp,SM9_ecap_pool
+Input:          zzn12 res        //value of the Miller loop, not zero, overwritten
+zzn2 X
+Output:         zzn12 *r
+Return:         NULL
+Others:
+****************************************************************/
+void final_exp_easy(zzn12 res, zzn2 X, zzn12 *r)
+{
+	zzn12 t0;
+	int mark;
+
+	mark = SM9_arena_mark();
+	zzn12_tmp(&t0);
 
 	// The final exponentiation
 	zzn12_copy(&res, &t0); //t0=r;
@@ -222,28 +284,73 @@ BOOL fast_pairing(ecn2 P, big Qx, big Qy, big x, zzn2 X, zzn12 *r)
 	zzn12_mul(res, t0, &res); // r^[(p^6-1)*(p^2+1)]
 	res.miller = FALSE;
 	res.unitary = TRUE;
+	zzn12_copy(&res, r);
+	SM9_arena_release(mark);
+}
+
+/****************************************************************
+Function:       final_exp_frob
+Description:    Frobenius branch of the hard part of the final exponentiation,
+x0=(res^(p^2)*res*res^p)^p, it does not depend on the powers of -x
+Calls:          zzn12_tmp,zzn12_copy,zzn12_powq,zzn12_mul,SM9_arena_mark,
+SM9_arena_release
+Called By:      final_exp,SM9_pair_pow
+Input:          zzn12 res        //from final_exp_easy, only read
+zzn2 X
+Output:         zzn12 *x0
+Return:         NULL
+Others:
+****************************************************************/
+void final_exp_frob(zzn12 res, zzn2 X, zzn12 *x0)
+{
+	zzn12 t0, x1;
+	int mark;
+
+	mark = SM9_arena_mark();
+	zzn12_tmp(&t0);
+	zzn12_tmp(&x1);
 
 	// Newer new idea...
 	// See "On the final exponentiation for calculating pairings on ordinary elliptic curves"
 	// Michael Scott and Naomi Benger and Manuel Charlemagne and Luis J. Dominguez Perez and Ezekiel J. Kachisa
 	zzn12_copy(&res, &t0);
 	zzn12_powq(X, &t0);
-	zzn12_copy(&t0, &x0);
-	zzn12_powq(X, &x0); //x0=t0
+	zzn12_copy(&t0, x0);
+	zzn12_powq(X, x0); //x0=t0
 
 	zzn12_mul(res, t0, &x1);
-	zzn12_mul(x0, x1, &x0); // x0*=(res*t0);
-	zzn12_powq(X, &x0);
+	zzn12_mul(*x0, x1, x0); // x0*=(res*t0);
+	zzn12_powq(X, x0);
+	SM9_arena_release(mark);
+}
+
+/****************************************************************
+Function:       final_exp_hard
+Description:    rest of the hard part of the final exponentiation, from the
+Frobenius branch and the three powers of -x
+Calls:          zzn12_tmp,zzn12_copy,zzn12_powq,zzn12_inverse,zzn12_div,
+zzn12_mul,SM9_arena_mark,SM9_arena_release
+Called By:      final_exp,SM9_ecap_pool
+Input:          zzn12 res        //from final_exp_easy
+zzn12 x0         //from final_exp_frob
+zzn12 x4,x2,t0   //res^(-x), x4^(-x) and x2^(-x)
+zzn2 X
+Output:         zzn12 *r
+Return:         NULL
+Others:         res, x4, x2 and t0 are overwritten
+****************************************************************/
+void final_exp_hard(zzn12 res, zzn12 x0, zzn12 x4, zzn12 x2, zzn12 t0, zzn2 X, zzn12 *r)
+{
+	zzn12 x1, x3, x5;
+	int mark;
+
+	mark = SM9_arena_mark();
+	zzn12_tmp(&x3);
 
 	x1 = zzn12_inverse(res); // just a conjugation!
-	negify(x, negify_x);
-	x4 = zzn12_pow(res, negify_x); //negify_x=-x   x is sparse.
 	zzn12_copy(&x4, &x3);
 	zzn12_powq(X, &x3);
-
-	x2 = zzn12_pow(x4, negify_x);
 	x5 = zzn12_inverse(x2);
-	t0 = zzn12_pow(x2, negify_x);
 
 	zzn12_powq(X, &x2);
 	zzn12_div(x4, x2, &x4);
@@ -268,8 +375,7 @@ BOOL fast_pairing(ecn2 P, big Qx, big Qy, big x, zzn2 X, zzn12 *r)
 	zzn12_mul(t0, res, &t0); //t0*=t0;t0*=res;
 
 	zzn12_copy(&t0, r); //r= t0;
-
-	return TRUE;
+	SM9_arena_release(mark);
 }
 
 /****************************************************************
@@ -279,35 +385,37 @@ Line Y-slope.X-c=0, through A, so intercept c=y-slope.x
 Line Y-slope.X-y+slope.x = (Y-y)-slope.(X-x) = 0
 Now evaluate at Q -> return (Qy-y)-slope.(Qx-x)
 see ake12bnx.cpp for details in MIRACL c++ source file
-Calls:          MIRACL functions,zzn12_init
+Calls:          MIRACL functions,zzn12_tmp,SM9_arena_mark,SM9_tmp,SM9_arena_release
 Called By:      g
 Input:          ecn2 A,ecn2 *C,ecn2 *B,zzn2 slope,zzn2 extra,BOOL Doubling,big Qx,big Qy
 Output:
 Return:         zzn12
-Others:
+Others:         the result is made of bigs of the arena
 ****************************************************************/
 zzn12 line(ecn2 A, ecn2 *C, ecn2 *B, zzn2 slope, zzn2 extra, BOOL Doubling, big Qx, big Qy)
 {
 	zzn12 res;
 	zzn2 X, Y, Z, Z2, U, QY, CZ;
 	big QX;
+	int mark;
 
-	QX = mirvar(0);
-	X.a = mirvar(0);
-	X.b = mirvar(0);
-	Y.a = mirvar(0);
-	Y.b = mirvar(0);
-	Z.a = mirvar(0);
-	Z.b = mirvar(0);
-	Z2.a = mirvar(0);
-	Z2.b = mirvar(0);
-	U.a = mirvar(0);
-	U.b = mirvar(0);
-	QY.a = mirvar(0);
-	QY.b = mirvar(0);
-	CZ.a = mirvar(0);
-	CZ.b = mirvar(0);
-	zzn12_init(&res);
+	zzn12_tmp(&res);
+	mark = SM9_arena_mark();
+	QX = SM9_tmp();
+	X.a = SM9_tmp();
+	X.b = SM9_tmp();
+	Y.a = SM9_tmp();
+	Y.b = SM9_tmp();
+	Z.a = SM9_tmp();
+	Z.b = SM9_tmp();
+	Z2.a = SM9_tmp();
+	Z2.b = SM9_tmp();
+	U.a = SM9_tmp();
+	U.b = SM9_tmp();
+	QY.a = SM9_tmp();
+	QY.b = SM9_tmp();
+	CZ.a = SM9_tmp();
+	CZ.b = SM9_tmp();
 
 	ecn2_getz(C, &CZ);
 	// Thanks to A. Menezes for pointing out this optimization...
@@ -371,6 +479,7 @@ zzn12 line(ecn2 A, ecn2 *C, ecn2 *B, zzn2 slope, zzn2 extra, BOOL Doubling, big
 			zzn2_copy(&Z, &(res.b.b));
 		}
 	}
+	SM9_arena_release(mark);
 	return res;
 }
 
@@ -378,32 +487,36 @@ zzn12 line(ecn2 A, ecn2 *C, ecn2 *B, zzn2 slope, zzn2 extra, BOOL Doubling, big
 Function:       g
 Description:    Add A=A+B  (or A=A+A),Return line function value
 see ake12bnx.cpp for details in MIRACL c++ source file
-Calls:          MIRACL functions,zzn12_init,line
+Calls:          MIRACL functions,zzn12_tmp,zzn12_copy,line,SM9_arena_mark,
+SM9_tmp,SM9_arena_release
 Called By:
 Input:          ecn2 *A,ecn2 *B,big Qx,big Qy
 Output:
 Return:         zzn12
-Others:
+Others:         the result is made of bigs of the arena
 ****************************************************************/
 zzn12 g(ecn2 *A, ecn2 *B, big Qx, big Qy)
 {
 	zzn2 lam, extra;
 	BOOL Doubling;
 	ecn2 P;
-	zzn12 res;
-	lam.a = mirvar(0);
-	lam.b = mirvar(0);
-	extra.a = mirvar(0);
-	extra.b = mirvar(0);
-	P.x.a = mirvar(0);
-	P.x.b = mirvar(0);
-	P.y.a = mirvar(0);
-	P.y.b = mirvar(0);
-	P.z.a = mirvar(0);
-	P.z.b = mirvar(0);
+	zzn12 res, l;
+	int mark;
+
+	zzn12_tmp(&res);
+	mark = SM9_arena_mark();
+	lam.a = SM9_tmp();
+	lam.b = SM9_tmp();
+	extra.a = SM9_tmp();
+	extra.b = SM9_tmp();
+	P.x.a = SM9_tmp();
+	P.x.b = SM9_tmp();
+	P.y.a = SM9_tmp();
+	P.y.b = SM9_tmp();
+	P.z.a = SM9_tmp();
+	P.z.b = SM9_tmp();
 	P.marker = MR_EPOINT_INFINITY;
 
-	zzn12_init(&res);
 	ecn2_copy(A, &P);
 	Doubling = ecn2_add2(B, A, &lam, &extra);
 	if (A->marker == MR_EPOINT_INFINITY)
@@ -413,7 +526,11 @@ zzn12 g(ecn2 *A, ecn2 *B, big Qx, big Qy)
 		res.unitary = TRUE;
 	}
 	else
-		res = line(P, A, B, lam, extra, Doubling, Qx, Qy);
+	{
+		l = line(P, A, B, lam, extra, Doubling, Qx, Qy);
+		zzn12_copy(&l, &res);
+	}
+	SM9_arena_release(mark);
 	return res;
 }
 
@@ -440,8 +557,7 @@ void set_frobenius_constant(zzn2 *X)
 	convert(1, one);
 	convert(2, two);
 
-	mip = get_mip();
-	copy(mip->modulus, p);
+	copy(get_mip()->modulus, p);
 
 	switch (get_mip()->pmod8)
 	{
@@ -467,27 +583,30 @@ void set_frobenius_constant(zzn2 *X)
 Function:       ecap
 Description:    caculate Rate pairing
 see ake12bnx.cpp for details in MIRACL c++ source file
-Calls:          MIRACL functions,fast_pairing
+Calls:          MIRACL functions,fast_pairing,SM9_arena_mark,SM9_tmp,SM9_arena_release
 Called By:      SM9_Sign,SM9_Verify
 Input:          ecn2 P,epoint *Q, big x,zzn2 X
 Output:         zzn12 *r
 Return:         FALSE: calculation error
 TRUE: correct calculation
-Others:
+Others:         all the temporaries of the pairing are given back on return
 ****************************************************************/
 BOOL ecap(ecn2 P, epoint *Q, big x, zzn2 X, zzn12 *r)
 {
 	BOOL Ok;
 	big Qx, Qy;
-	Qx = mirvar(0);
-	Qy = mirvar(0);
+	int mark;
+
+	mark = SM9_arena_mark();
+	Qx = SM9_tmp();
+	Qy = SM9_tmp();
 
 	ecn2_norm(&P);
 	epoint_get(Q, Qx, Qy);
 
 	Ok = fast_pairing(P, Qx, Qy, x, X, r);
 
-	if (Ok)
+	if (SM9_arena_release(mark) && Ok)
 		return TRUE;
 
 	return FALSE;
@@ -498,7 +617,8 @@ Function:       member
 Description:    ctest if a zzn12 element is of order q
 test r^q = r^(p+1-t) =1, so test r^p=r^(t-1)
 see ake12bnx.cpp for details in MIRACL c++ source file
-Calls:          MIRACL functions,zzn12_init,zzn12_copy,zzn12_powq
+Calls:          MIRACL functions,zzn12_tmp,zzn12_copy,zzn12_powq,SM9_arena_mark,
+SM9_tmp,SM9_arena_release
 Called By:      SM9_Sign,SM9_Verify
 Input:          zzn12 r,big x,zzn2 F
 Output:         NULL
@@ -510,9 +630,12 @@ BOOL member(zzn12 r, big x, zzn2 F)
 {
 	zzn12 w;
 	big six;
+	BOOL Ok;
+	int mark;
 
-	six = mirvar(0);
-	zzn12_init(&w);
+	mark = SM9_arena_mark();
+	six = SM9_tmp();
+	zzn12_tmp(&w);
 
 	convert(6, six);
 	zzn12_copy(&r, &w); //w=r
@@ -520,7 +643,504 @@ BOOL member(zzn12 r, big x, zzn2 F)
 	r = zzn12_pow(r, x);
 	r = zzn12_pow(r, x);
 	r = zzn12_pow(r, six); // t-1=6x^2
-	if (zzn4_compare(&w.a, &r.a) && zzn4_compare(&w.a, &r.a) && zzn4_compare(&w.a, &r.a))
-		return TRUE;
-	return FALSE;
-}
\ No newline at end of file
+	Ok = zzn4_compare(&w.a, &r.a) && zzn4_compare(&w.a, &r.a) && zzn4_compare(&w.a, &r.a);
+	return SM9_arena_release(mark) && Ok;
+}
+
+/****************************************************************
+Function:       line_prep
+Description:    A=A+B (or A=A+A) as g does, and keep the part of the line
+function that does not depend on Q: the line evaluated at Q(x,y) is
+a*y+b in r.a and c*x in r.c.b (r.b.b for the D-type twist)
+see line for the formulas
+Calls:          MIRACL functions
+Called By:      ecap_prep
+Input:          ecn2 *A,ecn2 *B
+Output:         ecn2 *A,zzn2 *a,zzn2 *b,zzn2 *c
+Return:         FALSE: A+B is the point at infinity, A or B is not of order N
+TRUE: correct calculation
+Others:
+****************************************************************/
+static BOOL line_prep(ecn2 *A, ecn2 *B, zzn2 *a, zzn2 *b, zzn2 *c)
+{
+	zzn2 lam, extra, X, Y, Z, Z2, CZ;
+	ecn2 P;
+	BOOL Doubling;
+	char *mem;
+
+	mem = (char *)memalloc(20);
+	lam.a = mirvar_mem(mem, 0);
+	lam.b = mirvar_mem(mem, 1);
+	extra.a = mirvar_mem(mem, 2);
+	extra.b = mirvar_mem(mem, 3);
+	X.a = mirvar_mem(mem, 4);
+	X.b = mirvar_mem(mem, 5);
+	Y.a = mirvar_mem(mem, 6);
+	Y.b = mirvar_mem(mem, 7);
+	Z.a = mirvar_mem(mem, 8);
+	Z.b = mirvar_mem(mem, 9);
+	Z2.a = mirvar_mem(mem, 10);
+	Z2.b = mirvar_mem(mem, 11);
+	CZ.a = mirvar_mem(mem, 12);
+	CZ.b = mirvar_mem(mem, 13);
+	P.x.a = mirvar_mem(mem, 14);
+	P.x.b = mirvar_mem(mem, 15);
+	P.y.a = mirvar_mem(mem, 16);
+	P.y.b = mirvar_mem(mem, 17);
+	P.z.a = mirvar_mem(mem, 18);
+	P.z.b = mirvar_mem(mem, 19);
+	P.marker = MR_EPOINT_INFINITY;
+
+	ecn2_copy(A, &P);
+	Doubling = ecn2_add2(B, A, &lam, &extra);
+	if (A->marker == MR_EPOINT_INFINITY)
+	{
+		memkill(mem, 20);
+		return FALSE;
+	}
+	ecn2_getz(A, &CZ);
+	if (Doubling)
+	{
+		//a=CZ*Z^2, b=slope*X-extra, c=-(Z^2*slope)
+		ecn2_get(&P, &X, &Y, &Z);
+		zzn2_mul(&Z, &Z, &Z2);
+		zzn2_mul(&lam, &X, b);
+		zzn2_sub(b, &extra, b);
+		zzn2_mul(&CZ, &Z2, a);
+		zzn2_mul(&Z2, &lam, c);
+		zzn2_negate(c, c);
+	}
+	else
+	{
+		//a=CZ, b=slope*X-Y*CZ, c=-slope
+		ecn2_getxy(B, &X, &Y);
+		zzn2_mul(&lam, &X, b);
+		zzn2_mul(&Y, &CZ, &Y);
+		zzn2_sub(b, &Y, b);
+		zzn2_copy(&CZ, a);
+		zzn2_negate(&lam, c);
+	}
+	if (get_mip()->TWIST == MR_SEXTIC_M)
+		zzn2_txx(a); // "multiplied across" by i, as line does with Qy
+
+	memkill(mem, 20);
+	return TRUE;
+}
+
+/****************************************************************
+Function:       ecap_prep
+Description:    lines of the Miller loop of fast_pairing for a fixed P in G2,
+so that e(P,Q) for many Q only evaluates them at Q
+Calls:          MIRACL functions,line_prep,q_power_frobenius
+Called By:      SM9_exch_key_init,SM9_recv_key_init,SM9_pub_lines,SM9_Init
+Input:          ecn2 P,big x,zzn2 X
+Output:         ecap_lines *L
+Return:         FALSE: can not get memory, or P is not of order N
+TRUE: correct calculation
+Others:         release L with ecap_lines_free
+****************************************************************/
+BOOL ecap_prep(ecn2 P, big x, zzn2 X, ecap_lines *L)
+{
+	int i, k, nb;
+	big n;
+	ecn2 A, KA;
+	BOOL Ok = TRUE;
+	char *mem;
+
+	memset(L, 0, sizeof(ecap_lines));
+	mem = (char *)memalloc(13);
+	if (mem == NULL)
+		return FALSE;
+	n = mirvar_mem(mem, 0);
+	A.x.a = mirvar_mem(mem, 1);
+	A.x.b = mirvar_mem(mem, 2);
+	A.y.a = mirvar_mem(mem, 3);
+	A.y.b = mirvar_mem(mem, 4);
+	A.z.a = mirvar_mem(mem, 5);
+	A.z.b = mirvar_mem(mem, 6);
+	A.marker = MR_EPOINT_INFINITY;
+	KA.x.a = mirvar_mem(mem, 7);
+	KA.x.b = mirvar_mem(mem, 8);
+	KA.y.a = mirvar_mem(mem, 9);
+	KA.y.b = mirvar_mem(mem, 10);
+	KA.z.a = mirvar_mem(mem, 11);
+	KA.z.b = mirvar_mem(mem, 12);
+	KA.marker = MR_EPOINT_INFINITY;
+
+	premult(x, 6, n);
+	incr(n, 2, n); //n=(6*x+2);
+	L->negx = (size(x) < 0);
+	if (L->negx)
+		negify(n, n);
+	nb = logb2(n);
+
+	//one doubling per bit, one addition per bit set, two more at the end
+	L->n = nb - 1 + 2;
+	for (i = nb - 2; i >= 0; i--)
+		if (mr_testbit(n, i))
+			L->n++;
+	L->mem = (char *)memalloc(6 * L->n);
+	L->a = (zzn2 *)malloc(3 * L->n * sizeof(zzn2));
+	if (L->mem == NULL || L->a == NULL)
+	{
+		ecap_lines_free(L);
+		memkill(mem, 13);
+		return FALSE;
+	}
+	L->b = L->a + L->n;
+	L->c = L->b + L->n;
+	for (k = 0; k < L->n; k++)
+	{
+		L->a[k].a = mirvar_mem(L->mem, 6 * k);
+		L->a[k].b = mirvar_mem(L->mem, 6 * k + 1);
+		L->b[k].a = mirvar_mem(L->mem, 6 * k + 2);
+		L->b[k].b = mirvar_mem(L->mem, 6 * k + 3);
+		L->c[k].a = mirvar_mem(L->mem, 6 * k + 4);
+		L->c[k].b = mirvar_mem(L->mem, 6 * k + 5);
+	}
+
+	//the same steps as fast_pairing
+	ecn2_norm(&P);
+	ecn2_copy(&P, &A);
+	k = 0;
+	for (i = nb - 2; i >= 0 && Ok; i--)
+	{
+		Ok = line_prep(&A, &A, &L->a[k], &L->b[k], &L->c[k]);
+		k++;
+		if (Ok && mr_testbit(n, i))
+		{
+			Ok = line_prep(&A, &P, &L->a[k], &L->b[k], &L->c[k]);
+			k++;
+		}
+	}
+	if (Ok)
+	{
+		ecn2_copy(&P, &KA);
+		q_power_frobenius(KA, X);
+		if (L->negx)
+			ecn2_negate(&A, &A);
+		Ok = line_prep(&A, &KA, &L->a[k], &L->b[k], &L->c[k]);
+		k++;
+	}
+	if (Ok)
+	{
+		q_power_frobenius(KA, X);
+		ecn2_negate(&KA, &KA);
+		Ok = line_prep(&A, &KA, &L->a[k], &L->b[k], &L->c[k]);
+	}
+
+	memkill(mem, 13);
+	if (!Ok)
+		ecap_lines_free(L);
+	return Ok;
+}
+
+/****************************************************************
+Function:       ecap_fixed
+Description:    R-ate pairing e(P,Q) with the lines of P made by ecap_prep:
+the Miller loop only evaluates them at Q, then the final exponentiation
+Calls:          ecap_multi
+Called By:      SM9_exch_respond,SM9_exch_confirm,SM9_batch_open,SM9_recv_key_init,
+SM9_pub_lines,SM9_pool_pairing
+Input:          ecap_lines *L,epoint *Q,big x,zzn2 X
+Output:         zzn12 *r
+Return:         FALSE: calculation error
+TRUE: correct calculation
+Others:         L is only read and may be shared by threads
+****************************************************************/
+BOOL ecap_fixed(ecap_lines *L, epoint *Q, big x, zzn2 X, zzn12 *r)
+{
+	return ecap_multi(1, &L, &Q, x, X, r);
+}
+
+/****************************************************************
+Function:       line_eval
+Description:    line k of the table L evaluated at (Qx,Qy), in Montgomery form
+Calls:          MIRACL functions
+Called By:      ecap_multi
+Input:          ecap_lines *L,int k,big Qx,big Qy
+Output:         zzn12 *l
+Return:         NULL
+Others:         only the a.a, a.b and c.b (M-twist) or b.b (D-twist) parts of l
+are written, the others must stay zero
+****************************************************************/
+static void line_eval(ecap_lines *L, int k, big Qx, big Qy, zzn12 *l)
+{
+	zzn2_smul(&L->a[k], Qy, &l->a.a);
+	zzn2_copy(&L->b[k], &l->a.b);
+	if (get_mip()->TWIST == MR_SEXTIC_M)
+		zzn2_smul(&L->c[k], Qx, &l->c.b);
+	else
+		zzn2_smul(&L->c[k], Qx, &l->b.b);
+}
+
+/****************************************************************
+Function:       ecap_loop
+Description:    n=|6x+2|, the loop parameter of the R-ate pairing
+Calls:          MIRACL functions
+Called By:      ecap_multi,ecap_miller_seg,SM9_ecap_pool
+Input:          big x
+Output:         big n
+Return:         the number of bits of n, the Miller loop runs over bits nb-2..0
+Others:
+****************************************************************/
+int ecap_loop(big x, big n)
+{
+	premult(x, 6, n);
+	incr(n, 2, n);
+	if (size(x) < 0)
+		negify(n, n);
+	return logb2(n);
+}
+
+/****************************************************************
+Function:       ecap_q_get
+Description:    affine coordinates of the Q_j in Montgomery form, for line_eval
+Calls:          MIRACL functions,SM9_tmp
+Called By:      ecap_multi,ecap_miller_seg,ecap_miller_end
+Input:          int m,epoint *Q[]
+Output:         big Qx[],big Qy[]   //bigs of the arena, not set for a Q_j at infinity
+Return:         NULL
+Others:
+****************************************************************/
+static void ecap_q_get(int m, epoint *Q[], big Qx[], big Qy[])
+{
+	int j;
+
+	for (j = 0; j < m; j++)
+	{
+		Qx[j] = SM9_tmp();
+		Qy[j] = SM9_tmp();
+		if (point_at_infinity(Q[j]))
+			continue;
+		epoint_get(Q[j], Qx[j], Qy[j]);
+		nres(Qx[j], Qx[j]);
+		nres(Qy[j], Qy[j]);
+	}
+}
+
+/****************************************************************
+Function:       ecap_multi
+Description:    product of the R-ate pairings e(P_j,Q_j), j<m, with the lines
+of each P_j made by ecap_prep: one Miller loop whose squarings are shared by
+all pairs, each step multiplies in the line of every pair, and one final
+exponentiation for the product
+Calls:          MIRACL functions,zzn12_tmp,zzn12_mul,zzn12_conj,final_exp,
+line_eval,SM9_arena_mark,SM9_tmp,SM9_arena_release
+Called By:      ecap_fixed,SM9_batch_test,Unsigncrypt_into
+Input:          int m,ecap_lines *L[],epoint *Q[],big x,zzn2 X
+Output:         zzn12 *r
+Return:         FALSE: calculation error
+TRUE: correct calculation
+Others:         a Q_j at infinity is left out as e(P_j,O)=1, the tables are
+only read and may be shared by threads. Up to ECAP_MULTI_STACK pairs the
+points are kept on the stack, no heap memory is used
+****************************************************************/
+BOOL ecap_multi(int m, ecap_lines *L[], epoint *Q[], big x, zzn2 X, zzn12 *r)
+{
+	int i, j, k, nb, mark;
+	big n, *Qx, *Qy, Qxy[2 * ECAP_MULTI_STACK];
+	zzn12 res, l;
+	BOOL Ok = TRUE;
+
+	Qx = Qxy;
+	if (m > ECAP_MULTI_STACK)
+		Qx = (big *)malloc(sizeof(big) * 2 * m);
+	if (Qx == NULL)
+		return FALSE;
+	Qy = Qx + m;
+	mark = SM9_arena_mark();
+	n = SM9_tmp();
+	zzn12_tmp(&res);
+	zzn12_tmp(&l);
+
+	nb = ecap_loop(x, n);
+	ecap_q_get(m, Q, Qx, Qy);
+
+	zzn4_from_int(1, &res.a);
+	res.unitary = TRUE;
+	res.miller = TRUE;
+	k = 0;
+	for (i = nb - 2; i >= -1; i--)
+	{
+		if (i >= 0)
+			zzn12_mul(res, res, &res);
+		else if (L[0]->negx)
+			zzn12_conj(&res, &res);
+		//i>=0: the doubling line, i=-1: the two lines of the end
+		do
+		{
+			for (j = 0; j < m; j++)
+			{
+				if (point_at_infinity(Q[j]))
+					continue;
+				line_eval(L[j], k, Qx[j], Qy[j], &l);
+				zzn12_mul(res, l, &res);
+			}
+			k++;
+		} while (i < 0 && k < L[0]->n);
+		if (i >= 0 && mr_testbit(n, i))
+		{
+			for (j = 0; j < m; j++)
+			{
+				if (point_at_infinity(Q[j]))
+					continue;
+				line_eval(L[j], k, Qx[j], Qy[j], &l);
+				zzn12_mul(res, l, &res);
+			}
+			k++;
+		}
+	}
+	if (Qx != Qxy)
+		free(Qx);
+
+	if (zzn4_iszero(&res.a) && zzn4_iszero(&res.b) && zzn4_iszero(&res.c))
+		Ok = FALSE;
+	else
+		final_exp(res, x, X, r);
+	return SM9_arena_release(mark) && Ok;
+}
+
+/****************************************************************
+Function:       ecap_miller_seg
+Description:    the steps of bits hi..lo of the Miller loop of ecap_multi,
+started from 1, then squared lo more times. For segments that cut the bits
+nb-2..0 of |6x+2| the product of these values is the loop of ecap_multi
+before its two last lines: with the lines of ecap_prep the steps need no
+point of G2, and each segment can run on its own thread (Aranha et al.,
+parallel Miller loop)
+Calls:          MIRACL functions,ecap_loop,ecap_q_get,line_eval,zzn12_tmp,
+zzn12_mul,zzn12_copy,SM9_arena_mark,SM9_tmp,SM9_arena_release
+Called By:      SM9_pair_miller
+Input:          int m,ecap_lines *L[],epoint *Q[],big x
+int hi,lo        //nb-2>=hi>=lo>=0
+Output:         zzn12 *f         //already initiated
+Return:         FALSE: can not get memory
+TRUE: correct calculation
+Others:         the Q_j must be normalized, they and the tables are only read
+****************************************************************/
+BOOL ecap_miller_seg(int m, ecap_lines *L[], epoint *Q[], big x, int hi, int lo, zzn12 *f)
+{
+	int i, j, k, nb, mark;
+	big n, *Qx, *Qy, Qxy[2 * ECAP_MULTI_STACK];
+	zzn12 res, l;
+
+	Qx = Qxy;
+	if (m > ECAP_MULTI_STACK)
+		Qx = (big *)malloc(sizeof(big) * 2 * m);
+	if (Qx == NULL)
+		return FALSE;
+	Qy = Qx + m;
+	mark = SM9_arena_mark();
+	n = SM9_tmp();
+	zzn12_tmp(&res);
+	zzn12_tmp(&l);
+	nb = ecap_loop(x, n);
+	ecap_q_get(m, Q, Qx, Qy);
+
+	//the lines of the bits above hi come first in the tables
+	k = 0;
+	for (i = nb - 2; i > hi; i--)
+		k += mr_testbit(n, i) ? 2 : 1;
+
+	zzn4_from_int(1, &res.a);
+	res.unitary = TRUE;
+	res.miller = TRUE;
+	for (i = hi; i >= lo; i--)
+	{
+		if (i < hi)
+			zzn12_mul(res, res, &res);
+		for (j = 0; j < m; j++)
+		{
+			if (point_at_infinity(Q[j]))
+				continue;
+			line_eval(L[j], k, Qx[j], Qy[j], &l);
+			zzn12_mul(res, l, &res);
+		}
+		k++;
+		if (mr_testbit(n, i))
+		{
+			for (j = 0; j < m; j++)
+			{
+				if (point_at_infinity(Q[j]))
+					continue;
+				line_eval(L[j], k, Qx[j], Qy[j], &l);
+				zzn12_mul(res, l, &res);
+			}
+			k++;
+		}
+	}
+	//the squarings of the bits below lo
+	for (i = 0; i < lo; i++)
+		zzn12_mul(res, res, &res);
+	zzn12_copy(&res, f);
+
+	if (Qx != Qxy)
+		free(Qx);
+	return SM9_arena_release(mark);
+}
+
+/****************************************************************
+Function:       ecap_miller_end
+Description:    the end of the Miller loop of ecap_multi on the product of the
+segments of ecap_miller_seg: conjugation when x<0, then the two last lines
+Calls:          MIRACL functions,ecap_q_get,line_eval,zzn12_tmp,zzn12_mul,
+zzn12_conj,SM9_arena_mark,SM9_arena_release
+Called By:      SM9_ecap_pool
+Input:          int m,ecap_lines *L[],epoint *Q[]
+zzn12 *f         //the product of the segments
+Output:         zzn12 *f
+Return:         FALSE: can not get memory
+TRUE: correct calculation
+Others:
+****************************************************************/
+BOOL ecap_miller_end(int m, ecap_lines *L[], epoint *Q[], zzn12 *f)
+{
+	int j, k, mark;
+	big *Qx, *Qy, Qxy[2 * ECAP_MULTI_STACK];
+	zzn12 l;
+
+	Qx = Qxy;
+	if (m > ECAP_MULTI_STACK)
+		Qx = (big *)malloc(sizeof(big) * 2 * m);
+	if (Qx == NULL)
+		return FALSE;
+	Qy = Qx + m;
+	mark = SM9_arena_mark();
+	zzn12_tmp(&l);
+	ecap_q_get(m, Q, Qx, Qy);
+
+	if (L[0]->negx)
+		zzn12_conj(f, f);
+	for (k = L[0]->n - 2; k < L[0]->n; k++)
+		for (j = 0; j < m; j++)
+		{
+			if (point_at_infinity(Q[j]))
+				continue;
+			line_eval(L[j], k, Qx[j], Qy[j], &l);
+			zzn12_mul(*f, l, f);
+		}
+
+	if (Qx != Qxy)
+		free(Qx);
+	return SM9_arena_release(mark);
+}
+
+/****************************************************************
+Function:       ecap_lines_free
+Description:    release the lines made by ecap_prep
+Calls:          MIRACL functions
+Called By:      ecap_prep,SM9_exch_free
+Input:          ecap_lines *L
+Output:         NULL
+Return:         NULL
+Others:
+****************************************************************/
+void ecap_lines_free(ecap_lines *L)
+{
+	if (L->mem != NULL)
+		memkill(L->mem, 6 * L->n);
+	if (L->a != NULL)
+		free(L->a);
+	memset(L, 0, sizeof(ecap_lines));
+}
@@ -22,6 +22,17 @@ Function List:
 5.g
 6.fast_pairing
 7.ecap
+8.final_exp               //final exponentiation, split out of fast_pairing
+9.ecap_prep               //lines of the Miller loop of a fixed point of G2
+10.ecap_fixed             //R-ate pairing with the lines of ecap_prep
+11.ecap_lines_free        //release the lines
+12.ecap_multi             //product of pairings with the lines of ecap_prep, one Miller loop
+13.final_exp_easy         //easy part of the final exponentiation
+14.final_exp_frob         //Frobenius branch of the hard part
+15.final_exp_hard         //hard part from the Frobenius branch and the powers of -x
+16.ecap_loop              //|6x+2| and its number of bits
+17.ecap_miller_seg        //one segment of the Miller loop of ecap_multi, for threads
+18.ecap_miller_end        //conjugation and two last lines on the product of the segments
 Notes:
 **************************************************************************/
 
@@ -31,6 +42,19 @@ Notes:
 #include "miracl.h"
 #include "zzn12_operation.h"
 
+#define ECAP_MULTI_STACK 4 //pairs of ecap_multi whose points need no heap memory
+
+
+//lines of the Miller loop for a fixed P in G2, line k at Q(x,y) is a[k]*y+b[k]
+//in r.a and c[k]*x in r.c.b, in the order fast_pairing multiplies them in
+typedef struct
+{
+	int n;                //number of lines
+	zzn2 *a, *b, *c;
+	BOOL negx;            //x<0, the Miller value is conjugated before the last two lines
+	char *mem;            //the bigs of a, b and c
+} ecap_lines;
+
 void q_power_frobenius(ecn2 A, zzn2 F);
 zzn2 zzn2_pow(zzn2 x, big k);
 BOOL fast_pairing(ecn2 P, big Qx, big Qy, big x, zzn2 X, zzn12 *r);
@@ -39,6 +63,17 @@ zzn12 g(ecn2 *A, ecn2 *B, big Qx, big Qy);
 void set_frobenius_constant(zzn2 *X);
 BOOL ecap(ecn2 P, epoint *Q, big x, zzn2 X, zzn12 *r);
 BOOL member(zzn12 r, big x, zzn2 F);
+void final_exp(zzn12 res, big x, zzn2 X, zzn12 *r);
+void final_exp_easy(zzn12 res, zzn2 X, zzn12 *r);
+void final_exp_frob(zzn12 res, zzn2 X, zzn12 *x0);
+void final_exp_hard(zzn12 res, zzn12 x0, zzn12 x4, zzn12 x2, zzn12 t0, zzn2 X, zzn12 *r);
+BOOL ecap_prep(ecn2 P, big x, zzn2 X, ecap_lines *L);
+BOOL ecap_fixed(ecap_lines *L, epoint *Q, big x, zzn2 X, zzn12 *r);
+BOOL ecap_multi(int m, ecap_lines *L[], epoint *Q[], big x, zzn2 X, zzn12 *r);
+void ecap_lines_free(ecap_lines *L);
+int ecap_loop(big x, big n);
+BOOL ecap_miller_seg(int m, ecap_lines *L[], epoint *Q[], big x, int hi, int lo, zzn12 *f);
+BOOL ecap_miller_end(int m, ecap_lines *L[], epoint *Q[], zzn12 *f);
 
 #endif
 
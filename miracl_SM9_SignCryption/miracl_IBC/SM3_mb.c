@@ -0,0 +1,620 @@
+/************************************************************************
+FileName:
+SM3_mb.c
+Version:
+SM3_MB_V1.0
+Date:
+Oct 19,2026
+Description:
+Multi-buffer SM3, see SM3_mb.h. The lane core keeps word k of every lane in
+one vector, so a round of CF is the scalar round of KDF.c applied to
+SM3_MB_LANES messages at once.
+Function List:
+1.SM3_mb_job_init      //bind a job to its 32-byte output
+2.SM3_mb_job_add       //append a piece of message to a job
+3.SM3_mb_job_resume    //start a job from an SM3_STATE that has absorbed a prefix
+4.SM3_mb_next_block    //next 64-byte block of a lane, padding included
+5.SM3_mb_compress      //the lane core, compress one block in every lane
+6.SM3_256_mb           //the scheduler, hash an array of jobs
+7.SM3_KDF_midstate     //KDF keystream from the state that has absorbed Z
+8.SM3_KDF_mb           //KDF keystream, counter blocks hashed in the lanes
+9.SM3_KDF_thread       //thread body of SM3_KDF_resume
+10.SM3_KDF_resume      //KDF keystream from a midstate, counter ranges split over threads
+11.SM3_KDF_mt          //absorbs Z and calls SM3_KDF_resume
+************************************************************************/
+
+#include <string.h>
+#include "SM3_mb.h"
+#include "SM9_thread.h"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/* lanes still busy when the queue is empty are finished with the scalar core
+   once this few are left, a nearly empty vector is slower than the scalar rounds */
+#define SM3_MB_SCALAR_TAIL 2
+
+#define SM3_KDF_MB_JOBS (4 * SM3_MB_LANES) //counter blocks queued per SM3_256_mb call
+#define SM3_KDF_MAX_THREADS 64
+
+typedef struct
+{
+	SM3_MB_JOB *job;
+	int seg;          //piece being read
+	size_t off;       //offset in that piece
+	uint64_t bitlen;  //bit length of the whole job
+	int pad;          //0: no padding yet, 1: 0x80 written, 2: last block given out
+	unsigned char buf[64];
+} SM3_MB_LANE;
+
+typedef struct
+{
+	const SM3_STATE *mid;
+	uint32_t ct;
+	unsigned char *K;
+	size_t klen;
+} SM3_KDF_PART;
+
+#if defined(__AVX512F__)
+typedef __m512i SM3_VEC;
+#define SM3_V_LOAD(p) _mm512_loadu_si512((const void *)(p))
+#define SM3_V_STORE(p, x) _mm512_storeu_si512((void *)(p), (x))
+#define SM3_V_SET1(x) _mm512_set1_epi32((int)(x))
+#define SM3_V_ADD(a, b) _mm512_add_epi32((a), (b))
+#define SM3_V_XOR(a, b) _mm512_xor_si512((a), (b))
+#define SM3_V_ROTL(x, n) _mm512_rol_epi32((x), (n))
+#define SM3_V_XOR3(a, b, c) _mm512_ternarylogic_epi32((a), (b), (c), 0x96)
+#define SM3_V_FF1(a, b, c) _mm512_ternarylogic_epi32((a), (b), (c), 0xE8)
+#define SM3_V_GG1(e, f, g) _mm512_ternarylogic_epi32((e), (f), (g), 0xCA)
+#elif defined(__AVX2__)
+typedef __m256i SM3_VEC;
+#define SM3_V_LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define SM3_V_STORE(p, x) _mm256_storeu_si256((__m256i *)(p), (x))
+#define SM3_V_SET1(x) _mm256_set1_epi32((int)(x))
+#define SM3_V_ADD(a, b) _mm256_add_epi32((a), (b))
+#define SM3_V_XOR(a, b) _mm256_xor_si256((a), (b))
+#define SM3_V_ROTL(x, n) _mm256_or_si256(_mm256_slli_epi32((x), (n)), _mm256_srli_epi32((x), 32 - (n)))
+#define SM3_V_XOR3(a, b, c) SM3_V_XOR(SM3_V_XOR((a), (b)), (c))
+#define SM3_V_FF1(a, b, c) _mm256_or_si256(_mm256_and_si256((a), (b)), _mm256_and_si256(_mm256_or_si256((a), (b)), (c)))
+#define SM3_V_GG1(e, f, g) _mm256_or_si256(_mm256_and_si256((e), (f)), _mm256_andnot_si256((e), (g)))
+#endif
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+
+#define SM3_V_FF0(a, b, c) SM3_V_XOR3((a), (b), (c))
+#define SM3_V_GG0(e, f, g) SM3_V_XOR3((e), (f), (g))
+#define SM3_V_P0(x) SM3_V_XOR3((x), SM3_V_ROTL((x), 9), SM3_V_ROTL((x), 17))
+#define SM3_V_P1(x) SM3_V_XOR3((x), SM3_V_ROTL((x), 15), SM3_V_ROTL((x), 23))
+
+/* the scalar SM3_ROUND of KDF.c on vectors, same register renaming */
+#define SM3_V_ROUND(A, B, C, D, E, F, G, H, FF, GG, j)                                  \
+	do                                                                                  \
+	{                                                                                   \
+		SM3_VEC A12 = SM3_V_ROTL(A, 12);                                                \
+		SM3_VEC SS1 = SM3_V_ROTL(SM3_V_ADD(SM3_V_ADD(A12, E), SM3_V_SET1(SM3_Tj[j])), 7); \
+		SM3_VEC SS2 = SM3_V_XOR(SS1, A12);                                              \
+		D = SM3_V_ADD(SM3_V_ADD(FF(A, B, C), D), SM3_V_ADD(SS2, SM3_V_XOR(W[j], W[(j) + 4]))); \
+		H = SM3_V_ADD(SM3_V_ADD(GG(E, F, G), H), SM3_V_ADD(SS1, W[j]));                 \
+		B = SM3_V_ROTL(B, 9);                                                           \
+		F = SM3_V_ROTL(F, 19);                                                          \
+		H = SM3_V_P0(H);                                                                \
+	} while (0)
+
+#define SM3_V_ROUND4(FF, GG, j)                                 \
+	SM3_V_ROUND(A, B, C, D, E, F, G, H, FF, GG, (j));           \
+	SM3_V_ROUND(D, A, B, C, H, E, F, G, FF, GG, (j) + 1);       \
+	SM3_V_ROUND(C, D, A, B, G, H, E, F, FF, GG, (j) + 2);       \
+	SM3_V_ROUND(B, C, D, A, F, G, H, E, FF, GG, (j) + 3)
+
+/* 8 lanes of 8 big-endian words: out[k] holds word k of the lanes p[0..7] */
+static void SM3_mb_load8x8(__m256i out[8], const unsigned char *const p[8], int off)
+{
+	const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	__m256i r[8], t[8], u[8];
+	int i;
+
+	for (i = 0; i < 8; i++)
+		r[i] = _mm256_loadu_si256((const __m256i *)(p[i] + off));
+	for (i = 0; i < 8; i += 2)
+	{
+		t[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+		t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+	}
+	for (i = 0; i < 8; i += 4)
+	{
+		u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+		u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+		u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+		u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+	}
+	for (i = 0; i < 4; i++)
+	{
+		out[i] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u[i], u[i + 4], 0x20), bswap);
+		out[i + 4] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u[i], u[i + 4], 0x31), bswap);
+	}
+}
+
+#endif
+
+/******************************************************************************
+Function:       SM3_mb_job_init
+Description:    start an empty job whose hash will be written to hash
+Calls:
+Called By:
+Input:          SM3_MB_JOB *job
+unsigned char hash[]  //32 bytes
+Output:         SM3_MB_JOB *job
+Return:         null
+Others:
+*******************************************************************************/
+void SM3_mb_job_init(SM3_MB_JOB *job, unsigned char hash[])
+{
+	job->nseg = 0;
+	job->iv = NULL;
+	job->prelen = 0;
+	job->hash = hash;
+}
+
+/******************************************************************************
+Function:       SM3_mb_job_add
+Description:    append len bytes to the message of a job
+Calls:
+Called By:
+Input:          SM3_MB_JOB *job
+const unsigned char *data
+size_t len
+Output:         SM3_MB_JOB *job
+Return:         0: success
+1: the job already holds SM3_MB_MAXSEG pieces
+Others:         data is only referenced, it must stay valid until SM3_256_mb returns
+*******************************************************************************/
+int SM3_mb_job_add(SM3_MB_JOB *job, const unsigned char *data, size_t len)
+{
+	if (job->nseg == SM3_MB_MAXSEG)
+		return 1;
+	job->seg[job->nseg] = data;
+	job->seglen[job->nseg] = len;
+	job->nseg++;
+	return 0;
+}
+
+/******************************************************************************
+Function:       SM3_mb_job_resume
+Description:    start a job that continues the message absorbed by md: the
+job starts from md->state, and the bytes waiting in md->buf are its first piece
+Calls:          SM3_mb_job_init, SM3_mb_job_add
+Called By:      SM3_KDF_midstate
+Input:          const SM3_STATE *md
+unsigned char hash[]  //32 bytes
+Output:         SM3_MB_JOB *job
+Return:         null
+Others:         md is only referenced and must not change until SM3_256_mb
+returns, any number of jobs may resume from the same md
+*******************************************************************************/
+void SM3_mb_job_resume(SM3_MB_JOB *job, const SM3_STATE *md, unsigned char hash[])
+{
+	SM3_mb_job_init(job, hash);
+	job->iv = md->state;
+	job->prelen = md->length >> 3;
+	SM3_mb_job_add(job, md->buf, md->curlen);
+}
+
+/******************************************************************************
+Function:       SM3_mb_next_block
+Description:    give out the next block of the message in a lane. A whole block
+inside one piece is returned in place, otherwise the block is gathered in
+l->buf, where the padding and the bit length are appended at the end
+Calls:
+Called By:      SM3_256_mb
+Input:          SM3_MB_LANE *l
+Output:         SM3_MB_LANE *l
+Return:         the 64-byte block, NULL when the job is finished
+Others:         the block in l->buf is valid until the next call
+*******************************************************************************/
+static const unsigned char *SM3_mb_next_block(SM3_MB_LANE *l)
+{
+	SM3_MB_JOB *job = l->job;
+	const unsigned char *p;
+	size_t pos = 0, n;
+
+	if (l->pad == 2)
+		return NULL;
+
+	while (l->seg < job->nseg && l->off == job->seglen[l->seg])
+	{
+		l->seg++;
+		l->off = 0;
+	}
+	if (l->seg < job->nseg && job->seglen[l->seg] - l->off >= 64)
+	{
+		p = job->seg[l->seg] + l->off;
+		l->off += 64;
+		return p;
+	}
+
+	while (pos < 64 && l->seg < job->nseg)
+	{
+		n = job->seglen[l->seg] - l->off;
+		if (n > 64 - pos)
+			n = 64 - pos;
+		memcpy(l->buf + pos, job->seg[l->seg] + l->off, n);
+		pos += n;
+		l->off += n;
+		if (l->off == job->seglen[l->seg])
+		{
+			l->seg++;
+			l->off = 0;
+		}
+	}
+	if (pos == 64)
+		return l->buf;
+
+	if (l->pad == 0)
+	{
+		l->buf[pos++] = 0x80;
+		l->pad = 1;
+	}
+	if (pos <= 56)
+	{
+		memset(l->buf + pos, 0, 56 - pos);
+		SM3_STORE32(l->buf + 56, (uint32_t)(l->bitlen >> 32));
+		SM3_STORE32(l->buf + 60, (uint32_t)l->bitlen);
+		l->pad = 2;
+	}
+	else
+		memset(l->buf + pos, 0, 64 - pos);
+	return l->buf;
+}
+
+/******************************************************************************
+Function:       SM3_mb_compress
+Description:    compress one block in each lane, V[k][i] is word k of the
+chaining value of lane i
+Calls:          SM3_compress_blocks (no SIMD)
+Called By:      SM3_256_mb
+Input:          uint32_t V[8][SM3_MB_LANES]
+const unsigned char *blk[SM3_MB_LANES]  //NULL for an idle lane
+Output:         uint32_t V[8][SM3_MB_LANES]
+Return:         null
+Others:         the chaining value of an idle lane is left undefined
+*******************************************************************************/
+void SM3_mb_compress(uint32_t V[8][SM3_MB_LANES], const unsigned char *blk[SM3_MB_LANES])
+{
+#if defined(__AVX512F__) || defined(__AVX2__)
+	static const unsigned char zero[64] = { 0 };
+	const unsigned char *p[SM3_MB_LANES];
+	SM3_VEC W[68];
+	SM3_VEC A, B, C, D, E, F, G, H;
+	int i, j;
+
+	for (i = 0; i < SM3_MB_LANES; i++)
+		p[i] = blk[i] ? blk[i] : zero;
+
+#if defined(__AVX512F__)
+	{
+		__m256i lo[8], hi[8];
+
+		for (j = 0; j < 64; j += 32)
+		{
+			SM3_mb_load8x8(lo, p, j);
+			SM3_mb_load8x8(hi, p + 8, j);
+			for (i = 0; i < 8; i++)
+				W[j / 4 + i] = _mm512_inserti64x4(_mm512_castsi256_si512(lo[i]), hi[i], 1);
+		}
+	}
+#else
+	SM3_mb_load8x8(W, p, 0);
+	SM3_mb_load8x8(W + 8, p, 32);
+#endif
+	for (j = 16; j < 68; j++)
+	{
+		SM3_VEC tmp = SM3_V_XOR3(W[j - 16], W[j - 9], SM3_V_ROTL(W[j - 3], 15));
+		W[j] = SM3_V_XOR3(SM3_V_P1(tmp), SM3_V_ROTL(W[j - 13], 7), W[j - 6]);
+	}
+
+	A = SM3_V_LOAD(V[0]);
+	B = SM3_V_LOAD(V[1]);
+	C = SM3_V_LOAD(V[2]);
+	D = SM3_V_LOAD(V[3]);
+	E = SM3_V_LOAD(V[4]);
+	F = SM3_V_LOAD(V[5]);
+	G = SM3_V_LOAD(V[6]);
+	H = SM3_V_LOAD(V[7]);
+
+	SM3_V_ROUND4(SM3_V_FF0, SM3_V_GG0, 0);
+	SM3_V_ROUND4(SM3_V_FF0, SM3_V_GG0, 4);
+	SM3_V_ROUND4(SM3_V_FF0, SM3_V_GG0, 8);
+	SM3_V_ROUND4(SM3_V_FF0, SM3_V_GG0, 12);
+	SM3_V_ROUND4(SM3_V_FF1, SM3_V_GG1, 16);
+	SM3_V_ROUND4(SM3_V_FF1, SM3_V_GG1, 20);
+	SM3_V_ROUND4(SM3_V_FF1, SM3_V_GG1, 24);
+	SM3_V_ROUND4(SM3_V_FF1, SM3_V_GG1, 28);
+	SM3_V_ROUND4(SM3_V_FF1, SM3_V_GG1, 32);
+	SM3_V_ROUND4(SM3_V_FF1, SM3_V_GG1, 36);
+	SM3_V_ROUND4(SM3_V_FF1, SM3_V_GG1, 40);
+	SM3_V_ROUND4(SM3_V_FF1, SM3_V_GG1, 44);
+	SM3_V_ROUND4(SM3_V_FF1, SM3_V_GG1, 48);
+	SM3_V_ROUND4(SM3_V_FF1, SM3_V_GG1, 52);
+	SM3_V_ROUND4(SM3_V_FF1, SM3_V_GG1, 56);
+	SM3_V_ROUND4(SM3_V_FF1, SM3_V_GG1, 60);
+
+	//update V
+	SM3_V_STORE(V[0], SM3_V_XOR(SM3_V_LOAD(V[0]), A));
+	SM3_V_STORE(V[1], SM3_V_XOR(SM3_V_LOAD(V[1]), B));
+	SM3_V_STORE(V[2], SM3_V_XOR(SM3_V_LOAD(V[2]), C));
+	SM3_V_STORE(V[3], SM3_V_XOR(SM3_V_LOAD(V[3]), D));
+	SM3_V_STORE(V[4], SM3_V_XOR(SM3_V_LOAD(V[4]), E));
+	SM3_V_STORE(V[5], SM3_V_XOR(SM3_V_LOAD(V[5]), F));
+	SM3_V_STORE(V[6], SM3_V_XOR(SM3_V_LOAD(V[6]), G));
+	SM3_V_STORE(V[7], SM3_V_XOR(SM3_V_LOAD(V[7]), H));
+#else
+	uint32_t S[8];
+	int i, k;
+
+	for (i = 0; i < SM3_MB_LANES; i++)
+	{
+		if (blk[i] == NULL)
+			continue;
+		for (k = 0; k < 8; k++)
+			S[k] = V[k][i];
+		SM3_compress_blocks(S, blk[i], 1);
+		for (k = 0; k < 8; k++)
+			V[k][i] = S[k];
+	}
+#endif
+}
+
+/******************************************************************************
+Function:       SM3_256_mb
+Description:    hash n independent jobs. Every lane takes a job, all lanes are
+compressed together block by block, and a lane that finishes its job writes
+the hash and takes the next job from the array at once
+Calls:          SM3_mb_next_block, SM3_mb_compress, SM3_compress_blocks
+Called By:
+Input:          SM3_MB_JOB jobs[n]
+int n
+Output:         the 32-byte hash of every job in jobs[i].hash
+Return:         null
+Others:         gives the same hashes as SM3_256 on the concatenated pieces
+*******************************************************************************/
+void SM3_256_mb(SM3_MB_JOB jobs[], int n)
+{
+	static const uint32_t IV[8] = { SM3_IVA, SM3_IVB, SM3_IVC, SM3_IVD, SM3_IVE, SM3_IVF, SM3_IVG, SM3_IVH };
+	SM3_MB_LANE lane[SM3_MB_LANES];
+	uint32_t V[8][SM3_MB_LANES];
+	const unsigned char *blk[SM3_MB_LANES];
+	uint32_t S[8];
+	uint64_t bytes;
+	int next = 0, active, i, k;
+
+	for (i = 0; i < SM3_MB_LANES; i++)
+		lane[i].job = NULL;
+
+	for (;;)
+	{
+		active = 0;
+		for (i = 0; i < SM3_MB_LANES; i++)
+		{
+			blk[i] = NULL;
+			while (blk[i] == NULL)
+			{
+				if (lane[i].job != NULL)
+				{
+					blk[i] = SM3_mb_next_block(&lane[i]);
+					if (blk[i] != NULL)
+						break;
+					for (k = 0; k < 8; k++)
+						SM3_STORE32(lane[i].job->hash + 4 * k, V[k][i]);
+					lane[i].job = NULL;
+				}
+				if (next == n)
+					break;
+
+				//take the next job
+				lane[i].job = &jobs[next++];
+				lane[i].seg = 0;
+				lane[i].off = 0;
+				lane[i].pad = 0;
+				for (bytes = lane[i].job->prelen, k = 0; k < lane[i].job->nseg; k++)
+					bytes += lane[i].job->seglen[k];
+				lane[i].bitlen = bytes << 3;
+				for (k = 0; k < 8; k++)
+					V[k][i] = lane[i].job->iv ? lane[i].job->iv[k] : IV[k];
+			}
+			if (blk[i] != NULL)
+				active++;
+		}
+		if (active == 0)
+			break;
+
+		if (next == n && active <= SM3_MB_SCALAR_TAIL)
+			break;
+		SM3_mb_compress(V, blk);
+	}
+
+	//the last few lanes are run to the end one at a time
+	for (i = 0; i < SM3_MB_LANES; i++)
+	{
+		if (blk[i] == NULL)
+			continue;
+		for (k = 0; k < 8; k++)
+			S[k] = V[k][i];
+		do
+		{
+			SM3_compress_blocks(S, blk[i], 1);
+			blk[i] = SM3_mb_next_block(&lane[i]);
+		} while (blk[i] != NULL);
+		for (k = 0; k < 8; k++)
+			SM3_STORE32(lane[i].job->hash + 4 * k, S[k]);
+	}
+}
+
+/******************************************************************************
+Function:       SM3_KDF_midstate
+Description:    klen bytes of keystream for the counters ct, ct+1, ..., every
+counter block resumes from mid, the state that has absorbed Z, so it costs
+one or two compressions whatever the length of Z
+Calls:          SM3_mb_job_resume, SM3_mb_job_add, SM3_256_mb
+Called By:      SM3_KDF_mb, SM3_KDF_thread
+Input:          const SM3_STATE *mid
+uint32_t ct
+size_t klen
+Output:         unsigned char *K  //klen bytes
+Return:         null
+Others:         whole blocks are hashed straight into K
+*******************************************************************************/
+static void SM3_KDF_midstate(const SM3_STATE *mid, uint32_t ct, unsigned char *K, size_t klen)
+{
+	SM3_MB_JOB jobs[SM3_KDF_MB_JOBS];
+	unsigned char ctb[SM3_KDF_MB_JOBS][4];
+	unsigned char last[32];
+	size_t rest = 0;
+	int i, n;
+
+	while (klen)
+	{
+		for (n = 0; n < SM3_KDF_MB_JOBS && klen; n++)
+		{
+			SM3_STORE32(ctb[n], ct);
+			ct++;
+			rest = klen < 32 ? klen : 32;
+			SM3_mb_job_resume(&jobs[n], mid, rest == 32 ? K + 32 * n : last);
+			SM3_mb_job_add(&jobs[n], ctb[n], 4);
+			klen -= rest;
+		}
+		SM3_256_mb(jobs, n);
+
+		i = n - 1;
+		if (jobs[i].hash == last)
+		{
+			memcpy(K + 32 * i, last, rest);
+			K += rest;
+			n--;
+		}
+		K += 32 * (size_t)n;
+	}
+}
+
+/******************************************************************************
+Function:       SM3_KDF_mb
+Description:    klen bytes of the KDF keystream Hv(Z||ct)||Hv(Z||ct+1)||...,
+Z is absorbed once and the counter blocks are independent jobs for SM3_256_mb
+Calls:          SM3_init, SM3_process, SM3_KDF_midstate
+Called By:      SM3_KDF_mt
+Input:          const unsigned char *Z
+size_t zlen
+uint32_t ct       //counter of the first block, 1 for the whole keystream
+size_t klen
+Output:         unsigned char *K  //klen bytes
+Return:         null
+Others:
+*******************************************************************************/
+void SM3_KDF_mb(const unsigned char *Z, size_t zlen, uint32_t ct, unsigned char *K, size_t klen)
+{
+	SM3_STATE mid;
+
+	SM3_init(&mid);
+	SM3_process(&mid, (unsigned char *)Z, zlen);
+	SM3_KDF_midstate(&mid, ct, K, klen);
+}
+
+/******************************************************************************
+Function:       SM3_KDF_thread
+Description:    thread body of SM3_KDF_resume, one counter range
+Calls:          SM3_KDF_midstate
+Called By:      SM3_KDF_resume
+Input:          void *arg  //SM3_KDF_PART
+Output:         the keystream of the range
+Return:         null
+Others:
+*******************************************************************************/
+static void SM3_KDF_thread(void *arg)
+{
+	SM3_KDF_PART *part = (SM3_KDF_PART *)arg;
+
+	SM3_KDF_midstate(part->mid, part->ct, part->K, part->klen);
+}
+
+/******************************************************************************
+Function:       SM3_KDF_resume
+Description:    klen bytes of keystream for the counters ct, ct+1, ..., from
+mid, the state that has absorbed Z. A keystream shorter than twice
+SM3_KDF_THREAD_MIN bytes is computed in the calling thread. A longer one is
+cut into contiguous counter ranges, one per processor, the calling thread
+computes the last range itself. All ranges resume from the same state
+Calls:          SM3_KDF_midstate, SM9_cpu_count, SM9_thread_start, SM9_thread_join
+Called By:      SM3_KDF_mt, SM3_KDF_squeeze
+Input:          const SM3_STATE *mid
+uint32_t ct
+size_t klen
+Output:         unsigned char *K  //klen bytes
+Return:         null
+Others:         a range whose thread can not be started is computed in place.
+The 32-bit counter limits a keystream to (2^32-1)*32 bytes, as in GM/T 0004
+*******************************************************************************/
+void SM3_KDF_resume(const SM3_STATE *mid, uint32_t ct, unsigned char *K, size_t klen)
+{
+	SM3_KDF_PART part[SM3_KDF_MAX_THREADS];
+	SM9_THREAD th[SM3_KDF_MAX_THREADS];
+	int started[SM3_KDF_MAX_THREADS];
+	size_t blocks, per;
+	int nthr, i;
+
+	nthr = SM9_cpu_count();
+	if (nthr > SM3_KDF_MAX_THREADS)
+		nthr = SM3_KDF_MAX_THREADS;
+	if ((size_t)nthr > klen / SM3_KDF_THREAD_MIN)
+		nthr = (int)(klen / SM3_KDF_THREAD_MIN);
+	if (nthr <= 1)
+	{
+		SM3_KDF_midstate(mid, ct, K, klen);
+		return;
+	}
+
+	//whole 32-byte blocks per range, the last range takes the remainder
+	blocks = (klen + 31) / 32;
+	per = blocks / nthr;
+	for (i = 0; i < nthr; i++)
+	{
+		part[i].mid = mid;
+		part[i].ct = ct + (uint32_t)(per * i);
+		part[i].K = K + 32 * per * i;
+		part[i].klen = i < nthr - 1 ? 32 * per : klen - 32 * per * i;
+	}
+
+	for (i = 0; i < nthr - 1; i++)
+		started[i] = SM9_thread_start(&th[i], SM3_KDF_thread, &part[i]) == 0;
+	SM3_KDF_thread(&part[nthr - 1]);
+	for (i = 0; i < nthr - 1; i++)
+	{
+		if (started[i])
+			SM9_thread_join(th[i]);
+		else
+			SM3_KDF_thread(&part[i]);
+	}
+}
+
+/******************************************************************************
+Function:       SM3_KDF_mt
+Description:    same output as SM3_KDF_mb, Z is absorbed once and the counter
+blocks are computed by SM3_KDF_resume, over several threads when long
+Calls:          SM3_init, SM3_process, SM3_KDF_resume
+Called By:      SM3_KDF
+Input:          const unsigned char *Z
+size_t zlen
+uint32_t ct
+size_t klen
+Output:         unsigned char *K  //klen bytes
+Return:         null
+Others:
+*******************************************************************************/
+void SM3_KDF_mt(const unsigned char *Z, size_t zlen, uint32_t ct, unsigned char *K, size_t klen)
+{
+	SM3_STATE mid;
+
+	SM3_init(&mid);
+	SM3_process(&mid, (unsigned char *)Z, zlen);
+	SM3_KDF_resume(&mid, ct, K, klen);
+}
@@ -0,0 +1,72 @@
+/************************************************************************
+FileName:
+SM3_mb.h
+Version:
+SM3_MB_V1.0
+Date:
+Oct 19,2026
+Description:
+Multi-buffer SM3: hashes many independent messages at once, one message per
+SIMD lane. 16 lanes are used when compiled with AVX-512 (__AVX512F__), 8 lanes
+with AVX2 (__AVX2__), otherwise the lanes are compressed one by one with the
+scalar core of KDF.c, so the results never depend on the instruction set.
+The lanes are fixed when compiling, there is no cpuid check: miracl_IBC.vcxproj
+builds for the default instruction set and only adds /arch:AVX2 when asked to
+(msbuild /p:SM9_AVX2=true), and such a binary needs a processor with AVX2.
+Function List:
+1.SM3_mb_job_init      //bind a job to its 32-byte output
+2.SM3_mb_job_add       //append a piece of message to a job
+3.SM3_mb_job_resume    //start a job from an SM3_STATE that has absorbed a prefix
+4.SM3_mb_compress      //the lane core, compress one block in every lane
+5.SM3_256_mb           //the scheduler, hash an array of jobs
+6.SM3_KDF_mb           //KDF keystream, counter blocks hashed in the lanes
+7.SM3_KDF_resume       //KDF keystream from a midstate, counter ranges split over threads
+8.SM3_KDF_mt           //absorbs Z and calls SM3_KDF_resume
+Notes:
+A job is the concatenation of up to SM3_MB_MAXSEG pieces, so inputs such as
+H1's 0x01||ID||hid||ct are hashed without being copied into one buffer first.
+Jobs of any length can be mixed; a lane takes the next job as soon as its
+previous one is finished. Jobs sharing a long prefix can all resume from one
+SM3_STATE that has absorbed it, as the KDF counter blocks do.
+************************************************************************/
+
+#ifndef HEADER_SM3_MB_H
+#define HEADER_SM3_MB_H
+
+#include "KDF.h"
+
+#if defined(__AVX512F__)
+#define SM3_MB_LANES 16
+#else
+#define SM3_MB_LANES 8
+#endif
+
+#define SM3_MB_MAXSEG 4 //pieces of message per job
+
+//keystream bytes per thread below which SM3_KDF_resume stays in the calling thread,
+//large enough that starting a thread costs under 1% of the range it computes
+#define SM3_KDF_THREAD_MIN (1024 * 1024)
+
+//bytes of key stream, XOR and hash that SM3_KDF_xor keeps in cache at a time
+#define SM3_KDF_XOR_CHUNK (16 * 1024)
+
+typedef struct
+{
+	const unsigned char *seg[SM3_MB_MAXSEG];
+	size_t seglen[SM3_MB_MAXSEG];
+	int nseg;
+	const uint32_t *iv;  //chaining value to start from, NULL for the SM3 IV
+	uint64_t prelen;     //bytes already compressed into iv
+	unsigned char *hash; //32 bytes, written when the job is finished
+} SM3_MB_JOB;
+
+void SM3_mb_job_init(SM3_MB_JOB *job, unsigned char hash[]);
+int SM3_mb_job_add(SM3_MB_JOB *job, const unsigned char *data, size_t len);
+void SM3_mb_job_resume(SM3_MB_JOB *job, const SM3_STATE *md, unsigned char hash[]);
+void SM3_mb_compress(uint32_t V[8][SM3_MB_LANES], const unsigned char *blk[SM3_MB_LANES]);
+void SM3_256_mb(SM3_MB_JOB jobs[], int n);
+void SM3_KDF_mb(const unsigned char *Z, size_t zlen, uint32_t ct, unsigned char *K, size_t klen);
+void SM3_KDF_resume(const SM3_STATE *mid, uint32_t ct, unsigned char *K, size_t klen);
+void SM3_KDF_mt(const unsigned char *Z, size_t zlen, uint32_t ct, unsigned char *K, size_t klen);
+
+#endif
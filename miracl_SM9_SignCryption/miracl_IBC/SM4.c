@@ -0,0 +1,888 @@
+/************************************************************************
+FileName:
+SM4.c
+Version:
+SM4_V1.0
+Date:
+Oct 19,2026
+Description:
+SM4 block cipher with CTR and GCM modes, see SM4.h. The vector core keeps
+word k of every block in one vector, so a round is the scalar round applied
+to SM4_LANES blocks at once. Its S-box is S(x) = B(AES(A(x))), A and B affine
+over GF(2): gf2p8affine computes A, gf2p8affineinv computes AES and B in one
+step; without GFNI A and B are 4-bit pshufb tables and aesenclast with a zero
+round key, its ShiftRows undone beforehand, gives the AES S-box.
+Function List:
+1.SM4_set_key                 //expand a 16-byte key into the 32 round keys
+2.SM4_encrypt                 //encrypt one block
+3.SM4_encrypt_lanes           //the vector core, encrypt SM4_PAR blocks
+4.SM4_encrypt_blocks          //encrypt n blocks, SM4_PAR at a time
+5.SM4_ctr32_encrypt_blocks    //CTR mode on whole blocks, 32-bit counter
+6.SM4_gcm_gmult               //Xi = Xi * H in GF(2^128)
+7.SM4_gcm_ghash               //absorb whole blocks into Xi
+8.SM4_gcm_init                //GCM key and IV setup
+9.SM4_gcm_setiv               //new IV under the same key
+10.SM4_gcm_aad                //authenticate the additional data
+11.SM4_gcm_crypt              //GCM body shared by encryption and decryption
+12.SM4_gcm_encrypt            //GCM encryption, any piece length
+13.SM4_gcm_decrypt            //GCM decryption, any piece length
+14.SM4_gcm_tag                //finish GCM and give the 16-byte tag
+************************************************************************/
+
+#include <string.h>
+#include "SM4.h"
+
+#if defined(SM4_PCLMUL) && (defined(__SSSE3__) || defined(__AVX__))
+#define SM4_CLMUL
+#endif
+
+#if SM4_LANES > 1 || defined(SM4_CLMUL)
+#include <immintrin.h>
+#endif
+
+#define SM4_BATCH 64 //blocks of key stream made per SM4_encrypt_blocks call in CTR and GCM
+#define SM4_PAR (2 * SM4_LANES) //blocks per pass of the vector core
+
+#define SM4_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define SM4_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define SM4_GETU32(p) ((uint32_t)(p)[0] << 24 | (uint32_t)(p)[1] << 16 | (uint32_t)(p)[2] << 8 | (uint32_t)(p)[3])
+#define SM4_PUTU32(p, v)                    \
+	do                                      \
+	{                                       \
+		(p)[0] = (unsigned char)((v) >> 24); \
+		(p)[1] = (unsigned char)((v) >> 16); \
+		(p)[2] = (unsigned char)((v) >> 8);  \
+		(p)[3] = (unsigned char)(v);         \
+	} while (0)
+
+static const unsigned char SM4_Sbox[256] = {
+	0xd6, 0x90, 0xe9, 0xfe, 0xcc, 0xe1, 0x3d, 0xb7, 0x16, 0xb6, 0x14, 0xc2, 0x28, 0xfb, 0x2c, 0x05,
+	0x2b, 0x67, 0x9a, 0x76, 0x2a, 0xbe, 0x04, 0xc3, 0xaa, 0x44, 0x13, 0x26, 0x49, 0x86, 0x06, 0x99,
+	0x9c, 0x42, 0x50, 0xf4, 0x91, 0xef, 0x98, 0x7a, 0x33, 0x54, 0x0b, 0x43, 0xed, 0xcf, 0xac, 0x62,
+	0xe4, 0xb3, 0x1c, 0xa9, 0xc9, 0x08, 0xe8, 0x95, 0x80, 0xdf, 0x94, 0xfa, 0x75, 0x8f, 0x3f, 0xa6,
+	0x47, 0x07, 0xa7, 0xfc, 0xf3, 0x73, 0x17, 0xba, 0x83, 0x59, 0x3c, 0x19, 0xe6, 0x85, 0x4f, 0xa8,
+	0x68, 0x6b, 0x81, 0xb2, 0x71, 0x64, 0xda, 0x8b, 0xf8, 0xeb, 0x0f, 0x4b, 0x70, 0x56, 0x9d, 0x35,
+	0x1e, 0x24, 0x0e, 0x5e, 0x63, 0x58, 0xd1, 0xa2, 0x25, 0x22, 0x7c, 0x3b, 0x01, 0x21, 0x78, 0x87,
+	0xd4, 0x00, 0x46, 0x57, 0x9f, 0xd3, 0x27, 0x52, 0x4c, 0x36, 0x02, 0xe7, 0xa0, 0xc4, 0xc8, 0x9e,
+	0xea, 0xbf, 0x8a, 0xd2, 0x40, 0xc7, 0x38, 0xb5, 0xa3, 0xf7, 0xf2, 0xce, 0xf9, 0x61, 0x15, 0xa1,
+	0xe0, 0xae, 0x5d, 0xa4, 0x9b, 0x34, 0x1a, 0x55, 0xad, 0x93, 0x32, 0x30, 0xf5, 0x8c, 0xb1, 0xe3,
+	0x1d, 0xf6, 0xe2, 0x2e, 0x82, 0x66, 0xca, 0x60, 0xc0, 0x29, 0x23, 0xab, 0x0d, 0x53, 0x4e, 0x6f,
+	0xd5, 0xdb, 0x37, 0x45, 0xde, 0xfd, 0x8e, 0x2f, 0x03, 0xff, 0x6a, 0x72, 0x6d, 0x6c, 0x5b, 0x51,
+	0x8d, 0x1b, 0xaf, 0x92, 0xbb, 0xdd, 0xbc, 0x7f, 0x11, 0xd9, 0x5c, 0x41, 0x1f, 0x10, 0x5a, 0xd8,
+	0x0a, 0xc1, 0x31, 0x88, 0xa5, 0xcd, 0x7b, 0xbd, 0x2d, 0x74, 0xd0, 0x12, 0xb8, 0xe5, 0xb4, 0xb0,
+	0x89, 0x69, 0x97, 0x4a, 0x0c, 0x96, 0x77, 0x7e, 0x65, 0xb9, 0xf1, 0x09, 0xc5, 0x6e, 0xc6, 0x84,
+	0x18, 0xf0, 0x7d, 0xec, 0x3a, 0xdc, 0x4d, 0x20, 0x79, 0xee, 0x5f, 0x3e, 0xd7, 0xcb, 0x39, 0x48};
+
+//SM4_T0[v] = L(S(v) << 24), the round function of any byte position is a rotation of it
+static const uint32_t SM4_T0[256] = {
+	0x8ed55b5b, 0xd0924242, 0x4deaa7a7, 0x06fdfbfb,
+	0xfccf3333, 0x65e28787, 0xc93df4f4, 0x6bb5dede,
+	0x4e165858, 0x6eb4dada, 0x44145050, 0xcac10b0b,
+	0x8828a0a0, 0x17f8efef, 0x9c2cb0b0, 0x11051414,
+	0x872bacac, 0xfb669d9d, 0xf2986a6a, 0xae77d9d9,
+	0x822aa8a8, 0x46bcfafa, 0x14041010, 0xcfc00f0f,
+	0x02a8aaaa, 0x54451111, 0x5f134c4c, 0xbe269898,
+	0x6d482525, 0x9e841a1a, 0x1e061818, 0xfd9b6666,
+	0xec9e7272, 0x4a430909, 0x10514141, 0x24f7d3d3,
+	0xd5934646, 0x53ecbfbf, 0xf89a6262, 0x927be9e9,
+	0xff33cccc, 0x04555151, 0x270b2c2c, 0x4f420d0d,
+	0x59eeb7b7, 0xf3cc3f3f, 0x1caeb2b2, 0xea638989,
+	0x74e79393, 0x7fb1cece, 0x6c1c7070, 0x0daba6a6,
+	0xedca2727, 0x28082020, 0x48eba3a3, 0xc1975656,
+	0x80820202, 0xa3dc7f7f, 0xc4965252, 0x12f9ebeb,
+	0xa174d5d5, 0xb38d3e3e, 0xc33ffcfc, 0x3ea49a9a,
+	0x5b461d1d, 0x1b071c1c, 0x3ba59e9e, 0x0cfff3f3,
+	0x3ff0cfcf, 0xbf72cdcd, 0x4b175c5c, 0x52b8eaea,
+	0x8f810e0e, 0x3d586565, 0xcc3cf0f0, 0x7d196464,
+	0x7ee59b9b, 0x91871616, 0x734e3d3d, 0x08aaa2a2,
+	0xc869a1a1, 0xc76aadad, 0x85830606, 0x7ab0caca,
+	0xb570c5c5, 0xf4659191, 0xb2d96b6b, 0xa7892e2e,
+	0x18fbe3e3, 0x47e8afaf, 0x330f3c3c, 0x674a2d2d,
+	0xb071c1c1, 0x0e575959, 0xe99f7676, 0xe135d4d4,
+	0x661e7878, 0xb4249090, 0x360e3838, 0x265f7979,
+	0xef628d8d, 0x38596161, 0x95d24747, 0x2aa08a8a,
+	0xb1259494, 0xaa228888, 0x8c7df1f1, 0xd73becec,
+	0x05010404, 0xa5218484, 0x9879e1e1, 0x9b851e1e,
+	0x84d75353, 0x00000000, 0x5e471919, 0x0b565d5d,
+	0xe39d7e7e, 0x9fd04f4f, 0xbb279c9c, 0x1a534949,
+	0x7c4d3131, 0xee36d8d8, 0x0a020808, 0x7be49f9f,
+	0x20a28282, 0xd4c71313, 0xe8cb2323, 0xe69c7a7a,
+	0x42e9abab, 0x43bdfefe, 0xa2882a2a, 0x9ad14b4b,
+	0x40410101, 0xdbc41f1f, 0xd838e0e0, 0x61b7d6d6,
+	0x2fa18e8e, 0x2bf4dfdf, 0x3af1cbcb, 0xf6cd3b3b,
+	0x1dfae7e7, 0xe5608585, 0x41155454, 0x25a38686,
+	0x60e38383, 0x16acbaba, 0x295c7575, 0x34a69292,
+	0xf7996e6e, 0xe434d0d0, 0x721a6868, 0x01545555,
+	0x19afb6b6, 0xdf914e4e, 0xfa32c8c8, 0xf030c0c0,
+	0x21f6d7d7, 0xbc8e3232, 0x75b3c6c6, 0x6fe08f8f,
+	0x691d7474, 0x2ef5dbdb, 0x6ae18b8b, 0x962eb8b8,
+	0x8a800a0a, 0xfe679999, 0xe2c92b2b, 0xe0618181,
+	0xc0c30303, 0x8d29a4a4, 0xaf238c8c, 0x07a9aeae,
+	0x390d3434, 0x1f524d4d, 0x764f3939, 0xd36ebdbd,
+	0x81d65757, 0xb7d86f6f, 0xeb37dcdc, 0x51441515,
+	0xa6dd7b7b, 0x09fef7f7, 0xb68c3a3a, 0x932fbcbc,
+	0x0f030c0c, 0x03fcffff, 0xc26ba9a9, 0xba73c9c9,
+	0xd96cb5b5, 0xdc6db1b1, 0x375a6d6d, 0x15504545,
+	0xb98f3636, 0x771b6c6c, 0x13adbebe, 0xda904a4a,
+	0x57b9eeee, 0xa9de7777, 0x4cbef2f2, 0x837efdfd,
+	0x55114444, 0xbdda6767, 0x2c5d7171, 0x45400505,
+	0x631f7c7c, 0x50104040, 0x325b6969, 0xb8db6363,
+	0x220a2828, 0xc5c20707, 0xf531c4c4, 0xa88a2222,
+	0x31a79696, 0xf9ce3737, 0x977aeded, 0x49bff6f6,
+	0x992db4b4, 0xa475d1d1, 0x90d34343, 0x5a124848,
+	0x58bae2e2, 0x71e69797, 0x64b6d2d2, 0x70b2c2c2,
+	0xad8b2626, 0xcd68a5a5, 0xcb955e5e, 0x624b2929,
+	0x3c0c3030, 0xce945a5a, 0xab76dddd, 0x867ff9f9,
+	0xf1649595, 0x5dbbe6e6, 0x35f2c7c7, 0x2d092424,
+	0xd1c61717, 0xd66fb9b9, 0xdec51b1b, 0x94861212,
+	0x78186060, 0x30f3c3c3, 0x897cf5f5, 0x5cefb3b3,
+	0xd23ae8e8, 0xacdf7373, 0x794c3535, 0xa0208080,
+	0x9d78e5e5, 0x56edbbbb, 0x235e7d7d, 0xc63ef8f8,
+	0x8bd45f5f, 0xe7c82f2f, 0xdd39e4e4, 0x68492121};
+
+static const uint32_t SM4_FK[4] = {0xa3b1bac6, 0x56aa3350, 0x677d9197, 0xb27022dc};
+
+static const uint32_t SM4_CK[32] = {
+	0x00070e15, 0x1c232a31, 0x383f464d, 0x545b6269,
+	0x70777e85, 0x8c939aa1, 0xa8afb6bd, 0xc4cbd2d9,
+	0xe0e7eef5, 0xfc030a11, 0x181f262d, 0x343b4249,
+	0x50575e65, 0x6c737a81, 0x888f969d, 0xa4abb2b9,
+	0xc0c7ced5, 0xdce3eaf1, 0xf8ff060d, 0x141b2229,
+	0x30373e45, 0x4c535a61, 0x686f767d, 0x848b9299,
+	0xa0a7aeb5, 0xbcc3cad1, 0xd8dfe6ed, 0xf4fb0209,
+	0x10171e25, 0x2c333a41, 0x484f565d, 0x646b7279};
+
+#define SM4_TAU(x)                                                                   \
+	((uint32_t)SM4_Sbox[(x) >> 24] << 24 | (uint32_t)SM4_Sbox[((x) >> 16) & 0xff] << 16 | \
+	 (uint32_t)SM4_Sbox[((x) >> 8) & 0xff] << 8 | (uint32_t)SM4_Sbox[(x) & 0xff])
+
+//T(x) = L(tau(x)) by table, L is linear and commutes with rotations
+#define SM4_T(x) (SM4_T0[(x) >> 24] ^ SM4_ROTR(SM4_T0[((x) >> 16) & 0xff], 8) ^ \
+	SM4_ROTR(SM4_T0[((x) >> 8) & 0xff], 16) ^ SM4_ROTR(SM4_T0[(x) & 0xff], 24))
+
+#if SM4_LANES == 16
+typedef __m512i SM4_VEC;
+#define SM4_V_LOAD(p) _mm512_loadu_si512((const void *)(p))
+#define SM4_V_STORE(p, x) _mm512_storeu_si512((void *)(p), (x))
+#define SM4_V_SET1(x) _mm512_set1_epi32((int)(x))
+#define SM4_V_TABLE(hi, lo) _mm512_set_epi64((hi), (lo), (hi), (lo), (hi), (lo), (hi), (lo))
+#define SM4_V_XOR(a, b) _mm512_xor_si512((a), (b))
+#define SM4_V_XOR3(a, b, c) _mm512_ternarylogic_epi32((a), (b), (c), 0x96)
+#define SM4_V_SHUF(x, t) _mm512_shuffle_epi8((x), (t))
+#define SM4_V_ROTL(x, n) _mm512_rol_epi32((x), (n))
+#define SM4_V_UNPACKLO32(a, b) _mm512_unpacklo_epi32((a), (b))
+#define SM4_V_UNPACKHI32(a, b) _mm512_unpackhi_epi32((a), (b))
+#define SM4_V_UNPACKLO64(a, b) _mm512_unpacklo_epi64((a), (b))
+#define SM4_V_UNPACKHI64(a, b) _mm512_unpackhi_epi64((a), (b))
+#define SM4_V_SBOX(x) _mm512_gf2p8affineinv_epi64_epi8(                                    \
+	_mm512_gf2p8affine_epi64_epi8((x), _mm512_set1_epi64(0x669b0d608a162e14LL), 0x01), \
+	_mm512_set1_epi64(0x598edb70229ca40eLL), 0xd3)
+#elif SM4_LANES == 8
+typedef __m256i SM4_VEC;
+#define SM4_V_LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define SM4_V_STORE(p, x) _mm256_storeu_si256((__m256i *)(p), (x))
+#define SM4_V_SET1(x) _mm256_set1_epi32((int)(x))
+#define SM4_V_TABLE(hi, lo) _mm256_set_epi64x((hi), (lo), (hi), (lo))
+#define SM4_V_XOR(a, b) _mm256_xor_si256((a), (b))
+#define SM4_V_AND(a, b) _mm256_and_si256((a), (b))
+#define SM4_V_SRLI32(x, n) _mm256_srli_epi32((x), (n))
+#define SM4_V_SHUF(x, t) _mm256_shuffle_epi8((x), (t))
+#define SM4_V_ROTL(x, n) _mm256_or_si256(_mm256_slli_epi32((x), (n)), _mm256_srli_epi32((x), 32 - (n)))
+#define SM4_V_UNPACKLO32(a, b) _mm256_unpacklo_epi32((a), (b))
+#define SM4_V_UNPACKHI32(a, b) _mm256_unpackhi_epi32((a), (b))
+#define SM4_V_UNPACKLO64(a, b) _mm256_unpacklo_epi64((a), (b))
+#define SM4_V_UNPACKHI64(a, b) _mm256_unpackhi_epi64((a), (b))
+#if defined(__VAES__)
+#define SM4_V_AESENCLAST(x) _mm256_aesenclast_epi128((x), _mm256_setzero_si256())
+#else
+#define SM4_V_AESENCLAST(x) _mm256_inserti128_si256(                                                \
+	_mm256_castsi128_si256(_mm_aesenclast_si128(_mm256_castsi256_si128(x), _mm_setzero_si128())), \
+	_mm_aesenclast_si128(_mm256_extracti128_si256((x), 1), _mm_setzero_si128()), 1)
+#endif
+#elif SM4_LANES == 4
+typedef __m128i SM4_VEC;
+#define SM4_V_LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define SM4_V_STORE(p, x) _mm_storeu_si128((__m128i *)(p), (x))
+#define SM4_V_SET1(x) _mm_set1_epi32((int)(x))
+#define SM4_V_TABLE(hi, lo) _mm_set_epi64x((hi), (lo))
+#define SM4_V_XOR(a, b) _mm_xor_si128((a), (b))
+#define SM4_V_AND(a, b) _mm_and_si128((a), (b))
+#define SM4_V_SRLI32(x, n) _mm_srli_epi32((x), (n))
+#define SM4_V_SHUF(x, t) _mm_shuffle_epi8((x), (t))
+#define SM4_V_ROTL(x, n) _mm_or_si128(_mm_slli_epi32((x), (n)), _mm_srli_epi32((x), 32 - (n)))
+#define SM4_V_UNPACKLO32(a, b) _mm_unpacklo_epi32((a), (b))
+#define SM4_V_UNPACKHI32(a, b) _mm_unpackhi_epi32((a), (b))
+#define SM4_V_UNPACKLO64(a, b) _mm_unpacklo_epi64((a), (b))
+#define SM4_V_UNPACKHI64(a, b) _mm_unpackhi_epi64((a), (b))
+#define SM4_V_AESENCLAST(x) _mm_aesenclast_si128((x), _mm_setzero_si128())
+#endif
+
+#if SM4_LANES == 8 || SM4_LANES == 4
+#define SM4_V_XOR3(a, b, c) SM4_V_XOR(SM4_V_XOR((a), (b)), (c))
+/* x -> A(x) by the low and high nibble tables, ShiftRows undone so that
+   aesenclast only applies SubBytes, then B(y) by nibble tables again */
+#define SM4_V_AFFINE(x, lo, hi) SM4_V_XOR(SM4_V_SHUF((lo), SM4_V_AND((x), m0f)), \
+	SM4_V_SHUF((hi), SM4_V_AND(SM4_V_SRLI32((x), 4), m0f)))
+#define SM4_V_SBOX(x) SM4_V_AFFINE(SM4_V_AESENCLAST(SM4_V_SHUF(SM4_V_AFFINE((x), pre_lo, pre_hi), inv_sr)), \
+	post_lo, post_hi)
+#endif
+
+#if SM4_LANES > 1
+
+/* L(x) = x ^ (x <<< 2) ^ (x <<< 10) ^ (x <<< 18) ^ (x <<< 24)
+        = x ^ (x <<< 24) ^ ((x ^ (x <<< 8) ^ (x <<< 16)) <<< 2), byte rotations by pshufb */
+#define SM4_V_L(x) SM4_V_XOR3((x), SM4_V_SHUF((x), rol24), \
+	SM4_V_ROTL(SM4_V_XOR3((x), SM4_V_SHUF((x), rol8), SM4_V_SHUF((x), rol16)), 2))
+
+/* the scalar round on vectors: X0 ^= T(X1 ^ X2 ^ X3 ^ rk) */
+#define SM4_V_ROUND(X0, X1, X2, X3, rk)                                      \
+	do                                                                       \
+	{                                                                        \
+		SM4_VEC t_ = SM4_V_XOR(SM4_V_XOR3((X1), (X2), (X3)), SM4_V_SET1(rk)); \
+		t_ = SM4_V_SBOX(t_);                                                 \
+		X0 = SM4_V_XOR(X0, SM4_V_L(t_));                                     \
+	} while (0)
+
+/* 4x4 transpose of 32-bit words in every 128-bit lane, it is its own inverse */
+#define SM4_V_TRANSPOSE(a, b, c, d)             \
+	do                                          \
+	{                                           \
+		SM4_VEC t0_ = SM4_V_UNPACKLO32(a, b);   \
+		SM4_VEC t1_ = SM4_V_UNPACKHI32(a, b);   \
+		SM4_VEC t2_ = SM4_V_UNPACKLO32(c, d);   \
+		SM4_VEC t3_ = SM4_V_UNPACKHI32(c, d);   \
+		a = SM4_V_UNPACKLO64(t0_, t2_);         \
+		b = SM4_V_UNPACKHI64(t0_, t2_);         \
+		c = SM4_V_UNPACKLO64(t1_, t3_);         \
+		d = SM4_V_UNPACKHI64(t1_, t3_);         \
+	} while (0)
+
+/* SM4_LANES blocks at p into word vectors and back */
+#define SM4_V_LOAD4(a, b, c, d, p)                               \
+	do                                                           \
+	{                                                            \
+		a = SM4_V_SHUF(SM4_V_LOAD(p), bswap);                    \
+		b = SM4_V_SHUF(SM4_V_LOAD((p) + 4 * SM4_LANES), bswap);  \
+		c = SM4_V_SHUF(SM4_V_LOAD((p) + 8 * SM4_LANES), bswap);  \
+		d = SM4_V_SHUF(SM4_V_LOAD((p) + 12 * SM4_LANES), bswap); \
+		SM4_V_TRANSPOSE(a, b, c, d);                             \
+	} while (0)
+
+#define SM4_V_STORE4(p, a, b, c, d)                              \
+	do                                                           \
+	{                                                            \
+		SM4_V_TRANSPOSE(a, b, c, d);                             \
+		SM4_V_STORE(p, SM4_V_SHUF(a, bswap));                    \
+		SM4_V_STORE((p) + 4 * SM4_LANES, SM4_V_SHUF(b, bswap));  \
+		SM4_V_STORE((p) + 8 * SM4_LANES, SM4_V_SHUF(c, bswap));  \
+		SM4_V_STORE((p) + 12 * SM4_LANES, SM4_V_SHUF(d, bswap)); \
+	} while (0)
+
+#endif
+
+/******************************************************************************
+Function:       SM4_set_key
+Description:    key expansion of GB/T 32907-2016
+Calls:
+Called By:      SM4_gcm_init
+Input:          const unsigned char key[16]
+Output:         SM4_KEY *ks   //the 32 round keys
+Return:         null
+Others:
+*******************************************************************************/
+void SM4_set_key(const unsigned char key[SM4_KEY_LEN], SM4_KEY *ks)
+{
+	uint32_t K[4], x;
+	int i;
+
+	for (i = 0; i < 4; i++)
+		K[i] = SM4_GETU32(key + 4 * i) ^ SM4_FK[i];
+	for (i = 0; i < 32; i++)
+	{
+		x = K[(i + 1) & 3] ^ K[(i + 2) & 3] ^ K[(i + 3) & 3] ^ SM4_CK[i];
+		x = SM4_TAU(x);
+		K[i & 3] ^= x ^ SM4_ROTL(x, 13) ^ SM4_ROTL(x, 23);
+		ks->rk[i] = K[i & 3];
+	}
+}
+
+/******************************************************************************
+Function:       SM4_encrypt
+Description:    encrypt one block with the scalar rounds, T by table
+Calls:
+Called By:      SM4_encrypt_blocks, SM4_gcm_init, SM4_gcm_crypt, SM4_gcm_tag
+Input:          const SM4_KEY *ks
+const unsigned char in[16]
+Output:         unsigned char out[16]
+Return:         null
+Others:         in and out may be the same block
+*******************************************************************************/
+void SM4_encrypt(const SM4_KEY *ks, const unsigned char in[16], unsigned char out[16])
+{
+	uint32_t X[4], x;
+	int i;
+
+	for (i = 0; i < 4; i++)
+		X[i] = SM4_GETU32(in + 4 * i);
+	for (i = 0; i < 32; i++)
+	{
+		x = X[(i + 1) & 3] ^ X[(i + 2) & 3] ^ X[(i + 3) & 3] ^ ks->rk[i];
+		X[i & 3] ^= SM4_T(x);
+	}
+	for (i = 0; i < 4; i++)
+		SM4_PUTU32(out + 4 * i, X[3 - i]);
+}
+
+#if SM4_LANES > 1
+/******************************************************************************
+Function:       SM4_encrypt_lanes
+Description:    encrypt SM4_PAR consecutive blocks, word k of every block
+is held in vector Xk or Yk after the transpose
+Calls:
+Called By:      SM4_encrypt_blocks
+Input:          const SM4_KEY *ks
+const unsigned char *in   //16 * SM4_PAR bytes
+Output:         unsigned char *out
+Return:         null
+Others:         in and out may be the same buffer. The vector groups X and Y
+are independent, their rounds interleave so that one hides the latency of
+the other
+*******************************************************************************/
+static void SM4_encrypt_lanes(const SM4_KEY *ks, const unsigned char *in, unsigned char *out)
+{
+	const SM4_VEC bswap = SM4_V_TABLE(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+	const SM4_VEC rol8 = SM4_V_TABLE(0x0e0d0c0f0a09080bLL, 0x0605040702010003LL);
+	const SM4_VEC rol16 = SM4_V_TABLE(0x0d0c0f0e09080b0aLL, 0x0504070601000302LL);
+	const SM4_VEC rol24 = SM4_V_TABLE(0x0c0f0e0d080b0a09LL, 0x0407060500030201LL);
+#if SM4_LANES == 8 || SM4_LANES == 4
+	const SM4_VEC m0f = SM4_V_SET1(0x0f0f0f0f);
+	const SM4_VEC pre_lo = SM4_V_TABLE(0xC7C1B4B222245157LL, 0x9197E2E474720701LL);
+	const SM4_VEC pre_hi = SM4_V_TABLE(0xF052B91BF95BB012LL, 0xE240AB09EB49A200LL);
+	const SM4_VEC post_lo = SM4_V_TABLE(0xEDD14478172BBE82LL, 0x5B67F2CEA19D0834LL);
+	const SM4_VEC post_hi = SM4_V_TABLE(0x11CDBE62CC1063BFLL, 0xAE7201DD73AFDC00LL);
+	const SM4_VEC inv_sr = SM4_V_TABLE(0x0306090C0F020508LL, 0x0B0E0104070A0D00LL);
+#endif
+	SM4_VEC X0, X1, X2, X3, Y0, Y1, Y2, Y3;
+	int i;
+
+	SM4_V_LOAD4(X0, X1, X2, X3, in);
+	SM4_V_LOAD4(Y0, Y1, Y2, Y3, in + 16 * SM4_LANES);
+	for (i = 0; i < 32; i += 4)
+	{
+		SM4_V_ROUND(X0, X1, X2, X3, ks->rk[i]);
+		SM4_V_ROUND(Y0, Y1, Y2, Y3, ks->rk[i]);
+		SM4_V_ROUND(X1, X2, X3, X0, ks->rk[i + 1]);
+		SM4_V_ROUND(Y1, Y2, Y3, Y0, ks->rk[i + 1]);
+		SM4_V_ROUND(X2, X3, X0, X1, ks->rk[i + 2]);
+		SM4_V_ROUND(Y2, Y3, Y0, Y1, ks->rk[i + 2]);
+		SM4_V_ROUND(X3, X0, X1, X2, ks->rk[i + 3]);
+		SM4_V_ROUND(Y3, Y0, Y1, Y2, ks->rk[i + 3]);
+	}
+	//the output block is X35 X34 X33 X32
+	SM4_V_STORE4(out, X3, X2, X1, X0);
+	SM4_V_STORE4(out + 16 * SM4_LANES, Y3, Y2, Y1, Y0);
+}
+#endif
+
+/******************************************************************************
+Function:       SM4_encrypt_blocks
+Description:    ECB encryption of n blocks, SM4_PAR blocks per vector pass,
+the blocks left over are padded to one more pass
+Calls:          SM4_encrypt_lanes, SM4_encrypt
+Called By:      SM4_ctr32_encrypt_blocks
+Input:          const SM4_KEY *ks
+const unsigned char *in   //16 * n bytes
+size_t n
+Output:         unsigned char *out
+Return:         null
+Others:         in and out may be the same buffer
+*******************************************************************************/
+void SM4_encrypt_blocks(const SM4_KEY *ks, const unsigned char *in, unsigned char *out, size_t n)
+{
+#if SM4_LANES > 1
+	unsigned char buf[16 * SM4_PAR];
+
+	for (; n >= SM4_PAR; n -= SM4_PAR)
+	{
+		SM4_encrypt_lanes(ks, in, out);
+		in += 16 * SM4_PAR;
+		out += 16 * SM4_PAR;
+	}
+	if (n)
+	{
+		memcpy(buf, in, 16 * n);
+		SM4_encrypt_lanes(ks, buf, buf);
+		memcpy(out, buf, 16 * n);
+	}
+#else
+	for (; n; n--)
+	{
+		SM4_encrypt(ks, in, out);
+		in += 16;
+		out += 16;
+	}
+#endif
+}
+
+/******************************************************************************
+Function:       SM4_ctr32_encrypt_blocks
+Description:    out = in XOR E(ctr), E(ctr+1), ... for n blocks, the counter
+is the last 32 bits of ctr, big-endian, as in GCM
+Calls:          SM4_encrypt_blocks
+Called By:      SM4_gcm_crypt
+Input:          const SM4_KEY *ks
+const unsigned char *in   //16 * n bytes
+size_t n
+unsigned char ctr[16]     //first counter block
+Output:         unsigned char *out
+unsigned char ctr[16]     //the counter block after the last one used
+Return:         null
+Others:         in and out may be the same buffer
+*******************************************************************************/
+void SM4_ctr32_encrypt_blocks(const SM4_KEY *ks, const unsigned char *in, unsigned char *out,
+	size_t n, unsigned char ctr[16])
+{
+	unsigned char ks_buf[SM4_BATCH * 16];
+	uint32_t c = SM4_GETU32(ctr + 12);
+	size_t m, i;
+
+	while (n)
+	{
+		m = n < SM4_BATCH ? n : SM4_BATCH;
+		for (i = 0; i < m; i++)
+		{
+			memcpy(ks_buf + 16 * i, ctr, 12);
+			SM4_PUTU32(ks_buf + 16 * i + 12, c);
+			c++;
+		}
+		SM4_encrypt_blocks(ks, ks_buf, ks_buf, m);
+		for (i = 0; i < 16 * m; i += 8)
+		{
+			uint64_t x, y;
+
+			memcpy(&x, in + i, 8);
+			memcpy(&y, ks_buf + i, 8);
+			x ^= y;
+			memcpy(out + i, &x, 8);
+		}
+		in += 16 * m;
+		out += 16 * m;
+		n -= m;
+	}
+	SM4_PUTU32(ctr + 12, c);
+}
+
+#if defined(SM4_CLMUL)
+/* GHASH on byte reflected blocks: the 256-bit carry-less product is
+   accumulated in (lo, hi) and reduced once, as in the Intel CLMUL white paper */
+static void SM4_clmul_acc(__m128i a, __m128i b, __m128i *lo, __m128i *hi)
+{
+	__m128i t0 = _mm_clmulepi64_si128(a, b, 0x00);
+	__m128i t1 = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+	__m128i t2 = _mm_clmulepi64_si128(a, b, 0x11);
+
+	*lo = _mm_xor_si128(*lo, _mm_xor_si128(t0, _mm_slli_si128(t1, 8)));
+	*hi = _mm_xor_si128(*hi, _mm_xor_si128(t2, _mm_srli_si128(t1, 8)));
+}
+
+static __m128i SM4_clmul_reduce(__m128i lo, __m128i hi)
+{
+	__m128i t7, t8, t9;
+
+	//shift the product left by one bit, the operands are bit reflected
+	t7 = _mm_srli_epi32(lo, 31);
+	t8 = _mm_srli_epi32(hi, 31);
+	lo = _mm_slli_epi32(lo, 1);
+	hi = _mm_slli_epi32(hi, 1);
+	t9 = _mm_srli_si128(t7, 12);
+	t8 = _mm_slli_si128(t8, 4);
+	t7 = _mm_slli_si128(t7, 4);
+	lo = _mm_or_si128(lo, t7);
+	hi = _mm_or_si128(_mm_or_si128(hi, t8), t9);
+	//reduce modulo x^128 + x^7 + x^2 + x + 1
+	t7 = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+	t8 = _mm_srli_si128(t7, 4);
+	lo = _mm_xor_si128(lo, _mm_slli_si128(t7, 12));
+	t9 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+	lo = _mm_xor_si128(lo, _mm_xor_si128(t9, t8));
+	return _mm_xor_si128(hi, lo);
+}
+
+static __m128i SM4_clmul_mul(__m128i a, __m128i b)
+{
+	__m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+	SM4_clmul_acc(a, b, &lo, &hi);
+	return SM4_clmul_reduce(lo, hi);
+}
+
+#define SM4_BSWAP128 _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)
+#else
+//GHASH reduction of the 4 bits shifted out of a 4-bit step
+static const uint64_t SM4_rem_4bit[16] = {
+	(uint64_t)0x0000 << 48, (uint64_t)0x1C20 << 48, (uint64_t)0x3840 << 48, (uint64_t)0x2460 << 48,
+	(uint64_t)0x7080 << 48, (uint64_t)0x6CA0 << 48, (uint64_t)0x48C0 << 48, (uint64_t)0x54E0 << 48,
+	(uint64_t)0xE100 << 48, (uint64_t)0xFD20 << 48, (uint64_t)0xD940 << 48, (uint64_t)0xC560 << 48,
+	(uint64_t)0x9180 << 48, (uint64_t)0x8DA0 << 48, (uint64_t)0xA9C0 << 48, (uint64_t)0xB5E0 << 48};
+#endif
+
+/******************************************************************************
+Function:       SM4_gcm_gmult
+Description:    Xi = Xi * H in GF(2^128)
+Calls:
+Called By:      SM4_gcm_ghash, SM4_gcm_aad, SM4_gcm_crypt, SM4_gcm_tag
+Input:          SM4_GCM_CTX *ctx
+Output:         SM4_GCM_CTX *ctx
+Return:         null
+Others:         4-bit tables, or PCLMULQDQ
+*******************************************************************************/
+static void SM4_gcm_gmult(SM4_GCM_CTX *ctx)
+{
+#if defined(SM4_CLMUL)
+	__m128i X = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)ctx->Xi), SM4_BSWAP128);
+
+	X = SM4_clmul_mul(X, _mm_loadu_si128((const __m128i *)ctx->Hpow[0]));
+	_mm_storeu_si128((__m128i *)ctx->Xi, _mm_shuffle_epi8(X, SM4_BSWAP128));
+#else
+	uint64_t Zhi, Zlo, rem;
+	int cnt = 15, nlo, nhi;
+
+	nlo = ctx->Xi[15];
+	nhi = nlo >> 4;
+	nlo &= 0xf;
+	Zhi = ctx->Htable[nlo][0];
+	Zlo = ctx->Htable[nlo][1];
+	for (;;)
+	{
+		rem = Zlo & 0xf;
+		Zlo = (Zhi << 60) | (Zlo >> 4);
+		Zhi = (Zhi >> 4) ^ SM4_rem_4bit[rem];
+		Zhi ^= ctx->Htable[nhi][0];
+		Zlo ^= ctx->Htable[nhi][1];
+		if (--cnt < 0)
+			break;
+		nlo = ctx->Xi[cnt];
+		nhi = nlo >> 4;
+		nlo &= 0xf;
+		rem = Zlo & 0xf;
+		Zlo = (Zhi << 60) | (Zlo >> 4);
+		Zhi = (Zhi >> 4) ^ SM4_rem_4bit[rem];
+		Zhi ^= ctx->Htable[nlo][0];
+		Zlo ^= ctx->Htable[nlo][1];
+	}
+	SM4_PUTU32(ctx->Xi, (uint32_t)(Zhi >> 32));
+	SM4_PUTU32(ctx->Xi + 4, (uint32_t)Zhi);
+	SM4_PUTU32(ctx->Xi + 8, (uint32_t)(Zlo >> 32));
+	SM4_PUTU32(ctx->Xi + 12, (uint32_t)Zlo);
+#endif
+}
+
+/******************************************************************************
+Function:       SM4_gcm_ghash
+Description:    absorb n whole blocks into the GHASH accumulator
+Calls:          SM4_gcm_gmult
+Called By:      SM4_gcm_init, SM4_gcm_aad, SM4_gcm_crypt
+Input:          SM4_GCM_CTX *ctx
+const unsigned char *in   //16 * n bytes
+size_t n
+Output:         SM4_GCM_CTX *ctx
+Return:         null
+Others:         with PCLMULQDQ 4 blocks share one reduction:
+Xi = (Xi ^ B1) * H^4 ^ B2 * H^3 ^ B3 * H^2 ^ B4 * H
+*******************************************************************************/
+static void SM4_gcm_ghash(SM4_GCM_CTX *ctx, const unsigned char *in, size_t n)
+{
+#if defined(SM4_CLMUL)
+	const __m128i bswap = SM4_BSWAP128;
+	__m128i X = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)ctx->Xi), bswap);
+	__m128i H1 = _mm_loadu_si128((const __m128i *)ctx->Hpow[0]);
+	__m128i H2 = _mm_loadu_si128((const __m128i *)ctx->Hpow[1]);
+	__m128i H3 = _mm_loadu_si128((const __m128i *)ctx->Hpow[2]);
+	__m128i H4 = _mm_loadu_si128((const __m128i *)ctx->Hpow[3]);
+	__m128i lo, hi;
+
+	for (; n >= 4; n -= 4)
+	{
+		lo = _mm_setzero_si128();
+		hi = _mm_setzero_si128();
+		SM4_clmul_acc(_mm_xor_si128(X, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)in), bswap)), H4, &lo, &hi);
+		SM4_clmul_acc(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 16)), bswap), H3, &lo, &hi);
+		SM4_clmul_acc(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 32)), bswap), H2, &lo, &hi);
+		SM4_clmul_acc(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 48)), bswap), H1, &lo, &hi);
+		X = SM4_clmul_reduce(lo, hi);
+		in += 64;
+	}
+	for (; n; n--)
+	{
+		X = SM4_clmul_mul(_mm_xor_si128(X, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)in), bswap)), H1);
+		in += 16;
+	}
+	_mm_storeu_si128((__m128i *)ctx->Xi, _mm_shuffle_epi8(X, bswap));
+#else
+	int i;
+
+	for (; n; n--)
+	{
+		for (i = 0; i < 16; i++)
+			ctx->Xi[i] ^= in[i];
+		SM4_gcm_gmult(ctx);
+		in += 16;
+	}
+#endif
+}
+
+/******************************************************************************
+Function:       SM4_gcm_init
+Description:    set the key, H = E(0) and its tables, and J0 from the IV
+Calls:          SM4_set_key, SM4_encrypt, SM4_gcm_setiv
+Called By:
+Input:          const unsigned char key[16]
+const unsigned char *iv
+size_t ivlen      //12 is the usual length, any other is hashed into J0
+Output:         SM4_GCM_CTX *ctx
+Return:         null
+Others:
+*******************************************************************************/
+void SM4_gcm_init(SM4_GCM_CTX *ctx, const unsigned char key[SM4_KEY_LEN], const unsigned char *iv, size_t ivlen)
+{
+	unsigned char H[16];
+	int i;
+
+	memset(ctx, 0, sizeof(SM4_GCM_CTX));
+	SM4_set_key(key, &ctx->ks);
+	memset(H, 0, 16);
+	SM4_encrypt(&ctx->ks, H, H);
+
+#if defined(SM4_CLMUL)
+	{
+		__m128i H1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)H), SM4_BSWAP128), P = H1;
+
+		for (i = 0; i < 4; i++)
+		{
+			_mm_storeu_si128((__m128i *)ctx->Hpow[i], P);
+			P = SM4_clmul_mul(P, H1);
+		}
+	}
+#else
+	{
+		uint64_t Vhi, Vlo;
+		int j;
+
+		//Htable[i] = i * H for the 4-bit values i, bit 3 of i is the first bit of the block
+		Vhi = (uint64_t)SM4_GETU32(H) << 32 | SM4_GETU32(H + 4);
+		Vlo = (uint64_t)SM4_GETU32(H + 8) << 32 | SM4_GETU32(H + 12);
+		ctx->Htable[8][0] = Vhi;
+		ctx->Htable[8][1] = Vlo;
+		for (i = 4; i > 0; i >>= 1)
+		{
+			uint64_t T = (uint64_t)0xe1 << 56 & (0 - (Vlo & 1));
+			Vlo = (Vhi << 63) | (Vlo >> 1);
+			Vhi = (Vhi >> 1) ^ T;
+			ctx->Htable[i][0] = Vhi;
+			ctx->Htable[i][1] = Vlo;
+		}
+		for (i = 2; i < 16; i <<= 1)
+			for (j = 1; j < i; j++)
+			{
+				ctx->Htable[i + j][0] = ctx->Htable[i][0] ^ ctx->Htable[j][0];
+				ctx->Htable[i + j][1] = ctx->Htable[i][1] ^ ctx->Htable[j][1];
+			}
+	}
+#endif
+
+	SM4_gcm_setiv(ctx, iv, ivlen);
+}
+
+/******************************************************************************
+Function:       SM4_gcm_setiv
+Description:    start a new message under the key already in ctx: J0 from the
+IV, GHASH and the lengths back to zero. H and its tables are kept, so a
+context set up once by SM4_gcm_init serves many messages
+Calls:          SM4_gcm_ghash
+Called By:      SM4_gcm_init
+Input:          const unsigned char *iv
+size_t ivlen      //12 is the usual length, any other is hashed into J0
+Output:         SM4_GCM_CTX *ctx
+Return:         null
+Others:
+*******************************************************************************/
+void SM4_gcm_setiv(SM4_GCM_CTX *ctx, const unsigned char *iv, size_t ivlen)
+{
+	unsigned char last[16];
+
+	memset(ctx->Xi, 0, 16);
+	memset(ctx->ek, 0, 16);
+	ctx->alen = ctx->clen = 0;
+	ctx->used = 0;
+	if (ivlen == SM4_GCM_IV_LEN)
+	{
+		memcpy(ctx->J0, iv, SM4_GCM_IV_LEN);
+		ctx->J0[12] = ctx->J0[13] = ctx->J0[14] = 0;
+		ctx->J0[15] = 1;
+	}
+	else
+	{
+		SM4_gcm_ghash(ctx, iv, ivlen / 16);
+		memset(last, 0, 16);
+		memcpy(last, iv + ivlen / 16 * 16, ivlen % 16);
+		if (ivlen % 16)
+			SM4_gcm_ghash(ctx, last, 1);
+		memset(last, 0, 16);
+		SM4_PUTU32(last + 8, (uint32_t)((uint64_t)ivlen >> 29));
+		SM4_PUTU32(last + 12, (uint32_t)((uint64_t)ivlen << 3));
+		SM4_gcm_ghash(ctx, last, 1);
+		memcpy(ctx->J0, ctx->Xi, 16);
+		memset(ctx->Xi, 0, 16);
+	}
+	memcpy(ctx->ctr, ctx->J0, 16);
+	SM4_PUTU32(ctx->ctr + 12, SM4_GETU32(ctx->J0 + 12) + 1);
+}
+
+/******************************************************************************
+Function:       SM4_gcm_aad
+Description:    authenticate the additional data
+Calls:          SM4_gcm_ghash, SM4_gcm_gmult
+Called By:
+Input:          SM4_GCM_CTX *ctx
+const unsigned char *aad
+size_t len
+Output:         SM4_GCM_CTX *ctx
+Return:         null
+Others:         at most one call, after SM4_gcm_init and before any text
+*******************************************************************************/
+void SM4_gcm_aad(SM4_GCM_CTX *ctx, const unsigned char *aad, size_t len)
+{
+	size_t i;
+
+	ctx->alen = len;
+	SM4_gcm_ghash(ctx, aad, len / 16);
+	aad += len / 16 * 16;
+	len %= 16;
+	if (len)
+	{
+		for (i = 0; i < len; i++)
+			ctx->Xi[i] ^= aad[i];
+		SM4_gcm_gmult(ctx);
+	}
+}
+
+/******************************************************************************
+Function:       SM4_gcm_crypt
+Description:    CTR encryption and GHASH of the ciphertext, a partial block
+left by the previous call is finished first
+Calls:          SM4_ctr32_encrypt_blocks, SM4_gcm_ghash, SM4_gcm_gmult, SM4_encrypt
+Called By:      SM4_gcm_encrypt, SM4_gcm_decrypt
+Input:          SM4_GCM_CTX *ctx
+const unsigned char *in
+size_t len
+int enc           //1: in is the plaintext, 0: in is the ciphertext
+Output:         unsigned char *out
+Return:         null
+Others:         whole blocks go SM4_BATCH at a time through the key stream and
+GHASH while they are in cache; in and out may be the same buffer
+*******************************************************************************/
+static void SM4_gcm_crypt(SM4_GCM_CTX *ctx, const unsigned char *in, unsigned char *out, size_t len, int enc)
+{
+	size_t n, m;
+	unsigned char c;
+
+	ctx->clen += len;
+	while (ctx->used && len)
+	{
+		c = enc ? (unsigned char)(*in ^ ctx->ek[ctx->used]) : *in;
+		*out++ = (unsigned char)(*in++ ^ ctx->ek[ctx->used]);
+		ctx->Xi[ctx->used] ^= c;
+		ctx->used = (ctx->used + 1) & 15;
+		if (ctx->used == 0)
+			SM4_gcm_gmult(ctx);
+		len--;
+	}
+	for (n = len / 16; n; n -= m)
+	{
+		m = n < SM4_BATCH ? n : SM4_BATCH;
+		if (!enc)
+			SM4_gcm_ghash(ctx, in, m);
+		SM4_ctr32_encrypt_blocks(&ctx->ks, in, out, m, ctx->ctr);
+		if (enc)
+			SM4_gcm_ghash(ctx, out, m);
+		in += 16 * m;
+		out += 16 * m;
+	}
+	len %= 16;
+	if (len)
+	{
+		SM4_encrypt(&ctx->ks, ctx->ctr, ctx->ek);
+		SM4_PUTU32(ctx->ctr + 12, SM4_GETU32(ctx->ctr + 12) + 1);
+		for (; ctx->used < len; ctx->used++)
+		{
+			c = enc ? (unsigned char)(in[ctx->used] ^ ctx->ek[ctx->used]) : in[ctx->used];
+			out[ctx->used] = (unsigned char)(in[ctx->used] ^ ctx->ek[ctx->used]);
+			ctx->Xi[ctx->used] ^= c;
+		}
+	}
+}
+
+/******************************************************************************
+Function:       SM4_gcm_encrypt
+Description:    GCM encryption of the next piece of plaintext
+Calls:          SM4_gcm_crypt
+Called By:      SM9_DEM_encrypt
+Input:          SM4_GCM_CTX *ctx
+const unsigned char *in
+size_t len
+Output:         unsigned char *out
+Return:         null
+Others:         pieces of any length may follow each other
+*******************************************************************************/
+void SM4_gcm_encrypt(SM4_GCM_CTX *ctx, const unsigned char *in, unsigned char *out, size_t len)
+{
+	SM4_gcm_crypt(ctx, in, out, len, 1);
+}
+
+/******************************************************************************
+Function:       SM4_gcm_decrypt
+Description:    GCM decryption of the next piece of ciphertext
+Calls:          SM4_gcm_crypt
+Called By:      SM9_DEM_decrypt
+Input:          SM4_GCM_CTX *ctx
+const unsigned char *in
+size_t len
+Output:         unsigned char *out
+Return:         null
+Others:         the plaintext must not be used before SM4_gcm_tag has been
+checked
+*******************************************************************************/
+void SM4_gcm_decrypt(SM4_GCM_CTX *ctx, const unsigned char *in, unsigned char *out, size_t len)
+{
+	SM4_gcm_crypt(ctx, in, out, len, 0);
+}
+
+/******************************************************************************
+Function:       SM4_gcm_tag
+Description:    tag = E(J0) XOR GHASH(AAD, C, lengths)
+Calls:          SM4_gcm_gmult, SM4_encrypt
+Called By:      SM9_DEM_encrypt, SM9_DEM_decrypt
+Input:          SM4_GCM_CTX *ctx
+Output:         unsigned char tag[16]
+Return:         null
+Others:
+*******************************************************************************/
+void SM4_gcm_tag(SM4_GCM_CTX *ctx, unsigned char tag[SM4_GCM_TAG_LEN])
+{
+	unsigned char ej0[16];
+	int i;
+
+	if (ctx->used)
+		SM4_gcm_gmult(ctx);
+	ctx->used = 0;
+	SM4_PUTU32(ej0, (uint32_t)(ctx->alen >> 29));
+	SM4_PUTU32(ej0 + 4, (uint32_t)(ctx->alen << 3));
+	SM4_PUTU32(ej0 + 8, (uint32_t)(ctx->clen >> 29));
+	SM4_PUTU32(ej0 + 12, (uint32_t)(ctx->clen << 3));
+	for (i = 0; i < 16; i++)
+		ctx->Xi[i] ^= ej0[i];
+	SM4_gcm_gmult(ctx);
+	SM4_encrypt(&ctx->ks, ctx->J0, ej0);
+	for (i = 0; i < 16; i++)
+		tag[i] = ctx->Xi[i] ^ ej0[i];
+}
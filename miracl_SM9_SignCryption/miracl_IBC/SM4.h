@@ -0,0 +1,90 @@
+/************************************************************************
+FileName:
+SM4.h
+Version:
+SM4_V1.0
+Date:
+Oct 19,2026
+Description:
+SM4 block cipher (GB/T 32907-2016) with CTR and GCM modes, used as the DEM
+of the KEM-DEM signcryption mode. Many blocks are encrypted at once with the
+words of the blocks sliced across a vector, one block per 32-bit lane:
+16 blocks with GFNI and AVX-512 (__GFNI__, __AVX512BW__), 8 blocks with AVX2
+and AES-NI (__AVX2__, __AES__), 4 blocks with AES-NI (__AES__, __SSSE3__),
+otherwise the scalar rounds. The S-box of the vector code is the AES S-box
+between two affine maps, computed by gf2p8affine or by aesenclast and pshufb.
+GHASH uses PCLMULQDQ (__PCLMUL__) or 4-bit tables. As in SM3_mb.h, the path is
+chosen when compiling, with MSVC AES-NI and PCLMULQDQ only under /arch:AVX2.
+Function List:
+1.SM4_set_key                 //expand a 16-byte key into the 32 round keys
+2.SM4_encrypt                 //encrypt one block
+3.SM4_encrypt_blocks          //encrypt n blocks, many at a time
+4.SM4_ctr32_encrypt_blocks    //CTR mode on whole blocks, 32-bit counter
+5.SM4_gcm_init                //GCM key and IV setup
+6.SM4_gcm_setiv               //new IV under the same key, H is kept
+7.SM4_gcm_aad                 //authenticate the additional data
+8.SM4_gcm_encrypt             //GCM encryption, any piece length
+9.SM4_gcm_decrypt             //GCM decryption, any piece length
+10.SM4_gcm_tag                //finish GCM and give the 16-byte tag
+************************************************************************/
+
+#ifndef HEADER_SM4_H
+#define HEADER_SM4_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//MSVC has no macros for AES-NI and PCLMULQDQ, every AVX2 processor has both
+#if defined(__AES__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define SM4_AESNI
+#endif
+#if defined(__PCLMUL__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define SM4_PCLMUL
+#endif
+
+#if defined(__GFNI__) && defined(__AVX512BW__)
+#define SM4_LANES 16
+#elif defined(__AVX2__) && defined(SM4_AESNI)
+#define SM4_LANES 8
+#elif defined(SM4_AESNI) && (defined(__SSSE3__) || defined(__AVX__))
+#define SM4_LANES 4
+#else
+#define SM4_LANES 1
+#endif
+
+#define SM4_BLOCK_LEN 16
+#define SM4_KEY_LEN 16
+#define SM4_GCM_IV_LEN 12
+#define SM4_GCM_TAG_LEN 16
+
+typedef struct
+{
+	uint32_t rk[32];
+} SM4_KEY;
+
+typedef struct
+{
+	SM4_KEY ks;
+	uint64_t Htable[16][2]; //4-bit GHASH tables of H
+	unsigned char Hpow[4][16]; //H^1..H^4 byte reflected, for PCLMULQDQ
+	unsigned char J0[16];   //pre-counter block, encrypts the tag
+	unsigned char ctr[16];  //next counter block
+	unsigned char Xi[16];   //GHASH accumulator
+	unsigned char ek[16];   //key stream of a partial block
+	uint64_t alen, clen;    //bytes of AAD and of text
+	unsigned int used;      //bytes of the current block already processed
+} SM4_GCM_CTX;
+
+void SM4_set_key(const unsigned char key[SM4_KEY_LEN], SM4_KEY *ks);
+void SM4_encrypt(const SM4_KEY *ks, const unsigned char in[16], unsigned char out[16]);
+void SM4_encrypt_blocks(const SM4_KEY *ks, const unsigned char *in, unsigned char *out, size_t n);
+void SM4_ctr32_encrypt_blocks(const SM4_KEY *ks, const unsigned char *in, unsigned char *out,
+	size_t n, unsigned char ctr[16]);
+void SM4_gcm_init(SM4_GCM_CTX *ctx, const unsigned char key[SM4_KEY_LEN], const unsigned char *iv, size_t ivlen);
+void SM4_gcm_setiv(SM4_GCM_CTX *ctx, const unsigned char *iv, size_t ivlen);
+void SM4_gcm_aad(SM4_GCM_CTX *ctx, const unsigned char *aad, size_t len);
+void SM4_gcm_encrypt(SM4_GCM_CTX *ctx, const unsigned char *in, unsigned char *out, size_t len);
+void SM4_gcm_decrypt(SM4_GCM_CTX *ctx, const unsigned char *in, unsigned char *out, size_t len);
+void SM4_gcm_tag(SM4_GCM_CTX *ctx, unsigned char tag[SM4_GCM_TAG_LEN]);
+
+#endif
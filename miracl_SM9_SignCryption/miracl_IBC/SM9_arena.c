@@ -0,0 +1,253 @@
+/************************************************************************
+FileName:
+SM9_arena.c
+Version:
+SM9_ARENA_V1.0
+Date:
+Oct 19,2026
+Description:
+Per-thread scratch arena of bigs, see SM9_arena.h
+Function List:
+1.SM9_arena_grow          //add a block to the arena of the calling thread
+2.SM9_arena_init          //the first block of the arena of the calling thread
+3.SM9_arena_free          //release the arena of the calling thread
+4.SM9_tmp                 //a zeroed big from the arena
+5.SM9_tmp_point           //a point at infinity made of bigs of the arena
+6.SM9_arena_mark          //the current top of the arena
+7.SM9_arena_release       //give back everything taken since a mark
+8.SM9_arena_owns          //tell a big of the arena from a big of mirvar
+9.SM9_arena_peak          //the most bigs ever in use at the same time
+************************************************************************/
+
+#include <string.h>
+#include "SM9_arena.h"
+#include "SM9_thread.h"
+
+typedef struct
+{
+	char *mem[SM9_ARENA_BLOCKS];      //memalloc'd blocks, the first one has the sink after its bigs
+	big first[SM9_ARENA_BLOCKS];      //first and last big of each block, for SM9_arena_owns
+	big last[SM9_ARENA_BLOCKS];
+	int blocks;                       //blocks made so far
+	int top;                          //index of the next free big, big i is in block i/SM9_ARENA_BIGS
+	int peak;
+	BOOL failed;                      //SM9_tmp handed out the sink since the arena was last empty
+	big sink;                         //what SM9_tmp hands out when the arena is full
+} SM9_ARENA;
+
+static SM9_TLS SM9_ARENA SM9_arena;
+
+/****************************************************************
+Function:       SM9_arena_grow
+Description:    add a block of SM9_ARENA_BIGS bigs to the arena of the calling
+                thread, the first block gets one more big, the sink
+Calls:          MIRACL functions
+Called By:      SM9_arena_init,SM9_tmp
+Input:          null
+Output:         null
+Return:         FALSE: SM9_ARENA_BLOCKS blocks already, or can not get memory
+                TRUE: one more block
+Others:
+****************************************************************/
+static BOOL SM9_arena_grow(void)
+{
+	SM9_ARENA *a = &SM9_arena;
+	int n = SM9_ARENA_BIGS + (a->blocks == 0 ? 1 : 0);
+	char *mem;
+
+	if (a->blocks == SM9_ARENA_BLOCKS)
+		return FALSE;
+	mem = (char *)memalloc(n);
+	if (mem == NULL)
+		return FALSE;
+	a->mem[a->blocks] = mem;
+	a->first[a->blocks] = mirvar_mem(mem, 0);
+	a->last[a->blocks] = mirvar_mem(mem, n - 1);
+	if (a->blocks == 0)
+		a->sink = a->last[0];
+	a->blocks++;
+	return TRUE;
+}
+
+/****************************************************************
+Function:       SM9_arena_init
+Description:    make the first block of the arena of the calling thread, so
+                that the operations that follow take no memory from the heap
+Calls:          SM9_arena_grow
+Called By:      SM9_Init,SM9_ctx_init,SM9_batch_worker,SM9_coupon_worker
+Input:          null
+Output:         null
+Return:         0: success
+                1: can not get memory
+Others:         after mirsys, the arena is otherwise made by the first SM9_tmp
+****************************************************************/
+int SM9_arena_init(void)
+{
+	if (SM9_arena.blocks > 0)
+		return 0;
+	return SM9_arena_grow() ? 0 : 1;
+}
+
+/****************************************************************
+Function:       SM9_arena_free
+Description:    release all the blocks of the arena of the calling thread
+Calls:          MIRACL functions
+Called By:      SM9_ctx_free,SM9_batch_worker,SM9_coupon_worker,SM9_bcast_worker
+Input:          null
+Output:         null
+Return:         null
+Others:         before mirexit, no big of the arena may be in use
+****************************************************************/
+void SM9_arena_free(void)
+{
+	SM9_ARENA *a = &SM9_arena;
+	int i;
+
+	for (i = 0; i < a->blocks; i++)
+		memkill(a->mem[i], SM9_ARENA_BIGS + (i == 0 ? 1 : 0));
+	memset(a, 0, sizeof(SM9_ARENA));
+}
+
+/****************************************************************
+Function:       SM9_tmp
+Description:    take the next big of the arena of the calling thread and set
+                it to 0, a new block is added when the last one is full
+Calls:          MIRACL functions,SM9_arena_grow
+Called By:      zzn12_tmp,zzn12_mul,zzn12_inverse,zzn12_pow,zzn12_powq,
+                q_power_frobenius,fast_pairing,final_exp,line,g,ecap,member,
+                ecap_multi,Signcrypt_work,Unsigncrypt_work,SM9_G1_mul_glv
+Input:          null
+Output:         null
+Return:         the big
+Others:         with SM9_ARENA_NO_HEAP, or when SM9_ARENA_BLOCKS blocks are
+                full, the arena does not grow: the sink big is returned, the
+                result of the operation is wrong and SM9_arena_release says so
+****************************************************************/
+big SM9_tmp(void)
+{
+	SM9_ARENA *a = &SM9_arena;
+	int b = a->top / SM9_ARENA_BIGS;
+	BOOL ok = TRUE;
+	big x;
+
+	if (b == a->blocks)
+	{
+#ifdef SM9_ARENA_NO_HEAP
+		ok = a->blocks == 0 && SM9_arena_grow(); //only when SM9_arena_init was not called
+#else
+		ok = SM9_arena_grow();
+#endif
+	}
+	if (!ok)
+	{
+		a->failed = TRUE;
+		if (a->sink == NULL)
+			return mirvar(0);
+		zero(a->sink);
+		return a->sink;
+	}
+	x = mirvar_mem(a->mem[b], a->top % SM9_ARENA_BIGS);
+	zero(x);
+	a->top++;
+	if (a->top > a->peak)
+		a->peak = a->top;
+	return x;
+}
+
+/****************************************************************
+Function:       SM9_tmp_point
+Description:    a point of the curve over Fp whose coordinates are bigs of the
+                arena, in place of epoint_init
+Calls:          SM9_tmp
+Called By:      Signcrypt_work,Unsigncrypt_work,SM9_G1_mul_glv
+Input:          null
+Output:         epoint *P    //the point at infinity
+Return:         null
+Others:         P lives until the caller releases its mark, it must not be
+                given to epoint_free
+****************************************************************/
+void SM9_tmp_point(epoint *P)
+{
+	P->X = SM9_tmp();
+	P->Y = SM9_tmp();
+#ifndef MR_AFFINE_ONLY
+	P->Z = SM9_tmp();
+#endif
+	P->marker = MR_EPOINT_INFINITY;
+}
+
+/****************************************************************
+Function:       SM9_arena_mark
+Description:    the current top of the arena of the calling thread
+Calls:
+Called By:      the functions that call SM9_tmp
+Input:          null
+Output:         null
+Return:         the mark, for SM9_arena_release
+Others:
+****************************************************************/
+int SM9_arena_mark(void)
+{
+	return SM9_arena.top;
+}
+
+/****************************************************************
+Function:       SM9_arena_release
+Description:    give back all the bigs taken since mark was taken
+Calls:
+Called By:      the functions that call SM9_tmp
+Input:          int mark     //from SM9_arena_mark
+Output:         null
+Return:         FALSE: the sink was handed out since the arena was last empty,
+                the results computed in the meantime are wrong
+                TRUE: every big came from the arena
+Others:         marks are released in the reverse order they were taken
+****************************************************************/
+BOOL SM9_arena_release(int mark)
+{
+	SM9_ARENA *a = &SM9_arena;
+	BOOL ok = !a->failed;
+
+	a->top = mark;
+	if (mark == 0)
+		a->failed = FALSE;
+	return ok;
+}
+
+/****************************************************************
+Function:       SM9_arena_owns
+Description:    whether x is a big of the arena of the calling thread
+Calls:
+Called By:      zzn12_kill
+Input:          big x
+Output:         null
+Return:         TRUE: x came from SM9_tmp, it must not be given to mirkill
+                FALSE: x came from mirvar
+Others:
+****************************************************************/
+BOOL SM9_arena_owns(big x)
+{
+	SM9_ARENA *a = &SM9_arena;
+	int i;
+
+	for (i = 0; i < a->blocks; i++)
+		if ((char *)x >= (char *)a->first[i] && (char *)x <= (char *)a->last[i])
+			return TRUE;
+	return FALSE;
+}
+
+/****************************************************************
+Function:       SM9_arena_peak
+Description:    the most bigs of the arena of the calling thread ever in use
+                at the same time, to size SM9_ARENA_BIGS
+Calls:
+Called By:      SM9_SelfCheck
+Input:          null
+Output:         null
+Return:         the number of bigs
+Others:
+****************************************************************/
+int SM9_arena_peak(void)
+{
+	return SM9_arena.peak;
+}
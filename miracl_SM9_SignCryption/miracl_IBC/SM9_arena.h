@@ -0,0 +1,53 @@
+/************************************************************************
+FileName:
+SM9_arena.h
+Version:
+SM9_ARENA_V1.0
+Date:
+Oct 19,2026
+Description:
+Scratch arena for the temporaries of the pairing and of the GT arithmetic.
+The original code takes every temporary with mirvar and never gives it back,
+so each ecap, Signcrypt or Unsigncrypt leaks some hundreds of bigs. Here they
+come from blocks of SM9_ARENA_BIGS bigs, one arena per thread, handed out in
+stack order: an operation takes a mark, draws its bigs with SM9_tmp and
+releases the mark before it returns, which gives all of them back at once.
+Defining SM9_ARENA_NO_HEAP keeps the arena to the block made by
+SM9_arena_init: the pairing, final exponentiation and GT powers then make no
+heap allocation at all, and running out of the block is reported instead of
+growing it.
+Function List:
+1.SM9_arena_init          //the first block of the arena of the calling thread
+2.SM9_arena_free          //release the arena of the calling thread
+3.SM9_tmp                 //a zeroed big from the arena
+4.SM9_tmp_point           //a point at infinity made of bigs of the arena
+5.SM9_arena_mark          //the current top of the arena
+6.SM9_arena_release       //give back everything taken since a mark
+7.SM9_arena_owns          //tell a big of the arena from a big of mirvar
+8.SM9_arena_peak          //the most bigs ever in use at the same time
+Notes:
+A zzn12 or zzn2 returned by value (zzn12_pow, zzn12_inverse, line, g, ...) is
+made of bigs of the arena and lives until the caller releases its own mark:
+copy it into a zzn12 of zzn12_init before that if it must be kept.
+SM9_arena_init and SM9_arena_free use the mip of the calling thread, call
+them after mirsys and before mirexit.
+************************************************************************/
+
+#ifndef HEADER_SM9_ARENA_H
+#define HEADER_SM9_ARENA_H
+
+#include "miracl.h"
+
+#define SM9_ARENA_BIGS 1024       //bigs of one block of the arena
+#define SM9_ARENA_BLOCKS 8        //blocks an arena may grow to without SM9_ARENA_NO_HEAP
+
+int SM9_arena_init(void);
+void SM9_arena_free(void);
+big SM9_tmp(void);
+void SM9_tmp_point(epoint *P);
+int SM9_arena_mark(void);
+BOOL SM9_arena_release(int mark);
+BOOL SM9_arena_owns(big x);
+int SM9_arena_peak(void);
+
+#endif
@@ -0,0 +1,692 @@
+/************************************************************************
+FileName:
+SM9_batch.c
+Version:
+SM9_BATCH_V1.0
+Date:
+Oct 19,2026
+Description:
+Batch unsigncryption with one randomized check, see SM9_batch.h
+Function List:
+1.SM9_recv_key_init       //lines of deR and Ppub, g=e(P1,Ppub) and its table
+2.SM9_recv_key_free       //release the key
+3.SM9_batch_open          //B1-B3 and h1 of one ciphertext: w', M', h' and H1(IDS||hid,N)
+4.SM9_batch_worker        //thread of SM9_batch_run
+5.SM9_batch_run           //B1-B3 of all items, one range per processor
+6.SM9_batch_test          //the merged check of some ciphertexts
+7.SM9_batch_find          //bisection of a batch that failed the check
+8.Unsigncrypt_batch       //unsigncrypt n ciphertexts with one randomized check
+9.SM9_batch_task          //SM9_batch_open as an item of SM9_pool_calc
+10.SM9_verify_batch       //Unsigncrypt_batch with its B1-B3 on a pool of threads
+11.Unsigncrypt_key        //unsigncrypt one ciphertext with the prepared key
+************************************************************************/
+
+#include <string.h>
+#include "SM9_pool.h"
+
+extern zzn2 X; //Frobniues constant
+extern epoint *P1;
+extern big N, para_a, para_b, para_t, para_q;
+extern ecap_lines P2_lines;
+
+typedef struct
+{
+	big h, h1, d;                     //h', H1(IDS||hid,N) and the random exponent d
+	epoint *S;
+	zzn12 w;                          //w'
+} SM9_BATCH_WORK;
+
+typedef struct
+{
+	SM9_RECV_KEY *key;
+	SM9_UNSC_ITEM *items;
+	int *result;
+	SM9_BATCH_WORK *wk;
+} SM9_BATCH;
+
+typedef void (*SM9_BATCH_FUNC)(SM9_BATCH *b, int i);
+
+typedef struct
+{
+	SM9_BATCH *b;
+	SM9_BATCH_FUNC func;
+	int from, to;
+	int curve;                        //the thread makes its own mip
+} SM9_BATCH_JOB;
+
+/****************************************************************
+Function:       SM9_recv_key_init
+Description:    prepare the receiver for Unsigncrypt_batch: the Miller loop
+                lines of its private key and of Ppub, g=e(P1,Ppub) with its table
+Calls:          MIRACL functions,bytes128_to_ecn2,ecap_prep,ecap_fixed,member,
+                zzn12_init,zzn12_kill,zzn12_fb_init,SM9_recv_key_free
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                hid          //0x03
+                IDR          //identification of the receiver, kept by pointer
+                de           //private key of IDR, 128 bytes
+                Ppub         //master public key [ks]P2, 128 bytes
+Output:
+                key
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_GEPUB_ERR: Ppub is not a point of G2
+                SM9_GEPRI_ERR: de is not a point of G2
+                SM9_MY_ECAP_12A_ERR: R-ate calculation error
+                SM9_MEMBER_ERR: the order of g is error
+                SM9_CTX_ERR: ctx belongs to another thread
+Others:
+****************************************************************/
+int SM9_recv_key_init(SM9_CTX *ctx, SM9_RECV_KEY *key, unsigned char hid[], unsigned char *IDR,
+	unsigned char de[], unsigned char Ppub[])
+{
+	ecn2 D, Ppubs;
+	char *mem;
+	int buf = 0;
+
+	memset(key, 0, sizeof(SM9_RECV_KEY));
+	key->IDR = IDR;
+	key->hid = hid[0];
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	mem = (char *)memalloc(12);
+	if (mem == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	D.x.a = mirvar_mem(mem, 0);
+	D.x.b = mirvar_mem(mem, 1);
+	D.y.a = mirvar_mem(mem, 2);
+	D.y.b = mirvar_mem(mem, 3);
+	D.z.a = mirvar_mem(mem, 4);
+	D.z.b = mirvar_mem(mem, 5);
+	D.marker = MR_EPOINT_INFINITY;
+	Ppubs.x.a = mirvar_mem(mem, 6);
+	Ppubs.x.b = mirvar_mem(mem, 7);
+	Ppubs.y.a = mirvar_mem(mem, 8);
+	Ppubs.y.b = mirvar_mem(mem, 9);
+	Ppubs.z.a = mirvar_mem(mem, 10);
+	Ppubs.z.b = mirvar_mem(mem, 11);
+	Ppubs.marker = MR_EPOINT_INFINITY;
+	zzn12_init(&key->g);
+
+	if (!bytes128_to_ecn2(Ppub, &Ppubs) || !ecap_prep(Ppubs, para_t, X, &key->pub))
+		buf = SM9_GEPUB_ERR;
+	else if (!bytes128_to_ecn2(de, &D) || !ecap_prep(D, para_t, X, &key->de))
+		buf = SM9_GEPRI_ERR;
+	else if (!ecap_fixed(&key->pub, P1, para_t, X, &key->g))
+		buf = SM9_MY_ECAP_12A_ERR;
+	else if (!member(key->g, para_t, X))
+		buf = SM9_MEMBER_ERR;
+	else
+	{
+		zzn12_fb_init(&key->gfb, key->g);
+		key->gfb_ok = TRUE;
+	}
+
+	memkill(mem, 12);
+	if (buf != 0)
+	{
+		zzn12_kill(&key->g);
+		SM9_recv_key_free(key);
+	}
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_recv_key_free
+Description:    release the lines, g and its table
+Calls:          ecap_lines_free,zzn12_fb_free,zzn12_kill
+Called By:      SM9_recv_key_init,SM9_SelfCheck
+Input:
+                key
+Output:
+                NULL
+Return:
+                NULL
+Others:
+****************************************************************/
+void SM9_recv_key_free(SM9_RECV_KEY *key)
+{
+	ecap_lines_free(&key->de);
+	ecap_lines_free(&key->pub);
+	if (key->gfb_ok)
+	{
+		zzn12_fb_free(&key->gfb);
+		zzn12_kill(&key->g);
+	}
+	memset(key, 0, sizeof(SM9_RECV_KEY));
+}
+
+/****************************************************************
+Function:       SM9_batch_open
+Description:    B1-B3 of ciphertext i as Unsigncrypt_into does them, with T
+                and S read from the item: w'=e(T,deR) with the lines of deR,
+                M' and h'=H2(M'||w',N) in one pass
+Calls:          MIRACL functions,ecap_fixed,SM3_KDF_init,SM3_KDF_absorb,
+                SM3_KDF_xor,SM9_DEM_decrypt,SM9_absorb_zzn12,SM9_H_init,SM9_H_final
+Called By:      SM9_batch_run,SM9_batch_task,Unsigncrypt_key
+Input:
+                b
+                i            //index of the ciphertext
+Output:
+                b->wk[i], b->items[i].M, b->result[i]
+Return:
+                NULL
+Others:         h1=H1(IDS||hid,N) of B5 is computed by the caller with SM9_H1_mb
+****************************************************************/
+static void SM9_batch_open(SM9_BATCH *b, int i)
+{
+	SM9_UNSC_ITEM *it = &b->items[i];
+	SM9_BATCH_WORK *wk = &b->wk[i];
+	SM3_KDF_CTX kdf, hv;
+	big x, y;
+	epoint *T;
+	char *mem;
+
+	b->result[i] = 0;
+	mem = (char *)memalloc(2);
+	if (mem == NULL)
+	{
+		b->result[i] = SM9_ASK_MEMORY_ERR;
+		return;
+	}
+	x = mirvar_mem(mem, 0);
+	y = mirvar_mem(mem, 1);
+	T = epoint_init();
+
+	bytes_to_big(BNLEN, it->T, x);
+	bytes_to_big(BNLEN, it->T + BNLEN, y);
+	if (!epoint_set(x, y, 0, T))
+		b->result[i] = SM9_T_NOT_VALID_G1;
+	bytes_to_big(BNLEN, it->S, x);
+	bytes_to_big(BNLEN, it->S + BNLEN, y);
+	if (b->result[i] == 0 && !epoint_set(x, y, 0, wk->S))
+		b->result[i] = SM9_S_NOT_VALID_G1;
+
+	//B1: w' = e(T, deR)
+	if (b->result[i] == 0 && !ecap_fixed(&b->key->de, T, para_t, X, &wk->w))
+		b->result[i] = SM9_MY_ECAP_12A_ERR;
+
+	//B2, B3: M' and h'=H2(M'||w',N)
+	if (b->result[i] == 0)
+	{
+		SM3_KDF_init(&kdf);
+		SM3_KDF_absorb(&kdf, it->T, BNLEN * 2);
+		SM9_absorb_zzn12(&kdf, wk->w);
+		SM3_KDF_absorb(&kdf, b->key->IDR, strlen((char *)b->key->IDR));
+		SM9_H_init(&hv, 0x02);
+		if (it->mlen >= SM9_DEM_THRESHOLD)
+			b->result[i] = SM9_DEM_decrypt(&kdf, &hv, it->C, it->mlen, it->M);
+		else
+			SM3_KDF_xor(&kdf, &hv, it->C, it->M, it->mlen, 1);
+		if (b->result[i] == 0)
+		{
+			SM9_absorb_zzn12(&hv, wk->w);
+			b->result[i] = SM9_H_final(&hv, N, wk->h);
+		}
+		memset(&kdf, 0, sizeof(kdf));
+		memset(&hv, 0, sizeof(hv));
+	}
+
+	epoint_free(T);
+	memkill(mem, 2);
+}
+
+#if defined(MR_OS_THREADS) && !defined(SM9_NO_THREADS)
+/****************************************************************
+Function:       SM9_batch_worker
+Description:    thread of SM9_batch_run: a context of its own when job->curve
+                is set, then its range of items
+Calls:          SM9_ctx_init,SM9_ctx_free
+Called By:      SM9_batch_run
+Input:
+                arg          //SM9_BATCH_JOB
+Output:
+                NULL
+Return:
+                NULL
+Others:         without a context the items of the range get SM9_ASK_MEMORY_ERR
+****************************************************************/
+static void SM9_batch_worker(void *arg)
+{
+	SM9_BATCH_JOB *job = (SM9_BATCH_JOB *)arg;
+	SM9_CTX ctx;
+	int i;
+
+	if (job->curve && SM9_ctx_init(&ctx) != 0)
+	{
+		for (i = job->from; i < job->to; i++)
+			job->b->result[i] = SM9_ASK_MEMORY_ERR;
+		return;
+	}
+	for (i = job->from; i < job->to; i++)
+		job->func(job->b, i);
+	if (job->curve)
+		SM9_ctx_free(&ctx);
+}
+#endif
+
+/****************************************************************
+Function:       SM9_batch_run
+Description:    func(b,i) for i<n, the items are cut into ranges, one per
+                processor, when MIRACL has MR_OS_THREADS, otherwise all of
+                them in the calling thread
+Calls:          SM9_batch_worker,SM9_thread_start,SM9_thread_join,SM9_cpu_count
+Called By:      SM9_verify_batch
+Input:
+                b, func, n
+Output:
+                NULL
+Return:
+                NULL
+Others:         the calling thread keeps the last range with its own mip
+****************************************************************/
+static void SM9_batch_run(SM9_BATCH *b, SM9_BATCH_FUNC func, int n)
+{
+#if defined(MR_OS_THREADS) && !defined(SM9_NO_THREADS)
+	SM9_BATCH_JOB job[SM9_BATCH_MAX_THREADS];
+	SM9_THREAD th[SM9_BATCH_MAX_THREADS];
+	int started[SM9_BATCH_MAX_THREADS];
+	int nthr, i;
+
+	if (n <= 0)
+		return;
+	nthr = SM9_cpu_count();
+	if (nthr > SM9_BATCH_MAX_THREADS)
+		nthr = SM9_BATCH_MAX_THREADS;
+	if (nthr > n)
+		nthr = n;
+	for (i = 0; i < nthr; i++)
+	{
+		job[i].b = b;
+		job[i].func = func;
+		job[i].from = (int)((long long)n * i / nthr);
+		job[i].to = (int)((long long)n * (i + 1) / nthr);
+		job[i].curve = 1;
+	}
+	job[nthr - 1].curve = 0;
+	for (i = 0; i < nthr - 1; i++)
+		started[i] = SM9_thread_start(&th[i], SM9_batch_worker, &job[i]) == 0;
+	SM9_batch_worker(&job[nthr - 1]);
+	for (i = 0; i < nthr - 1; i++)
+	{
+		if (started[i])
+			SM9_thread_join(th[i]);
+		else
+		{
+			job[i].curve = 0;
+			SM9_batch_worker(&job[i]);
+		}
+	}
+#else
+	int i;
+
+	for (i = 0; i < n; i++)
+		func(b, i);
+#endif
+}
+
+/****************************************************************
+Function:       SM9_batch_test
+Description:    the merged check of the m ciphertexts idx[]: as
+                e(S,[h1]P2+Ppub) = e([h1]S,P2)*e(S,Ppub), the pairings of all of
+                them are e(A,P2)*e(B,Ppub) with A=sum [d*h1]S and B=sum [d]S,
+                two multi-scalar multiplications and one multi-pairing over the
+                lines of P2 and Ppub, times g^e with e=sum d*h' mod N, against
+                the product of the w'^d
+Calls:          MIRACL functions,ecap_multi,zzn12_fb_pow,zzn12_multi_pow,
+                zzn12_mul,zzn12_to_bytes384,zzn12_tmp,SM9_arena_mark,SM9_arena_release
+Called By:      SM9_verify_batch,SM9_batch_find,Unsigncrypt_key
+Input:
+                b
+                idx          //indexes of the ciphertexts
+                m            //number of them
+Output:
+                ok           //TRUE when the check holds
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_MY_ECAP_12A_ERR: R-ate calculation error
+Others:         with m=1 this is the check of Unsigncrypt_into raised to d
+****************************************************************/
+static int SM9_batch_test(SM9_BATCH *b, int idx[], int m, BOOL *ok)
+{
+	unsigned char lb[BNLEN * 12], rb[BNLEN * 12];
+	ecap_lines *L[2];
+	epoint *Q[2], **Sp;
+	big *a, *d, e, tmp;
+	zzn12 *w, M, G, W;
+	char *mem;
+	int j, mark, buf = 0;
+
+	*ok = FALSE;
+	Sp = (epoint **)malloc(sizeof(epoint *) * m);
+	a = (big *)malloc(sizeof(big) * 2 * m);
+	w = (zzn12 *)malloc(sizeof(zzn12) * m);
+	mem = (char *)memalloc(2 + m);
+	if (Sp == NULL || a == NULL || w == NULL || mem == NULL)
+	{
+		if (mem != NULL)
+			memkill(mem, 2 + m);
+		free(Sp);
+		free(a);
+		free(w);
+		return SM9_ASK_MEMORY_ERR;
+	}
+	d = a + m;
+	e = mirvar_mem(mem, 0);
+	tmp = mirvar_mem(mem, 1);
+
+	for (j = 0; j < m; j++)
+	{
+		a[j] = mirvar_mem(mem, 2 + j);
+		d[j] = b->wk[idx[j]].d;
+		Sp[j] = b->wk[idx[j]].S;
+		w[j] = b->wk[idx[j]].w;
+		multiply(d[j], b->wk[idx[j]].h1, a[j]);
+		divide(a[j], N, tmp);
+		multiply(d[j], b->wk[idx[j]].h, tmp);
+		add(e, tmp, e);
+		divide(e, N, tmp);
+	}
+
+	L[0] = &P2_lines;
+	L[1] = &b->key->pub;
+	Q[0] = epoint_init();
+	Q[1] = epoint_init();
+	ecurve_multn(m, a, Sp, Q[0]);
+	ecurve_multn(m, d, Sp, Q[1]);
+
+	mark = SM9_arena_mark();
+	zzn12_tmp(&M);
+	if (!ecap_multi(2, L, Q, para_t, X, &M))
+		buf = SM9_MY_ECAP_12A_ERR;
+	else
+	{
+		G = zzn12_fb_pow(&b->key->gfb, e);
+		zzn12_mul(M, G, &M);
+		W = zzn12_multi_pow(m, w, d);
+		zzn12_to_bytes384(M, lb);
+		zzn12_to_bytes384(W, rb);
+		*ok = memcmp(lb, rb, sizeof(lb)) == 0;
+	}
+	if (!SM9_arena_release(mark) && buf == 0)
+	{
+		*ok = FALSE;
+		buf = SM9_ASK_MEMORY_ERR;
+	}
+	epoint_free(Q[0]);
+	epoint_free(Q[1]);
+
+	memkill(mem, 2 + m);
+	free(Sp);
+	free(a);
+	free(w);
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_batch_find
+Description:    the m ciphertexts idx[] failed the merged check: cut them in
+                halves and check the first, the second half is only checked
+                when the first one has failed too
+Calls:          SM9_batch_test,SM9_batch_find
+Called By:      SM9_verify_batch,SM9_batch_find
+Input:
+                b, idx, m
+Output:
+                b->result    //SM9_DATA_MEMCMP_ERR for each bad ciphertext
+Return:
+                0: success
+                other: the error of SM9_batch_test
+Others:
+****************************************************************/
+static int SM9_batch_find(SM9_BATCH *b, int idx[], int m)
+{
+	int half = m / 2, buf;
+	BOOL ok;
+
+	if (m == 1)
+	{
+		b->result[idx[0]] = SM9_DATA_MEMCMP_ERR;
+		return 0;
+	}
+	buf = SM9_batch_test(b, idx, half, &ok);
+	if (buf != 0)
+		return buf;
+	if (!ok)
+	{
+		buf = SM9_batch_find(b, idx, half);
+		if (buf != 0)
+			return buf;
+		buf = SM9_batch_test(b, idx + half, m - half, &ok);
+		if (buf != 0 || ok)
+			return buf;
+	}
+	return SM9_batch_find(b, idx + half, m - half);
+}
+
+/****************************************************************
+Function:       SM9_batch_task
+Description:    SM9_batch_open as an item of SM9_pool_calc
+Calls:          SM9_batch_open
+Called By:      SM9_pool_calc
+Input:
+                arg          //SM9_BATCH
+                i
+Output:
+                as SM9_batch_open
+Return:
+                0, the status of the item is b->result[i]
+Others:
+****************************************************************/
+static int SM9_batch_task(void *arg, int i)
+{
+	SM9_batch_open((SM9_BATCH *)arg, i);
+	return 0;
+}
+
+/****************************************************************
+Function:       SM9_verify_batch
+Description:    unsigncrypt n ciphertexts to the receiver of key. B1-B3 of each
+                one, its w', M' and h', are computed on their own, spread over
+                the threads of tp or over the processors; B5 of all of them is
+                one SM9_H1_mb and B6 one randomized check, with bisection when it fails
+Calls:          MIRACL functions,SM9_pool_calc,SM9_batch_task,SM9_batch_run,
+                SM9_batch_open,SM9_H1_mb,SM9_batch_test,SM9_batch_find,zzn12_init,zzn12_kill
+Called By:      Unsigncrypt_batch,SM9_pool_bench,SM9_SelfCheck
+Input:
+                tp           //pool of threads, NULL for threads of this call
+                ctx          //context of the calling thread
+                key          //made by SM9_recv_key_init
+                items        //the n ciphertexts
+                n
+Output:
+                items[i].M   //M' of each good ciphertext, zeroed for a bad one
+                result       //0 or the error of each ciphertext, as Unsigncrypt_into
+Return:
+                0: all ciphertexts are good
+                SM9_DATA_MEMCMP_ERR: some are not, see result
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_MY_ECAP_12A_ERR: R-ate calculation error in the merged check
+                SM9_CTX_ERR: ctx belongs to another thread
+Others:
+****************************************************************/
+int SM9_verify_batch(SM9_POOL *tp, SM9_CTX *ctx, SM9_RECV_KEY *key, SM9_UNSC_ITEM items[], int n,
+	int result[])
+{
+	SM9_BATCH b;
+	int *idx = NULL, m = 0, i, buf = 0;
+	unsigned char **ids = NULL;
+	big *h1 = NULL;
+	char *mem = NULL;
+	BOOL ok;
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	if (n <= 0)
+		return 0;
+	b.key = key;
+	b.items = items;
+	b.result = result;
+	b.wk = (SM9_BATCH_WORK *)malloc(sizeof(SM9_BATCH_WORK) * n);
+	idx = (int *)malloc(sizeof(int) * n);
+	ids = (unsigned char **)malloc(sizeof(unsigned char *) * n);
+	h1 = (big *)malloc(sizeof(big) * n);
+	mem = (char *)memalloc(3 * n);
+	if (b.wk == NULL || idx == NULL || ids == NULL || h1 == NULL || mem == NULL)
+	{
+		if (mem != NULL)
+			memkill(mem, 3 * n);
+		free(b.wk);
+		free(idx);
+		free(ids);
+		free(h1);
+		return SM9_ASK_MEMORY_ERR;
+	}
+	for (i = 0; i < n; i++)
+	{
+		b.wk[i].h = mirvar_mem(mem, 3 * i);
+		b.wk[i].h1 = mirvar_mem(mem, 3 * i + 1);
+		b.wk[i].d = mirvar_mem(mem, 3 * i + 2);
+		b.wk[i].S = epoint_init();
+		zzn12_init(&b.wk[i].w);
+	}
+	if (tp != NULL)
+		SM9_pool_calc(tp, SM9_batch_task, &b, n, NULL);
+	else
+		SM9_batch_run(&b, SM9_batch_open, n);
+
+	//B5 of all ciphertexts at once, their H1(IDS||hid,N) share the lanes of SM3_256_mb
+	for (i = 0; i < n; i++)
+	{
+		ids[i] = items[i].IDS;
+		h1[i] = b.wk[i].h1;
+	}
+	buf = SM9_H1_mb(ids, n, &key->hid, N, h1);
+
+	//B6 of all good ciphertexts at once
+	for (i = 0; buf == 0 && i < n; i++)
+	{
+		if (result[i] != 0)
+			continue;
+		do
+			strong_bigdig(&ctx->rng, SM9_BATCH_DELTA_BITS, 2, b.wk[i].d);
+		while (size(b.wk[i].d) == 0);
+		idx[m++] = i;
+	}
+	if (m > 0)
+	{
+		buf = SM9_batch_test(&b, idx, m, &ok);
+		if (buf == 0 && !ok)
+			buf = SM9_batch_find(&b, idx, m);
+	}
+
+	//no M' is given out before its check has passed
+	for (i = 0; i < n; i++)
+	{
+		if (buf != 0 && result[i] == 0)
+			result[i] = buf;
+		if (result[i] == 0)
+			continue;
+		memset(items[i].M, 0, items[i].mlen);
+		if (buf == 0)
+			buf = SM9_DATA_MEMCMP_ERR;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		epoint_free(b.wk[i].S);
+		zzn12_kill(&b.wk[i].w);
+	}
+	memkill(mem, 3 * n);
+	free(b.wk);
+	free(idx);
+	free(ids);
+	free(h1);
+	return buf;
+}
+
+/****************************************************************
+Function:       Unsigncrypt_batch
+Description:    SM9_verify_batch with threads of its own
+Calls:          SM9_verify_batch
+Called By:      SM9_SelfCheck
+Input:
+                ctx, key, items, n //as SM9_verify_batch
+Output:
+                items[i].M, result
+Return:
+                as SM9_verify_batch
+Others:
+****************************************************************/
+int Unsigncrypt_batch(SM9_CTX *ctx, SM9_RECV_KEY *key, SM9_UNSC_ITEM items[], int n, int result[])
+{
+	return SM9_verify_batch(NULL, ctx, key, items, n, result);
+}
+
+/****************************************************************
+Function:       Unsigncrypt_key
+Description:    unsigncrypt one ciphertext to the receiver of key: B1-B3 with
+                the lines of deR, and B6 on its own, the check of
+                SM9_batch_test with d=1 and one ciphertext
+Calls:          MIRACL functions,SM9_batch_open,SM9_H1_mb,SM9_batch_test,zzn12_init,zzn12_kill
+Called By:      SM9_pool_unsigncrypt,SM9_pool_latency
+Input:
+                ctx          //context of the calling thread
+                key          //made by SM9_recv_key_init
+                it           //the ciphertext
+Output:
+                it->M        //M', zeroed when the ciphertext is bad
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_DATA_MEMCMP_ERR: [e(S,P)]g^h' is not w'
+                SM9_CTX_ERR: ctx belongs to another thread
+                other: as Unsigncrypt_into
+Others:         the key is only read, several threads may share it
+****************************************************************/
+int Unsigncrypt_key(SM9_CTX *ctx, SM9_RECV_KEY *key, SM9_UNSC_ITEM *it)
+{
+	SM9_BATCH b;
+	SM9_BATCH_WORK wk;
+	char *mem;
+	int idx = 0, result, buf;
+	BOOL ok;
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	mem = (char *)memalloc(3);
+	if (mem == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	wk.h = mirvar_mem(mem, 0);
+	wk.h1 = mirvar_mem(mem, 1);
+	wk.d = mirvar_mem(mem, 2);
+	convert(1, wk.d);
+	wk.S = epoint_init();
+	zzn12_init(&wk.w);
+	b.key = key;
+	b.items = it;
+	b.result = &result;
+	b.wk = &wk;
+
+	SM9_batch_open(&b, 0);
+	buf = result;
+	if (buf == 0)
+		buf = SM9_H1_mb(&it->IDS, 1, &key->hid, N, &wk.h1);
+	if (buf == 0)
+	{
+		buf = SM9_batch_test(&b, &idx, 1, &ok);
+		if (buf == 0 && !ok)
+			buf = SM9_DATA_MEMCMP_ERR;
+	}
+	if (buf != 0)
+		memset(it->M, 0, it->mlen);
+
+	epoint_free(wk.S);
+	zzn12_kill(&wk.w);
+	memkill(mem, 3);
+	return buf;
+}
@@ -0,0 +1,66 @@
+/************************************************************************
+FileName:
+SM9_batch.h
+Version:
+SM9_BATCH_V1.0
+Date:
+Oct 19,2026
+Description:
+Batch unsigncryption for a receiver that drains a queue of signcryptions.
+Every ciphertext still gets its own w' = e(T,deR), the KDF needs it, but the
+n checks e(S_i,P_i)*g^h'_i = w'_i of step B6 are merged into one with random
+exponents d_i of SM9_BATCH_DELTA_BITS bits. As e(S,[h1]P2+Ppub) =
+e([h1]S,P2)*e(S,Ppub), the senders only enter through their h1:
+	e(sum [d_i*h1_i]S_i, P2) * e(sum [d_i]S_i, Ppub) * g^(sum d_i*h'_i) = prod w'_i^d_i
+that is two multi-scalar multiplications in G1, one multi-pairing over the
+lines of P2 and Ppub, one fixed-base power of g and one multi-exponentiation
+in GT, whatever the number of senders. When the check fails the batch is
+cut in halves until the bad ciphertexts are found.
+Function List:
+1.SM9_recv_key_init       //lines of deR and Ppub, g=e(P1,Ppub) and its table
+2.SM9_recv_key_free       //release the key
+3.Unsigncrypt_batch       //unsigncrypt n ciphertexts with one randomized check
+4.Unsigncrypt_key         //unsigncrypt one ciphertext with the prepared key
+Notes:
+A forged ciphertext passes the merged check with probability 2^-SM9_BATCH_DELTA_BITS.
+The d_i come from the csprng of the SM9_CTX of the calling thread, seeded
+from the OS by SM9_ctx_init.
+************************************************************************/
+
+#ifndef HEADER_SM9_BATCH_H
+#define HEADER_SM9_BATCH_H
+
+#include "SM9_sv.h"
+#include "SM9_thread.h"
+
+#define SM9_BATCH_DELTA_BITS 64   //bits of the random exponents of the merged check
+#define SM9_BATCH_MAX_THREADS 16
+
+//long-term side of the receiver
+typedef struct
+{
+	unsigned char *IDR;           //identification of the receiver, kept by pointer
+	unsigned char hid;
+	ecap_lines de;                //lines of the private key deR
+	ecap_lines pub;               //lines of Ppub=[ks]P2
+	zzn12 g;                      //e(P1,Ppub)
+	zzn12_fb gfb;                 //fixed-base table of g
+	BOOL gfb_ok;
+} SM9_RECV_KEY;
+
+//one signcryption of the queue
+typedef struct
+{
+	unsigned char *IDS;           //identification of the sender, a C string
+	size_t mlen;                  //the length of the message
+	unsigned char *S, *T, *C;     //the signcryption, C is SM9_C_LEN(mlen) bytes
+	unsigned char *M;             //M', mlen bytes, written by Unsigncrypt_batch
+} SM9_UNSC_ITEM;
+
+int SM9_recv_key_init(SM9_CTX *ctx, SM9_RECV_KEY *key, unsigned char hid[], unsigned char *IDR,
+	unsigned char de[], unsigned char Ppub[]);
+void SM9_recv_key_free(SM9_RECV_KEY *key);
+int Unsigncrypt_batch(SM9_CTX *ctx, SM9_RECV_KEY *key, SM9_UNSC_ITEM items[], int n, int result[]);
+int Unsigncrypt_key(SM9_CTX *ctx, SM9_RECV_KEY *key, SM9_UNSC_ITEM *it);
+
+#endif
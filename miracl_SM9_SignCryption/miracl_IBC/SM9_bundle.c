@@ -0,0 +1,262 @@
+/************************************************************************
+FileName:
+SM9_bundle.c
+Version:
+SM9_BUNDLE_V1.0
+Date:
+Oct 19,2026
+Description:
+Bundles of small records under one signcryption, see SM9_bundle.h
+Function List:
+1.SM9_bundle_init         //start a bundle in a buffer of the caller
+2.SM9_bundle_add          //append one record
+3.SM9_bundle_ready        //the bundle has reached its limits
+4.SM9_bundle_finish       //write the index, give the payload length
+5.Signcrypt_bundle        //finish and signcrypt a bundle with a coupon
+6.Unsigncrypt_bundle      //unsigncrypt a bundle and read its index
+7.SM9_bundle_parse        //read and check the index of a payload
+8.SM9_bundle_record       //record i of a parsed payload, no copy
+************************************************************************/
+
+#include <string.h>
+#include <limits.h>
+#include "SM9_bundle.h"
+
+/****************************************************************
+Function:       SM9_bundle_init
+Description:    start an empty bundle in buf
+Calls:
+Called By:      SM9_SelfCheck
+Input:
+                buf          //holds the records and the index
+                cap          //the size of buf
+                max_records  //records per bundle, 0 for as many as fit
+Output:
+                b
+Return:
+                NULL
+Others:
+****************************************************************/
+void SM9_bundle_init(SM9_BUNDLE *b, unsigned char *buf, size_t cap, int max_records)
+{
+	b->buf = buf;
+	b->cap = cap;
+	b->len = 0;
+	b->n = 0;
+	b->max_records = max_records;
+}
+
+/****************************************************************
+Function:       SM9_bundle_add
+Description:    copy one record after the others, its end offset goes to the
+                index kept at the end of buf
+Calls:
+Called By:      SM9_SelfCheck
+Input:
+                b
+                rec          //the record
+                len          //the length of rec
+Output:
+                b
+Return:
+                0: success
+                1: the record does not fit or max_records is reached, send the
+                   bundle and add it to the next one
+Others:
+****************************************************************/
+int SM9_bundle_add(SM9_BUNDLE *b, const unsigned char *rec, size_t len)
+{
+	size_t room;
+
+	if (b->max_records && b->n >= b->max_records)
+		return 1;
+	if (b->cap < b->len + SM9_BUNDLE_OVERHEAD(b->n + 1))
+		return 1;
+	room = b->cap - b->len - SM9_BUNDLE_OVERHEAD(b->n + 1);
+	if (len > room || b->len + len > 0xFFFFFFFF || b->len + len + SM9_BUNDLE_OVERHEAD(b->n + 1) > INT_MAX)
+		return 1;
+
+	memcpy(b->buf + b->len, rec, len);
+	b->len += len;
+	b->n++;
+	SM3_STORE32(b->buf + b->cap - SM9_BUNDLE_ENTRY_LEN * b->n, (uint32_t)b->len);
+	return 0;
+}
+
+/****************************************************************
+Function:       SM9_bundle_ready
+Description:    the bundle holds max_records records or is full
+Calls:
+Called By:
+Input:
+                b
+Output:
+                NULL
+Return:
+                1: send it, 0: it can take more
+Others:
+****************************************************************/
+int SM9_bundle_ready(const SM9_BUNDLE *b)
+{
+	if (b->max_records && b->n >= b->max_records)
+		return 1;
+	return b->cap <= b->len + SM9_BUNDLE_OVERHEAD(b->n + 1);
+}
+
+/****************************************************************
+Function:       SM9_bundle_finish
+Description:    move the index right after the records, in record order, and
+                append the number of records
+Calls:
+Called By:      Signcrypt_bundle
+Input:
+                b
+Output:
+                b->buf       //the payload
+Return:
+                length of the payload
+Others:         nothing can be added afterwards, SM9_bundle_init starts again
+****************************************************************/
+size_t SM9_bundle_finish(SM9_BUNDLE *b)
+{
+	unsigned char *idx = b->buf + b->len, e[SM9_BUNDLE_ENTRY_LEN];
+	int i;
+
+	//the entries were written downwards, so they are in reverse order
+	memmove(idx, b->buf + b->cap - SM9_BUNDLE_ENTRY_LEN * b->n, SM9_BUNDLE_ENTRY_LEN * b->n);
+	for (i = 0; i < b->n / 2; i++)
+	{
+		memcpy(e, idx + SM9_BUNDLE_ENTRY_LEN * i, SM9_BUNDLE_ENTRY_LEN);
+		memcpy(idx + SM9_BUNDLE_ENTRY_LEN * i, idx + SM9_BUNDLE_ENTRY_LEN * (b->n - 1 - i), SM9_BUNDLE_ENTRY_LEN);
+		memcpy(idx + SM9_BUNDLE_ENTRY_LEN * (b->n - 1 - i), e, SM9_BUNDLE_ENTRY_LEN);
+	}
+	SM3_STORE32(idx + SM9_BUNDLE_ENTRY_LEN * b->n, (uint32_t)b->n);
+	return b->len + SM9_BUNDLE_OVERHEAD(b->n);
+}
+
+/****************************************************************
+Function:       Signcrypt_bundle
+Description:    finish a bundle and signcrypt its payload as one message
+Calls:          SM9_bundle_finish,Signcrypt_online
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                pool         //made by SM9_coupon_pool_init for the sender
+                hid          //0x03
+                IDR          //identification of the receiver
+                b            //the bundle
+Output:
+                S, T         //as Signcrypt_online
+                C            //SM9_C_LEN(*plen) bytes
+                plen         //length of the payload
+Return:
+                as Signcrypt_online
+Others:
+****************************************************************/
+int Signcrypt_bundle(SM9_CTX *ctx, SM9_COUPON_POOL *pool, unsigned char hid[], unsigned char *IDR, SM9_BUNDLE *b,
+	unsigned char S[], unsigned char T[], unsigned char C[], size_t *plen)
+{
+	*plen = SM9_bundle_finish(b);
+	return Signcrypt_online(ctx, pool, hid, IDR, b->buf, *plen, S, T, C);
+}
+
+/****************************************************************
+Function:       Unsigncrypt_bundle
+Description:    unsigncrypt a bundle into M and read its index, the records
+                are then read in place with SM9_bundle_record
+Calls:          Unsigncrypt_into,SM9_bundle_parse
+Called By:      SM9_SelfCheck
+Input:
+                ctx,hid,IDR,IDS,IDlen,S,T,C,skID,ks,Ppub  //as Unsigncrypt
+                plen         //length of the payload
+Output:
+                M            //the payload, plen bytes
+                v            //the records of M
+Return:
+                0: success
+                SM9_BUNDLE_FORMAT_ERR: the index does not fit the records
+                other: the error of Unsigncrypt_into
+Others:
+****************************************************************/
+int Unsigncrypt_bundle(SM9_CTX *ctx, unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int IDlen, size_t plen,
+	unsigned char S[], unsigned char T[], unsigned char C[], unsigned char skID[], big ks, unsigned char Ppub[],
+	unsigned char M[], SM9_BUNDLE_VIEW *v)
+{
+	int buf;
+
+	buf = Unsigncrypt_into(ctx, hid, IDR, IDS, IDlen, NULL, plen, S, T, C, skID, ks, Ppub, M);
+	if (buf != 0)
+		return buf;
+	return SM9_bundle_parse(v, M, plen);
+}
+
+/****************************************************************
+Function:       SM9_bundle_parse
+Description:    read the number of records and check that the end offsets
+                grow and that the last one is where the index starts
+Calls:
+Called By:      Unsigncrypt_bundle
+Input:
+                M            //the payload
+                plen         //its length
+Output:
+                v
+Return:
+                0: success
+                SM9_BUNDLE_FORMAT_ERR: the index does not fit the records
+Others:
+****************************************************************/
+int SM9_bundle_parse(SM9_BUNDLE_VIEW *v, const unsigned char *M, size_t plen)
+{
+	uint32_t n, end, prev = 0;
+	size_t dlen;
+	uint32_t i;
+
+	if (plen < SM9_BUNDLE_ENTRY_LEN)
+		return SM9_BUNDLE_FORMAT_ERR;
+	n = SM3_LOAD32(M + plen - SM9_BUNDLE_ENTRY_LEN);
+	if (n > (plen - SM9_BUNDLE_ENTRY_LEN) / SM9_BUNDLE_ENTRY_LEN || n > INT_MAX)
+		return SM9_BUNDLE_FORMAT_ERR;
+	dlen = plen - SM9_BUNDLE_OVERHEAD((size_t)n);
+	v->data = M;
+	v->index = M + dlen;
+	for (i = 0; i < n; i++)
+	{
+		end = SM3_LOAD32(v->index + SM9_BUNDLE_ENTRY_LEN * i);
+		if (end < prev)
+			return SM9_BUNDLE_FORMAT_ERR;
+		prev = end;
+	}
+	if (prev != dlen)
+		return SM9_BUNDLE_FORMAT_ERR;
+	v->n = (int)n;
+	return 0;
+}
+
+/****************************************************************
+Function:       SM9_bundle_record
+Description:    record i of a payload read by SM9_bundle_parse
+Calls:
+Called By:      SM9_SelfCheck
+Input:
+                v
+                i            //0 to v->n - 1
+Output:
+                rec          //points into the payload
+                len          //the length of the record
+Return:
+                0: success
+                SM9_BUNDLE_FORMAT_ERR: there is no record i
+Others:
+****************************************************************/
+int SM9_bundle_record(const SM9_BUNDLE_VIEW *v, int i, const unsigned char **rec, size_t *len)
+{
+	uint32_t start;
+
+	if (i < 0 || i >= v->n)
+		return SM9_BUNDLE_FORMAT_ERR;
+	start = i ? SM3_LOAD32(v->index + SM9_BUNDLE_ENTRY_LEN * (i - 1)) : 0;
+	*rec = v->data + start;
+	*len = SM3_LOAD32(v->index + SM9_BUNDLE_ENTRY_LEN * i) - start;
+	return 0;
+}
@@ -0,0 +1,67 @@
+/************************************************************************
+FileName:
+SM9_bundle.h
+Version:
+SM9_BUNDLE_V1.0
+Date:
+Oct 19,2026
+Description:
+Many small records to one receiver under a single signcryption. The records
+are packed one after the other into the buffer of the caller and signcrypted
+as one message, the receiver unsigncrypts once and reads the records in
+place through the index.
+Payload: record 0 || ... || record n-1 || end(0) || ... || end(n-1) || n,
+end(i) is the offset just past record i, 4 bytes big-endian as n.
+Function List:
+1.SM9_bundle_init         //start a bundle in a buffer of the caller
+2.SM9_bundle_add          //append one record
+3.SM9_bundle_ready        //the bundle has reached its limits
+4.SM9_bundle_finish       //write the index, give the payload length
+5.Signcrypt_bundle        //finish and signcrypt a bundle with a coupon
+6.Unsigncrypt_bundle      //unsigncrypt a bundle and read its index
+7.SM9_bundle_parse        //read and check the index of a payload
+8.SM9_bundle_record       //record i of a parsed payload, no copy
+Notes:
+max_records and the size of the buffer set the tradeoff: a larger bundle
+shares one pairing among more records, a smaller one is sent sooner.
+************************************************************************/
+
+#ifndef HEADER_SM9_BUNDLE_H
+#define HEADER_SM9_BUNDLE_H
+
+#include "SM9_coupon.h"
+
+#define SM9_BUNDLE_ENTRY_LEN 4
+#define SM9_BUNDLE_OVERHEAD(n) (SM9_BUNDLE_ENTRY_LEN * ((n) + 1)) //index bytes of n records
+
+//sender side, the index grows down from the end of buf until SM9_bundle_finish
+typedef struct
+{
+	unsigned char *buf;
+	size_t cap;
+	size_t len;                   //bytes of records
+	int n;                        //number of records
+	int max_records;              //0 for no limit
+} SM9_BUNDLE;
+
+//receiver side, points into the unsigncrypted payload
+typedef struct
+{
+	const unsigned char *data;
+	const unsigned char *index;
+	int n;
+} SM9_BUNDLE_VIEW;
+
+void SM9_bundle_init(SM9_BUNDLE *b, unsigned char *buf, size_t cap, int max_records);
+int SM9_bundle_add(SM9_BUNDLE *b, const unsigned char *rec, size_t len);
+int SM9_bundle_ready(const SM9_BUNDLE *b);
+size_t SM9_bundle_finish(SM9_BUNDLE *b);
+int Signcrypt_bundle(SM9_CTX *ctx, SM9_COUPON_POOL *pool, unsigned char hid[], unsigned char *IDR, SM9_BUNDLE *b,
+	unsigned char S[], unsigned char T[], unsigned char C[], size_t *plen);
+int Unsigncrypt_bundle(SM9_CTX *ctx, unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int IDlen, size_t plen,
+	unsigned char S[], unsigned char T[], unsigned char C[], unsigned char skID[], big ks, unsigned char Ppub[],
+	unsigned char M[], SM9_BUNDLE_VIEW *v);
+int SM9_bundle_parse(SM9_BUNDLE_VIEW *v, const unsigned char *M, size_t plen);
+int SM9_bundle_record(const SM9_BUNDLE_VIEW *v, int i, const unsigned char **rec, size_t *len);
+
+#endif
@@ -0,0 +1,995 @@
+/************************************************************************
+FileName:
+SM9_coupon.c
+Version:
+SM9_COUPON_V1.0
+Date:
+Oct 19,2026
+Description:
+Online/offline signcryption with a pool of precomputed coupons
+Function List:
+1.SM9_coupon_pool_init    //sender setup: g, dSA, fixed-base tables, empty pool
+2.SM9_coupon_pool_free    //stop the threads and release the pool
+3.SM9_coupon_make         //offline phase, compute one coupon
+4.SM9_coupon_put          //add a coupon to the pool, lock-free
+5.SM9_coupon_get          //take a coupon from the pool, lock-free
+6.SM9_coupon_count        //number of coupons ready
+7.SM9_coupon_fill         //refill the pool in the calling thread
+8.SM9_coupon_worker       //body of a background thread
+9.SM9_coupon_pool_start   //refill the pool from background threads
+10.SM9_coupon_pool_stop   //stop and join the background threads
+11.SM9_coupon_point      //[r]QB of a receiver with a coupon
+12.Signcrypt_coupon       //online phase of Signcrypt with a given coupon
+13.Signcrypt_online       //online phase of Signcrypt with a coupon of the pool
+14.SM9_bcast_T            //T of a range of receivers of Signcrypt_broadcast
+15.SM9_bcast_C            //C of a range of receivers of Signcrypt_broadcast
+16.SM9_bcast_worker       //body of a thread of Signcrypt_broadcast
+17.Signcrypt_broadcast    //one message to many receivers with one coupon
+Notes:
+head and tail only grow, the cell of a position is position & mask. A cell
+with seq == pos is free for the put of pos, with seq == pos + 1 it holds the
+coupon for the get of pos, and the get gives it back for the put of
+pos + mask + 1. The counters are compared by difference so they may wrap.
+************************************************************************/
+
+#include <string.h>
+#include "SM9_coupon.h"
+
+extern zzn2 X; //Frobniues constant
+extern epoint *P1;
+extern ecn2 P2;
+extern big N, para_a, para_b, para_t, para_q;
+
+//a - b and a + b of the pool counters, modulo 2^(bits of long)
+#define SM9_COUPON_DIFF(a, b) ((long)((unsigned long)(a) - (unsigned long)(b)))
+#define SM9_COUPON_ADD(a, b) ((long)((unsigned long)(a) + (unsigned long)(b)))
+
+/****************************************************************
+Function:       SM9_coupon_pool_init
+Description:    set up the sender side of online/offline signcryption:
+                g = e(P1,Ppub), the sender key dSA = [ks/(H1(IDS||hid,N)+ks)]P1
+                and the fixed-base tables of g, P1, Ppube = [ks]P1 and dSA.
+                The pool is left empty.
+Calls:          MIRACL functions,ecap,member,zzn12_init,zzn12_fb_init,
+                SM9_H_init,SM9_H_final
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                num          //number of coupons the pool holds, rounded up to a power of 2
+                hid          //0x03
+                IDS          //identification of the sender
+                IDlen        //the length of IDS
+                ks           //master private key
+Output:
+                pool
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_MY_ECAP_12A_ERR: R-ate calculation error
+                SM9_MEMBER_ERR: the order of g is error
+                SM9_GEPRI_ERR: H1(IDS||hid,N)+ks is zero, dSA does not exist
+                SM9_CTX_ERR: ctx belongs to another thread
+                other: the error of SM9_H_final
+Others:
+****************************************************************/
+int SM9_coupon_pool_init(SM9_CTX *ctx, SM9_COUPON_POOL *pool, int num, unsigned char hid[], unsigned char *IDS,
+	int IDlen, big ks)
+{
+	big h1, t1, t2, rem, x, y;
+	epoint *P;
+	ecn2 Ppube;
+	SM3_KDF_CTX kdf;
+	char *mem;
+	long n;
+	int buf;
+
+	memset(pool, 0, sizeof(SM9_COUPON_POOL));
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	for (n = 1; n < num; n <<= 1);
+	pool->cell = (SM9_COUPON_CELL *)malloc(n * sizeof(SM9_COUPON_CELL));
+	if (pool->cell == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	pool->mask = n - 1;
+	for (n = 0; n <= pool->mask; n++)
+		pool->cell[n].seq = n;
+
+	mem = (char *)memalloc(12);
+	if (mem == NULL)
+	{
+		SM9_coupon_pool_free(pool);
+		return SM9_ASK_MEMORY_ERR;
+	}
+	h1 = mirvar_mem(mem, 0);
+	t1 = mirvar_mem(mem, 1);
+	t2 = mirvar_mem(mem, 2);
+	rem = mirvar_mem(mem, 3);
+	x = mirvar_mem(mem, 4);
+	y = mirvar_mem(mem, 5);
+	Ppube.x.a = mirvar_mem(mem, 6);
+	Ppube.x.b = mirvar_mem(mem, 7);
+	Ppube.y.a = mirvar_mem(mem, 8);
+	Ppube.y.b = mirvar_mem(mem, 9);
+	Ppube.z.a = mirvar_mem(mem, 10);
+	Ppube.z.b = mirvar_mem(mem, 11);
+	Ppube.marker = MR_EPOINT_INFINITY;
+	P = epoint_init();
+
+	//g=e(P1,Ppub), Ppub=[ks]P2
+	ecn2_copy(&P2, &Ppube);
+	ecn2_mul(ks, &Ppube);
+	zzn12_init(&pool->g);
+	if (!ecap(Ppube, P1, para_t, X, &pool->g))
+		buf = SM9_MY_ECAP_12A_ERR;
+	else if (!member(pool->g, para_t, X))
+		buf = SM9_MEMBER_ERR;
+	else
+	{
+		zzn12_fb_init(&pool->gfb, pool->g);
+		pool->gfb_ok = TRUE;
+		//t2=ks*(H1(IDS||hid,N)+ks)^(-1)
+		SM9_H_init(&kdf, 0x01);
+		SM3_KDF_absorb(&kdf, IDS, IDlen);
+		SM3_KDF_absorb(&kdf, hid, 1);
+		buf = SM9_H_final(&kdf, N, h1);
+	}
+	if (buf == 0)
+	{
+		add(h1, ks, t1);
+		divide(t1, N, rem);
+		if (size(t1) == 0)
+			buf = SM9_GEPRI_ERR;
+	}
+	if (buf == 0)
+	{
+		xgcd(t1, N, t1, t1, t1);
+		multiply(ks, t1, t2);
+		divide(t2, N, rem);
+
+		ecurve_mult(t2, P1, P); //dSA=[t2]P1
+		epoint_get(P, x, y);
+		if (!ebrick_init(&pool->dSA_b, x, y, para_a, para_b, para_q, SM9_COUPON_WINDOW, BNLEN * 8))
+			buf = SM9_ASK_MEMORY_ERR;
+		ecurve_mult(ks, P1, P); //Ppube=[ks]P1
+		epoint_get(P, x, y);
+		if (!ebrick_init(&pool->Ppube_b, x, y, para_a, para_b, para_q, SM9_COUPON_WINDOW, BNLEN * 8))
+			buf = SM9_ASK_MEMORY_ERR;
+		epoint_get(P1, x, y);
+		if (!ebrick_init(&pool->P1_b, x, y, para_a, para_b, para_q, SM9_COUPON_WINDOW, BNLEN * 8))
+			buf = SM9_ASK_MEMORY_ERR;
+	}
+
+	epoint_free(P);
+	memkill(mem, 12);
+	if (buf != 0)
+		SM9_coupon_pool_free(pool);
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_coupon_pool_free
+Description:    stop the background threads, wipe the coupons and free the pool
+Calls:          SM9_coupon_pool_stop,zzn12_fb_free,zzn12_kill,MIRACL functions
+Called By:      SM9_coupon_pool_init,SM9_SelfCheck
+Input:
+                pool
+Output:
+                NULL
+Return:
+                NULL
+Others:
+****************************************************************/
+void SM9_coupon_pool_free(SM9_COUPON_POOL *pool)
+{
+	SM9_coupon_pool_stop(pool);
+	if (pool->dSA_b.table != NULL)
+		ebrick_end(&pool->dSA_b);
+	if (pool->Ppube_b.table != NULL)
+		ebrick_end(&pool->Ppube_b);
+	if (pool->P1_b.table != NULL)
+		ebrick_end(&pool->P1_b);
+	if (pool->gfb_ok)
+		zzn12_fb_free(&pool->gfb);
+	zzn12_kill(&pool->g);
+	if (pool->cell != NULL)
+	{
+		memset(pool->cell, 0, (pool->mask + 1) * sizeof(SM9_COUPON_CELL));
+		free(pool->cell);
+	}
+	memset(pool, 0, sizeof(SM9_COUPON_POOL));
+}
+
+/****************************************************************
+Function:       SM9_coupon_make
+Description:    offline phase of Signcrypt: r in [1,N-1] from the csprng of ctx, w=g^r and V=[r]Ppube,
+                both with fixed-base tables. Runs in any thread with its own context.
+Calls:          MIRACL functions,zzn12_fb_pow,zzn12_to_bytes384,SM9_arena_mark,
+                SM9_arena_release
+Called By:      SM9_coupon_fill,SM9_coupon_worker,Signcrypt_online,
+                Signcrypt_broadcast,SM9_session_open,SM9_encrypt,SM9_encap
+Input:
+                ctx          //context of the calling thread
+                pool         //the fixed-base tables of g and Ppube
+Output:
+                cp           //the coupon
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_CTX_ERR: ctx belongs to another thread
+Others:
+****************************************************************/
+int SM9_coupon_make(SM9_CTX *ctx, SM9_COUPON_POOL *pool, SM9_COUPON *cp)
+{
+	big r, x, y;
+	zzn12 w;
+	char *mem;
+	int mark;
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	mem = (char *)memalloc(3);
+	if (mem == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	r = mirvar_mem(mem, 0);
+	x = mirvar_mem(mem, 1);
+	y = mirvar_mem(mem, 2);
+
+	do
+		strong_bigrand(&ctx->rng, N, r);
+	while (size(r) == 0);
+	mark = SM9_arena_mark();
+	w = zzn12_fb_pow(&pool->gfb, r);
+	zzn12_to_bytes384(w, cp->w);
+	SM9_arena_release(mark);
+	mul_brick(&pool->Ppube_b, r, x, y);
+	big_to_bytes(BNLEN, r, cp->r, 1);
+	big_to_bytes(BNLEN, x, cp->V, 1);
+	big_to_bytes(BNLEN, y, cp->V + BNLEN, 1);
+
+	memkill(mem, 3);
+	return 0;
+}
+
+/****************************************************************
+Function:       SM9_coupon_put
+Description:    add a coupon to the pool, safe with any number of threads
+Calls:          SM9_atomic_load,SM9_atomic_store,SM9_atomic_cas
+Called By:      SM9_coupon_fill,SM9_coupon_worker
+Input:
+                pool
+                cp           //the coupon
+Output:
+                NULL
+Return:
+                0: success
+                1: the pool is full
+Others:
+****************************************************************/
+int SM9_coupon_put(SM9_COUPON_POOL *pool, const SM9_COUPON *cp)
+{
+	SM9_COUPON_CELL *c;
+	long pos, dif;
+
+	pos = SM9_atomic_load(&pool->head);
+	for (;;)
+	{
+		c = &pool->cell[pos & pool->mask];
+		dif = SM9_COUPON_DIFF(SM9_atomic_load(&c->seq), pos);
+		if (dif == 0)
+		{
+			if (SM9_atomic_cas(&pool->head, pos, SM9_COUPON_ADD(pos, 1)))
+				break;
+			pos = SM9_atomic_load(&pool->head);
+		}
+		else if (dif < 0)
+			return 1; //the cell still holds the coupon of pos - mask - 1
+		else
+			pos = SM9_atomic_load(&pool->head); //another thread took pos
+	}
+	memcpy(&c->cp, cp, sizeof(SM9_COUPON));
+	SM9_atomic_store(&c->seq, SM9_COUPON_ADD(pos, 1));
+	return 0;
+}
+
+/****************************************************************
+Function:       SM9_coupon_get
+Description:    take a coupon from the pool, safe with any number of threads.
+                The r of the cell is wiped before the cell is given back.
+Calls:          SM9_atomic_load,SM9_atomic_store,SM9_atomic_cas
+Called By:      Signcrypt_online
+Input:
+                pool
+Output:
+                cp           //the coupon
+Return:
+                0: success
+                1: the pool is empty
+Others:
+****************************************************************/
+int SM9_coupon_get(SM9_COUPON_POOL *pool, SM9_COUPON *cp)
+{
+	SM9_COUPON_CELL *c;
+	long pos, dif;
+
+	pos = SM9_atomic_load(&pool->tail);
+	for (;;)
+	{
+		c = &pool->cell[pos & pool->mask];
+		dif = SM9_COUPON_DIFF(SM9_atomic_load(&c->seq), SM9_COUPON_ADD(pos, 1));
+		if (dif == 0)
+		{
+			if (SM9_atomic_cas(&pool->tail, pos, SM9_COUPON_ADD(pos, 1)))
+				break;
+			pos = SM9_atomic_load(&pool->tail);
+		}
+		else if (dif < 0)
+			return 1; //the put of pos has not finished
+		else
+			pos = SM9_atomic_load(&pool->tail); //another thread took pos
+	}
+	memcpy(cp, &c->cp, sizeof(SM9_COUPON));
+	memset(c->cp.r, 0, BNLEN);
+	SM9_atomic_store(&c->seq, SM9_COUPON_ADD(pos, pool->mask + 1));
+	return 0;
+}
+
+/****************************************************************
+Function:       SM9_coupon_count
+Description:    number of coupons in the pool, exact only when no other
+                thread puts or gets
+Calls:          SM9_atomic_load
+Called By:      SM9_coupon_fill,SM9_coupon_worker
+Input:
+                pool
+Output:
+                NULL
+Return:
+                number of coupons
+Others:
+****************************************************************/
+int SM9_coupon_count(SM9_COUPON_POOL *pool)
+{
+	long tail, n;
+
+	tail = SM9_atomic_load(&pool->tail);
+	n = SM9_COUPON_DIFF(SM9_atomic_load(&pool->head), tail);
+	if (n < 0)
+		n = 0;
+	if (n > pool->mask + 1)
+		n = pool->mask + 1;
+	return (int)n;
+}
+
+/****************************************************************
+Function:       SM9_coupon_fill
+Description:    make up to n coupons in the calling thread, stop when the pool is full
+Calls:          SM9_coupon_make,SM9_coupon_put,SM9_coupon_count
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                pool
+                n            //number of coupons wanted
+Output:
+                NULL
+Return:
+                number of coupons added, 0 for a context of another thread
+Others:
+****************************************************************/
+int SM9_coupon_fill(SM9_CTX *ctx, SM9_COUPON_POOL *pool, int n)
+{
+	SM9_COUPON cp;
+	int i;
+
+	for (i = 0; i < n && SM9_coupon_count(pool) <= pool->mask; i++)
+	{
+		if (SM9_coupon_make(ctx, pool, &cp) != 0 || SM9_coupon_put(pool, &cp) != 0)
+			break;
+	}
+	memset(&cp, 0, sizeof(SM9_COUPON));
+	return i;
+}
+
+#if defined(MR_OS_THREADS) && !defined(SM9_NO_THREADS)
+/****************************************************************
+Function:       SM9_coupon_worker
+Description:    background thread: its own context, then make coupons until the
+                pool is stopped, waiting SM9_COUPON_IDLE_MS while it is full. The
+                tables of the pool are only read, all threads share them.
+Calls:          MIRACL functions,SM9_ctx_init,SM9_ctx_free,SM9_coupon_make,
+                SM9_coupon_put,SM9_atomic_load,SM9_thread_sleep
+Called By:      SM9_coupon_pool_start
+Input:
+                arg          //the pool
+Output:
+                NULL
+Return:
+                NULL
+Others:
+****************************************************************/
+static void SM9_coupon_worker(void *arg)
+{
+	SM9_COUPON_POOL *pool = (SM9_COUPON_POOL *)arg;
+	SM9_COUPON cp;
+	SM9_CTX ctx;
+
+	if (SM9_ctx_init(&ctx) != 0)
+		return;
+
+
+	while (!SM9_atomic_load(&pool->stop))
+	{
+		if (SM9_coupon_count(pool) > pool->mask)
+		{
+			SM9_thread_sleep(SM9_COUPON_IDLE_MS);
+			continue;
+		}
+		if (SM9_coupon_make(&ctx, pool, &cp) != 0)
+			break;
+		while (SM9_coupon_put(pool, &cp) != 0 && !SM9_atomic_load(&pool->stop))
+			SM9_thread_sleep(SM9_COUPON_IDLE_MS);
+	}
+	memset(&cp, 0, sizeof(SM9_COUPON));
+	SM9_ctx_free(&ctx);
+}
+#endif
+
+/****************************************************************
+Function:       SM9_coupon_pool_start
+Description:    start nthreads background threads that keep the pool full
+Calls:          SM9_thread_start,SM9_cpu_count
+Called By:      SM9_SelfCheck
+Input:
+                pool
+                nthreads     //0 for one less than the number of processors
+Output:
+                NULL
+Return:
+                number of threads started, 0 without MR_OS_THREADS
+Others:
+****************************************************************/
+int SM9_coupon_pool_start(SM9_COUPON_POOL *pool, int nthreads)
+{
+#if defined(MR_OS_THREADS) && !defined(SM9_NO_THREADS)
+	if (nthreads <= 0)
+		nthreads = SM9_cpu_count() - 1;
+	if (nthreads < 1)
+		nthreads = 1;
+	if (nthreads > SM9_COUPON_MAX_THREADS)
+		nthreads = SM9_COUPON_MAX_THREADS;
+	SM9_atomic_store(&pool->stop, 0);
+	while (pool->nthreads < nthreads)
+	{
+		if (SM9_thread_start(&pool->th[pool->nthreads], SM9_coupon_worker, pool) != 0)
+			break;
+		pool->nthreads++;
+	}
+	return pool->nthreads;
+#else
+	return 0;
+#endif
+}
+
+/****************************************************************
+Function:       SM9_coupon_pool_stop
+Description:    stop and join the background threads, the coupons stay in the pool
+Calls:          SM9_atomic_store,SM9_thread_join
+Called By:      SM9_coupon_pool_free
+Input:
+                pool
+Output:
+                NULL
+Return:
+                NULL
+Others:
+****************************************************************/
+void SM9_coupon_pool_stop(SM9_COUPON_POOL *pool)
+{
+	SM9_atomic_store(&pool->stop, 1);
+	while (pool->nthreads > 0)
+		SM9_thread_join(pool->th[--pool->nthreads]);
+}
+
+/****************************************************************
+Function:       SM9_coupon_point
+Description:    [r]QB=[r*H1(ID||hid,N)]P1+V for the r of a coupon, the T of
+                Signcrypt and the C1 of SM9_encrypt and SM9_encap
+Calls:          SM9_H_init,SM9_H_final,SM3_KDF_absorb,MIRACL functions
+Called By:      Signcrypt_coupon,SM9_encrypt,SM9_encap
+Input:
+                ctx          //context of the calling thread
+                pool         //made by SM9_coupon_pool_init
+                cp           //the coupon
+                hid          //0x03
+                ID           //identification of the receiver
+Output:
+                T            //[r]QB, 64 bytes
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_CTX_ERR: ctx belongs to another thread
+                other: the error of SM9_H_final
+Others:
+****************************************************************/
+int SM9_coupon_point(SM9_CTX *ctx, SM9_COUPON_POOL *pool, const SM9_COUPON *cp, unsigned char hid[],
+	unsigned char *ID, unsigned char T[])
+{
+	SM3_KDF_CTX kdf;
+	big r, h, e, rem, x, y;
+	epoint *P, *V;
+	char *mem;
+	int buf;
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	mem = (char *)memalloc(6);
+	if (mem == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	r = mirvar_mem(mem, 0);
+	h = mirvar_mem(mem, 1);
+	e = mirvar_mem(mem, 2);
+	rem = mirvar_mem(mem, 3);
+	x = mirvar_mem(mem, 4);
+	y = mirvar_mem(mem, 5);
+	P = epoint_init();
+	V = epoint_init();
+
+	SM9_H_init(&kdf, 0x01);
+	SM3_KDF_absorb(&kdf, ID, strlen((char *)ID));
+	SM3_KDF_absorb(&kdf, hid, 1);
+	buf = SM9_H_final(&kdf, N, h);
+	if (buf == 0)
+	{
+		bytes_to_big(BNLEN, cp->r, r);
+		multiply(r, h, e);
+		divide(e, N, rem);
+		mul_brick(&pool->P1_b, e, x, y);
+		epoint_set(x, y, 0, P);
+		bytes_to_big(BNLEN, cp->V, x);
+		bytes_to_big(BNLEN, cp->V + BNLEN, y);
+		epoint_set(x, y, 0, V);
+		ecurve_add(V, P);
+		epoint_get(P, x, y);
+		big_to_bytes(BNLEN, x, T, 1);
+		big_to_bytes(BNLEN, y, T + BNLEN, 1);
+	}
+
+	epoint_free(P);
+	epoint_free(V);
+	memkill(mem, 6);
+	return buf;
+}
+
+/****************************************************************
+Function:       Signcrypt_coupon
+Description:    online phase of Signcrypt with a given coupon, the output is the
+                same as Signcrypt with the r of the coupon
+Calls:          SM9_coupon_point,SM9_H_init,SM9_H_final,SM3_KDF_init,SM3_KDF_absorb,
+                SM3_KDF_xor,SM9_DEM_encrypt,MIRACL functions
+Called By:      Signcrypt_online,SM9_session_open
+Input:
+                ctx          //context of the calling thread
+                pool         //made by SM9_coupon_pool_init for the sender
+                cp           //a coupon of the pool, not used before
+                hid          //0x03
+                IDR          //identification of the receiver
+                message      //the message to be signcrypted
+                mlen         //the length of message
+Output:
+                S            //S=[l]dSA, 64 bytes
+                T            //T=[r]QB, 64 bytes
+                C            //the ciphertext, SM9_C_LEN(mlen) bytes
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_L_error: l is zero
+                SM9_CTX_ERR: ctx belongs to another thread
+                other: the error of SM9_H_final
+Others:
+****************************************************************/
+int Signcrypt_coupon(SM9_CTX *ctx, SM9_COUPON_POOL *pool, const SM9_COUPON *cp, unsigned char hid[],
+	unsigned char *IDR, unsigned char *message, size_t mlen, unsigned char S[], unsigned char T[], unsigned char C[])
+{
+	SM3_KDF_CTX kdf, hv;
+	big r, h, l, x, y;
+	char *mem;
+	int buf;
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	mem = (char *)memalloc(5);
+	if (mem == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	r = mirvar_mem(mem, 0);
+	h = mirvar_mem(mem, 1);
+	l = mirvar_mem(mem, 2);
+	x = mirvar_mem(mem, 3);
+	y = mirvar_mem(mem, 4);
+
+	//A1, A7: T=[r]QB=[r*H1(IDR||hid,N)]P1+V
+	buf = SM9_coupon_point(ctx, pool, cp, hid, IDR, T);
+	if (buf == 0)
+	{
+		bytes_to_big(BNLEN, cp->r, r);
+
+		//A4, A8: as in Signcrypt, w comes encoded in the coupon
+		SM3_KDF_init(&kdf);
+		SM3_KDF_absorb(&kdf, T, BNLEN * 2);
+		SM3_KDF_absorb(&kdf, cp->w, BNLEN * 12);
+		SM3_KDF_absorb(&kdf, IDR, strlen((char *)IDR));
+		SM9_H_init(&hv, 0x02);
+		if (mlen >= SM9_DEM_THRESHOLD)
+			SM9_DEM_encrypt(&kdf, &hv, message, mlen, C);
+		else
+			SM3_KDF_xor(&kdf, &hv, message, C, mlen, 0);
+		SM3_KDF_absorb(&hv, cp->w, BNLEN * 12);
+		buf = SM9_H_final(&hv, N, h);
+	}
+	if (buf == 0)
+	{
+		//A5: l=(r-h)mod N
+		subtract(r, h, l);
+		if (size(l) < 0)
+			add(l, N, l);
+		if (size(l) == 0)
+			buf = SM9_L_error;
+	}
+	if (buf == 0)
+	{
+		//A6: S=[l]dSA
+		mul_brick(&pool->dSA_b, l, x, y);
+		big_to_bytes(BNLEN, x, S, 1);
+		big_to_bytes(BNLEN, y, S + BNLEN, 1);
+	}
+
+	memkill(mem, 5);
+	return buf;
+}
+
+/****************************************************************
+Function:       Signcrypt_online
+Description:    online phase of Signcrypt with the next coupon of the pool.
+                An empty pool costs one SM9_coupon_make.
+Calls:          SM9_coupon_get,SM9_coupon_make,Signcrypt_coupon
+Called By:      SM9_SelfCheck,SM9_pool_signcrypt
+Input:
+                ctx          //context of the calling thread
+                pool         //made by SM9_coupon_pool_init for the sender
+                hid          //0x03
+                IDR          //identification of the receiver
+                message      //the message to be signcrypted
+                mlen         //the length of message
+Output:
+                S            //S=[l]dSA, 64 bytes
+                T            //T=[r]QB, 64 bytes
+                C            //the ciphertext, SM9_C_LEN(mlen) bytes
+Return:
+                as Signcrypt_coupon and SM9_coupon_make
+Others:
+****************************************************************/
+int Signcrypt_online(SM9_CTX *ctx, SM9_COUPON_POOL *pool, unsigned char hid[], unsigned char *IDR,
+	unsigned char *message, size_t mlen, unsigned char S[], unsigned char T[], unsigned char C[])
+{
+	SM9_COUPON cp;
+	int buf = 0;
+
+	if (SM9_coupon_get(pool, &cp) != 0)
+		buf = SM9_coupon_make(ctx, pool, &cp);
+	if (buf == 0)
+		buf = Signcrypt_coupon(ctx, pool, &cp, hid, IDR, message, mlen, S, T, C);
+	memset(&cp, 0, sizeof(SM9_COUPON));
+	return buf;
+}
+
+//the recipients [from,to) of Signcrypt_broadcast given to one thread
+typedef struct
+{
+	SM9_COUPON_POOL *pool;
+	const SM9_COUPON *cp;
+	unsigned char *hid;
+	unsigned char **IDR;
+	unsigned char *message;
+	size_t mlen;
+	unsigned char *T;       //64 bytes per recipient
+	unsigned char *C;       //SM9_C_LEN(mlen) bytes per recipient
+	int from, to;
+	int curve;              //1: the thread makes its own mip and computes T too
+	int err;
+} SM9_BCAST_JOB;
+
+/****************************************************************
+Function:       SM9_bcast_T
+Description:    T_i=[r*H1(IDR_i||hid,N)]P1+V for the recipients of a job, with
+                the fixed-base table of P1. SM9_BCAST_BATCH points are brought
+                back to affine together, one inversion for the batch, and their
+                H1 are one SM9_H1_mb.
+Calls:          SM9_H1_mb,MIRACL functions
+Called By:      SM9_bcast_worker,Signcrypt_broadcast
+Input:
+                job
+Output:
+                job->T
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                other: the error of SM9_H1_mb
+Others:
+****************************************************************/
+static int SM9_bcast_T(SM9_BCAST_JOB *job)
+{
+	big r, e, rem, x, y, h[SM9_BCAST_BATCH], work[SM9_BCAST_BATCH];
+	epoint *V, *P[SM9_BCAST_BATCH];
+	char *mem;
+	int i, j, m, buf = 0;
+
+	mem = (char *)memalloc(5 + 2 * SM9_BCAST_BATCH);
+	if (mem == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	r = mirvar_mem(mem, 0);
+	e = mirvar_mem(mem, 1);
+	rem = mirvar_mem(mem, 2);
+	x = mirvar_mem(mem, 3);
+	y = mirvar_mem(mem, 4);
+	for (j = 0; j < SM9_BCAST_BATCH; j++)
+	{
+		h[j] = mirvar_mem(mem, 5 + j);
+		work[j] = mirvar_mem(mem, 5 + SM9_BCAST_BATCH + j);
+		P[j] = epoint_init();
+	}
+	V = epoint_init();
+
+	bytes_to_big(BNLEN, job->cp->r, r);
+	bytes_to_big(BNLEN, job->cp->V, x);
+	bytes_to_big(BNLEN, job->cp->V + BNLEN, y);
+	epoint_set(x, y, 0, V);
+	for (i = job->from; i < job->to && buf == 0; i += m)
+	{
+		m = job->to - i < SM9_BCAST_BATCH ? job->to - i : SM9_BCAST_BATCH;
+		buf = SM9_H1_mb(job->IDR + i, m, job->hid, N, h);
+		if (buf != 0)
+			break;
+		for (j = 0; j < m; j++)
+		{
+			multiply(r, h[j], e);
+			divide(e, N, rem);
+			mul_brick(&job->pool->P1_b, e, x, y);
+			epoint_set(x, y, 0, P[j]);
+			ecurve_add(V, P[j]);
+		}
+		epoint_multi_norm(m, work, P);
+		for (j = 0; j < m; j++)
+		{
+			epoint_get(P[j], x, y);
+			big_to_bytes(BNLEN, x, job->T + (i + j) * BNLEN * 2, 1);
+			big_to_bytes(BNLEN, y, job->T + (i + j) * BNLEN * 2 + BNLEN, 1);
+		}
+	}
+
+	for (j = 0; j < SM9_BCAST_BATCH; j++)
+		epoint_free(P[j]);
+	epoint_free(V);
+	memkill(mem, 5 + 2 * SM9_BCAST_BATCH);
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_bcast_C
+Description:    C_i=M XOR KDF(T_i||w||IDR_i,mlen), or the SM4-GCM DEM from
+                SM9_DEM_THRESHOLD bytes on, for the recipients of a job.
+                No MIRACL, it runs in any thread.
+Calls:          SM3_KDF_init,SM3_KDF_absorb,SM3_KDF_xor,SM9_DEM_encrypt
+Called By:      SM9_bcast_worker,Signcrypt_broadcast
+Input:
+                job
+Output:
+                job->C
+Return:
+                NULL
+Others:
+****************************************************************/
+static void SM9_bcast_C(SM9_BCAST_JOB *job)
+{
+	SM3_KDF_CTX kdf;
+	unsigned char *C;
+	int i;
+
+	for (i = job->from; i < job->to; i++)
+	{
+		C = job->C + (size_t)i * SM9_C_LEN(job->mlen);
+		SM3_KDF_init(&kdf);
+		SM3_KDF_absorb(&kdf, job->T + i * BNLEN * 2, BNLEN * 2);
+		SM3_KDF_absorb(&kdf, job->cp->w, BNLEN * 12);
+		SM3_KDF_absorb(&kdf, job->IDR[i], strlen((char *)job->IDR[i]));
+		if (job->mlen >= SM9_DEM_THRESHOLD)
+			SM9_DEM_encrypt(&kdf, NULL, job->message, job->mlen, C);
+		else
+			SM3_KDF_xor(&kdf, NULL, job->message, C, job->mlen, 0);
+	}
+	memset(&kdf, 0, sizeof(kdf));
+}
+
+/****************************************************************
+Function:       SM9_bcast_worker
+Description:    thread of Signcrypt_broadcast: T of its recipients in a context
+                of its own when job->curve is set, then their C
+Calls:          SM9_bcast_T,SM9_bcast_C,SM9_ctx_init,SM9_ctx_free
+Called By:      Signcrypt_broadcast
+Input:
+                arg          //SM9_BCAST_JOB
+Output:
+                NULL
+Return:
+                NULL
+Others:
+****************************************************************/
+static void SM9_bcast_worker(void *arg)
+{
+	SM9_BCAST_JOB *job = (SM9_BCAST_JOB *)arg;
+	SM9_CTX ctx;
+
+	if (job->curve)
+	{
+		job->err = SM9_ctx_init(&ctx);
+		if (job->err == 0)
+			job->err = SM9_bcast_T(job);
+		SM9_ctx_free(&ctx);
+	}
+	if (job->err == 0)
+		SM9_bcast_C(job);
+}
+
+/****************************************************************
+Function:       Signcrypt_broadcast
+Description:    signcrypt one message to n recipients with one coupon. h=H2(M||w,N),
+                l and S=[l]dSA are computed once and shared, each recipient
+                gets T_i=[r]QB_i and C_i. The recipients are cut into ranges,
+                one per processor: C_i always in parallel, T_i too when MIRACL
+                has MR_OS_THREADS, otherwise before in the calling thread.
+Calls:          SM9_coupon_get,SM9_coupon_make,SM9_H_init,SM9_H_final,SM3_KDF_absorb,
+                SM9_bcast_T,SM9_bcast_C,SM9_bcast_worker,SM9_thread_start,
+                SM9_thread_join,SM9_cpu_count,MIRACL functions
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                pool         //made by SM9_coupon_pool_init for the sender
+                hid          //0x03
+                IDR          //identifications of the n receivers
+                n            //number of receivers
+                message      //the message to be signcrypted
+                mlen         //the length of message
+Output:
+                S            //S=[l]dSA, 64 bytes, the same for all receivers
+                T            //T_i=[r]QB_i, 64 bytes each, n*64 bytes
+                C            //the ciphertexts, SM9_C_LEN(mlen) bytes each
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_L_error: l is zero
+                SM9_CTX_ERR: ctx belongs to another thread
+                other: the error of SM9_H_final
+Others:         a receiver only learns that the message was sent to it, the
+                list of the others is not in its (S,T_i,C_i).
+****************************************************************/
+int Signcrypt_broadcast(SM9_CTX *ctx, SM9_COUPON_POOL *pool, unsigned char hid[], unsigned char *IDR[], int n,
+	unsigned char *message, size_t mlen, unsigned char S[], unsigned char T[], unsigned char C[])
+{
+	SM9_BCAST_JOB job[SM9_COUPON_MAX_THREADS], all;
+	SM9_THREAD th[SM9_COUPON_MAX_THREADS];
+	int started[SM9_COUPON_MAX_THREADS];
+	SM9_COUPON cp;
+	SM3_KDF_CTX hv;
+	big r, h, l, x, y;
+	char *mem;
+	int nthr, curve, i, buf;
+
+	if (n <= 0)
+		return 0;
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	if (SM9_coupon_get(pool, &cp) != 0)
+	{
+		buf = SM9_coupon_make(ctx, pool, &cp);
+		if (buf != 0)
+			return buf;
+	}
+
+	mem = (char *)memalloc(5);
+	if (mem == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	r = mirvar_mem(mem, 0);
+	h = mirvar_mem(mem, 1);
+	l = mirvar_mem(mem, 2);
+	x = mirvar_mem(mem, 3);
+	y = mirvar_mem(mem, 4);
+
+	//A4, A5, A6 once for all receivers: h=H2(M||w,N), l=(r-h)mod N, S=[l]dSA
+	SM9_H_init(&hv, 0x02);
+	SM3_KDF_absorb(&hv, message, mlen);
+	SM3_KDF_absorb(&hv, cp.w, BNLEN * 12);
+	buf = SM9_H_final(&hv, N, h);
+	if (buf == 0)
+	{
+		bytes_to_big(BNLEN, cp.r, r);
+		subtract(r, h, l);
+		if (size(l) < 0)
+			add(l, N, l);
+		if (size(l) == 0)
+			buf = SM9_L_error;
+	}
+	if (buf == 0)
+	{
+		mul_brick(&pool->dSA_b, l, x, y);
+		big_to_bytes(BNLEN, x, S, 1);
+		big_to_bytes(BNLEN, y, S + BNLEN, 1);
+	}
+	if (buf != 0)
+	{
+		memset(&cp, 0, sizeof(SM9_COUPON));
+		memkill(mem, 5);
+		return buf;
+	}
+
+	//A1, A7, A8 for each receiver
+	nthr = SM9_cpu_count();
+	if (nthr > SM9_COUPON_MAX_THREADS)
+		nthr = SM9_COUPON_MAX_THREADS;
+	if (nthr > n)
+		nthr = n;
+#if defined(MR_OS_THREADS) && !defined(SM9_NO_THREADS)
+	curve = 1;
+#else
+	curve = 0;
+#endif
+	for (i = 0; i < nthr; i++)
+	{
+		job[i].pool = pool;
+		job[i].cp = &cp;
+		job[i].hid = hid;
+		job[i].IDR = IDR;
+		job[i].message = message;
+		job[i].mlen = mlen;
+		job[i].T = T;
+		job[i].C = C;
+		job[i].from = (int)((long long)n * i / nthr);
+		job[i].to = (int)((long long)n * (i + 1) / nthr);
+		job[i].curve = curve;
+		job[i].err = 0;
+	}
+	if (!curve)
+	{
+		//all T in the calling thread, the threads only do the KDF and the XOR
+		all = job[0];
+		all.from = 0;
+		all.to = n;
+		buf = SM9_bcast_T(&all);
+	}
+
+	//the calling thread keeps the last range with its own mip
+	job[nthr - 1].curve = 0;
+	for (i = 0; i < nthr - 1 && buf == 0; i++)
+		started[i] = SM9_thread_start(&th[i], SM9_bcast_worker, &job[i]) == 0;
+	if (buf == 0)
+	{
+		if (curve)
+			job[nthr - 1].err = SM9_bcast_T(&job[nthr - 1]);
+		if (job[nthr - 1].err == 0)
+			SM9_bcast_C(&job[nthr - 1]);
+		for (i = 0; i < nthr - 1; i++)
+		{
+			if (started[i])
+				SM9_thread_join(th[i]);
+			else
+			{
+				if (job[i].curve)
+					job[i].err = SM9_bcast_T(&job[i]);
+				if (job[i].err == 0)
+					SM9_bcast_C(&job[i]);
+			}
+		}
+		for (i = 0; i < nthr && buf == 0; i++)
+			buf = job[i].err;
+	}
+
+	memset(&cp, 0, sizeof(SM9_COUPON));
+	memkill(mem, 5);
+	return buf;
+}
@@ -0,0 +1,105 @@
+/************************************************************************
+FileName:
+SM9_coupon.h
+Version:
+SM9_COUPON_V1.0
+Date:
+Oct 19,2026
+Description:
+Online/offline signcryption. Everything in Signcrypt that depends neither on
+the message nor on the recipient is done ahead of time and kept as a coupon:
+r, w = g^r with its 384-byte encoding, and V = [r]Ppube where Ppube = [ks]P1.
+Since QB = [H1(IDR||hid,N)]P1 + Ppube, T = [r]QB = [r*H1(IDR||hid,N)]P1 + V,
+so the online phase is H1, one fixed-base multiplication for T, the KDF and
+H2, l, and one fixed-base multiplication S = [l]dSA. w = g^r and V are
+fixed-base too, with the tables of g and Ppube kept by the pool. Ppube is
+also the encryption master public key of GM/T 0044, so SM9_enc takes its
+C1 = [r]QB and w from the same coupons.
+Function List:
+1.SM9_coupon_pool_init    //sender setup: g, dSA, fixed-base tables, empty pool
+2.SM9_coupon_pool_free    //stop the threads and release the pool
+3.SM9_coupon_make         //offline phase, compute one coupon
+4.SM9_coupon_put          //add a coupon to the pool, lock-free
+5.SM9_coupon_get          //take a coupon from the pool, lock-free
+6.SM9_coupon_count        //number of coupons ready
+7.SM9_coupon_fill         //refill the pool in the calling thread
+8.SM9_coupon_pool_start   //refill the pool from background threads
+9.SM9_coupon_pool_stop    //stop and join the background threads
+10.SM9_coupon_point      //[r]QB of a receiver with a coupon
+11.Signcrypt_coupon       //online phase of Signcrypt with a given coupon
+12.Signcrypt_online       //online phase of Signcrypt with a coupon of the pool
+13.Signcrypt_broadcast    //one message to many receivers with one coupon
+Notes:
+The pool is a bounded queue of SM9_COUPON_CELL with a sequence number per
+cell, so any number of threads can put and get without a lock. Background
+threads need a MIRACL built with MR_OS_THREADS, each makes its own SM9_CTX;
+without it SM9_coupon_pool_start starts none and the pool is refilled with
+SM9_coupon_fill when the caller is idle. An empty pool is not an error,
+Signcrypt_online then makes its coupon itself.
+A coupon must be used once only, a second use of r reveals dSA.
+Signcrypt_broadcast uses one coupon for all its receivers: h, l and S only
+depend on M and w, so they are shared, and each receiver costs one
+fixed-base multiplication for T_i and its KDF.
+************************************************************************/
+
+#ifndef HEADER_SM9_COUPON_H
+#define HEADER_SM9_COUPON_H
+
+#include "SM9_sv.h"
+#include "SM9_thread.h"
+
+#define SM9_COUPON_WINDOW 8       //window of the fixed-base tables, 2^8 points each
+#define SM9_COUPON_MAX_THREADS 16
+#define SM9_COUPON_IDLE_MS 1      //background threads wait this long when the pool is full
+#define SM9_BCAST_BATCH 16        //T_i brought back to affine together by Signcrypt_broadcast
+
+typedef struct
+{
+	unsigned char r[BNLEN];
+	unsigned char w[BNLEN * 12]; //zzn12_to_bytes384(g^r)
+	unsigned char V[BNLEN * 2];  //[r]Ppube
+} SM9_COUPON;
+
+typedef struct
+{
+	SM9_ATOMIC seq;
+	SM9_COUPON cp;
+} SM9_COUPON_CELL;
+
+typedef struct
+{
+	SM9_COUPON_CELL *cell;
+	long mask;                    //number of cells - 1, a power of 2 - 1
+	SM9_ATOMIC head;              //next cell to put
+	SM9_ATOMIC tail;              //next cell to get
+	SM9_ATOMIC stop;
+	int nthreads;
+	SM9_THREAD th[SM9_COUPON_MAX_THREADS];
+	zzn12 g;                      //e(P1,Ppub)
+	zzn12_fb gfb;                 //fixed-base table of g
+	BOOL gfb_ok;
+	ebrick P1_b;                  //fixed-base table of P1
+	ebrick Ppube_b;               //fixed-base table of Ppube = [ks]P1
+	ebrick dSA_b;                 //fixed-base table of the sender key dSA
+} SM9_COUPON_POOL;
+
+int SM9_coupon_pool_init(SM9_CTX *ctx, SM9_COUPON_POOL *pool, int num, unsigned char hid[], unsigned char *IDS,
+	int IDlen, big ks);
+void SM9_coupon_pool_free(SM9_COUPON_POOL *pool);
+int SM9_coupon_make(SM9_CTX *ctx, SM9_COUPON_POOL *pool, SM9_COUPON *cp);
+int SM9_coupon_put(SM9_COUPON_POOL *pool, const SM9_COUPON *cp);
+int SM9_coupon_get(SM9_COUPON_POOL *pool, SM9_COUPON *cp);
+int SM9_coupon_count(SM9_COUPON_POOL *pool);
+int SM9_coupon_fill(SM9_CTX *ctx, SM9_COUPON_POOL *pool, int n);
+int SM9_coupon_pool_start(SM9_COUPON_POOL *pool, int nthreads);
+void SM9_coupon_pool_stop(SM9_COUPON_POOL *pool);
+int SM9_coupon_point(SM9_CTX *ctx, SM9_COUPON_POOL *pool, const SM9_COUPON *cp, unsigned char hid[],
+	unsigned char *ID, unsigned char T[]);
+int Signcrypt_coupon(SM9_CTX *ctx, SM9_COUPON_POOL *pool, const SM9_COUPON *cp, unsigned char hid[],
+	unsigned char *IDR, unsigned char *message, size_t mlen, unsigned char S[], unsigned char T[], unsigned char C[]);
+int Signcrypt_online(SM9_CTX *ctx, SM9_COUPON_POOL *pool, unsigned char hid[], unsigned char *IDR,
+	unsigned char *message, size_t mlen, unsigned char S[], unsigned char T[], unsigned char C[]);
+int Signcrypt_broadcast(SM9_CTX *ctx, SM9_COUPON_POOL *pool, unsigned char hid[], unsigned char *IDR[], int n,
+	unsigned char *message, size_t mlen, unsigned char S[], unsigned char T[], unsigned char C[]);
+
+#endif
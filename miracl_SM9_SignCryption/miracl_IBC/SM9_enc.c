@@ -0,0 +1,370 @@
+/************************************************************************
+FileName:
+SM9_enc.c
+Version:
+SM9_ENC_V1.0
+Date:
+Oct 19,2026
+Description:
+SM9 encryption and key encapsulation on the coupon pool, see SM9_enc.h
+Function List:
+1.SM9_enc_start           //sender: C1 from a coupon and the KDF of C1||w||IDB
+2.SM9_enc_w               //receiver: check C1, w'=e(C1,deB) and the KDF of C1||w'||IDB
+3.SM9_encrypt             //C = C1||C3||C2 of a message to IDB
+4.SM9_decrypt             //check C1 and C3 and recover the message
+5.SM9_encap               //C = C1 and a key K of klen bytes for IDB
+6.SM9_decap               //recover K from C1
+Notes:
+A coupon whose K1 or K is all zero is dropped and the next one is taken,
+as the standard draws a new r.
+************************************************************************/
+
+#include <string.h>
+#include "SM9_enc.h"
+
+extern zzn2 X; //Frobniues constant
+extern big para_t, para_q;
+
+/****************************************************************
+Function:       SM9_enc_start
+Description:    take a coupon, C1=[r]QB with its r and start the KDF of C1||w||IDB
+Calls:          SM9_coupon_get,SM9_coupon_make,SM9_coupon_point,SM3_KDF_init,
+                SM3_KDF_absorb
+Called By:      SM9_encrypt,SM9_encap
+Input:
+                ctx          //context of the calling thread
+                pool         //made by SM9_coupon_pool_init
+                hid          //0x03
+                IDB          //identification of the receiver
+Output:
+                C1           //64 bytes
+                kdf          //Z=C1||w||IDB absorbed
+Return:
+                0: success
+                other: the error of SM9_coupon_make or SM9_coupon_point
+Others:         the coupon is wiped, only the KDF keeps what comes from r
+****************************************************************/
+static int SM9_enc_start(SM9_CTX *ctx, SM9_COUPON_POOL *pool, unsigned char hid[], unsigned char *IDB,
+	unsigned char C1[], SM3_KDF_CTX *kdf)
+{
+	SM9_COUPON cp;
+	int buf = 0;
+
+	if (SM9_coupon_get(pool, &cp) != 0)
+		buf = SM9_coupon_make(ctx, pool, &cp);
+	//A1-A4: C1=[r]QB, w=g^r
+	if (buf == 0)
+		buf = SM9_coupon_point(ctx, pool, &cp, hid, IDB, C1);
+	if (buf == 0)
+	{
+		SM3_KDF_init(kdf);
+		SM3_KDF_absorb(kdf, C1, SM9_ENC_C1_LEN);
+		SM3_KDF_absorb(kdf, cp.w, BNLEN * 12);
+		SM3_KDF_absorb(kdf, IDB, strlen((char *)IDB));
+	}
+	memset(&cp, 0, sizeof(SM9_COUPON));
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_enc_w
+Description:    check that C1 is a point of G1, w'=e(C1,deB) and start the KDF
+                of C1||w'||IDB
+Calls:          MIRACL functions,bytes128_to_ecn2,ecap,SM9_absorb_zzn12,
+                SM3_KDF_init,SM3_KDF_absorb
+Called By:      SM9_decrypt,SM9_decap
+Input:
+                IDB          //identification of the receiver
+                deB          //private key of IDB, 128 bytes
+                C1           //64 bytes
+Output:
+                kdf          //Z=C1||w'||IDB absorbed
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_C1_NOT_VALID_G1: C1 is not a point of G1
+                SM9_GEPRI_ERR: deB is not a point of G2
+                SM9_MY_ECAP_12A_ERR: R-ate calculation error
+Others:         w' lives in the memory of x and y, memkill releases it with them
+****************************************************************/
+static int SM9_enc_w(unsigned char *IDB, unsigned char deB[], const unsigned char C1[], SM3_KDF_CTX *kdf)
+{
+	big x, y;
+	ecn2 de;
+	epoint *P;
+	zzn12 w;
+	char *mem;
+	int buf = 0;
+
+	mem = (char *)memalloc(20);
+	if (mem == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	x = mirvar_mem(mem, 0);
+	y = mirvar_mem(mem, 1);
+	de.x.a = mirvar_mem(mem, 2);
+	de.x.b = mirvar_mem(mem, 3);
+	de.y.a = mirvar_mem(mem, 4);
+	de.y.b = mirvar_mem(mem, 5);
+	de.z.a = mirvar_mem(mem, 6);
+	de.z.b = mirvar_mem(mem, 7);
+	de.marker = MR_EPOINT_INFINITY;
+	P = epoint_init();
+	w.a.a.a = mirvar_mem(mem, 8);
+	w.a.a.b = mirvar_mem(mem, 9);
+	w.a.b.a = mirvar_mem(mem, 10);
+	w.a.b.b = mirvar_mem(mem, 11);
+	w.b.a.a = mirvar_mem(mem, 12);
+	w.b.a.b = mirvar_mem(mem, 13);
+	w.b.b.a = mirvar_mem(mem, 14);
+	w.b.b.b = mirvar_mem(mem, 15);
+	w.c.a.a = mirvar_mem(mem, 16);
+	w.c.a.b = mirvar_mem(mem, 17);
+	w.c.b.a = mirvar_mem(mem, 18);
+	w.c.b.b = mirvar_mem(mem, 19);
+	w.a.unitary = w.b.unitary = w.c.unitary = FALSE;
+	w.miller = w.unitary = FALSE;
+
+	//B1: C1 in G1, the coordinates must be below q as well
+	bytes_to_big(BNLEN, (unsigned char *)C1, x);
+	bytes_to_big(BNLEN, (unsigned char *)C1 + BNLEN, y);
+	if (mr_compare(x, para_q) >= 0 || mr_compare(y, para_q) >= 0 || !epoint_set(x, y, 0, P))
+		buf = SM9_C1_NOT_VALID_G1;
+	else if (!bytes128_to_ecn2(deB, &de))
+		buf = SM9_GEPRI_ERR;
+	//B2: w'=e(C1,deB)
+	else if (!ecap(de, P, para_t, X, &w))
+		buf = SM9_MY_ECAP_12A_ERR;
+	else
+	{
+		SM3_KDF_init(kdf);
+		SM3_KDF_absorb(kdf, C1, SM9_ENC_C1_LEN);
+		SM9_absorb_zzn12(kdf, w);
+		SM3_KDF_absorb(kdf, IDB, strlen((char *)IDB));
+	}
+
+	epoint_free(P);
+	memkill(mem, 20);
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_encrypt
+Description:    SM9 encryption with the key stream cipher: K1||K2=KDF(C1||w||IDB),
+                C2=M XOR K1, C3=SM3(C2||K2). C2 is hashed as it is produced.
+Calls:          SM9_enc_start,SM3_KDF_init,SM3_KDF_xor,SM3_KDF_squeeze,
+                SM3_KDF_absorb,SM3_done
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                pool         //made by SM9_coupon_pool_init, any sender may use it
+                hid          //0x03
+                IDB          //identification of the receiver
+                M            //the message
+                mlen         //the length of M
+Output:
+                C            //C1||C3||C2, SM9_ENC_C_LEN(mlen) bytes
+Return:
+                0: success
+                SM9_ERR_K1_ZERO: K1 was all zero SM9_ENC_MAX_TRIES times
+                SM9_CTX_ERR: ctx belongs to another thread
+                other: the error of SM9_enc_start
+Others:         M and C must not overlap
+****************************************************************/
+int SM9_encrypt(SM9_CTX *ctx, SM9_COUPON_POOL *pool, unsigned char hid[], unsigned char *IDB,
+	const unsigned char M[], size_t mlen, unsigned char C[])
+{
+	SM3_KDF_CTX kdf, mac;
+	unsigned char K2[SM9_ENC_K2_LEN], diff, *C2 = C + SM9_ENC_C1_LEN + SM9_ENC_C3_LEN;
+	size_t i;
+	int tries, buf;
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	for (tries = 0;; tries++)
+	{
+		if (tries == SM9_ENC_MAX_TRIES)
+			return SM9_ERR_K1_ZERO;
+		buf = SM9_enc_start(ctx, pool, hid, IDB, C, &kdf);
+		if (buf != 0)
+			return buf;
+		//A6: C2=M XOR K1, and C2 goes into the hash of C3
+		SM3_KDF_init(&mac);
+		SM3_KDF_xor(&kdf, &mac, M, C2, mlen, 1);
+		//A5: K1 all zero leaves C2=M, take a new r
+		diff = 0;
+		for (i = 0; i < mlen; i++)
+			diff |= C2[i] ^ M[i];
+		if (diff != 0 || mlen == 0)
+			break;
+	}
+
+	//A7: C3=MAC(K2,C2)=SM3(C2||K2)
+	SM3_KDF_squeeze(&kdf, K2, SM9_ENC_K2_LEN);
+	SM3_KDF_absorb(&mac, K2, SM9_ENC_K2_LEN);
+	SM3_done(&mac.mid, C + SM9_ENC_C1_LEN);
+
+	memset(K2, 0, sizeof(K2));
+	memset(&kdf, 0, sizeof(SM3_KDF_CTX));
+	return 0;
+}
+
+/****************************************************************
+Function:       SM9_decrypt
+Description:    SM9 decryption with the key stream cipher, C2 is hashed as it
+                is decrypted and M is wiped when C3 does not match
+Calls:          SM9_enc_w,SM3_KDF_init,SM3_KDF_xor,SM3_KDF_squeeze,
+                SM3_KDF_absorb,SM3_done
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                IDB          //identification of the receiver
+                deB          //private key of IDB, 128 bytes
+                C            //C1||C3||C2
+                clen         //the length of C
+Output:
+                M            //clen - SM9_ENC_C_LEN(0) bytes
+                mlen         //the length of M
+Return:
+                0: success
+                SM9_C3_MEMCMP_ERR: C3 does not match, or C is too short
+                SM9_ERR_K1_ZERO: K1 is all zero
+                SM9_CTX_ERR: ctx belongs to another thread
+                other: the error of SM9_enc_w
+Others:
+****************************************************************/
+int SM9_decrypt(SM9_CTX *ctx, unsigned char *IDB, unsigned char deB[], const unsigned char C[], size_t clen,
+	unsigned char M[], size_t *mlen)
+{
+	SM3_KDF_CTX kdf, mac;
+	unsigned char K2[SM9_ENC_K2_LEN], u[SM9_ENC_C3_LEN], diff;
+	const unsigned char *C2 = C + SM9_ENC_C1_LEN + SM9_ENC_C3_LEN;
+	size_t n, i;
+	int buf;
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	if (clen < SM9_ENC_C_LEN(0))
+		return SM9_C3_MEMCMP_ERR;
+	n = clen - SM9_ENC_C_LEN(0);
+
+	//B1, B2
+	buf = SM9_enc_w(IDB, deB, C, &kdf);
+	if (buf != 0)
+		return buf;
+
+	//B3: M'=C2 XOR K1, C2 goes into the hash of u
+	SM3_KDF_init(&mac);
+	SM3_KDF_xor(&kdf, &mac, C2, M, n, 0);
+	diff = 0;
+	for (i = 0; i < n; i++)
+		diff |= C2[i] ^ M[i];
+	if (diff == 0 && n != 0)
+		buf = SM9_ERR_K1_ZERO;
+
+	//B4: u=MAC(K2,C2) must be C3
+	SM3_KDF_squeeze(&kdf, K2, SM9_ENC_K2_LEN);
+	SM3_KDF_absorb(&mac, K2, SM9_ENC_K2_LEN);
+	SM3_done(&mac.mid, u);
+	diff = 0;
+	for (i = 0; i < SM9_ENC_C3_LEN; i++)
+		diff |= u[i] ^ C[SM9_ENC_C1_LEN + i];
+	if (buf == 0 && diff != 0)
+		buf = SM9_C3_MEMCMP_ERR;
+
+	if (buf != 0)
+		memset(M, 0, n);
+	else
+		*mlen = n;
+	memset(K2, 0, sizeof(K2));
+	memset(&kdf, 0, sizeof(SM3_KDF_CTX));
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_encap
+Description:    SM9 key encapsulation: C=C1=[r]QB and K=KDF(C1||w||IDB,klen)
+Calls:          SM9_enc_start,SM3_KDF_squeeze
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                pool         //made by SM9_coupon_pool_init, any sender may use it
+                hid          //0x03
+                IDB          //identification of the receiver
+                klen         //the length of K
+Output:
+                K            //the key, klen bytes
+                C            //C1, 64 bytes
+Return:
+                0: success
+                SM9_ERR_Decap_K: K was all zero SM9_ENC_MAX_TRIES times
+                SM9_CTX_ERR: ctx belongs to another thread
+                other: the error of SM9_enc_start
+Others:
+****************************************************************/
+int SM9_encap(SM9_CTX *ctx, SM9_COUPON_POOL *pool, unsigned char hid[], unsigned char *IDB, int klen,
+	unsigned char K[], unsigned char C[])
+{
+	SM3_KDF_CTX kdf;
+	unsigned char diff;
+	int tries, i, buf;
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	for (tries = 0;; tries++)
+	{
+		if (tries == SM9_ENC_MAX_TRIES)
+			return SM9_ERR_Decap_K;
+		buf = SM9_enc_start(ctx, pool, hid, IDB, C, &kdf);
+		if (buf != 0)
+			return buf;
+		//A6: K all zero, take a new r
+		SM3_KDF_squeeze(&kdf, K, klen);
+		diff = 0;
+		for (i = 0; i < klen; i++)
+			diff |= K[i];
+		if (diff != 0)
+			break;
+	}
+
+	memset(&kdf, 0, sizeof(SM3_KDF_CTX));
+	return 0;
+}
+
+/****************************************************************
+Function:       SM9_decap
+Description:    SM9 key decapsulation: K'=KDF(C1||w'||IDB,klen), w'=e(C1,deB)
+Calls:          SM9_enc_w,SM3_KDF_squeeze
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                IDB          //identification of the receiver
+                deB          //private key of IDB, 128 bytes
+                C            //C1, 64 bytes
+                klen         //the length of K
+Output:
+                K            //the key, klen bytes
+Return:
+                0: success
+                SM9_ERR_Decap_K: K' is all zero
+                SM9_CTX_ERR: ctx belongs to another thread
+                other: the error of SM9_enc_w
+Others:
+****************************************************************/
+int SM9_decap(SM9_CTX *ctx, unsigned char *IDB, unsigned char deB[], const unsigned char C[], int klen,
+	unsigned char K[])
+{
+	SM3_KDF_CTX kdf;
+	unsigned char diff = 0;
+	int i, buf;
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	buf = SM9_enc_w(IDB, deB, C, &kdf);
+	if (buf != 0)
+		return buf;
+	SM3_KDF_squeeze(&kdf, K, klen);
+	for (i = 0; i < klen; i++)
+		diff |= K[i];
+	memset(&kdf, 0, sizeof(SM3_KDF_CTX));
+	return diff == 0 ? SM9_ERR_Decap_K : 0;
+}
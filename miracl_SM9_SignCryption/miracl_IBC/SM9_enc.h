@@ -0,0 +1,46 @@
+/************************************************************************
+FileName:
+SM9_enc.h
+Version:
+SM9_ENC_V1.0
+Date:
+Oct 19,2026
+Description:
+SM9 public key encryption and key encapsulation of GM/T 0044 part 4, with
+the key stream cipher of the standard. The master public key Ppub-e = [ks]P1
+is the Ppube of the signcryption coupons, so the sender draws r, w = g^r and
+[r]Ppube from an SM9_COUPON_POOL: C1 = [r]QB costs one fixed-base
+multiplication of P1 and the rest is the KDF. Without a coupon ready the
+sender costs one more fixed-base multiplication and one fixed-base power of g.
+Function List:
+1.SM9_encrypt             //C = C1||C3||C2 of a message to IDB
+2.SM9_decrypt             //check C1 and C3 and recover the message
+3.SM9_encap               //C = C1 and a key K of klen bytes for IDB
+4.SM9_decap               //recover K from C1
+Notes:
+deB = [ks/(H1(IDB||hid,N)+ks)]P2 is the skID given by SM9_GenerateSignKey,
+128 bytes as bytes128_to_ecn2 reads them. C3 = SM3(C2||K2), K1 and K2 come
+from one KDF(C1||w||IDB) stream, C2 is XORed and hashed in the same pass.
+************************************************************************/
+
+#ifndef HEADER_SM9_ENC_H
+#define HEADER_SM9_ENC_H
+
+#include "SM9_coupon.h"
+
+#define SM9_ENC_K2_LEN 32                  //MAC key K2
+#define SM9_ENC_C1_LEN (BNLEN * 2)
+#define SM9_ENC_C3_LEN 32
+#define SM9_ENC_C_LEN(mlen) (SM9_ENC_C1_LEN + SM9_ENC_C3_LEN + (mlen))
+#define SM9_ENC_MAX_TRIES 16               //coupons tried before K1 or K is given up as all zero
+
+int SM9_encrypt(SM9_CTX *ctx, SM9_COUPON_POOL *pool, unsigned char hid[], unsigned char *IDB,
+	const unsigned char M[], size_t mlen, unsigned char C[]);
+int SM9_decrypt(SM9_CTX *ctx, unsigned char *IDB, unsigned char deB[], const unsigned char C[], size_t clen,
+	unsigned char M[], size_t *mlen);
+int SM9_encap(SM9_CTX *ctx, SM9_COUPON_POOL *pool, unsigned char hid[], unsigned char *IDB, int klen,
+	unsigned char K[], unsigned char C[]);
+int SM9_decap(SM9_CTX *ctx, unsigned char *IDB, unsigned char deB[], const unsigned char C[], int klen,
+	unsigned char K[]);
+
+#endif
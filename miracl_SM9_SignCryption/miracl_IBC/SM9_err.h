@@ -0,0 +1,36 @@
+/************************************************************************
+FileName:
+SM9_err.h
+Version:
+SM9_ERR_V1.0
+Date:
+Oct 19,2026
+Description:
+Error codes of SM9 encryption, key encapsulation and key exchange
+(GM/T 0044 parts 3 and 4) and of the random source, shared by SM9_sv.h and
+both copies of sm9_standard.h so that each name has one value in every program.
+Notes:
+The values start above the codes that SM9_sv.h and sm9_standard.h keep for
+themselves, 0x01 to 0x1F, so no value stands for two errors.
+************************************************************************/
+
+#ifndef HEADER_SM9_ERR_H
+#define HEADER_SM9_ERR_H
+
+#define SM9_ERR_CMP_S1SB 0x00000020        //S1!=SB
+#define SM9_ERR_CMP_S2SA 0x00000021        //S2!=SA
+#define SM9_ERR_RA 0x00000022              //RA of a key exchange is not a point of G1
+#define SM9_ERR_RB 0x00000023              //RB of a key exchange is not a point of G1
+#define SM9_ERR_SA 0x00000024              //SA can not be made or checked in this state of the exchange
+#define SM9_ERR_SB 0x00000025              //SB can not be made in this state of the exchange
+#define SM9_C1_NOT_VALID_G1 0x00000026     //C1 of an SM9 ciphertext is not a point of G1
+#define SM9_ENCRYPT_ERR 0x00000027         //encryption error
+#define SM9_ERR_K1_ZERO 0x00000028         //K1 of SM9 encryption is all zero
+#define SM9_C3_MEMCMP_ERR 0x00000029       //C3 of an SM9 ciphertext does not match C2
+#define SM9_DECRYPT_ERR 0x0000002A         //decryption error
+#define SM9_ERR_Encap_C 0x0000002B         //cipher error in key encapsulation
+#define SM9_ERR_Encap_K 0x0000002C         //the encapsulated key is all zero
+#define SM9_ERR_Decap_K 0x0000002D         //the decapsulated key is all zero
+#define SM9_RNG_ERR 0x0000002E             //the random source of the OS can not be read
+
+#endif
@@ -0,0 +1,562 @@
+/************************************************************************
+FileName:
+SM9_exch.c
+Version:
+SM9_EXCH_V1.0
+Date:
+Oct 19,2026
+Description:
+SM9 key exchange with precomputed pairing lines and tables, see SM9_exch.h
+Function List:
+1.SM9_exch_key_init       //lines of de, table of g, for the local user
+2.SM9_exch_key_free       //release the key
+3.SM9_exch_peer_init      //fixed-base table of the Q of a peer
+4.SM9_exch_peer_free      //release the peer
+5.SM9_exch_start          //r, R=[r]Q of the peer and g^r, both roles
+6.SM9_exch_pair           //check the R of the peer, e(R,de) and e(R,de)^r
+7.SM9_exch_derive         //SK and the two confirmation hashes
+8.SM9_exch_respond        //B: check RA, SKB and SB
+9.SM9_exch_confirm        //A: check RB and SB, SKA and SA
+10.SM9_exch_finish        //B: check SA
+Notes:
+Transcript: IDA||IDB||RA||RB whatever the role, g1,g2,g3 as named by B.
+SB = S1 = Hash(0x82||g1||Hash(g2||g3||IDA||IDB||RA||RB)), SA = S2 with 0x83.
+************************************************************************/
+
+#include <string.h>
+#include "SM9_exch.h"
+
+extern zzn2 X; //Frobniues constant
+extern epoint *P1;
+extern ecn2 P2;
+extern big N, para_a, para_b, para_t, para_q;
+
+/****************************************************************
+Function:       SM9_exch_key_init
+Description:    prepare the local user for key exchange: g=e(Ppub-e,P2) with its
+                fixed-base table and the Miller loop lines of its private key
+Calls:          MIRACL functions,bytes128_to_ecn2,ecap,member,ecap_prep,
+                zzn12_init,zzn12_fb_init
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                hid          //0x02
+                ID           //identification of the local user, kept by pointer
+                IDlen        //the length of ID
+                de           //private key of ID, 128 bytes
+                Ppube        //master public key [ke]P1, 64 bytes
+Output:
+                key
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_GEPUB_ERR: Ppube is not a point of G1
+                SM9_GEPRI_ERR: de is not a point of G2 of order N
+                SM9_MY_ECAP_12A_ERR: R-ate calculation error
+                SM9_MEMBER_ERR: the order of g is error
+                SM9_CTX_ERR: ctx belongs to another thread
+Others:
+****************************************************************/
+int SM9_exch_key_init(SM9_CTX *ctx, SM9_EXCH_KEY *key, unsigned char hid[], unsigned char *ID, int IDlen,
+	unsigned char de[], unsigned char Ppube[])
+{
+	big x, y;
+	ecn2 D;
+	epoint *P;
+	char *mem;
+	int buf = 0;
+
+	memset(key, 0, sizeof(SM9_EXCH_KEY));
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	key->ID = ID;
+	key->IDlen = IDlen;
+	key->hid = hid[0];
+	memcpy(key->Ppube, Ppube, BNLEN * 2);
+
+	mem = (char *)memalloc(8);
+	if (mem == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	x = mirvar_mem(mem, 0);
+	y = mirvar_mem(mem, 1);
+	D.x.a = mirvar_mem(mem, 2);
+	D.x.b = mirvar_mem(mem, 3);
+	D.y.a = mirvar_mem(mem, 4);
+	D.y.b = mirvar_mem(mem, 5);
+	D.z.a = mirvar_mem(mem, 6);
+	D.z.b = mirvar_mem(mem, 7);
+	D.marker = MR_EPOINT_INFINITY;
+	P = epoint_init();
+	zzn12_init(&key->g);
+
+	bytes_to_big(BNLEN, Ppube, x);
+	bytes_to_big(BNLEN, Ppube + BNLEN, y);
+	if (!epoint_set(x, y, 0, P))
+		buf = SM9_GEPUB_ERR;
+	else if (!bytes128_to_ecn2(de, &D))
+		buf = SM9_GEPRI_ERR;
+	else if (!ecap(P2, P, para_t, X, &key->g))
+		buf = SM9_MY_ECAP_12A_ERR;
+	else if (!member(key->g, para_t, X))
+		buf = SM9_MEMBER_ERR;
+	else if (!ecap_prep(D, para_t, X, &key->de))
+		buf = SM9_GEPRI_ERR;
+	else
+	{
+		zzn12_fb_init(&key->gfb, key->g);
+		key->gfb_ok = TRUE;
+	}
+
+	epoint_free(P);
+	memkill(mem, 8);
+	if (buf != 0)
+		SM9_exch_key_free(key);
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_exch_key_free
+Description:    release the lines, g and the table of a key
+Calls:          ecap_lines_free,zzn12_fb_free,zzn12_kill
+Called By:      SM9_exch_key_init,SM9_SelfCheck
+Input:
+                key
+Output:
+                NULL
+Return:
+                NULL
+Others:
+****************************************************************/
+void SM9_exch_key_free(SM9_EXCH_KEY *key)
+{
+	ecap_lines_free(&key->de);
+	if (key->gfb_ok)
+		zzn12_fb_free(&key->gfb);
+	zzn12_kill(&key->g);
+	memset(key, 0, sizeof(SM9_EXCH_KEY));
+}
+
+/****************************************************************
+Function:       SM9_exch_peer_init
+Description:    Q=[H1(ID||hid,N)]P1+Ppub-e of a peer and its fixed-base table,
+                kept for all the handshakes with that peer
+Calls:          MIRACL functions,SM9_H_init,SM9_H_final,SM3_KDF_absorb
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                key          //the local user, gives hid and Ppub-e
+                ID           //identification of the peer, kept by pointer
+                IDlen        //the length of ID
+Output:
+                peer
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_GEPUB_ERR: Q is the point at infinity
+                SM9_CTX_ERR: ctx belongs to another thread
+                other: the error of SM9_H_final
+Others:
+****************************************************************/
+int SM9_exch_peer_init(SM9_CTX *ctx, SM9_EXCH_KEY *key, SM9_EXCH_PEER *peer, unsigned char *ID, int IDlen)
+{
+	SM3_KDF_CTX kdf;
+	big h, x, y;
+	epoint *Q, *V;
+	char *mem;
+	int buf;
+
+	memset(peer, 0, sizeof(SM9_EXCH_PEER));
+	peer->ID = ID;
+	peer->IDlen = IDlen;
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	mem = (char *)memalloc(3);
+	if (mem == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	h = mirvar_mem(mem, 0);
+	x = mirvar_mem(mem, 1);
+	y = mirvar_mem(mem, 2);
+	Q = epoint_init();
+	V = epoint_init();
+
+	SM9_H_init(&kdf, 0x01);
+	SM3_KDF_absorb(&kdf, ID, IDlen);
+	SM3_KDF_absorb(&kdf, &key->hid, 1);
+	buf = SM9_H_final(&kdf, N, h);
+	if (buf == 0)
+	{
+		ecurve_mult(h, P1, Q);
+		bytes_to_big(BNLEN, key->Ppube, x);
+		bytes_to_big(BNLEN, key->Ppube + BNLEN, y);
+		epoint_set(x, y, 0, V);
+		ecurve_add(V, Q);
+		if (point_at_infinity(Q))
+			buf = SM9_GEPUB_ERR;
+	}
+	if (buf == 0)
+	{
+		epoint_get(Q, x, y);
+		if (!ebrick_init(&peer->Q_b, x, y, para_a, para_b, para_q, SM9_EXCH_WINDOW, BNLEN * 8))
+			buf = SM9_ASK_MEMORY_ERR;
+	}
+
+	epoint_free(Q);
+	epoint_free(V);
+	memkill(mem, 3);
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_exch_peer_free
+Description:    release the table of a peer
+Calls:          MIRACL functions
+Called By:      SM9_SelfCheck
+Input:
+                peer
+Output:
+                NULL
+Return:
+                NULL
+Others:
+****************************************************************/
+void SM9_exch_peer_free(SM9_EXCH_PEER *peer)
+{
+	if (peer->Q_b.table != NULL)
+		ebrick_end(&peer->Q_b);
+	memset(peer, 0, sizeof(SM9_EXCH_PEER));
+}
+
+/****************************************************************
+Function:       SM9_exch_start
+Description:    start a handshake in either role: r in [1,N-1], R=[r]Q of the
+                peer and g^r, everything that does not need the R of the peer
+Calls:          MIRACL functions,zzn12_fb_pow,zzn12_to_bytes192,SM9_arena_mark,
+                SM9_arena_release
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                key          //the local user
+                peer         //the other side
+                initiator    //1: A, R is RA, 0: B, R is RB
+Output:
+                st           //the handshake
+                R            //RA or RB, 64 bytes
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_CTX_ERR: ctx belongs to another thread
+                other: the error of zzn12_to_bytes192
+Others:         B may start ahead of time and keep st until an RA comes,
+                g^r is kept compressed to halve st
+****************************************************************/
+int SM9_exch_start(SM9_CTX *ctx, SM9_EXCH_KEY *key, SM9_EXCH_PEER *peer, SM9_EXCH *st, int initiator,
+	unsigned char R[])
+{
+	big r, x, y;
+	zzn12 w;
+	char *mem;
+	int mark, buf = 0;
+
+	memset(st, 0, sizeof(SM9_EXCH));
+	st->initiator = initiator;
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	mem = (char *)memalloc(3);
+	if (mem == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	r = mirvar_mem(mem, 0);
+	x = mirvar_mem(mem, 1);
+	y = mirvar_mem(mem, 2);
+
+	//A1-A3, B1-B3: R=[r]Q
+	do
+		strong_bigrand(&ctx->rng, N, r);
+	while (size(r) == 0);
+	mul_brick(&peer->Q_b, r, x, y);
+	big_to_bytes(BNLEN, x, R, 1);
+	big_to_bytes(BNLEN, y, R + BNLEN, 1);
+	memcpy(initiator ? st->RA : st->RB, R, SM9_EXCH_R_LEN);
+
+	//A: g1=g^rA, B: g2=g^rB
+	mark = SM9_arena_mark();
+	w = zzn12_fb_pow(&key->gfb, r);
+	buf = zzn12_to_bytes192(w, st->gr);
+	big_to_bytes(BNLEN, r, st->r, 1);
+	st->state = 1;
+	if (!SM9_arena_release(mark) && buf == 0)
+		buf = SM9_ASK_MEMORY_ERR;
+	if (buf != 0)
+		memset(st, 0, sizeof(SM9_EXCH));
+
+	memkill(mem, 3);
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_exch_pair
+Description:    check that R of the peer is a point of G1, e=e(R,de) with the
+                lines of de and e_r=e^r
+Calls:          MIRACL functions,ecap_fixed,zzn12_tmp,zzn12_pow,zzn12_to_bytes384,
+                bytes192_to_zzn12,SM9_arena_mark,SM9_arena_release
+Called By:      SM9_exch_respond,SM9_exch_confirm
+Input:
+                key          //the local user
+                st           //the handshake, gives r
+                R            //RA or RB of the peer
+                err          //SM9_ERR_RA or SM9_ERR_RB
+Output:
+                e            //384 bytes
+                e_r          //384 bytes
+                gr           //384 bytes, g^r of st decompressed
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                err: R is not a point of G1
+                SM9_MY_ECAP_12A_ERR: R-ate calculation error
+Others:         st->gr was written by SM9_exch_start, so it is not checked
+                with member()
+****************************************************************/
+static int SM9_exch_pair(SM9_EXCH_KEY *key, SM9_EXCH *st, const unsigned char R[], int err,
+	unsigned char e[], unsigned char e_r[], unsigned char gr[])
+{
+	big r, x, y;
+	epoint *P;
+	zzn12 w, w_r;
+	char *mem;
+	int mark, buf = 0;
+
+	mem = (char *)memalloc(3);
+	if (mem == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	r = mirvar_mem(mem, 0);
+	x = mirvar_mem(mem, 1);
+	y = mirvar_mem(mem, 2);
+	P = epoint_init();
+	mark = SM9_arena_mark();
+	zzn12_tmp(&w);
+
+	bytes_to_big(BNLEN, (unsigned char *)R, x);
+	bytes_to_big(BNLEN, (unsigned char *)R + BNLEN, y);
+	if (mr_compare(x, para_q) >= 0 || mr_compare(y, para_q) >= 0 || !epoint_set(x, y, 0, P))
+		buf = err;
+	else if (!ecap_fixed(&key->de, P, para_t, X, &w))
+		buf = SM9_MY_ECAP_12A_ERR;
+	else
+	{
+		bytes_to_big(BNLEN, st->r, r);
+		w_r = zzn12_pow(w, r);
+		zzn12_to_bytes384(w, e);
+		zzn12_to_bytes384(w_r, e_r);
+		bytes192_to_zzn12(st->gr, &w);
+		zzn12_to_bytes384(w, gr);
+	}
+	if (!SM9_arena_release(mark) && buf == 0)
+		buf = SM9_ASK_MEMORY_ERR;
+
+	epoint_free(P);
+	memkill(mem, 3);
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_exch_derive
+Description:    SK=KDF(IDA||IDB||RA||RB||g1||g2||g3,klen) and the hashes
+                S82=Hash(0x82||g1||Hash(g2||g3||IDA||IDB||RA||RB)), S83 with 0x83
+Calls:          SM3_init,SM3_process,SM3_done,SM3_KDF_init,SM3_KDF_absorb,
+                SM3_KDF_squeeze
+Called By:      SM9_exch_respond,SM9_exch_confirm
+Input:
+                st           //RA and RB
+                IDA,IDAlen   //the initiator
+                IDB,IDBlen   //the responder
+                g1,g2,g3     //384 bytes each
+                klen         //the length of SK
+Output:
+                SK,S82,S83
+Return:
+                NULL
+Others:
+****************************************************************/
+static void SM9_exch_derive(SM9_EXCH *st, unsigned char *IDA, int IDAlen, unsigned char *IDB, int IDBlen,
+	unsigned char g1[], unsigned char g2[], unsigned char g3[], int klen,
+	unsigned char SK[], unsigned char S82[], unsigned char S83[])
+{
+	SM3_STATE md;
+	SM3_KDF_CTX kdf;
+	unsigned char inner[SM9_EXCH_S_LEN], pre;
+
+	SM3_KDF_init(&kdf);
+	SM3_KDF_absorb(&kdf, IDA, IDAlen);
+	SM3_KDF_absorb(&kdf, IDB, IDBlen);
+	SM3_KDF_absorb(&kdf, st->RA, SM9_EXCH_R_LEN);
+	SM3_KDF_absorb(&kdf, st->RB, SM9_EXCH_R_LEN);
+	SM3_KDF_absorb(&kdf, g1, BNLEN * 12);
+	SM3_KDF_absorb(&kdf, g2, BNLEN * 12);
+	SM3_KDF_absorb(&kdf, g3, BNLEN * 12);
+	SM3_KDF_squeeze(&kdf, SK, klen);
+
+	SM3_init(&md);
+	SM3_process(&md, g2, BNLEN * 12);
+	SM3_process(&md, g3, BNLEN * 12);
+	SM3_process(&md, IDA, IDAlen);
+	SM3_process(&md, IDB, IDBlen);
+	SM3_process(&md, st->RA, SM9_EXCH_R_LEN);
+	SM3_process(&md, st->RB, SM9_EXCH_R_LEN);
+	SM3_done(&md, inner);
+	for (pre = 0x82; pre <= 0x83; pre++)
+	{
+		SM3_init(&md);
+		SM3_process(&md, &pre, 1);
+		SM3_process(&md, g1, BNLEN * 12);
+		SM3_process(&md, inner, SM9_EXCH_S_LEN);
+		SM3_done(&md, pre == 0x82 ? S82 : S83);
+	}
+
+	memset(&kdf, 0, sizeof(SM3_KDF_CTX));
+	memset(&md, 0, sizeof(SM3_STATE));
+	memset(inner, 0, sizeof(inner));
+}
+
+/****************************************************************
+Function:       SM9_exch_respond
+Description:    responder B: g1=e(RA,deB), g2=g^rB from SM9_exch_start,
+                g3=g1^rB, SKB and SB, and keep S2 for SM9_exch_finish
+Calls:          SM9_exch_pair,SM9_exch_derive
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                key          //B
+                peer         //A
+                st           //started by SM9_exch_start as responder
+                RA           //from A, 64 bytes
+                klen         //the length of SK
+Output:
+                SK           //SKB, klen bytes
+                SB           //32 bytes, sent to A with RB
+Return:
+                0: success
+                SM9_ERR_SB: st is not a started responder
+                SM9_ERR_RA: RA is not a point of G1
+                SM9_CTX_ERR: ctx belongs to another thread
+                other: the error of SM9_exch_pair
+Others:         st is wiped on error
+****************************************************************/
+int SM9_exch_respond(SM9_CTX *ctx, SM9_EXCH_KEY *key, SM9_EXCH_PEER *peer, SM9_EXCH *st,
+	const unsigned char RA[], int klen, unsigned char SK[], unsigned char SB[])
+{
+	unsigned char g1[BNLEN * 12], g2[BNLEN * 12], g3[BNLEN * 12];
+	int buf;
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	if (st->initiator || st->state != 1)
+		return SM9_ERR_SB;
+	memcpy(st->RA, RA, SM9_EXCH_R_LEN);
+	//B4-B6
+	buf = SM9_exch_pair(key, st, RA, SM9_ERR_RA, g1, g3, g2);
+	if (buf == 0)
+	{
+		//B7, B8
+		SM9_exch_derive(st, peer->ID, peer->IDlen, key->ID, key->IDlen, g1, g2, g3, klen, SK, SB, st->S2);
+		st->state = 2;
+		memset(st->r, 0, BNLEN);
+		memset(st->gr, 0, sizeof(st->gr));
+	}
+	else
+		memset(st, 0, sizeof(SM9_EXCH));
+
+	memset(g1, 0, sizeof(g1));
+	memset(g2, 0, sizeof(g2));
+	memset(g3, 0, sizeof(g3));
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_exch_confirm
+Description:    initiator A: g1=g^rA from SM9_exch_start, g2=e(RB,deA), g3=g2^rA,
+                check S1=SB, then SKA and SA
+Calls:          SM9_exch_pair,SM9_exch_derive
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                key          //A
+                peer         //B
+                st           //started by SM9_exch_start as initiator
+                RB           //from B, 64 bytes
+                SB           //from B, 32 bytes, NULL without key confirmation
+                klen         //the length of SK
+Output:
+                SK           //SKA, klen bytes
+                SA           //32 bytes, sent to B
+Return:
+                0: success
+                SM9_ERR_SA: st is not a started initiator
+                SM9_ERR_RB: RB is not a point of G1
+                SM9_ERR_CMP_S1SB: S1!=SB, SK and SA are wiped
+                SM9_CTX_ERR: ctx belongs to another thread
+                other: the error of SM9_exch_pair
+Others:         st is wiped, the handshake is over for A
+****************************************************************/
+int SM9_exch_confirm(SM9_CTX *ctx, SM9_EXCH_KEY *key, SM9_EXCH_PEER *peer, SM9_EXCH *st,
+	const unsigned char RB[], const unsigned char SB[], int klen, unsigned char SK[], unsigned char SA[])
+{
+	unsigned char g1[BNLEN * 12], g2[BNLEN * 12], g3[BNLEN * 12], S1[SM9_EXCH_S_LEN], diff = 0;
+	int i, buf;
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	if (!st->initiator || st->state != 1)
+		return SM9_ERR_SA;
+	memcpy(st->RB, RB, SM9_EXCH_R_LEN);
+	//A5-A7
+	buf = SM9_exch_pair(key, st, RB, SM9_ERR_RB, g2, g3, g1);
+	if (buf == 0)
+	{
+		//A8-A10
+		SM9_exch_derive(st, key->ID, key->IDlen, peer->ID, peer->IDlen, g1, g2, g3, klen, SK, S1, SA);
+		for (i = 0; SB != NULL && i < SM9_EXCH_S_LEN; i++)
+			diff |= S1[i] ^ SB[i];
+		if (diff != 0)
+		{
+			memset(SK, 0, klen);
+			memset(SA, 0, SM9_EXCH_S_LEN);
+			buf = SM9_ERR_CMP_S1SB;
+		}
+	}
+
+	memset(st, 0, sizeof(SM9_EXCH));
+	memset(g1, 0, sizeof(g1));
+	memset(g2, 0, sizeof(g2));
+	memset(g3, 0, sizeof(g3));
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_exch_finish
+Description:    responder B: check S2=SA
+Calls:
+Called By:      SM9_SelfCheck
+Input:
+                st           //after SM9_exch_respond
+                SA           //from A, 32 bytes
+Output:
+                NULL
+Return:
+                0: success
+                SM9_ERR_SA: st is not waiting for SA
+                SM9_ERR_CMP_S2SA: S2!=SA, SKB must not be used
+Others:         st is wiped
+****************************************************************/
+int SM9_exch_finish(SM9_EXCH *st, const unsigned char SA[])
+{
+	unsigned char diff = 0;
+	int i;
+
+	if (st->initiator || st->state != 2)
+		return SM9_ERR_SA;
+	for (i = 0; i < SM9_EXCH_S_LEN; i++)
+		diff |= st->S2[i] ^ SA[i];
+	memset(st, 0, sizeof(SM9_EXCH));
+	return diff != 0 ? SM9_ERR_CMP_S2SA : 0;
+}
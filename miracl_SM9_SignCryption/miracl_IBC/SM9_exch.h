@@ -0,0 +1,84 @@
+/************************************************************************
+FileName:
+SM9_exch.h
+Version:
+SM9_EXCH_V1.0
+Date:
+Oct 19,2026
+Description:
+SM9 key exchange of GM/T 0044 part 3, initiator A and responder B, with
+the optional key confirmation SB, SA. What does not change between
+handshakes is prepared once: the lines of the Miller loop of the local
+private key, so that e(R,de) only evaluates them at R, the fixed-base table
+of g = e(Ppub-e,P2), and a fixed-base table of Q = [H1(ID||hid,N)]P1 + Ppub-e
+for each peer. SM9_exch_start computes R = [r]Q and g^r before the peer
+speaks, a handshake is then one ecap_fixed and one zzn12_pow per side.
+Function List:
+1.SM9_exch_key_init       //lines of de, table of g, for the local user
+2.SM9_exch_key_free       //release the key
+3.SM9_exch_peer_init      //fixed-base table of the Q of a peer
+4.SM9_exch_peer_free      //release the peer
+5.SM9_exch_start          //r, R=[r]Q of the peer and g^r, both roles
+6.SM9_exch_respond        //B: check RA, SKB and SB
+7.SM9_exch_confirm        //A: check RB and SB, SKA and SA
+8.SM9_exch_finish         //B: check SA
+Notes:
+Flow: A start -> RA -> B start, respond -> RB, SB -> A confirm -> SA ->
+B finish. An SM9_EXCH_KEY and its peers are only read by the handshakes and
+may be shared by threads, each SM9_EXCH belongs to one handshake.
+************************************************************************/
+
+#ifndef HEADER_SM9_EXCH_H
+#define HEADER_SM9_EXCH_H
+
+#include "SM9_sv.h"
+
+#define SM9_EXCH_R_LEN (BNLEN * 2)
+#define SM9_EXCH_S_LEN 32
+#define SM9_EXCH_WINDOW 8         //window of the fixed-base table of a peer
+
+//long-term side of the local user
+typedef struct
+{
+	unsigned char *ID;
+	int IDlen;
+	unsigned char hid;
+	unsigned char Ppube[BNLEN * 2];   //[ke]P1
+	ecap_lines de;                    //lines of the private key
+	zzn12 g;                          //e(Ppub-e,P2)
+	zzn12_fb gfb;                     //fixed-base table of g
+	BOOL gfb_ok;
+} SM9_EXCH_KEY;
+
+typedef struct
+{
+	unsigned char *ID;
+	int IDlen;
+	ebrick Q_b;                       //fixed-base table of Q=[H1(ID||hid,N)]P1+Ppub-e
+} SM9_EXCH_PEER;
+
+//one handshake
+typedef struct
+{
+	int initiator;
+	int state;                        //0: new, 1: started, 2: waiting for SA
+	unsigned char r[BNLEN];
+	unsigned char gr[GT_COMPRESSED_LEN]; //zzn12_to_bytes192(g^r), kept until the R of the peer comes
+	unsigned char RA[SM9_EXCH_R_LEN], RB[SM9_EXCH_R_LEN];
+	unsigned char S2[SM9_EXCH_S_LEN]; //B: the SA it expects
+} SM9_EXCH;
+
+int SM9_exch_key_init(SM9_CTX *ctx, SM9_EXCH_KEY *key, unsigned char hid[], unsigned char *ID, int IDlen,
+	unsigned char de[], unsigned char Ppube[]);
+void SM9_exch_key_free(SM9_EXCH_KEY *key);
+int SM9_exch_peer_init(SM9_CTX *ctx, SM9_EXCH_KEY *key, SM9_EXCH_PEER *peer, unsigned char *ID, int IDlen);
+void SM9_exch_peer_free(SM9_EXCH_PEER *peer);
+int SM9_exch_start(SM9_CTX *ctx, SM9_EXCH_KEY *key, SM9_EXCH_PEER *peer, SM9_EXCH *st, int initiator,
+	unsigned char R[]);
+int SM9_exch_respond(SM9_CTX *ctx, SM9_EXCH_KEY *key, SM9_EXCH_PEER *peer, SM9_EXCH *st,
+	const unsigned char RA[], int klen, unsigned char SK[], unsigned char SB[]);
+int SM9_exch_confirm(SM9_CTX *ctx, SM9_EXCH_KEY *key, SM9_EXCH_PEER *peer, SM9_EXCH *st,
+	const unsigned char RB[], const unsigned char SB[], int klen, unsigned char SK[], unsigned char SA[]);
+int SM9_exch_finish(SM9_EXCH *st, const unsigned char SA[]);
+
+#endif
@@ -0,0 +1,1289 @@
+/************************************************************************
+FileName:
+SM9_pool.c
+Version:
+SM9_POOL_V1.0
+Date:
+Oct 19,2026
+Description:
+Work-stealing pool of worker threads and the batches run on it, see SM9_pool.h
+Function List:
+1.SM9_pool_add            //add to a shared counter, returns the old value
+2.SM9_pool_take           //take the next item of a chunk
+3.SM9_pool_work           //the items of a chunk, then those left in the others
+4.SM9_pool_worker         //worker thread: pin, context, then batches until stopped
+5.SM9_pool_init           //start the workers, each with its own context
+6.SM9_pool_free           //stop and join the workers
+7.SM9_pool_go             //hand a batch to the workers and do chunk 0
+8.SM9_pool_run            //func(ctx,arg,i) for i<n over the workers and the caller
+9.SM9_pool_calc           //calc(arg,i) for i<n over the workers and the caller
+10.SM9_pool_status        //0 or the first error of a batch
+11.SM9_pool_signcrypt     //item of SM9_signcrypt_batch
+12.SM9_signcrypt_batch    //Signcrypt_online of n messages
+13.SM9_pool_unsigncrypt   //item of SM9_unsigncrypt_batch
+14.SM9_unsigncrypt_batch  //Unsigncrypt_key of n ciphertexts, each one checked alone
+15.SM9_pool_bench         //throughput of the three batches against the number of threads
+16.SM9_sc_branch          //one of the independent branches of Signcrypt_parallel
+17.Signcrypt_parallel     //one Signcrypt with its independent branches on the pool
+18.SM9_pool_latency       //stage times of Signcrypt_parallel against the number of threads
+19.SM9_pair_cut           //cut the Miller loop into segments of about the same cost
+20.SM9_pair_miller        //one segment of the Miller loop of SM9_ecap_pool
+21.SM9_pair_pow           //a power of |x|, or the Frobenius branch
+22.SM9_pair_round         //one power of -x of the final exponentiation
+23.SM9_ecap_pool          //ecap_multi with its Miller loop and final exponentiation on the pool
+24.SM9_pool_pairing       //stage times of SM9_ecap_pool against the number of threads
+************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "SM9_pool.h"
+
+extern zzn2 X; //Frobniues constant
+extern epoint *P1;
+extern big N, para_t;
+
+typedef struct
+{
+	SM9_COUPON_POOL *pool;
+	unsigned char *hid;
+	SM9_SC_ITEM *items;
+} SM9_SC_BATCH;
+
+typedef struct
+{
+	SM9_RECV_KEY *key;
+	SM9_UNSC_ITEM *items;
+} SM9_UNSC_BATCH;
+
+//the branches of one Signcrypt_parallel: the bigs of a branch belong to the
+//mip of the thread that runs it, so each one hands its result back as bytes
+typedef struct
+{
+	zzn12 g;                      //e(P1,Ppub) of the context of the caller, only read
+	big r, r0, r1, ks;            //only read
+	unsigned char *hid, *IDR, *IDS;
+	int IDlen;
+	unsigned char w[2][BNLEN * 12]; //zzn12_to_bytes384 of g^r0 and (g^p)^r1
+	unsigned char *T;             //T of the caller
+	unsigned char dSA[BNLEN * 2];
+	double t[SM9_SC_BRANCHES];    //wall time of each branch
+} SM9_SC_GRAPH;
+
+//the items of one SM9_ecap_pool: they write to zzn12 of the caller, the mips
+//of all the threads share q and so its Montgomery form
+typedef struct
+{
+	int m;                        //the pairs of ecap_multi
+	ecap_lines **L;
+	epoint **Q;
+	int hi[SM9_PAIR_SEGMENTS], lo[SM9_PAIR_SEGMENTS]; //bits of each segment
+	zzn12 e;                      //base of the current power, only read
+	big k;                        //|x|
+	zzn12 f[SM9_PAIR_SEGMENTS];   //result of each item
+} SM9_PAIR_JOB;
+
+/****************************************************************
+Function:       SM9_pool_add
+Description:    *a += v as one atomic step
+Calls:          SM9_atomic_load,SM9_atomic_cas
+Called By:      SM9_pool_take,SM9_pool_work,SM9_pool_worker
+Input:
+                a, v
+Output:
+                a
+Return:
+                the value of *a before the addition
+Others:
+****************************************************************/
+static long SM9_pool_add(SM9_ATOMIC *a, long v)
+{
+	long old;
+
+	do
+		old = SM9_atomic_load(a);
+	while (!SM9_atomic_cas(a, old, old + v));
+	return old;
+}
+
+/****************************************************************
+Function:       SM9_pool_take
+Description:    take the next item of a chunk, the owner of the chunk and the
+                threads that steal from it all take items this way
+Calls:          SM9_atomic_load,SM9_atomic_cas
+Called By:      SM9_pool_work
+Input:
+                c            //the chunk
+Output:
+                c
+Return:
+                the index of the item, -1 when the chunk is empty
+Others:
+****************************************************************/
+static long SM9_pool_take(SM9_POOL_CHUNK *c)
+{
+	long k;
+
+	do
+	{
+		k = SM9_atomic_load(&c->next);
+		if (k >= c->end)
+			return -1;
+	} while (!SM9_atomic_cas(&c->next, k, k + 1));
+	return k;
+}
+
+/****************************************************************
+Function:       SM9_pool_work
+Description:    the share of one thread in the current batch: the items of its
+                own chunk, then the items left in the chunks that follow it
+Calls:          SM9_pool_take,SM9_pool_add
+Called By:      SM9_pool_worker,SM9_pool_go
+Input:
+                tp
+                ctx          //context of the calling thread, only for tp->func
+                id           //chunk of the calling thread
+Output:
+                tp->result
+Return:
+                NULL
+Others:
+****************************************************************/
+static void SM9_pool_work(SM9_POOL *tp, SM9_CTX *ctx, int id)
+{
+	long k;
+	int j, buf;
+
+	for (j = 0; j < tp->nchunks; j++)
+	{
+		while ((k = SM9_pool_take(&tp->chunk[(id + j) % tp->nchunks])) >= 0)
+		{
+			buf = tp->func != NULL ? tp->func(ctx, tp->arg, (int)k) : tp->calc(tp->arg, (int)k);
+			if (tp->result != NULL)
+				tp->result[k] = buf;
+			if (j > 0)
+				SM9_pool_add(&tp->steals, 1);
+		}
+	}
+}
+
+#if defined(MR_OS_THREADS) && !defined(SM9_NO_THREADS)
+/****************************************************************
+Function:       SM9_pool_worker
+Description:    worker thread: pin itself, make its context with its own
+                csprng, then wait for batches, polling tp->gen, until the pool
+                is stopped
+Calls:          SM9_thread_pin,SM9_ctx_init,SM9_ctx_free,SM9_pool_work,
+                SM9_pool_add,SM9_atomic_load,SM9_atomic_store,SM9_thread_sleep
+Called By:      SM9_pool_init
+Input:
+                arg          //SM9_POOL_WORKER
+Output:
+                NULL
+Return:
+                NULL
+Others:         an idle worker yields SM9_POOL_IDLE_SPINS times, so that a
+                batch that follows another one starts at once, then sleeps
+****************************************************************/
+static void SM9_pool_worker(void *arg)
+{
+	SM9_POOL_WORKER *w = (SM9_POOL_WORKER *)arg;
+	SM9_POOL *tp = w->tp;
+	SM9_CTX ctx;
+	long gen;
+	int idle = 0;
+
+	if (w->cpu >= 0 && SM9_thread_pin(w->cpu) != 0)
+		w->cpu = -1;
+	if (SM9_ctx_init(&ctx) != 0)
+	{
+		SM9_atomic_store(&w->state, 2);
+		return;
+	}
+	gen = SM9_atomic_load(&tp->gen);
+	SM9_atomic_store(&w->state, 1);
+
+	while (!SM9_atomic_load(&tp->stop))
+	{
+		if (SM9_atomic_load(&tp->gen) == gen)
+		{
+			SM9_thread_sleep(idle < SM9_POOL_IDLE_SPINS ? 0 : SM9_POOL_IDLE_MS);
+			idle++;
+			continue;
+		}
+		gen++;
+		idle = 0;
+		SM9_pool_work(tp, &ctx, w->id);
+		SM9_pool_add(&tp->busy, -1);
+	}
+	SM9_ctx_free(&ctx);
+}
+#endif
+
+/****************************************************************
+Function:       SM9_pool_init
+Description:    start nthreads workers, worker i pinned to processor i mod the
+                number of processors, and wait until each one has its context
+Calls:          SM9_thread_start,SM9_thread_join,SM9_thread_sleep,SM9_cpu_count,
+                SM9_atomic_load
+Called By:      SM9_pool_bench,SM9_pool_latency,SM9_pool_pairing,SM9_SelfCheck
+Input:
+                nthreads     //workers besides the calling thread, -1 for one
+                             //less than the number of processors
+Output:
+                tp
+Return:
+                number of workers running, 0 without MR_OS_THREADS
+Others:         after SM9_Init, the workers share its curve constants
+****************************************************************/
+int SM9_pool_init(SM9_POOL *tp, int nthreads)
+{
+	memset(tp, 0, sizeof(SM9_POOL));
+#if defined(MR_OS_THREADS) && !defined(SM9_NO_THREADS)
+	{
+		int ncpu = SM9_cpu_count(), i;
+		SM9_POOL_WORKER *w;
+
+		if (nthreads < 0)
+			nthreads = ncpu - 1;
+		if (nthreads > SM9_POOL_MAX_THREADS)
+			nthreads = SM9_POOL_MAX_THREADS;
+		for (i = 0; i < nthreads; i++)
+		{
+			w = &tp->w[i];
+			w->tp = tp;
+			w->id = i + 1;
+			w->cpu = (i + 1) % ncpu; //processor 0 is left to the calling thread
+			if (SM9_thread_start(&w->th, SM9_pool_worker, w) != 0)
+				break;
+			tp->nworkers++;
+		}
+		for (i = 0; i < tp->nworkers; i++)
+		{
+			w = &tp->w[i];
+			while (SM9_atomic_load(&w->state) == 0)
+				SM9_thread_sleep(0);
+			if (w->state == 2)
+				SM9_thread_join(w->th); //its chunk is taken by the others
+			else
+				tp->nlive++;
+		}
+	}
+#endif
+	tp->nchunks = tp->nworkers + 1;
+	return tp->nlive;
+}
+
+/****************************************************************
+Function:       SM9_pool_free
+Description:    stop the workers and join them, each one frees its context
+Calls:          SM9_atomic_store,SM9_thread_join
+Called By:      SM9_pool_bench,SM9_pool_latency,SM9_pool_pairing,SM9_SelfCheck
+Input:
+                tp
+Output:
+                tp
+Return:
+                NULL
+Others:         not while a batch runs
+****************************************************************/
+void SM9_pool_free(SM9_POOL *tp)
+{
+	int i;
+
+	SM9_atomic_store(&tp->stop, 1);
+	for (i = 0; i < tp->nworkers; i++)
+		if (tp->w[i].state == 1)
+			SM9_thread_join(tp->w[i].th);
+	memset(tp, 0, sizeof(SM9_POOL));
+}
+
+/****************************************************************
+Function:       SM9_pool_go
+Description:    the items i<n of func or of calc, whichever is not NULL: they
+                are cut into one chunk per thread, the calling thread does
+                chunk 0 and then helps the others
+Calls:          SM9_pool_work,SM9_atomic_load,SM9_atomic_store,SM9_thread_sleep
+Called By:      SM9_pool_run,SM9_pool_calc
+Input:
+                tp           //NULL or a pool without worker: all in the calling thread
+                ctx          //context of the calling thread, only for func
+                func, calc, arg, n
+Output:
+                result       //status of each item, may be NULL
+Return:
+                NULL
+Others:         returns when all n items are done
+****************************************************************/
+static void SM9_pool_go(SM9_POOL *tp, SM9_CTX *ctx, SM9_POOL_FUNC func, SM9_POOL_CALC calc, void *arg,
+	int n, int result[])
+{
+	int i, buf;
+
+	if (n <= 0)
+		return;
+	if (tp == NULL || tp->nlive == 0)
+	{
+		for (i = 0; i < n; i++)
+		{
+			buf = func != NULL ? func(ctx, arg, i) : calc(arg, i);
+			if (result != NULL)
+				result[i] = buf;
+		}
+		return;
+	}
+
+	tp->func = func;
+	tp->calc = calc;
+	tp->arg = arg;
+	tp->result = result;
+	for (i = 0; i < tp->nchunks; i++)
+	{
+		tp->chunk[i].end = (long)((long long)n * (i + 1) / tp->nchunks);
+		SM9_atomic_store(&tp->chunk[i].next, (long)((long long)n * i / tp->nchunks));
+	}
+	SM9_atomic_store(&tp->busy, tp->nlive);
+	SM9_atomic_store(&tp->gen, tp->gen + 1);
+
+	SM9_pool_work(tp, ctx, 0);
+	while (SM9_atomic_load(&tp->busy) != 0)
+		SM9_thread_sleep(0);
+}
+
+/****************************************************************
+Function:       SM9_pool_run
+Description:    result[i]=func(ctx_k,arg,i) for i<n, ctx_k is the context of the
+                thread that takes item i
+Calls:          SM9_pool_go
+Called By:      SM9_signcrypt_batch,SM9_unsigncrypt_batch
+Input:
+                tp           //NULL or a pool without worker: all in the calling thread
+                ctx          //context of the calling thread
+                func, arg, n
+Output:
+                result       //status of each item, may be NULL
+Return:
+                NULL
+Others:         returns when all n items are done
+****************************************************************/
+void SM9_pool_run(SM9_POOL *tp, SM9_CTX *ctx, SM9_POOL_FUNC func, void *arg, int n, int result[])
+{
+	SM9_pool_go(tp, ctx, func, NULL, arg, n, result);
+}
+
+/****************************************************************
+Function:       SM9_pool_calc
+Description:    result[i]=calc(arg,i) for i<n, for items that only need the mip
+                of the thread that takes them, not its context
+Calls:          SM9_pool_go
+Called By:      SM9_verify_batch,Signcrypt_parallel,SM9_pair_round,SM9_ecap_pool
+Input:
+                tp           //NULL or a pool without worker: all in the calling thread
+                calc, arg, n
+Output:
+                result       //status of each item, may be NULL
+Return:
+                NULL
+Others:         returns when all n items are done
+****************************************************************/
+void SM9_pool_calc(SM9_POOL *tp, SM9_POOL_CALC calc, void *arg, int n, int result[])
+{
+	SM9_pool_go(tp, NULL, NULL, calc, arg, n, result);
+}
+
+/****************************************************************
+Function:       SM9_pool_status
+Description:    what a batch returns
+Calls:
+Called By:      SM9_signcrypt_batch,SM9_unsigncrypt_batch,Signcrypt_parallel,
+                SM9_pair_round,SM9_ecap_pool
+Input:
+                result, n
+Output:
+                NULL
+Return:
+                0 when every item succeeded, else the error of the first one
+                that did not
+Others:
+****************************************************************/
+static int SM9_pool_status(int result[], int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (result[i] != 0)
+			return result[i];
+	return 0;
+}
+
+/****************************************************************
+Function:       SM9_pool_signcrypt
+Description:    item i of SM9_signcrypt_batch
+Calls:          Signcrypt_online
+Called By:      SM9_pool_run
+Input:
+                ctx          //context of the thread of the item
+                arg          //SM9_SC_BATCH
+                i
+Output:
+                S, T and C of item i
+Return:
+                as Signcrypt_online
+Others:
+****************************************************************/
+static int SM9_pool_signcrypt(SM9_CTX *ctx, void *arg, int i)
+{
+	SM9_SC_BATCH *b = (SM9_SC_BATCH *)arg;
+	SM9_SC_ITEM *it = &b->items[i];
+
+	return Signcrypt_online(ctx, b->pool, b->hid, it->IDR, it->message, it->mlen, it->S, it->T, it->C);
+}
+
+/****************************************************************
+Function:       SM9_signcrypt_batch
+Description:    signcrypt n messages of the sender of pool over the threads of
+                tp, each one with a coupon of the pool or a new one
+Calls:          SM9_pool_run,SM9_pool_status
+Called By:      SM9_pool_bench,SM9_SelfCheck
+Input:
+                tp, ctx      //as SM9_pool_run
+                pool         //coupon pool of the sender
+                hid          //0x03
+                items        //the n messages and their receivers
+                n
+Output:
+                items[i].S, items[i].T, items[i].C
+                result       //0 or the error of each message, as Signcrypt_online
+Return:
+                0: all messages are signcrypted
+                other: the error of the first message that is not
+Others:
+****************************************************************/
+int SM9_signcrypt_batch(SM9_POOL *tp, SM9_CTX *ctx, SM9_COUPON_POOL *pool, unsigned char hid[],
+	SM9_SC_ITEM items[], int n, int result[])
+{
+	SM9_SC_BATCH b;
+
+	b.pool = pool;
+	b.hid = hid;
+	b.items = items;
+	SM9_pool_run(tp, ctx, SM9_pool_signcrypt, &b, n, result);
+	return SM9_pool_status(result, n);
+}
+
+/****************************************************************
+Function:       SM9_pool_unsigncrypt
+Description:    item i of SM9_unsigncrypt_batch
+Calls:          Unsigncrypt_key
+Called By:      SM9_pool_run
+Input:
+                ctx          //context of the thread of the item
+                arg          //SM9_UNSC_BATCH
+                i
+Output:
+                M of item i
+Return:
+                as Unsigncrypt_key
+Others:
+****************************************************************/
+static int SM9_pool_unsigncrypt(SM9_CTX *ctx, void *arg, int i)
+{
+	SM9_UNSC_BATCH *b = (SM9_UNSC_BATCH *)arg;
+
+	return Unsigncrypt_key(ctx, b->key, &b->items[i]);
+}
+
+/****************************************************************
+Function:       SM9_unsigncrypt_batch
+Description:    unsigncrypt n ciphertexts to the receiver of key over the
+                threads of tp, each one with its own check, so that one bad
+                ciphertext costs nothing to the others
+Calls:          SM9_pool_run,SM9_pool_status
+Called By:      SM9_pool_bench,SM9_SelfCheck
+Input:
+                tp, ctx      //as SM9_pool_run
+                key          //made by SM9_recv_key_init
+                items        //the n ciphertexts
+                n
+Output:
+                items[i].M   //M' of each good ciphertext, zeroed for a bad one
+                result       //0 or the error of each ciphertext, as Unsigncrypt_key
+Return:
+                0: all ciphertexts are good
+                other: the error of the first one that is not
+Others:         SM9_verify_batch is cheaper when bad ciphertexts are rare
+****************************************************************/
+int SM9_unsigncrypt_batch(SM9_POOL *tp, SM9_CTX *ctx, SM9_RECV_KEY *key, SM9_UNSC_ITEM items[], int n,
+	int result[])
+{
+	SM9_UNSC_BATCH b;
+
+	b.key = key;
+	b.items = items;
+	SM9_pool_run(tp, ctx, SM9_pool_unsigncrypt, &b, n, result);
+	return SM9_pool_status(result, n);
+}
+
+/****************************************************************
+Function:       SM9_pool_bench
+Description:    signcrypt SM9_POOL_BENCH_ITEMS messages to the receiver of key,
+                then unsigncrypt and verify them, on pools of 1, 2, 4, ... threads
+                up to the number of processors, and print the items per second
+                of each batch with its speedup over one thread
+Calls:          SM9_pool_init,SM9_pool_free,SM9_signcrypt_batch,
+                SM9_unsigncrypt_batch,SM9_verify_batch,SM9_coupon_get,
+                SM9_cpu_count,SM9_wall_time
+Called By:      SM9_Bench
+Input:
+                ctx          //context of the calling thread
+                pool         //coupon pool of the sender IDS, without background threads
+                key          //made by SM9_recv_key_init
+                hid          //0x03
+                IDS          //identification of the sender
+                message      //the message of every item
+                mlen         //the length of message
+Output:
+                NULL
+Return:
+                0: every batch succeeded and gave back the message
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_DATA_MEMCMP_ERR: M' is not the message
+                other: the error of a batch
+Others:         the coupons left in the pool are dropped before each signcrypt
+                batch, so that every item pays for its coupon
+****************************************************************/
+int SM9_pool_bench(SM9_CTX *ctx, SM9_COUPON_POOL *pool, SM9_RECV_KEY *key, unsigned char hid[],
+	unsigned char *IDS, unsigned char *message, size_t mlen)
+{
+	SM9_SC_ITEM sc[SM9_POOL_BENCH_ITEMS];
+	SM9_UNSC_ITEM un[SM9_POOL_BENCH_ITEMS];
+	int result[SM9_POOL_BENCH_ITEMS];
+	double t0, rate[3], base[3];
+	unsigned char *mem;
+	SM9_POOL tp;
+	SM9_COUPON cp;
+	size_t clen = SM9_C_LEN(mlen);
+	int n = SM9_POOL_BENCH_ITEMS, ncpu, nthr, i, k, buf = 0;
+
+	mem = (unsigned char *)malloc((size_t)n * (BNLEN * 4 + clen + mlen));
+	if (mem == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	for (i = 0; i < n; i++)
+	{
+		sc[i].IDR = key->IDR;
+		sc[i].message = message;
+		sc[i].mlen = mlen;
+		sc[i].S = mem + (size_t)i * (BNLEN * 4 + clen + mlen);
+		sc[i].T = sc[i].S + BNLEN * 2;
+		sc[i].C = sc[i].T + BNLEN * 2;
+		un[i].IDS = IDS;
+		un[i].mlen = mlen;
+		un[i].S = sc[i].S;
+		un[i].T = sc[i].T;
+		un[i].C = sc[i].C;
+		un[i].M = sc[i].C + clen;
+	}
+
+	printf("\n threads   signcrypt/s  unsigncrypt/s     verify/s   speedup (items/s against 1 thread)\n");
+	ncpu = SM9_cpu_count();
+	for (nthr = 1; buf == 0; nthr = nthr * 2 < ncpu ? nthr * 2 : ncpu)
+	{
+		SM9_pool_init(&tp, nthr - 1);
+		while (SM9_coupon_get(pool, &cp) == 0);
+
+		t0 = SM9_wall_time();
+		buf = SM9_signcrypt_batch(&tp, ctx, pool, hid, sc, n, result);
+		rate[0] = n / (SM9_wall_time() - t0);
+		if (buf == 0)
+		{
+			t0 = SM9_wall_time();
+			buf = SM9_unsigncrypt_batch(&tp, ctx, key, un, n, result);
+			rate[1] = n / (SM9_wall_time() - t0);
+		}
+		for (i = 0; buf == 0 && i < n; i++)
+			if (memcmp(un[i].M, message, mlen) != 0)
+				buf = SM9_DATA_MEMCMP_ERR;
+		if (buf == 0)
+		{
+			t0 = SM9_wall_time();
+			buf = SM9_verify_batch(&tp, ctx, key, un, n, result);
+			rate[2] = n / (SM9_wall_time() - t0);
+		}
+		if (buf == 0)
+		{
+			if (nthr == 1)
+				memcpy(base, rate, sizeof(rate));
+			printf("%8d %13.1f %14.1f %12.1f  ", tp.nlive + 1, rate[0], rate[1], rate[2]);
+			for (k = 0; k < 3; k++)
+				printf(" %5.2fx", rate[k] / base[k]);
+			printf("   %ld stolen\n", (long)tp.steals);
+		}
+		SM9_pool_free(&tp);
+		if (nthr == ncpu)
+			break;
+	}
+
+	memset(&cp, 0, sizeof(SM9_COUPON));
+	free(mem);
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_sc_branch
+Description:    branch i of Signcrypt_parallel: 0 is g^r0, 1 is (g^p)^r1,
+                2 is T=[r]QB and 3 is dSA=[t2]P1
+Calls:          MIRACL functions,zzn12_tmp,zzn12_copy,zzn12_powq,zzn12_pow,
+                zzn12_to_bytes384,SM9_H_init,SM9_H_final,SM3_KDF_absorb,
+                SM9_G1_mul_glv,SM9_arena_mark,SM9_tmp,SM9_arena_release,SM9_wall_time
+Called By:      SM9_pool_calc
+Input:
+                arg          //SM9_SC_GRAPH
+                i
+Output:
+                job->w[i], job->T or job->dSA, job->t[i]
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: the arena ran out
+                SM9_GEPRI_ERR: H1(ID||hid,N)+ks is zero for IDR or IDS
+                other: the error of SM9_H_final
+Others:         QB=[H1(IDR||hid,N)]P1+[ks]P1, so T is one multiplication of P1
+                by r*(H1(IDR||hid,N)+ks) mod N
+****************************************************************/
+static int SM9_sc_branch(void *arg, int i)
+{
+	SM9_SC_GRAPH *job = (SM9_SC_GRAPH *)arg;
+	SM3_KDF_CTX hv;
+	big h, rem, x, y;
+	epoint *R;
+	zzn12 w;
+	unsigned char *P;
+	double t0 = SM9_wall_time();
+	int mark, buf = 0;
+
+	mark = SM9_arena_mark();
+	h = SM9_tmp();
+	rem = SM9_tmp();
+	x = SM9_tmp();
+	y = SM9_tmp();
+	if (i < 2)
+	{
+		//A3 in two halves, g^p is a Frobenius
+		zzn12_tmp(&w);
+		zzn12_copy(&job->g, &w);
+		if (i == 1)
+			zzn12_powq(X, &w);
+		w = zzn12_pow(w, i == 0 ? job->r0 : job->r1);
+		zzn12_to_bytes384(w, job->w[i]);
+	}
+	else
+	{
+		SM9_H_init(&hv, 0x01);
+		if (i == 2)
+			SM3_KDF_absorb(&hv, job->IDR, strlen((char *)job->IDR));
+		else
+			SM3_KDF_absorb(&hv, job->IDS, job->IDlen);
+		SM3_KDF_absorb(&hv, job->hid, 1);
+		buf = SM9_H_final(&hv, N, h);
+		if (buf == 0)
+		{
+			add(h, job->ks, h);
+			divide(h, N, rem);
+			if (size(h) == 0)
+				buf = SM9_GEPRI_ERR;
+		}
+		if (buf == 0)
+		{
+			if (i == 2)
+			{
+				//A1, A7: T=[r]QB=[r*(H1(IDR||hid,N)+ks)]P1
+				multiply(h, job->r, h);
+				P = job->T;
+			}
+			else
+			{
+				//t2=ks*(H1(IDS||hid,N)+ks)^(-1), dSA=[t2]P1
+				xgcd(h, N, h, h, h);
+				multiply(job->ks, h, h);
+				P = job->dSA;
+			}
+			divide(h, N, rem);
+			R = epoint_init();
+			SM9_G1_mul_glv(h, P1, R);
+			epoint_get(R, x, y);
+			big_to_bytes(BNLEN, x, P, 1);
+			big_to_bytes(BNLEN, y, P + BNLEN, 1);
+			epoint_free(R);
+		}
+	}
+	if (!SM9_arena_release(mark) && buf == 0)
+		buf = SM9_ASK_MEMORY_ERR;
+	job->t[i] = SM9_wall_time() - t0;
+	return buf;
+}
+
+/****************************************************************
+Function:       Signcrypt_parallel
+Description:    Signcrypt for the latency of one message. After r is drawn,
+                g^r, T=[r]QB and dSA=[t2]P1 do not depend on each other;
+                g^r=g^r0*(g^p)^r1 with r=r0+r1*6t^2, as g^p=g^(6t^2) in GT,
+                which makes two exponentiations of half the length. The four
+                branches are four items of the pool, only the KDF, H2, l and
+                S=[l]dSA are left after them.
+Calls:          MIRACL functions,SM9_pub_lines,SM9_pool_calc,SM9_pool_status,
+                zzn12_tmp,zzn12_mul,bytes384_to_zzn12,zzn12_to_bytes384,
+                SM3_KDF_init,SM3_KDF_absorb,SM3_KDF_xor,SM9_DEM_encrypt,
+                SM9_H_init,SM9_H_final,SM9_G1_mul_glv,SM9_arena_mark,SM9_tmp,
+                SM9_arena_release,SM9_wall_time
+Called By:      SM9_pool_latency,SM9_SelfCheck
+Input:
+                tp           //NULL or a pool without worker: all in the calling thread,
+                             //SM9_SC_BRANCHES-1 workers are enough
+                ctx          //context of the calling thread, keeps g
+                hid          //0x03
+                IDR          //identification of the receiver, a C string
+                IDS          //identification of the sender
+                IDlen        //the length of IDS
+                message      //the message to be signcrypted
+                mlen         //the length of message
+                ks           //master private key
+                Ppub         //master public key [ks]P2, 128 bytes
+Output:
+                S, T, C      //as Signcrypt
+                tm           //wall time of each stage, may be NULL
+Return:
+                0: success
+                SM9_CTX_ERR: ctx belongs to another thread
+                SM9_L_error: l is zero
+                other: the error of SM9_pub_lines, SM9_sc_branch or SM9_H_final
+Others:         same S, T and C as Signcrypt for the same r
+****************************************************************/
+int Signcrypt_parallel(SM9_POOL *tp, SM9_CTX *ctx, unsigned char hid[], unsigned char *IDR, unsigned char *IDS,
+	int IDlen, unsigned char *message, size_t mlen, big ks, unsigned char Ppub[], unsigned char S[],
+	unsigned char T[], unsigned char C[], SM9_SC_TIMES *tm)
+{
+	SM9_SC_GRAPH job;
+	SM3_KDF_CTX kdf, hv;
+	ecap_lines *L;
+	big e, h, l, x, y;
+	epoint *D;
+	zzn12 w, w1;
+	int result[SM9_SC_BRANCHES];
+	double t0, t1 = 0, t2 = 0;
+	int mark, i, buf;
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	t0 = SM9_wall_time();
+	mark = SM9_arena_mark();
+	e = SM9_tmp();
+	h = SM9_tmp();
+	l = SM9_tmp();
+	x = SM9_tmp();
+	y = SM9_tmp();
+	job.r = SM9_tmp();
+	job.r0 = SM9_tmp();
+	job.r1 = SM9_tmp();
+
+	//A0: g=e(P1,Ppub), kept in the context
+	buf = SM9_pub_lines(ctx, Ppub, &L, &job.g);
+	if (buf == 0)
+	{
+		//A2: r, then r=r0+r1*6t^2 with 0<=r0<6t^2
+		do
+			strong_bigrand(&ctx->rng, N, job.r);
+		while (size(job.r) == 0);
+		multiply(para_t, para_t, e);
+		premult(e, 6, e);
+		copy(job.r, job.r0);
+		divide(job.r0, e, job.r1);
+		job.ks = ks;
+		job.hid = hid;
+		job.IDR = IDR;
+		job.IDS = IDS;
+		job.IDlen = IDlen;
+		job.T = T;
+
+		t1 = SM9_wall_time();
+		SM9_pool_calc(tp, SM9_sc_branch, &job, SM9_SC_BRANCHES, result);
+		t2 = SM9_wall_time();
+		buf = SM9_pool_status(result, SM9_SC_BRANCHES);
+	}
+	if (buf == 0)
+	{
+		//A3: w=g^r0*(g^p)^r1
+		zzn12_tmp(&w);
+		zzn12_tmp(&w1);
+		bytes384_to_zzn12(job.w[0], &w);
+		bytes384_to_zzn12(job.w[1], &w1);
+		zzn12_mul(w, w1, &w);
+		zzn12_to_bytes384(w, job.w[0]);
+
+		//A4, A8: as in Signcrypt
+		SM3_KDF_init(&kdf);
+		SM3_KDF_absorb(&kdf, T, BNLEN * 2);
+		SM3_KDF_absorb(&kdf, job.w[0], BNLEN * 12);
+		SM3_KDF_absorb(&kdf, IDR, strlen((char *)IDR));
+		SM9_H_init(&hv, 0x02);
+		if (mlen >= SM9_DEM_THRESHOLD)
+			SM9_DEM_encrypt(&kdf, &hv, message, mlen, C);
+		else
+			SM3_KDF_xor(&kdf, &hv, message, C, mlen, 0);
+		SM3_KDF_absorb(&hv, job.w[0], BNLEN * 12);
+		buf = SM9_H_final(&hv, N, h);
+	}
+	if (buf == 0)
+	{
+		//A5: l=(r-h)mod N
+		subtract(job.r, h, l);
+		if (size(l) < 0)
+			add(l, N, l);
+		if (size(l) == 0)
+			buf = SM9_L_error;
+	}
+	if (buf == 0)
+	{
+		//A6: S=[l]dSA
+		D = epoint_init();
+		bytes_to_big(BNLEN, job.dSA, x);
+		bytes_to_big(BNLEN, job.dSA + BNLEN, y);
+		epoint_set(x, y, 0, D);
+		SM9_G1_mul_glv(l, D, D);
+		epoint_get(D, x, y);
+		big_to_bytes(BNLEN, x, S, 1);
+		big_to_bytes(BNLEN, y, S + BNLEN, 1);
+		epoint_free(D);
+	}
+	if (!SM9_arena_release(mark) && buf == 0)
+		buf = SM9_ASK_MEMORY_ERR;
+
+	if (buf == 0 && tm != NULL)
+	{
+		tm->head = t1 - t0;
+		for (i = 0; i < SM9_SC_BRANCHES; i++)
+			tm->branch[i] = job.t[i];
+		tm->join = t2 - t1;
+		tm->total = SM9_wall_time() - t0;
+		tm->tail = tm->total - (t2 - t0);
+	}
+	memset(&job, 0, sizeof(SM9_SC_GRAPH));
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_pool_latency
+Description:    Signcrypt_parallel to the receiver of key on pools of 1, 2, 4
+                threads, up to SM9_SC_BRANCHES and the number of processors,
+                and print the stage times of the fastest of SM9_POOL_LATENCY_RUNS
+                runs with the speedup of the whole over one thread
+Calls:          SM9_pool_init,SM9_pool_free,Signcrypt_parallel,Unsigncrypt_key,
+                SM9_cpu_count
+Called By:      SM9_Bench
+Input:
+                ctx          //context of the calling thread
+                key          //made by SM9_recv_key_init
+                hid          //0x03
+                IDS          //identification of the sender, a C string
+                message, mlen
+                ks, Ppub     //master key pair
+Output:
+                NULL
+Return:
+                0: every run succeeded and gave back the message
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_DATA_MEMCMP_ERR: M' is not the message
+                other: the error of Signcrypt_parallel or Unsigncrypt_key
+Others:         every ciphertext is unsigncrypted, out of the times
+****************************************************************/
+int SM9_pool_latency(SM9_CTX *ctx, SM9_RECV_KEY *key, unsigned char hid[], unsigned char *IDS,
+	unsigned char *message, size_t mlen, big ks, unsigned char Ppub[])
+{
+	SM9_SC_TIMES tm, best, base;
+	SM9_UNSC_ITEM it;
+	SM9_POOL tp;
+	unsigned char *mem;
+	size_t clen = SM9_C_LEN(mlen);
+	int IDlen = strlen((char *)IDS), ncpu, nthr, i, k, buf = 0;
+
+	mem = (unsigned char *)malloc(BNLEN * 4 + clen + mlen);
+	if (mem == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	it.IDS = IDS;
+	it.mlen = mlen;
+	it.S = mem;
+	it.T = it.S + BNLEN * 2;
+	it.C = it.T + BNLEN * 2;
+	it.M = it.C + clen;
+
+	printf("\n threads    head    g^r0 (g^p)^r1      T     dSA    join    tail   total   speedup (ms, latency against 1 thread)\n");
+	ncpu = SM9_cpu_count();
+	if (ncpu > SM9_SC_BRANCHES)
+		ncpu = SM9_SC_BRANCHES;
+	for (nthr = 1; buf == 0; nthr = nthr * 2 < ncpu ? nthr * 2 : ncpu)
+	{
+		SM9_pool_init(&tp, nthr - 1);
+		for (i = 0; buf == 0 && i < SM9_POOL_LATENCY_RUNS; i++)
+		{
+			buf = Signcrypt_parallel(&tp, ctx, hid, key->IDR, IDS, IDlen, message, mlen, ks, Ppub,
+				it.S, it.T, it.C, &tm);
+			if (buf == 0)
+				buf = Unsigncrypt_key(ctx, key, &it);
+			if (buf == 0 && memcmp(it.M, message, mlen) != 0)
+				buf = SM9_DATA_MEMCMP_ERR;
+			if (buf == 0 && (i == 0 || tm.total < best.total))
+				best = tm;
+		}
+		if (buf == 0)
+		{
+			if (nthr == 1)
+				base = best;
+			printf("%8d %7.2f", tp.nlive + 1, best.head * 1e3);
+			for (k = 0; k < SM9_SC_BRANCHES; k++)
+				printf(" %7.2f", best.branch[k] * 1e3);
+			printf(" %7.2f %7.2f %7.2f  %5.2fx\n", best.join * 1e3, best.tail * 1e3, best.total * 1e3,
+				base.total / best.total);
+		}
+		SM9_pool_free(&tp);
+		if (nthr == ncpu)
+			break;
+	}
+
+	free(mem);
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_pair_cut
+Description:    cut the bits nb-2..0 of n into at most nseg segments of about
+                the same cost, counting one for a squaring and one for a line:
+                a bit costs its squaring and one or two lines, and a segment
+                also pays one squaring for each bit below it
+Calls:          MIRACL functions
+Called By:      SM9_ecap_pool
+Input:
+                n, nb        //from ecap_loop
+                nseg
+Output:
+                hi, lo       //bits hi[s]..lo[s] of each segment, segment 0 ends at bit 0
+Return:
+                the number of segments
+Others:         the smallest cost that fits in nseg segments is searched, the
+                loop has less than 100 bits
+****************************************************************/
+static int SM9_pair_cut(big n, int nb, int nseg, int hi[], int lo[])
+{
+	int K, c, i, s;
+
+	for (K = 1;; K++)
+	{
+		for (i = 0, s = 0; i <= nb - 2 && s < nseg; s++)
+		{
+			lo[s] = i;
+			for (c = i; i <= nb - 2 && c + 2 + mr_testbit(n, i) <= K; i++)
+				c += 2 + mr_testbit(n, i);
+			if (i == lo[s])
+				break;
+			hi[s] = i - 1;
+		}
+		if (i > nb - 2)
+			return s;
+	}
+}
+
+/****************************************************************
+Function:       SM9_pair_miller
+Description:    segment i of the Miller loop of SM9_ecap_pool
+Calls:          ecap_miller_seg
+Called By:      SM9_pool_calc
+Input:
+                arg          //SM9_PAIR_JOB
+                i
+Output:
+                job->f[i]
+Return:
+                0: success
+                SM9_MY_ECAP_12A_ERR: can not get memory
+Others:
+****************************************************************/
+static int SM9_pair_miller(void *arg, int i)
+{
+	SM9_PAIR_JOB *job = (SM9_PAIR_JOB *)arg;
+
+	if (!ecap_miller_seg(job->m, job->L, job->Q, para_t, job->hi[i], job->lo[i], &job->f[i]))
+		return SM9_MY_ECAP_12A_ERR;
+	return 0;
+}
+
+/****************************************************************
+Function:       SM9_pair_pow
+Description:    item i of a power of -x: 0 is e^|x| and 1, with the first power
+                only, the Frobenius branch of e
+Calls:          zzn12_copy,zzn12_pow,final_exp_frob,
+                SM9_arena_mark,SM9_arena_release
+Called By:      SM9_pool_calc
+Input:
+                arg          //SM9_PAIR_JOB
+                i
+Output:
+                job->f[i]
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: the arena ran out
+Others:         e^|x| is not cut: its squarings are one chain whatever the split,
+                a half e^k0*(e^(2^w))^k1 on a second thread still waits for the
+                w squarings of e^(2^w)
+****************************************************************/
+static int SM9_pair_pow(void *arg, int i)
+{
+	SM9_PAIR_JOB *job = (SM9_PAIR_JOB *)arg;
+	zzn12 y;
+	int mark;
+
+	mark = SM9_arena_mark();
+	if (i == 1)
+		final_exp_frob(job->e, X, &job->f[1]);
+	else
+	{
+		y = zzn12_pow(job->e, job->k);
+		zzn12_copy(&y, &job->f[0]);
+	}
+	return SM9_arena_release(mark) ? 0 : SM9_ASK_MEMORY_ERR;
+}
+
+/****************************************************************
+Function:       SM9_pair_round
+Description:    t=e^(-x) in the calling thread, with the Frobenius branch of e
+                on a second one when x0 is not NULL
+Calls:          SM9_pool_calc,SM9_pool_status,zzn12_inverse,
+                zzn12_copy,SM9_arena_mark,SM9_arena_release
+Called By:      SM9_ecap_pool
+Input:
+                tp           //as SM9_pool_calc
+                job          //k set
+                e            //unitary
+Output:
+                t, x0        //already initiated
+Return:
+                0: success
+                other: the error of an item
+Others:
+****************************************************************/
+static int SM9_pair_round(SM9_POOL *tp, SM9_PAIR_JOB *job, zzn12 e, zzn12 *t, zzn12 *x0)
+{
+	zzn12 y;
+	int result[2], n = x0 != NULL ? 2 : 1, mark, buf;
+
+	job->e = e;
+	SM9_pool_calc(n > 1 ? tp : NULL, SM9_pair_pow, job, n, result);
+	buf = SM9_pool_status(result, n);
+	if (buf != 0)
+		return buf;
+	mark = SM9_arena_mark();
+	zzn12_copy(&job->f[0], t);
+	if (size(para_t) > 0)
+	{
+		y = zzn12_inverse(*t); // just a conjugation!
+		zzn12_copy(&y, t);
+	}
+	if (x0 != NULL)
+		zzn12_copy(&job->f[1], x0);
+	return SM9_arena_release(mark) ? 0 : SM9_ASK_MEMORY_ERR;
+}
+
+/****************************************************************
+Function:       SM9_ecap_pool
+Description:    ecap_multi for the latency of one pairing. The Miller loop is
+                cut by SM9_pair_cut into one segment per thread of tp, each one
+                made by ecap_miller_seg, and their product gets the two last
+                lines. In the final exponentiation the three powers of -x form
+                a chain of squarings that no thread can shorten, only the
+                Frobenius branch runs next to the first one.
+Calls:          MIRACL functions,ecap_loop,ecap_miller_end,final_exp_easy,
+                final_exp_hard,SM9_pair_cut,SM9_pair_round,SM9_pool_calc,
+                SM9_pool_status,zzn12_tmp,zzn12_mul,zzn12_copy,SM9_arena_mark,
+                SM9_tmp,SM9_arena_release,SM9_wall_time
+Called By:      SM9_pool_pairing,SM9_SelfCheck
+Input:
+                tp           //NULL or a pool without worker: all in the calling thread
+                ctx          //context of the calling thread
+                m, L, Q      //as ecap_multi, the Q_j are normalized here
+Output:
+                r            //already initiated
+                tm           //wall time of each stage, may be NULL
+Return:
+                FALSE: calculation error
+                TRUE: correct calculation
+Others:         same r as ecap_multi(m,L,Q,para_t,X,r)
+****************************************************************/
+BOOL SM9_ecap_pool(SM9_POOL *tp, SM9_CTX *ctx, int m, ecap_lines *L[], epoint *Q[], zzn12 *r,
+	SM9_PAIR_TIMES *tm)
+{
+	SM9_PAIR_JOB job;
+	big n;
+	zzn12 res, e, x0, x4, x2, t0;
+	int result[SM9_PAIR_SEGMENTS];
+	double t[7] = { 0 };
+	int nseg, nb, i, mark, buf;
+
+	t[0] = SM9_wall_time();
+	mark = SM9_arena_mark();
+	n = SM9_tmp();
+	job.k = SM9_tmp();
+	zzn12_tmp(&res);
+	zzn12_tmp(&e);
+	zzn12_tmp(&x0);
+	zzn12_tmp(&x4);
+	zzn12_tmp(&x2);
+	zzn12_tmp(&t0);
+	for (i = 0; i < SM9_PAIR_SEGMENTS; i++)
+		zzn12_tmp(&job.f[i]);
+	//the threads only read the Q_j
+	for (i = 0; i < m; i++)
+		if (!point_at_infinity(Q[i]))
+			epoint_norm(Q[i]);
+	job.m = m;
+	job.L = L;
+	job.Q = Q;
+
+	//the Miller loop, one segment per thread
+	nb = ecap_loop(para_t, n);
+	nseg = tp == NULL ? 1 : tp->nlive + 1;
+	if (nseg > SM9_PAIR_SEGMENTS)
+		nseg = SM9_PAIR_SEGMENTS;
+	nseg = SM9_pair_cut(n, nb, nseg, job.hi, job.lo);
+	SM9_pool_calc(tp, SM9_pair_miller, &job, nseg, result);
+	buf = SM9_pool_status(result, nseg);
+	if (buf == 0)
+	{
+		zzn12_copy(&job.f[0], &res);
+		for (i = 1; i < nseg; i++)
+			zzn12_mul(res, job.f[i], &res);
+		if (!ecap_miller_end(m, L, Q, &res))
+			buf = SM9_MY_ECAP_12A_ERR;
+		else if (zzn4_iszero(&res.a) && zzn4_iszero(&res.b) && zzn4_iszero(&res.c))
+			buf = SM9_MY_ECAP_12A_ERR;
+	}
+	t[1] = SM9_wall_time();
+
+	//the final exponentiation
+	if (buf == 0)
+	{
+		final_exp_easy(res, X, &e);
+		t[2] = SM9_wall_time();
+		copy(para_t, job.k);
+		if (size(job.k) < 0)
+			negify(job.k, job.k);
+		buf = SM9_pair_round(tp, &job, e, &x4, &x0);
+	}
+	t[3] = SM9_wall_time();
+	if (buf == 0)
+		buf = SM9_pair_round(tp, &job, x4, &x2, NULL);
+	t[4] = SM9_wall_time();
+	if (buf == 0)
+		buf = SM9_pair_round(tp, &job, x2, &t0, NULL);
+	t[5] = SM9_wall_time();
+	if (buf == 0)
+		final_exp_hard(e, x0, x4, x2, t0, X, r);
+	t[6] = SM9_wall_time();
+
+	if (!SM9_arena_release(mark))
+		buf = SM9_ASK_MEMORY_ERR;
+	if (buf == 0 && tm != NULL)
+	{
+		tm->miller = t[1] - t[0];
+		tm->easy = t[2] - t[1];
+		for (i = 0; i < 3; i++)
+			tm->pow[i] = t[i + 3] - t[i + 2];
+		tm->hard = t[6] - t[5];
+		tm->total = t[6] - t[0];
+	}
+	return buf == 0;
+}
+
+/****************************************************************
+Function:       SM9_pool_pairing
+Description:    g=e(P1,Ppub) with the lines of Ppub kept in ctx, by ecap_fixed
+                and by SM9_ecap_pool on pools of 1, 2, 4 threads up to
+                SM9_PAIR_SEGMENTS and the number of processors, and print the
+                stage times of the fastest of SM9_POOL_PAIR_RUNS runs with the
+                speedup of the whole over ecap_fixed
+Calls:          SM9_pub_lines,ecap_fixed,SM9_pool_init,SM9_pool_free,
+                SM9_ecap_pool,zzn12_tmp,zzn12_to_bytes384,SM9_cpu_count,
+                SM9_wall_time,SM9_arena_mark,SM9_arena_release
+Called By:      SM9_Bench
+Input:
+                ctx          //context of the calling thread
+                Ppub         //master public key [ks]P2, 128 bytes
+Output:
+                NULL
+Return:
+                0: every pairing gave g
+                SM9_MY_ECAP_12A_ERR: R-ate calculation error
+                SM9_DATA_MEMCMP_ERR: a pairing is not g
+                other: the error of SM9_pub_lines
+Others:
+****************************************************************/
+int SM9_pool_pairing(SM9_CTX *ctx, unsigned char Ppub[])
+{
+	SM9_PAIR_TIMES tm, best;
+	SM9_POOL tp;
+	ecap_lines *L;
+	epoint *Q[1];
+	zzn12 g, r;
+	unsigned char gb[BNLEN * 12], rb[BNLEN * 12];
+	double t0, base = 0;
+	int ncpu, nthr, i, k, mark, buf;
+
+	buf = SM9_pub_lines(ctx, Ppub, &L, &g);
+	if (buf != 0)
+		return buf;
+	mark = SM9_arena_mark();
+	zzn12_tmp(&r);
+	zzn12_to_bytes384(g, gb);
+	Q[0] = P1;
+
+	for (i = 0; buf == 0 && i < SM9_POOL_PAIR_RUNS; i++)
+	{
+		t0 = SM9_wall_time();
+		if (!ecap_fixed(L, P1, para_t, X, &r))
+			buf = SM9_MY_ECAP_12A_ERR;
+		t0 = SM9_wall_time() - t0;
+		if (i == 0 || t0 < base)
+			base = t0;
+	}
+	if (buf == 0)
+		printf("\n ecap_fixed %.2f ms\n threads  miller    easy  pow(-x)  pow(-x)  pow(-x)    hard   total   speedup (ms, against ecap_fixed)\n",
+			base * 1e3);
+
+	ncpu = SM9_cpu_count();
+	if (ncpu > SM9_PAIR_SEGMENTS)
+		ncpu = SM9_PAIR_SEGMENTS;
+	for (nthr = 1; buf == 0; nthr = nthr * 2 < ncpu ? nthr * 2 : ncpu)
+	{
+		SM9_pool_init(&tp, nthr - 1);
+		for (i = 0; buf == 0 && i < SM9_POOL_PAIR_RUNS; i++)
+		{
+			if (!SM9_ecap_pool(&tp, ctx, 1, &L, Q, &r, &tm))
+				buf = SM9_MY_ECAP_12A_ERR;
+			if (buf == 0)
+			{
+				zzn12_to_bytes384(r, rb);
+				if (memcmp(rb, gb, BNLEN * 12) != 0)
+					buf = SM9_DATA_MEMCMP_ERR;
+			}
+			if (buf == 0 && (i == 0 || tm.total < best.total))
+				best = tm;
+		}
+		if (buf == 0)
+		{
+			printf("%8d %7.2f %7.2f", tp.nlive + 1, best.miller * 1e3, best.easy * 1e3);
+			for (k = 0; k < 3; k++)
+				printf(" %8.2f", best.pow[k] * 1e3);
+			printf(" %7.2f %7.2f  %5.2fx\n", best.hard * 1e3, best.total * 1e3, base / best.total);
+		}
+		SM9_pool_free(&tp);
+		if (nthr == ncpu)
+			break;
+	}
+
+	SM9_arena_release(mark);
+	return buf;
+}
@@ -0,0 +1,151 @@
+/************************************************************************
+FileName:
+SM9_pool.h
+Version:
+SM9_POOL_V1.0
+Date:
+Oct 19,2026
+Description:
+A pool of worker threads for batches of independent SM9 operations. Each
+worker is pinned to one processor and keeps its own SM9_CTX, that is its own
+mip, arena and cache of Ppub, for the life of the pool, so a batch costs no
+mirsys. A batch of n items is cut into one chunk per thread, the calling
+thread included. A thread takes the items of its own chunk one at a time and,
+once its chunk is empty, takes the items left in the chunks of the others:
+a slow item or a processor busy with something else does not hold the whole
+batch back.
+Signcrypt_parallel uses the pool the other way round, for the latency of one
+signcryption: once r is drawn, g^r, T=[r]QB and dSA=[t2]P1 do not depend on
+each other, g^r is itself cut in two halves with the Frobenius, and the four
+branches run on four threads before the short sequential tail.
+SM9_ecap_pool does the same for one pairing with the lines of ecap_prep: the
+Miller loop is cut into segments, one per thread, whose values are multiplied
+at the end. The powers of -x of the final exponentiation stay whole, their
+squarings are one chain, and only the Frobenius branch runs next to the first.
+Function List:
+1.SM9_pool_init           //start the workers, each with its own context
+2.SM9_pool_free           //stop and join the workers
+3.SM9_pool_run            //func(ctx,arg,i) for i<n over the workers and the caller
+4.SM9_pool_calc           //calc(arg,i) for i<n over the workers and the caller
+5.SM9_signcrypt_batch     //Signcrypt_online of n messages
+6.SM9_unsigncrypt_batch   //Unsigncrypt_key of n ciphertexts, each one checked alone
+7.SM9_verify_batch        //Unsigncrypt_batch with its B1-B3 on the pool
+8.SM9_pool_bench          //throughput of the three batches against the number of threads
+9.Signcrypt_parallel      //one Signcrypt with its independent branches on the pool
+10.SM9_pool_latency       //stage times of Signcrypt_parallel against the number of threads
+11.SM9_ecap_pool          //ecap_multi with its Miller loop and final exponentiation on the pool
+12.SM9_pool_pairing       //stage times of SM9_ecap_pool against the number of threads
+Notes:
+Without MR_OS_THREADS, or with SM9_NO_THREADS, the pool has no worker and a
+batch runs in the calling thread. Make the pool after SM9_Init. A pool runs one
+batch at a time, for one calling thread at a time.
+************************************************************************/
+
+#ifndef HEADER_SM9_POOL_H
+#define HEADER_SM9_POOL_H
+
+#include "SM9_batch.h"
+#include "SM9_coupon.h"
+
+#define SM9_POOL_MAX_THREADS 64
+#define SM9_POOL_IDLE_SPINS 1000  //polls of an idle worker that only yield before it sleeps
+#define SM9_POOL_IDLE_MS 1        //then it waits this long between polls
+#define SM9_POOL_BENCH_ITEMS 32   //items of each batch of SM9_pool_bench
+#define SM9_SC_BRANCHES 4         //independent branches of Signcrypt_parallel
+#define SM9_POOL_LATENCY_RUNS 8   //runs of SM9_pool_latency for each number of threads, the fastest is kept
+#define SM9_PAIR_SEGMENTS 4       //most segments of the Miller loop of SM9_ecap_pool
+#define SM9_POOL_PAIR_RUNS 8      //runs of SM9_pool_pairing for each number of threads, the fastest is kept
+
+//one item of a batch, returns its status
+typedef int (*SM9_POOL_FUNC)(SM9_CTX *ctx, void *arg, int i);
+
+//one item that only needs the mip of its thread, returns its status
+typedef int (*SM9_POOL_CALC)(void *arg, int i);
+
+//the items [next,end) of one thread not taken yet, one cache line each
+typedef struct
+{
+	SM9_ATOMIC next;
+	long end;
+	char pad[64 - sizeof(SM9_ATOMIC) - sizeof(long)];
+} SM9_POOL_CHUNK;
+
+typedef struct SM9_POOL_S SM9_POOL;
+
+typedef struct
+{
+	SM9_POOL *tp;
+	int id;                       //its chunk, chunk 0 is the one of the calling thread
+	int cpu;                      //processor it is pinned to, -1 when it is not
+	SM9_THREAD th;
+	SM9_ATOMIC state;             //0 starting, 1 waiting for batches, 2 could not make its context
+} SM9_POOL_WORKER;
+
+struct SM9_POOL_S
+{
+	int nworkers;                 //workers started
+	int nlive;                    //workers that made their context
+	int nchunks;                  //nworkers + 1
+	SM9_POOL_WORKER w[SM9_POOL_MAX_THREADS];
+	SM9_POOL_CHUNK chunk[SM9_POOL_MAX_THREADS + 1];
+	SM9_POOL_FUNC func;           //the current batch, func or calc
+	SM9_POOL_CALC calc;
+	void *arg;
+	int *result;
+	SM9_ATOMIC gen;               //number of the current batch, the workers start when it moves
+	SM9_ATOMIC busy;              //workers not done with the current batch
+	SM9_ATOMIC stop;
+	SM9_ATOMIC steals;            //items done by another thread than the one of their chunk
+};
+
+//one message of SM9_signcrypt_batch
+typedef struct
+{
+	unsigned char *IDR;           //identification of the receiver, a C string
+	unsigned char *message;
+	size_t mlen;                  //the length of message
+	unsigned char *S, *T, *C;     //written: 64, 64 and SM9_C_LEN(mlen) bytes
+} SM9_SC_ITEM;
+
+//wall time of the stages of one Signcrypt_parallel, in seconds
+typedef struct
+{
+	double head;                  //A0 and A2: g from the context, r cut into r0+r1*6t^2
+	double branch[SM9_SC_BRANCHES]; //g^r0, (g^p)^r1, T=[r]QB and dSA=[t2]P1, each in one thread
+	double join;                  //from the start of the branches until the last one is done
+	double tail;                  //w=g^r0*(g^p)^r1, A4, A8, A5 and A6: S=[l]dSA
+	double total;
+} SM9_SC_TIMES;
+
+//wall time of the stages of one SM9_ecap_pool, in seconds
+typedef struct
+{
+	double miller;                //the segments, their product and the two last lines
+	double easy;                  //final_exp_easy
+	double pow[3];                //res^(-x), x4^(-x) and x2^(-x), the first one with the Frobenius branch
+	double hard;                  //final_exp_hard
+	double total;
+} SM9_PAIR_TIMES;
+
+int SM9_pool_init(SM9_POOL *tp, int nthreads);
+void SM9_pool_free(SM9_POOL *tp);
+void SM9_pool_run(SM9_POOL *tp, SM9_CTX *ctx, SM9_POOL_FUNC func, void *arg, int n, int result[]);
+void SM9_pool_calc(SM9_POOL *tp, SM9_POOL_CALC calc, void *arg, int n, int result[]);
+int SM9_signcrypt_batch(SM9_POOL *tp, SM9_CTX *ctx, SM9_COUPON_POOL *pool, unsigned char hid[],
+	SM9_SC_ITEM items[], int n, int result[]);
+int SM9_unsigncrypt_batch(SM9_POOL *tp, SM9_CTX *ctx, SM9_RECV_KEY *key, SM9_UNSC_ITEM items[], int n,
+	int result[]);
+int SM9_verify_batch(SM9_POOL *tp, SM9_CTX *ctx, SM9_RECV_KEY *key, SM9_UNSC_ITEM items[], int n,
+	int result[]);
+int SM9_pool_bench(SM9_CTX *ctx, SM9_COUPON_POOL *pool, SM9_RECV_KEY *key, unsigned char hid[],
+	unsigned char *IDS, unsigned char *message, size_t mlen);
+int Signcrypt_parallel(SM9_POOL *tp, SM9_CTX *ctx, unsigned char hid[], unsigned char *IDR, unsigned char *IDS,
+	int IDlen, unsigned char *message, size_t mlen, big ks, unsigned char Ppub[], unsigned char S[],
+	unsigned char T[], unsigned char C[], SM9_SC_TIMES *tm);
+int SM9_pool_latency(SM9_CTX *ctx, SM9_RECV_KEY *key, unsigned char hid[], unsigned char *IDS,
+	unsigned char *message, size_t mlen, big ks, unsigned char Ppub[]);
+BOOL SM9_ecap_pool(SM9_POOL *tp, SM9_CTX *ctx, int m, ecap_lines *L[], epoint *Q[], zzn12 *r,
+	SM9_PAIR_TIMES *tm);
+int SM9_pool_pairing(SM9_CTX *ctx, unsigned char Ppub[]);
+
+#endif
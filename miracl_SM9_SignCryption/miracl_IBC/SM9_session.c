@@ -0,0 +1,454 @@
+/************************************************************************
+FileName:
+SM9_session.c
+Version:
+SM9_SESSION_V1.0
+Date:
+Oct 19,2026
+Description:
+Session mode after one signcrypted handshake, see SM9_session.h
+Function List:
+1.SM9_session_epoch       //keys of the next epoch, the chain key moves on
+2.SM9_session_ctr         //SM4-CTR of the HMAC mode
+3.SM9_session_hmac        //HMAC-SM3 from the precomputed pad states
+4.SM9_session_init        //session key from the T, w, IDR and IDS of a handshake
+5.SM9_session_open        //sender: signcrypt the handshake and start the session
+6.SM9_session_accept      //receiver: unsigncrypt the handshake and start the session
+7.SM9_session_limits      //when to rekey
+8.SM9_session_seal        //protect one record
+9.SM9_session_unseal      //check and decrypt one record
+10.SM9_session_free       //wipe the keys
+Notes:
+Epoch keys: K||salt||Kmac = KDF(ck||0x01, 52), then ck = KDF(ck||0x02, 32).
+A record nonce is salt||seq, seq starts from 0 in every epoch.
+An SM9_SESSION is used by one thread at a time.
+************************************************************************/
+
+#include <string.h>
+#include "SM9_session.h"
+
+static const unsigned char SM9_session_label[] = "SM9 session";
+
+/****************************************************************
+Function:       SM9_session_epoch
+Description:    derive the keys of the epoch sess->epoch from the chain key,
+                replace the chain key by the next one and restart the sequence
+Calls:          SM3_KDF,SM4_gcm_init,SM4_set_key,SM3_init,SM3_process
+Called By:      SM9_session_init,SM9_session_seal,SM9_session_unseal
+Input:
+                sess
+Output:
+                sess
+Return:
+                NULL
+Others:
+****************************************************************/
+static void SM9_session_epoch(SM9_SESSION *sess)
+{
+	unsigned char Z[33], K[SM4_KEY_LEN + 4 + SM9_SESSION_HMAC_LEN], pad[64];
+	int i;
+
+	memcpy(Z, sess->ck, 32);
+	Z[32] = 0x01;
+	SM3_KDF(Z, sizeof(Z), sizeof(K), K);
+	Z[32] = 0x02;
+	SM3_KDF(Z, sizeof(Z), 32, sess->ck);
+
+	memcpy(sess->salt, K + SM4_KEY_LEN, 4);
+	if (sess->mode == SM9_SESSION_GCM)
+		SM4_gcm_init(&sess->gcm, K, sess->salt, 4); //the IV is set again for every record
+	else
+	{
+		SM4_set_key(K, &sess->ks);
+		memset(pad, 0, sizeof(pad));
+		memcpy(pad, K + SM4_KEY_LEN + 4, SM9_SESSION_HMAC_LEN);
+		for (i = 0; i < 64; i++)
+			pad[i] ^= 0x36;
+		SM3_init(&sess->hin);
+		SM3_process(&sess->hin, pad, 64);
+		for (i = 0; i < 64; i++)
+			pad[i] ^= 0x36 ^ 0x5c;
+		SM3_init(&sess->hout);
+		SM3_process(&sess->hout, pad, 64);
+	}
+	sess->seq = 0;
+	sess->seen = 0;
+	sess->since = time(NULL);
+
+	memset(Z, 0, sizeof(Z));
+	memset(K, 0, sizeof(K));
+	memset(pad, 0, sizeof(pad));
+}
+
+/****************************************************************
+Function:       SM9_session_ctr
+Description:    out = in XOR SM4-CTR key stream, counter blocks nonce||ct from ct = 0
+Calls:          SM4_ctr32_encrypt_blocks
+Called By:      SM9_session_seal,SM9_session_unseal
+Input:
+                ks           //SM4 key of the epoch
+                nonce        //salt||seq, 12 bytes
+                in
+                len
+Output:
+                out
+Return:
+                NULL
+Others:         in and out may be the same buffer
+****************************************************************/
+static void SM9_session_ctr(const SM4_KEY *ks, const unsigned char nonce[], const unsigned char *in,
+	unsigned char *out, size_t len)
+{
+	unsigned char ctr[16], ek[16];
+	size_t n = len / 16, i;
+
+	memcpy(ctr, nonce, SM4_GCM_IV_LEN);
+	memset(ctr + SM4_GCM_IV_LEN, 0, 4);
+	SM4_ctr32_encrypt_blocks(ks, in, out, n, ctr);
+	if (len % 16)
+	{
+		memset(ek, 0, 16);
+		SM4_ctr32_encrypt_blocks(ks, ek, ek, 1, ctr);
+		for (i = 0; i < len % 16; i++)
+			out[n * 16 + i] = in[n * 16 + i] ^ ek[i];
+		memset(ek, 0, 16);
+	}
+}
+
+/****************************************************************
+Function:       SM9_session_hmac
+Description:    HMAC-SM3 of data, resumed from the states that have absorbed
+                the inner and the outer pad, so a record costs no key setup
+Calls:          SM3_process,SM3_done
+Called By:      SM9_session_seal,SM9_session_unseal
+Input:
+                sess
+                data
+                len
+Output:
+                tag          //32 bytes
+Return:
+                NULL
+Others:
+****************************************************************/
+static void SM9_session_hmac(const SM9_SESSION *sess, const unsigned char *data, size_t len, unsigned char tag[])
+{
+	SM3_STATE md;
+	unsigned char inner[32];
+
+	md = sess->hin;
+	SM3_process(&md, (unsigned char *)data, len);
+	SM3_done(&md, inner);
+	md = sess->hout;
+	SM3_process(&md, inner, 32);
+	SM3_done(&md, tag);
+	memset(&md, 0, sizeof(md));
+}
+
+/****************************************************************
+Function:       SM9_session_init
+Description:    start a session from the handshake: the chain key is
+                KDF(T||w||IDR||IDS||"SM9 session",32), then the keys of epoch 0.
+                Rekeying is set to SM9_SESSION_MAX_RECORDS records or
+                SM9_SESSION_MAX_SECS seconds.
+Calls:          SM3_KDF_init,SM3_KDF_absorb,SM3_KDF_squeeze,SM9_session_epoch
+Called By:      SM9_session_open,SM9_session_accept
+Input:
+                mode         //SM9_SESSION_GCM or SM9_SESSION_HMAC
+                T            //T of the handshake, 64 bytes
+                w            //zzn12_to_bytes384 of w of the handshake
+                IDR          //identification of the receiver
+                IDS          //identification of the sender
+Output:
+                sess
+Return:
+                NULL
+Others:
+****************************************************************/
+void SM9_session_init(SM9_SESSION *sess, int mode, unsigned char T[], unsigned char w[], unsigned char *IDR,
+	unsigned char *IDS)
+{
+	SM3_KDF_CTX kdf;
+
+	memset(sess, 0, sizeof(SM9_SESSION));
+	sess->mode = mode;
+	sess->max_records = SM9_SESSION_MAX_RECORDS;
+	sess->max_secs = SM9_SESSION_MAX_SECS;
+
+	SM3_KDF_init(&kdf);
+	SM3_KDF_absorb(&kdf, T, BNLEN * 2);
+	SM3_KDF_absorb(&kdf, w, BNLEN * 12);
+	SM3_KDF_absorb(&kdf, IDR, strlen((char *)IDR));
+	SM3_KDF_absorb(&kdf, IDS, strlen((char *)IDS));
+	SM3_KDF_absorb(&kdf, SM9_session_label, sizeof(SM9_session_label) - 1);
+	SM3_KDF_squeeze(&kdf, sess->ck, 32);
+	memset(&kdf, 0, sizeof(kdf));
+
+	SM9_session_epoch(sess);
+}
+
+/****************************************************************
+Function:       SM9_session_open
+Description:    sender side: signcrypt the handshake message with a coupon of
+                the pool, then start the session from its T and w
+Calls:          SM9_coupon_get,SM9_coupon_make,Signcrypt_coupon,SM9_session_init
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                mode         //SM9_SESSION_GCM or SM9_SESSION_HMAC
+                pool         //made by SM9_coupon_pool_init for the sender
+                hid          //0x03
+                IDR          //identification of the receiver
+                IDS          //identification of the sender, the identity of the pool
+                message      //the handshake message
+                mlen         //the length of message
+Output:
+                sess
+                S, T, C      //the handshake, as from Signcrypt_online
+Return:
+                as SM9_coupon_make and Signcrypt_coupon
+Others:
+****************************************************************/
+int SM9_session_open(SM9_CTX *ctx, SM9_SESSION *sess, int mode, SM9_COUPON_POOL *pool, unsigned char hid[],
+	unsigned char *IDR, unsigned char *IDS, unsigned char *message, size_t mlen, unsigned char S[], unsigned char T[],
+	unsigned char C[])
+{
+	SM9_COUPON cp;
+	int buf = 0;
+
+	if (SM9_coupon_get(pool, &cp) != 0)
+		buf = SM9_coupon_make(ctx, pool, &cp);
+	if (buf == 0)
+		buf = Signcrypt_coupon(ctx, pool, &cp, hid, IDR, message, mlen, S, T, C);
+	if (buf == 0)
+		SM9_session_init(sess, mode, T, cp.w, IDR, IDS);
+	memset(&cp, 0, sizeof(SM9_COUPON));
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_session_accept
+Description:    receiver side: unsigncrypt the handshake, then start the
+                session from the w' that the check of S against IDS has passed
+Calls:          Unsigncrypt_w,SM9_session_init
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                mode         //SM9_SESSION_GCM or SM9_SESSION_HMAC
+                hid          //0x03
+                IDR          //identification of the receiver
+                IDS          //identification of the sender
+                S, T, C      //the handshake
+                mlen         //the length of the handshake message
+                deR          //private key of IDR, 128 bytes
+                Ppub         //master public key
+Output:
+                sess         //not started on error
+                M            //the handshake message, mlen bytes, zeroed on error
+Return:
+                as Unsigncrypt_w
+Others:         no session key is derived from a handshake that does not verify
+****************************************************************/
+int SM9_session_accept(SM9_CTX *ctx, SM9_SESSION *sess, int mode, unsigned char hid[], unsigned char *IDR,
+	unsigned char *IDS, unsigned char S[], unsigned char T[], unsigned char C[], size_t mlen,
+	unsigned char deR[], unsigned char Ppub[], unsigned char M[])
+{
+	unsigned char wb[BNLEN * 12];
+	int buf;
+
+	buf = Unsigncrypt_w(ctx, hid, IDR, IDS, strlen((char *)IDS), NULL, mlen, S, T, C, deR, NULL, Ppub, M, wb);
+	if (buf == 0)
+		SM9_session_init(sess, mode, T, wb, IDR, IDS);
+	memset(wb, 0, sizeof(wb));
+	return buf;
+}
+
+/****************************************************************
+Function:       SM9_session_limits
+Description:    rekey after max_records records or max_secs seconds of an
+                epoch, whichever comes first
+Calls:
+Called By:
+Input:
+                max_records  //0 for no limit by count
+                max_secs     //0 for no limit by time
+Output:
+                sess
+Return:
+                NULL
+Others:         only the sender rekeys, the receiver follows the epoch of the records
+****************************************************************/
+void SM9_session_limits(SM9_SESSION *sess, uint64_t max_records, long max_secs)
+{
+	sess->max_records = max_records;
+	sess->max_secs = max_secs;
+}
+
+/****************************************************************
+Function:       SM9_session_seal
+Description:    out = epoch||seq||C||tag, C and tag by SM4-GCM with the header
+                as AAD, or by SM4-CTR and HMAC-SM3 of header||C. A new epoch
+                starts first when the limits of the current one are reached.
+Calls:          SM9_session_epoch,SM4_gcm_setiv,SM4_gcm_aad,SM4_gcm_encrypt,
+                SM4_gcm_tag,SM9_session_ctr,SM9_session_hmac
+Called By:      SM9_SelfCheck
+Input:
+                sess         //sender side
+                M            //the record
+                mlen         //the length of M
+Output:
+                out          //SM9_SESSION_RECORD_LEN(mode,mlen) bytes
+                sess
+Return:
+                NULL
+Others:
+****************************************************************/
+void SM9_session_seal(SM9_SESSION *sess, const unsigned char M[], size_t mlen, unsigned char out[])
+{
+	unsigned char nonce[SM4_GCM_IV_LEN];
+
+	if ((sess->max_records && sess->seq >= sess->max_records) ||
+		(sess->max_secs && difftime(time(NULL), sess->since) >= sess->max_secs))
+	{
+		sess->epoch++;
+		SM9_session_epoch(sess);
+	}
+
+	SM3_STORE32(out, sess->epoch);
+	SM3_STORE32(out + 4, (uint32_t)(sess->seq >> 32));
+	SM3_STORE32(out + 8, (uint32_t)sess->seq);
+	memcpy(nonce, sess->salt, 4);
+	memcpy(nonce + 4, out + 4, 8);
+	if (sess->mode == SM9_SESSION_GCM)
+	{
+		SM4_gcm_setiv(&sess->gcm, nonce, SM4_GCM_IV_LEN);
+		SM4_gcm_aad(&sess->gcm, out, SM9_SESSION_HDR_LEN);
+		SM4_gcm_encrypt(&sess->gcm, M, out + SM9_SESSION_HDR_LEN, mlen);
+		SM4_gcm_tag(&sess->gcm, out + SM9_SESSION_HDR_LEN + mlen);
+	}
+	else
+	{
+		SM9_session_ctr(&sess->ks, nonce, M, out + SM9_SESSION_HDR_LEN, mlen);
+		SM9_session_hmac(sess, out, SM9_SESSION_HDR_LEN + mlen, out + SM9_SESSION_HDR_LEN + mlen);
+	}
+	sess->seq++;
+}
+
+/****************************************************************
+Function:       SM9_session_unseal
+Description:    check and decrypt a record of SM9_session_seal. A record of a
+                later epoch brings the keys forward, they are kept only when
+                its tag is right. Records of past epochs, records received
+                before and records older than the window are refused.
+Calls:          SM9_session_epoch,SM4_gcm_setiv,SM4_gcm_aad,SM4_gcm_decrypt,
+                SM4_gcm_tag,SM9_session_ctr,SM9_session_hmac
+Called By:      SM9_SelfCheck
+Input:
+                sess         //receiver side
+                in           //the record
+                inlen        //the length of in
+Output:
+                M            //inlen - SM9_SESSION_RECORD_LEN(mode,0) bytes
+                mlen         //the length of M
+                sess
+Return:
+                0: success
+                SM9_SESSION_AUTH_ERR: the record is too short or its tag is wrong,
+                    M is wiped
+                SM9_SESSION_REPLAY_ERR: the record is a replay or too old
+Others:         M may be in + SM9_SESSION_HDR_LEN
+****************************************************************/
+int SM9_session_unseal(SM9_SESSION *sess, const unsigned char in[], size_t inlen, unsigned char M[], size_t *mlen)
+{
+	SM9_SESSION next, *cur = sess;
+	unsigned char nonce[SM4_GCM_IV_LEN], tag[SM9_SESSION_HMAC_LEN], dif = 0;
+	size_t len, tlen = SM9_SESSION_TAG_LEN(sess->mode), i;
+	uint32_t epoch;
+	uint64_t seq, off;
+
+	if (inlen < SM9_SESSION_HDR_LEN + tlen)
+		return SM9_SESSION_AUTH_ERR;
+	len = inlen - SM9_SESSION_HDR_LEN - tlen;
+	epoch = SM3_LOAD32(in);
+	seq = (uint64_t)SM3_LOAD32(in + 4) << 32 | SM3_LOAD32(in + 8);
+	if (epoch < sess->epoch)
+		return SM9_SESSION_REPLAY_ERR;
+	if (epoch - sess->epoch > SM9_SESSION_MAX_SKIP)
+		return SM9_SESSION_AUTH_ERR;
+	if (epoch > sess->epoch)
+	{
+		next = *sess;
+		while (next.epoch < epoch)
+		{
+			next.epoch++;
+			SM9_session_epoch(&next);
+		}
+		cur = &next;
+	}
+	else if (seq < sess->seq)
+	{
+		off = sess->seq - 1 - seq;
+		if (off >= SM9_SESSION_WINDOW || (sess->seen >> off & 1))
+			return SM9_SESSION_REPLAY_ERR;
+	}
+
+	memcpy(nonce, cur->salt, 4);
+	memcpy(nonce + 4, in + 4, 8);
+	if (cur->mode == SM9_SESSION_GCM)
+	{
+		SM4_gcm_setiv(&cur->gcm, nonce, SM4_GCM_IV_LEN);
+		SM4_gcm_aad(&cur->gcm, in, SM9_SESSION_HDR_LEN);
+		SM4_gcm_decrypt(&cur->gcm, in + SM9_SESSION_HDR_LEN, M, len);
+		SM4_gcm_tag(&cur->gcm, tag);
+	}
+	else
+		SM9_session_hmac(cur, in, SM9_SESSION_HDR_LEN + len, tag);
+	for (i = 0; i < tlen; i++)
+		dif |= tag[i] ^ in[SM9_SESSION_HDR_LEN + len + i];
+	if (dif)
+	{
+		if (cur->mode == SM9_SESSION_GCM)
+			memset(M, 0, len);
+		if (cur == &next)
+			memset(&next, 0, sizeof(next));
+		return SM9_SESSION_AUTH_ERR;
+	}
+	if (cur->mode == SM9_SESSION_HMAC)
+		SM9_session_ctr(&cur->ks, nonce, in + SM9_SESSION_HDR_LEN, M, len);
+	if (cur == &next)
+	{
+		*sess = next;
+		memset(&next, 0, sizeof(next));
+	}
+
+	//sess->seq is one past the highest sequence number received
+	if (seq >= sess->seq)
+	{
+		off = seq + 1 - sess->seq;
+		sess->seen = off >= SM9_SESSION_WINDOW ? 0 : sess->seen << off;
+		sess->seen |= 1;
+		sess->seq = seq + 1;
+	}
+	else
+		sess->seen |= (uint64_t)1 << (sess->seq - 1 - seq);
+	*mlen = len;
+	return 0;
+}
+
+/****************************************************************
+Function:       SM9_session_free
+Description:    wipe the keys of a session
+Calls:
+Called By:      SM9_SelfCheck
+Input:
+                sess
+Output:
+                sess
+Return:
+                NULL
+Others:
+****************************************************************/
+void SM9_session_free(SM9_SESSION *sess)
+{
+	memset(sess, 0, sizeof(SM9_SESSION));
+}
@@ -0,0 +1,77 @@
+/************************************************************************
+FileName:
+SM9_session.h
+Version:
+SM9_SESSION_V1.0
+Date:
+Oct 19,2026
+Description:
+Session mode for steady traffic to one receiver. One signcrypted handshake
+gives both sides T and w, the session key is KDF(T||w||IDR||IDS||"SM9 session")
+and the records that follow are protected with symmetric crypto only:
+SM4-GCM, or SM4-CTR with HMAC-SM3. Each epoch has its own keys, the chain
+key moves on and the old one is wiped, after max_records records or
+max_secs seconds.
+Function List:
+1.SM9_session_init        //session key from the T, w, IDR and IDS of a handshake
+2.SM9_session_open        //sender: signcrypt the handshake and start the session
+3.SM9_session_accept      //receiver: unsigncrypt the handshake and start the session
+4.SM9_session_limits      //when to rekey
+5.SM9_session_seal        //protect one record
+6.SM9_session_unseal      //check and decrypt one record
+7.SM9_session_free        //wipe the keys
+Notes:
+A session goes one way, from the signcrypter to the receiver, answers need
+a handshake of their own. A record is epoch(4)||seq(8)||C||tag, the header
+is authenticated. The receiver takes the epochs forward only and keeps a
+window of SM9_SESSION_WINDOW sequence numbers against replays.
+************************************************************************/
+
+#ifndef HEADER_SM9_SESSION_H
+#define HEADER_SM9_SESSION_H
+
+#include <time.h>
+#include "SM9_coupon.h"
+
+#define SM9_SESSION_GCM 0         //SM4-GCM records
+#define SM9_SESSION_HMAC 1        //SM4-CTR records with an HMAC-SM3 tag
+
+#define SM9_SESSION_HDR_LEN 12
+#define SM9_SESSION_HMAC_LEN 32
+#define SM9_SESSION_TAG_LEN(mode) ((mode) == SM9_SESSION_GCM ? SM4_GCM_TAG_LEN : SM9_SESSION_HMAC_LEN)
+#define SM9_SESSION_RECORD_LEN(mode, mlen) (SM9_SESSION_HDR_LEN + (mlen) + SM9_SESSION_TAG_LEN(mode))
+#define SM9_SESSION_MAX_RECORDS ((uint64_t)1 << 24) //default rekey by count
+#define SM9_SESSION_MAX_SECS 3600                   //default rekey by time
+#define SM9_SESSION_WINDOW 64
+#define SM9_SESSION_MAX_SKIP 16                     //epochs the receiver may jump at once
+
+typedef struct
+{
+	int mode;
+	unsigned char ck[32];         //chain key, the keys of the next epoch come from it
+	uint32_t epoch;
+	uint64_t seq;                 //sender: next sequence number, receiver: highest received + 1
+	uint64_t seen;                //receiver: bit i set when seq - 1 - i was received
+	uint64_t max_records;         //0 for no limit
+	long max_secs;                //0 for no limit
+	time_t since;                 //start of the epoch
+	unsigned char salt[4];        //nonce of a record is salt||seq
+	SM4_GCM_CTX gcm;              //GCM: key and H of the epoch
+	SM4_KEY ks;                   //HMAC: CTR key of the epoch
+	SM3_STATE hin, hout;          //HMAC: SM3 after the inner and the outer pad
+} SM9_SESSION;
+
+void SM9_session_init(SM9_SESSION *sess, int mode, unsigned char T[], unsigned char w[], unsigned char *IDR,
+	unsigned char *IDS);
+int SM9_session_open(SM9_CTX *ctx, SM9_SESSION *sess, int mode, SM9_COUPON_POOL *pool, unsigned char hid[],
+	unsigned char *IDR, unsigned char *IDS, unsigned char *message, size_t mlen, unsigned char S[], unsigned char T[],
+	unsigned char C[]);
+int SM9_session_accept(SM9_CTX *ctx, SM9_SESSION *sess, int mode, unsigned char hid[], unsigned char *IDR,
+	unsigned char *IDS, unsigned char S[], unsigned char T[], unsigned char C[], size_t mlen,
+	unsigned char deR[], unsigned char Ppub[], unsigned char M[]);
+void SM9_session_limits(SM9_SESSION *sess, uint64_t max_records, long max_secs);
+void SM9_session_seal(SM9_SESSION *sess, const unsigned char M[], size_t mlen, unsigned char out[]);
+int SM9_session_unseal(SM9_SESSION *sess, const unsigned char in[], size_t inlen, unsigned char M[], size_t *mlen);
+void SM9_session_free(SM9_SESSION *sess);
+
+#endif
@@ -30,6 +30,24 @@ The codes were slightly modified to pass the check of C complier.
 //        11.SM9_Sign            //SM9 signature algorithm
 //        12.SM9_Verify          //SM9 verification
 //        13.SM9_SelfCheck()     //SM9 slef-check
+//        14.zzn12_to_bytes192   //compress an element of GT into 192 bytes
+//        15.bytes192_to_zzn12   //decompress 192 bytes into an element of GT
+//        16.SM9_H_init          //start H1 or H2 on the incremental SM3
+//        17.SM9_H_final         //finish H1 or H2, reduce the hash into [1,n-1]
+//        18.zzn12_to_bytes384   //encode the 12 coefficients of zzn12 into 384 bytes
+//        19.SM9_absorb_big      //feed an element of Fp to a KDF or H1/H2
+//        20.SM9_absorb_point    //feed a point of G1 to a KDF or H1/H2
+//        21.SM9_absorb_zzn12    //feed an element of GT to a KDF or H1/H2
+//        22.SM9_DEM_encrypt     //SM4-GCM encryption of a long message with the KDF key
+//        23.SM9_DEM_decrypt     //SM4-GCM decryption and tag check
+//        24.bytes384_to_zzn12   //decode 384 bytes into an element of GT
+//        25.SM9_H1_mb           //H1 of many identifications in the lanes of SM3_256_mb
+//        26.Unsigncrypt_w       //unsigncryption into a buffer of the caller that also gives out the checked w'
+//        27.Unsigncrypt_into    //unsigncryption into a buffer of the caller, with the check of S
+//        28.SM9_G1_mul_glv      //[k]P in G1 with the GLV endomorphism
+//        29.SM9_pub_lines       //lines of the Miller loop of Ppub and g=e(P1,Ppub), kept in the context
+//        30.SM9_ctx_init        //context of the calling thread: its mip and the cache of Ppub
+//        31.SM9_ctx_free        //release a context
 
 //
 // Notes:
@@ -40,8 +58,13 @@ The codes were slightly modified to pass the check of C complier.
 
 #include <malloc.h>
 #include <math.h>
+#include <time.h>
 #include "miracl.h"
 #include "R-ate.h"
+#include "KDF.h"
+#include "SM4.h"
+#include "SM9_thread.h"
+#include "SM9_err.h"
 
 #define BNLEN 32 //BN curve with 256bit is used in SM9 algorithm
 
@@ -57,41 +80,86 @@ The codes were slightly modified to pass the check of C complier.
 #define SM9_GEPUB_ERR 0x0000000A           //ɹԿ
 #define SM9_GEPRI_ERR 0x0000000B           //˽Կ
 #define SM9_SIGN_ERR 0x0000000C            //ǩ
-extern unsigned char dA[32];
-extern unsigned char rand[32];
-extern unsigned char h[32], S[64],T[64], C[64];
-extern unsigned char Ppub[128], dSA[64],skID[128];
-extern unsigned char Ppub[128], dSA[64];
-extern unsigned char std_h[32];
-extern unsigned char std_S[64];
-extern unsigned char std_Ppub[128];
-extern unsigned char std_dSA[64];
-extern unsigned char hid[];
-extern unsigned char *IDR;
-extern unsigned char *message;
+#define SM9_GT_COMPRESS_ERR 0x0000000D     //element can not be compressed, not in GT
+#define SM9_DEM_TAG_ERR 0x0000000E         //SM4-GCM tag of C does not match
+#define SM9_SESSION_AUTH_ERR 0x0000000F    //tag of a session record does not match
+#define SM9_SESSION_REPLAY_ERR 0x00000010  //session record received before or of a past epoch
+#define SM9_T_NOT_VALID_G1 0x00000011      //T is not a point of G1
+#define SM9_BUNDLE_FORMAT_ERR 0x00000012   //index of a bundle does not fit its records
+#define SM9_ARENA_ERR 0x00000013           //an operation left temporaries in the arena
+#define SM9_CTX_ERR 0x00000014             //the context was made by another thread
 
+#define GT_COMPRESSED_LEN (BNLEN * 6) //length of a T2 torus compressed element of GT
+#define SM9_RNG_SEED_LEN 32           //bytes of the OS source that seed the csprng of a context
 
+//messages of at least SM9_DEM_THRESHOLD bytes are encrypted with SM4-GCM under a KDF key
+//instead of being XORed with mlen bytes of KDF output, C then carries the GCM tag
+#define SM9_DEM_THRESHOLD 1024
+#define SM9_DEM_TAG_LEN SM4_GCM_TAG_LEN
+#define SM9_DEM_CHUNK (16 * 1024) //bytes encrypted and hashed together while in cache
+#define SM9_C_LEN(mlen) ((mlen) + ((mlen) >= SM9_DEM_THRESHOLD ? SM9_DEM_TAG_LEN : 0))
+
+//what one thread keeps between its calls: the MIRACL workspace of the thread and
+//what only depends on the master public key. The curve constants P1, P2, N, X and
+//para_* are set once by SM9_Init and only read after that, all contexts share them.
+//A context is only used by the thread that made it. Every entry point of the
+//library takes the context of the calling thread first and returns SM9_CTX_ERR
+//for a context of another thread; the helpers below them (SM9_H1, SM9_absorb_*,
+//SM9_DEM_*, SM9_G1_mul_glv...) run on the mip of the calling thread.
+typedef struct
+{
+	miracl *mip;                      //MIRACL workspace of the thread
+	BOOL own;                         //mip was made by SM9_ctx_init, SM9_ctx_free ends it
+	unsigned char Ppub[BNLEN * 4];    //Ppub of the last call, with what only depends on it
+	ecap_lines L;                     //lines of the Miller loop of Ppub
+	zzn12 g;                          //e(P1,Ppub)
+	BOOL pub_ok;
+	csprng rng;                       //every random scalar of the thread, seeded from the OS
+} SM9_CTX;
 
 BOOL bytes128_to_ecn2(unsigned char Ppubs[], ecn2 *res);
 void zzn12_ElementPrint(zzn12 x);
 void ecn2_Bytes128_Print(ecn2 x);
 void LinkCharZzn12(unsigned char *message, int len, zzn12 w, unsigned char *Z, int Zlen);
+void zzn12_to_bytes384(zzn12 w, unsigned char c[]);
+BOOL bytes384_to_zzn12(unsigned char c[], zzn12 *w);
+int zzn12_to_bytes192(zzn12 w, unsigned char c[]);
+BOOL bytes192_to_zzn12(unsigned char c[], zzn12 *w);
 int Test_Point(epoint *point);
 int Test_Range(big x);
 int SM9_Init();
+int SM9_ctx_init(SM9_CTX *ctx);
+void SM9_ctx_free(SM9_CTX *ctx);
 int SM9_H1(unsigned char Z[], int Zlen, big n, big h1);
+int SM9_H1_mb(unsigned char *ID[], int num, unsigned char hid[], big n, big h1[]);
 int SM9_H2(unsigned char Z[], int Zlen, big n, big h2);
-int SM9_GenerateSignKey(unsigned char hid[], unsigned char *ID, int IDlen, big ks, unsigned char Ppubs[], unsigned char dsa[], unsigned char skid[]);
+void SM9_H_init(SM3_KDF_CTX *kdf, unsigned char prefix);
+int SM9_H_final(SM3_KDF_CTX *kdf, big n, big h);
+void SM9_absorb_big(SM3_KDF_CTX *kdf, big x);
+void SM9_absorb_point(SM3_KDF_CTX *kdf, epoint *P);
+void SM9_absorb_zzn12(SM3_KDF_CTX *kdf, zzn12 w);
+void SM9_DEM_encrypt(SM3_KDF_CTX *kdf, SM3_KDF_CTX *hv, const unsigned char M[], size_t mlen, unsigned char C[]);
+int SM9_DEM_decrypt(SM3_KDF_CTX *kdf, SM3_KDF_CTX *hv, const unsigned char C[], size_t mlen, unsigned char M[]);
+int SM9_GenerateSignKey(SM9_CTX *ctx, unsigned char hid[], unsigned char *ID, int IDlen, big ks, unsigned char Ppubs[], unsigned char dsa[], unsigned char skid[]);
 int SM9_Sign(unsigned char hid[], unsigned char *IDR, unsigned char *message, int len, unsigned char rand[],
 	unsigned char dsa[], unsigned char Ppub[], unsigned char H[], unsigned char S[]);
 int SM9_Verify(unsigned char H[], unsigned char S[], unsigned char hid[],
 	unsigned char *IDR, unsigned char *message, int len, unsigned char Ppub[]);
 int SM9_SelfCheck();
-int Signcrypt(unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int IDlen,
-	unsigned char *message, int mlen, unsigned char H[], unsigned char S[], unsigned char T[], unsigned char C[],
+int SM9_Bench();
+int Signcrypt(SM9_CTX *ctx, unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int IDlen,
+	unsigned char *message, size_t mlen, unsigned char H[], unsigned char S[], unsigned char T[], unsigned char C[],
 	unsigned char skID[], big ks, unsigned char Ppub[]);
-int Unsigncrypt(unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int IDlen,
-	unsigned char *message, int mlen, unsigned char S[], unsigned char T[], unsigned char C[],
+int Unsigncrypt(SM9_CTX *ctx, unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int IDlen,
+	unsigned char *message, size_t mlen, unsigned char S[], unsigned char T[], unsigned char C[],
 	unsigned char skID[], big ks, unsigned char Ppub[]);
+int Unsigncrypt_w(SM9_CTX *ctx, unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int IDlen,
+	unsigned char *message, size_t mlen, unsigned char S[], unsigned char T[], unsigned char C[],
+	unsigned char skID[], big ks, unsigned char Ppub[], unsigned char M_[], unsigned char w[]);
+int Unsigncrypt_into(SM9_CTX *ctx, unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int IDlen,
+	unsigned char *message, size_t mlen, unsigned char S[], unsigned char T[], unsigned char C[],
+	unsigned char skID[], big ks, unsigned char Ppub[], unsigned char M_[]);
+void SM9_G1_mul_glv(big k, epoint *P, epoint *R);
+int SM9_pub_lines(SM9_CTX *ctx, unsigned char Ppub[], ecap_lines **L, zzn12 *g);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,359 @@
+/************************************************************************
+FileName:
+SM9_thread.c
+Version:
+SM9_THREAD_V1.0
+Date:
+Oct 19,2026
+Description:
+Portable threads, see SM9_thread.h
+Function List:
+1.SM9_thread_entry    //native thread entry, calls the SM9_THREAD_FUNC
+2.SM9_thread_start    //start func(arg) in a new thread
+3.SM9_thread_join     //wait for a thread started by SM9_thread_start
+4.SM9_cpu_count       //number of online processors
+5.SM9_thread_sleep    //give up the processor for some milliseconds
+6.SM9_atomic_load     //read a shared counter, acquire
+7.SM9_atomic_store    //write a shared counter, release
+8.SM9_atomic_cas      //compare and swap a shared counter
+9.SM9_thread_pin      //keep the calling thread on one processor
+10.SM9_wall_time      //seconds of a monotonic wall clock
+11.SM9_os_random      //seed bytes from the random source of the OS
+************************************************************************/
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE   //pthread_setaffinity_np
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include "SM9_thread.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <bcrypt.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "bcrypt.lib")
+#endif
+#if !defined(SM9_NO_THREADS)
+#include <process.h>
+#endif
+#else
+#include <time.h>
+#if !defined(SM9_NO_THREADS)
+#include <unistd.h>
+#endif
+#endif
+
+typedef struct
+{
+	SM9_THREAD_FUNC func;
+	void *arg;
+} SM9_THREAD_START;
+
+/******************************************************************************
+Function:       SM9_thread_entry
+Description:    the native thread entry, frees the start block and calls the
+SM9_THREAD_FUNC
+Calls:
+Called By:      SM9_thread_start
+Input:          void *p  //SM9_THREAD_START allocated by SM9_thread_start
+Output:         null
+Return:         0
+Others:
+*******************************************************************************/
+#if !defined(SM9_NO_THREADS)
+#if defined(_WIN32)
+static unsigned __stdcall SM9_thread_entry(void *p)
+#else
+static void *SM9_thread_entry(void *p)
+#endif
+{
+	SM9_THREAD_START st = *(SM9_THREAD_START *)p;
+
+	free(p);
+	st.func(st.arg);
+	return 0;
+}
+#endif
+
+/******************************************************************************
+Function:       SM9_thread_start
+Description:    run func(arg) in a new thread
+Calls:          _beginthreadex or pthread_create
+Called By:
+Input:          SM9_THREAD_FUNC func
+void *arg
+Output:         SM9_THREAD *th
+Return:         0: the thread is running
+1: no thread could be started, func has not been called
+Others:         with SM9_NO_THREADS func(arg) is run before returning 0
+*******************************************************************************/
+int SM9_thread_start(SM9_THREAD *th, SM9_THREAD_FUNC func, void *arg)
+{
+#if defined(SM9_NO_THREADS)
+	*th = 0;
+	func(arg);
+	return 0;
+#else
+	SM9_THREAD_START *st = (SM9_THREAD_START *)malloc(sizeof(SM9_THREAD_START));
+
+	if (st == NULL)
+		return 1;
+	st->func = func;
+	st->arg = arg;
+#if defined(_WIN32)
+	*th = (HANDLE)_beginthreadex(NULL, 0, SM9_thread_entry, st, 0, NULL);
+	if (*th == 0)
+	{
+		free(st);
+		return 1;
+	}
+#else
+	if (pthread_create(th, NULL, SM9_thread_entry, st) != 0)
+	{
+		free(st);
+		return 1;
+	}
+#endif
+	return 0;
+#endif
+}
+
+/******************************************************************************
+Function:       SM9_thread_join
+Description:    wait until the thread has returned and release it
+Calls:          WaitForSingleObject or pthread_join
+Called By:
+Input:          SM9_THREAD th
+Output:         null
+Return:         null
+Others:
+*******************************************************************************/
+void SM9_thread_join(SM9_THREAD th)
+{
+#if defined(SM9_NO_THREADS)
+	(void)th;
+#elif defined(_WIN32)
+	WaitForSingleObject(th, INFINITE);
+	CloseHandle(th);
+#else
+	pthread_join(th, NULL);
+#endif
+}
+
+/******************************************************************************
+Function:       SM9_cpu_count
+Description:    number of processors available to the process
+Calls:          GetSystemInfo or sysconf
+Called By:
+Input:          null
+Output:         null
+Return:         at least 1
+Others:
+*******************************************************************************/
+int SM9_cpu_count(void)
+{
+#if defined(SM9_NO_THREADS)
+	return 1;
+#elif defined(_WIN32)
+	SYSTEM_INFO si;
+
+	GetSystemInfo(&si);
+	return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return n > 0 ? (int)n : 1;
+#endif
+}
+
+/******************************************************************************
+Function:       SM9_thread_sleep
+Description:    let other threads run for about ms milliseconds
+Calls:          Sleep or nanosleep
+Called By:
+Input:          int ms
+Output:         null
+Return:         null
+Others:         does nothing with SM9_NO_THREADS
+*******************************************************************************/
+void SM9_thread_sleep(int ms)
+{
+#if defined(SM9_NO_THREADS)
+	(void)ms;
+#elif defined(_WIN32)
+	Sleep((DWORD)ms);
+#else
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (long)(ms % 1000) * 1000000;
+	nanosleep(&ts, NULL);
+#endif
+}
+
+/******************************************************************************
+Function:       SM9_atomic_load
+Description:    read a counter shared between threads; the writes made by the
+thread that stored the value are visible after it
+Calls:          InterlockedCompareExchange or __atomic_load_n
+Called By:
+Input:          SM9_ATOMIC *a
+Output:         null
+Return:         the value of *a
+Others:
+*******************************************************************************/
+long SM9_atomic_load(SM9_ATOMIC *a)
+{
+#if defined(SM9_NO_THREADS)
+	return *a;
+#elif defined(_WIN32)
+	return InterlockedCompareExchange(a, 0, 0);
+#else
+	return __atomic_load_n(a, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/******************************************************************************
+Function:       SM9_atomic_store
+Description:    write a counter shared between threads, after every write made
+before it
+Calls:          InterlockedExchange or __atomic_store_n
+Called By:
+Input:          long v
+Output:         SM9_ATOMIC *a
+Return:         null
+Others:
+*******************************************************************************/
+void SM9_atomic_store(SM9_ATOMIC *a, long v)
+{
+#if defined(SM9_NO_THREADS)
+	*a = v;
+#elif defined(_WIN32)
+	InterlockedExchange(a, v);
+#else
+	__atomic_store_n(a, v, __ATOMIC_RELEASE);
+#endif
+}
+
+/******************************************************************************
+Function:       SM9_atomic_cas
+Description:    *a = v if *a still holds expect, as one atomic step
+Calls:          InterlockedCompareExchange or __atomic_compare_exchange_n
+Called By:
+Input:          SM9_ATOMIC *a
+long expect
+long v
+Output:         SM9_ATOMIC *a
+Return:         1: *a was expect and is now v
+0: another thread changed *a first, nothing written
+Others:
+*******************************************************************************/
+int SM9_atomic_cas(SM9_ATOMIC *a, long expect, long v)
+{
+#if defined(SM9_NO_THREADS)
+	if (*a != expect)
+		return 0;
+	*a = v;
+	return 1;
+#elif defined(_WIN32)
+	return InterlockedCompareExchange(a, v, expect) == expect;
+#else
+	return __atomic_compare_exchange_n(a, &expect, v, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/******************************************************************************
+Function:       SM9_thread_pin
+Description:    keep the calling thread on processor cpu, so that it keeps its
+caches and the threads of a pool do not share a processor
+Calls:          SetThreadAffinityMask or pthread_setaffinity_np
+Called By:      SM9_pool_worker
+Input:          int cpu  //0 to SM9_cpu_count()-1
+Output:         null
+Return:         0: the thread only runs on cpu from now on
+1: not pinned, the thread still runs anywhere
+Others:         only Windows and Linux can pin, elsewhere 1 is returned
+*******************************************************************************/
+int SM9_thread_pin(int cpu)
+{
+#if defined(SM9_NO_THREADS)
+	(void)cpu;
+	return 1;
+#elif defined(_WIN32)
+	if (cpu < 0 || cpu >= (int)(sizeof(DWORD_PTR) * 8))
+		return 1;
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0 ? 0 : 1;
+#elif defined(__linux__)
+	cpu_set_t set;
+
+	if (cpu < 0 || cpu >= CPU_SETSIZE)
+		return 1;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? 0 : 1;
+#else
+	(void)cpu;
+	return 1;
+#endif
+}
+
+/******************************************************************************
+Function:       SM9_wall_time
+Description:    seconds since some fixed point of a clock that only moves
+forward, for timings that span several threads, which clock() does not give
+Calls:          QueryPerformanceCounter or clock_gettime
+Called By:      SM9_pool_bench
+Input:          null
+Output:         null
+Return:         the time in seconds
+Others:
+*******************************************************************************/
+double SM9_wall_time(void)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER f, c;
+
+	QueryPerformanceFrequency(&f);
+	QueryPerformanceCounter(&c);
+	return (double)c.QuadPart / (double)f.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+/******************************************************************************
+Function:       SM9_os_random
+Description:    len bytes from the random source of the OS, to seed the
+csprng of a context
+Calls:          BCryptGenRandom or /dev/urandom
+Called By:      SM9_ctx_init
+Input:          len
+Output:         buf
+Return:
+                0: success
+                -1: the source can not be read
+Others:
+*******************************************************************************/
+int SM9_os_random(unsigned char *buf, int len)
+{
+#if defined(_WIN32)
+	if (!BCRYPT_SUCCESS(BCryptGenRandom(NULL, buf, (ULONG)len, BCRYPT_USE_SYSTEM_PREFERRED_RNG)))
+		return -1;
+	return 0;
+#else
+	FILE *fp;
+	size_t got;
+
+	fp = fopen("/dev/urandom", "rb");
+	if (fp == NULL)
+		return -1;
+	setvbuf(fp, NULL, _IONBF, 0);
+	got = fread(buf, 1, (size_t)len, fp);
+	fclose(fp);
+	return got == (size_t)len ? 0 : -1;
+#endif
+}
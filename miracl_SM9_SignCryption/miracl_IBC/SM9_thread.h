@@ -0,0 +1,65 @@
+/************************************************************************
+FileName:
+SM9_thread.h
+Version:
+SM9_THREAD_V1.0
+Date:
+Oct 19,2026
+Description:
+A small portable thread layer, Windows threads or POSIX threads.
+Defining SM9_NO_THREADS builds it without any threading: SM9_thread_start
+then runs the function at once in the calling thread.
+Function List:
+1.SM9_thread_start    //start func(arg) in a new thread
+2.SM9_thread_join     //wait for a thread started by SM9_thread_start
+3.SM9_cpu_count       //number of online processors
+4.SM9_thread_sleep    //give up the processor for some milliseconds
+5.SM9_atomic_load     //read a shared counter, acquire
+6.SM9_atomic_store    //write a shared counter, release
+7.SM9_atomic_cas      //compare and swap a shared counter
+8.SM9_thread_pin      //keep the calling thread on one processor
+9.SM9_wall_time       //seconds of a monotonic wall clock
+10.SM9_os_random      //seed bytes from the random source of the OS
+Notes:
+Only the hashing and symmetric code may run in these threads as it is.
+MIRACL keeps its state in the global mip, so big number work in a thread
+needs a MIRACL built with MR_OS_THREADS (MR_WINDOWS_MT, MR_UNIX_MT or MR_OPENMP_MT).
+************************************************************************/
+
+#ifndef HEADER_SM9_THREAD_H
+#define HEADER_SM9_THREAD_H
+
+#if defined(SM9_NO_THREADS)
+typedef int SM9_THREAD;
+#elif defined(_WIN32)
+#include <windows.h>
+typedef HANDLE SM9_THREAD;
+#else
+#include <pthread.h>
+typedef pthread_t SM9_THREAD;
+#endif
+
+//storage class of a variable with one instance per thread
+#if defined(SM9_NO_THREADS)
+#define SM9_TLS
+#elif defined(_MSC_VER)
+#define SM9_TLS __declspec(thread)
+#else
+#define SM9_TLS __thread
+#endif
+
+typedef void (*SM9_THREAD_FUNC)(void *arg);
+typedef volatile long SM9_ATOMIC;
+
+int SM9_thread_start(SM9_THREAD *th, SM9_THREAD_FUNC func, void *arg);
+void SM9_thread_join(SM9_THREAD th);
+int SM9_cpu_count(void);
+void SM9_thread_sleep(int ms);
+long SM9_atomic_load(SM9_ATOMIC *a);
+void SM9_atomic_store(SM9_ATOMIC *a, long v);
+int SM9_atomic_cas(SM9_ATOMIC *a, long expect, long v);
+int SM9_thread_pin(int cpu);
+double SM9_wall_time(void);
+int SM9_os_random(unsigned char *buf, int len);
+
+#endif
@@ -1,9 +1,18 @@
 #include <stdio.h>
+#include <string.h>
 #include "SM9_sv.h"
 #include<time.h>
 
-int main(void)
+int main(int argc, char *argv[])
 {
+	//"bench": the benchmarks of the thread pool instead of the self check
+	if (argc > 1 && strcmp(argv[1], "bench") == 0)
+	{
+		int error_code = SM9_Bench();
+		if (error_code)
+			printf("\nError code: 0x%x\n", error_code);
+		return error_code;
+	}
 
 	
 	clock_t startTime, finishTime;//ʱ
@@ -14,6 +14,7 @@ extern "C"{
 #include "miracl.h"
 #include "r-ate.h"
 #include "kdf_standard.h"
+#include "SM9_err.h"
 
 
 #define BNLEN 32 //BN curve with 256bit is used in SM9 algorithm
@@ -25,20 +26,6 @@ extern "C"{
 #define SM9_G2BASEPOINT_SET_ERR 0x00000006 //base point of G2 seted error(G2基点设置错误)
 #define SM9_GEPUB_ERR 0x00000007 //pubkey error(生成公钥错误)
 #define SM9_GEPRI_ERR 0x00000008 //privare key error(生成私钥错误)
-#define SM9_ERR_CMP_S1SB 0x00000009 //S1!=SB
-#define SM9_ERR_CMP_S2SA 0x0000000A //S2!=SA
-#define SM9_ERR_RA 0x0000000B //RA error
-#define SM9_ERR_RB 0x0000000C //RB error
-#define SM9_ERR_SA 0x0000000D //SA error
-#define SM9_ERR_SB 0x0000000E //SB error
-#define SM9_C1_NOT_VALID_G1 0x0000000F //C1不属于群G1
-#define SM9_ENCRYPT_ERR 0x00000010 //加密错误
-#define SM9_ERR_K1_ZERO 0x00000011 //K1 equals 0(K1全0)
-#define SM9_C3_MEMCMP_ERR 0x00000012 //C3对比不一致
-#define SM9_DECRYPT_ERR 0x00000013 //解密错误
-#define SM9_ERR_Encap_C 0x00000014 //cipher error in key encapsulation
-#define SM9_ERR_Encap_K 0x00000015 //key to be encapsulated
-#define SM9_ERR_Decap_K 0x00000016 //key generated by decapsulation
 #define SM9_H_OUTRANGE 0x00000017 //签名H不属于[1,N-1]
 #define SM9_DATA_MEMCMP_ERR 0x00000018 //数据对比不一致
 #define SM9_S_NOT_VALID_G1 0x00000019 //S不属于群G1
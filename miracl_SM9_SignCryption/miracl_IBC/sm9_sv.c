@@ -27,6 +27,27 @@ The codes were slightly modified to pass the check of C complier.
 //        11.SM9_Sign            //SM9 signature algorithm
 //        12.SM9_Verify          //SM9 verification
 //        13.SM9_SelfCheck()     //SM9 slef-check
+//        14.zzn12_to_bytes192   //compress an element of GT into 192 bytes
+//        15.bytes192_to_zzn12   //decompress 192 bytes into an element of GT
+//        16.SM9_H_init          //start H1 or H2 on the incremental SM3
+//        17.SM9_H_final         //finish H1 or H2, reduce the hash into [1,n-1]
+//        18.zzn12_to_bytes384   //encode the 12 coefficients of zzn12 into 384 bytes
+//        19.SM9_absorb_big      //feed an element of Fp to a KDF or H1/H2
+//        20.SM9_absorb_point    //feed a point of G1 to a KDF or H1/H2
+//        21.SM9_absorb_zzn12    //feed an element of GT to a KDF or H1/H2
+//        22.SM9_DEM_encrypt     //SM4-GCM encryption of a long message with the KDF key
+//        23.SM9_DEM_decrypt     //SM4-GCM decryption and tag check
+//        24.bytes384_to_zzn12   //decode 384 bytes into an element of GT
+//        25.SM9_H1_mb           //H1 of many identifications in the lanes of SM3_256_mb
+//        26.Unsigncrypt_work    //body of Unsigncrypt_w, its temporaries in the arena
+//        27.Unsigncrypt_w       //unsigncryption into a buffer of the caller that also gives out the checked w'
+//        28.Unsigncrypt_into    //unsigncryption into a buffer of the caller, with the check of S
+//        29.SM9_G1_mul_glv      //[k]P in G1 with the GLV endomorphism
+//        30.SM9_pub_lines       //lines of the Miller loop of Ppub and g=e(P1,Ppub), kept in the context
+//        31.Signcrypt_work      //body of Signcrypt, its temporaries in the arena
+//        32.SM9_ctx_init        //context of the calling thread: its mip and the cache of Ppub
+//        33.SM9_ctx_free        //release a context
+//        34.SM9_Bench           //benchmarks of the thread pool, apart from the self check
 
 //
 // Notes:
@@ -36,9 +57,15 @@ The codes were slightly modified to pass the check of C complier.
 //**************************************************************************/
 
 #include "SM9_sv.h"
+#include "SM9_session.h"
+#include "SM9_bundle.h"
+#include "SM9_enc.h"
+#include "SM9_exch.h"
+#include "SM9_batch.h"
+#include "SM9_pool.h"
 #include "kdf.h"
+#include "SM3_mb.h"
 
-extern miracl *mip;
 extern zzn2 X; //Frobniues constant
 
 unsigned char SM9_q[32] = { 0xB6, 0x40, 0x00, 0x00, 0x02, 0xA3, 0xA6, 0xF1, 0xD6, 0x03, 0xAB, 0x4F, 0xF5, 0x8E, 0xC7, 0x45,
@@ -67,10 +94,12 @@ unsigned char SM9_a[32] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
 unsigned char SM9_b[32] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05 };
 
-epoint *P1, *t, *s;
-ecn2 P2,skIDr;
+epoint *P1;
+ecn2 P2;
 big N; //order of group, N(t)
 big para_a, para_b, para_t, para_q;
+ecap_lines P2_lines; //lines of the Miller loop of P2, e(S,[h1]P2+Ppub) = e([h1]S,P2)*e(S,Ppub)
+big glv_beta, glv_A, glv_B, glv_C; //cube root of unity of Fp and the lattice of the GLV method in G1
 
 /****************************************************************
 Function:       bytes128_to_ecn2
@@ -195,35 +224,349 @@ Others:
 ****************************************************************/
 void LinkCharZzn12(unsigned char *message, int len, zzn12 w, unsigned char *Z, int Zlen)
 {
+	memcpy(Z, message, len);
+	zzn12_to_bytes384(w, Z + len);
+}
+
+/****************************************************************
+Function:       zzn12_to_bytes384
+Description:    canonical big-endian encoding of the 12 coefficients of w,
+in the order used by LinkCharZzn12
+Calls:          MIRACL functions
+Called By:      LinkCharZzn12,SM9_absorb_zzn12
+Input:          zzn12 w
+Output:         c[384]
+Return:         NULL
+Others:         the coefficients are taken out of Montgomery form in one loop
+with one temporary, which is freed before returning
+****************************************************************/
+void zzn12_to_bytes384(zzn12 w, unsigned char c[])
+{
+	big *coef[12];
 	big tmp;
+	char *mem;
+	int i;
+
+	coef[0] = &w.c.b.b;
+	coef[1] = &w.c.b.a;
+	coef[2] = &w.c.a.b;
+	coef[3] = &w.c.a.a;
+	coef[4] = &w.b.b.b;
+	coef[5] = &w.b.b.a;
+	coef[6] = &w.b.a.b;
+	coef[7] = &w.b.a.a;
+	coef[8] = &w.a.b.b;
+	coef[9] = &w.a.b.a;
+	coef[10] = &w.a.a.b;
+	coef[11] = &w.a.a.a;
+
+	mem = (char *)memalloc(1);
+	tmp = mirvar_mem(mem, 0);
+	for (i = 0; i < 12; i++)
+	{
+		redc(*coef[i], tmp);
+		big_to_bytes(BNLEN, tmp, c + BNLEN * i, 1);
+	}
+	memkill(mem, 1);
+}
 
-	tmp = mirvar(0);
+/****************************************************************
+Function:       bytes384_to_zzn12
+Description:    inverse of zzn12_to_bytes384
+Calls:          MIRACL functions
+Called By:      SM9_coupon_worker
+Input:          c[384]
+Output:         w:zzn12 element, already initiated
+Return:         TRUE: success
+FALSE: a coefficient is not in [0,q-1]
+Others:         w is marked unitary, c must encode an element of GT
+****************************************************************/
+BOOL bytes384_to_zzn12(unsigned char c[], zzn12 *w)
+{
+	big *coef[12];
+	big tmp;
+	char *mem;
+	int i;
+
+	coef[0] = &w->c.b.b;
+	coef[1] = &w->c.b.a;
+	coef[2] = &w->c.a.b;
+	coef[3] = &w->c.a.a;
+	coef[4] = &w->b.b.b;
+	coef[5] = &w->b.b.a;
+	coef[6] = &w->b.a.b;
+	coef[7] = &w->b.a.a;
+	coef[8] = &w->a.b.b;
+	coef[9] = &w->a.b.a;
+	coef[10] = &w->a.a.b;
+	coef[11] = &w->a.a.a;
+
+	mem = (char *)memalloc(1);
+	tmp = mirvar_mem(mem, 0);
+	for (i = 0; i < 12; i++)
+	{
+		bytes_to_big(BNLEN, c + BNLEN * i, tmp);
+		if (mr_compare(tmp, para_q) >= 0)
+		{
+			memkill(mem, 1);
+			return FALSE;
+		}
+		nres(tmp, *coef[i]);
+	}
+	memkill(mem, 1);
+	w->miller = FALSE;
+	w->unitary = TRUE;
+	return TRUE;
+}
 
-	memcpy(Z, message, len);
-	redc(w.c.b.b, tmp);
-	big_to_bytes(BNLEN, tmp, Z + len, 1);
-	redc(w.c.b.a, tmp);
-	big_to_bytes(BNLEN, tmp, Z + len + BNLEN, 1);
-	redc(w.c.a.b, tmp);
-	big_to_bytes(BNLEN, tmp, Z + len + BNLEN * 2, 1);
-	redc(w.c.a.a, tmp);
-	big_to_bytes(BNLEN, tmp, Z + len + BNLEN * 3, 1);
-	redc(w.b.b.b, tmp);
-	big_to_bytes(BNLEN, tmp, Z + len + BNLEN * 4, 1);
-	redc(w.b.b.a, tmp);
-	big_to_bytes(BNLEN, tmp, Z + len + BNLEN * 5, 1);
-	redc(w.b.a.b, tmp);
-	big_to_bytes(BNLEN, tmp, Z + len + BNLEN * 6, 1);
-	redc(w.b.a.a, tmp);
-	big_to_bytes(BNLEN, tmp, Z + len + BNLEN * 7, 1);
-	redc(w.a.b.b, tmp);
-	big_to_bytes(BNLEN, tmp, Z + len + BNLEN * 8, 1);
-	redc(w.a.b.a, tmp);
-	big_to_bytes(BNLEN, tmp, Z + len + BNLEN * 9, 1);
-	redc(w.a.a.b, tmp);
-	big_to_bytes(BNLEN, tmp, Z + len + BNLEN * 10, 1);
-	redc(w.a.a.a, tmp);
-	big_to_bytes(BNLEN, tmp, Z + len + BNLEN * 11, 1);
+/****************************************************************
+Function:       SM9_absorb_big
+Description:    feed the BNLEN-byte big-endian encoding of x to a KDF or H1/H2
+Calls:          MIRACL functions,SM3_KDF_absorb
+Called By:      SM9_absorb_point
+Input:          kdf
+x:      element of Fp, not in Montgomery form
+Output:         kdf
+Return:         NULL
+Others:
+****************************************************************/
+void SM9_absorb_big(SM3_KDF_CTX *kdf, big x)
+{
+	unsigned char c[BNLEN];
+
+	big_to_bytes(BNLEN, x, c, 1);
+	SM3_KDF_absorb(kdf, c, BNLEN);
+}
+
+/****************************************************************
+Function:       SM9_absorb_point
+Description:    feed the 64-byte encoding x||y of a point of G1 to a KDF or H1/H2
+Calls:          MIRACL functions,SM9_absorb_big
+Called By:
+Input:          kdf
+P:      point of G1, not the point at infinity
+Output:         kdf
+Return:         NULL
+Others:         the same bytes as the S and T outputs of Signcrypt
+****************************************************************/
+void SM9_absorb_point(SM3_KDF_CTX *kdf, epoint *P)
+{
+	big x, y;
+	char *mem;
+
+	mem = (char *)memalloc(2);
+	x = mirvar_mem(mem, 0);
+	y = mirvar_mem(mem, 1);
+	epoint_get(P, x, y);
+	SM9_absorb_big(kdf, x);
+	SM9_absorb_big(kdf, y);
+	memkill(mem, 2);
+}
+
+/****************************************************************
+Function:       SM9_absorb_zzn12
+Description:    feed the 384-byte encoding of w to a KDF or H1/H2, the bytes
+LinkCharZzn12 would append to a message
+Calls:          zzn12_to_bytes384,SM3_KDF_absorb
+Called By:      Signcrypt,Unsigncrypt
+Input:          kdf
+w:      zzn12 element
+Output:         kdf
+Return:         NULL
+Others:         no copy of the message is made, only the 384 bytes of w
+****************************************************************/
+void SM9_absorb_zzn12(SM3_KDF_CTX *kdf, zzn12 w)
+{
+	unsigned char c[BNLEN * 12];
+
+	zzn12_to_bytes384(w, c);
+	SM3_KDF_absorb(kdf, c, BNLEN * 12);
+}
+
+/****************************************************************
+Function:       SM9_DEM_encrypt
+Description:    KEM-DEM encryption of a message of SM9_DEM_THRESHOLD bytes or
+more: K1||K2 = KDF(T||w||IDR, 28), C = SM4-GCM(K1, nonce K2, M) || tag, and
+M is absorbed into H2 in the same pass
+Calls:          SM3_KDF_squeeze,SM3_KDF_absorb,SM4_gcm_init,SM4_gcm_encrypt,
+SM4_gcm_tag
+Called By:      Signcrypt,Signcrypt_online,SM9_bcast_C
+Input:          kdf:KDF state that has absorbed T||w||IDR
+hv:H2 state, NULL for no hash
+M:message
+mlen:length of M
+Output:         C:mlen bytes of ciphertext followed by the SM9_DEM_TAG_LEN byte tag
+kdf,hv
+Return:         NULL
+Others:         the KDF makes 28 bytes whatever mlen is, the message goes
+SM9_DEM_CHUNK bytes at a time through H2 and SM4-GCM while it is in cache
+****************************************************************/
+void SM9_DEM_encrypt(SM3_KDF_CTX *kdf, SM3_KDF_CTX *hv, const unsigned char M[], size_t mlen, unsigned char C[])
+{
+	unsigned char K[SM4_KEY_LEN + SM4_GCM_IV_LEN];
+	SM4_GCM_CTX gcm;
+	size_t n;
+
+	SM3_KDF_squeeze(kdf, K, sizeof(K));
+	SM4_gcm_init(&gcm, K, K + SM4_KEY_LEN, SM4_GCM_IV_LEN);
+	for (; mlen; mlen -= n)
+	{
+		n = mlen < SM9_DEM_CHUNK ? mlen : SM9_DEM_CHUNK;
+		if (hv)
+			SM3_KDF_absorb(hv, M, n);
+		SM4_gcm_encrypt(&gcm, M, C, n);
+		M += n;
+		C += n;
+	}
+	SM4_gcm_tag(&gcm, C);
+	memset(K, 0, sizeof(K));
+	memset(&gcm, 0, sizeof(gcm));
+}
+
+/****************************************************************
+Function:       SM9_DEM_decrypt
+Description:    KEM-DEM decryption, the inverse of SM9_DEM_encrypt: M' is
+recovered and absorbed into H2, then the tag that follows C is checked
+Calls:          SM3_KDF_squeeze,SM3_KDF_absorb,SM4_gcm_init,SM4_gcm_decrypt,
+SM4_gcm_tag
+Called By:      Unsigncrypt
+Input:          kdf:KDF state that has absorbed T||w'||IDR
+hv:H2 state
+C:mlen bytes of ciphertext followed by the tag
+mlen:length of the message
+Output:         M:mlen bytes of message, zeroed when the tag does not match
+kdf,hv
+Return:         0: success
+SM9_DEM_TAG_ERR: the tag does not match
+Others:         the tag is compared in constant time
+****************************************************************/
+int SM9_DEM_decrypt(SM3_KDF_CTX *kdf, SM3_KDF_CTX *hv, const unsigned char C[], size_t mlen, unsigned char M[])
+{
+	unsigned char K[SM4_KEY_LEN + SM4_GCM_IV_LEN], tag[SM9_DEM_TAG_LEN], diff = 0;
+	SM4_GCM_CTX gcm;
+	size_t n, off;
+	int i;
+
+	SM3_KDF_squeeze(kdf, K, sizeof(K));
+	SM4_gcm_init(&gcm, K, K + SM4_KEY_LEN, SM4_GCM_IV_LEN);
+	for (off = 0; off < mlen; off += n)
+	{
+		n = mlen - off < SM9_DEM_CHUNK ? mlen - off : SM9_DEM_CHUNK;
+		SM4_gcm_decrypt(&gcm, C + off, M + off, n);
+		SM3_KDF_absorb(hv, M + off, n);
+	}
+	SM4_gcm_tag(&gcm, tag);
+	for (i = 0; i < SM9_DEM_TAG_LEN; i++)
+		diff |= tag[i] ^ C[mlen + i];
+	memset(K, 0, sizeof(K));
+	memset(&gcm, 0, sizeof(gcm));
+	if (diff)
+	{
+		memset(M, 0, mlen);
+		return SM9_DEM_TAG_ERR;
+	}
+	return 0;
+}
+
+/****************************************************************
+Function:       zzn12_to_bytes192
+Description:    compress an element of GT into 192 bytes with the T2 torus,
+half of the 384 bytes written by LinkCharZzn12
+Calls:          MIRACL functions,zzn12_tmp,zzn12_torus_compress,SM9_arena_mark,
+SM9_tmp,SM9_arena_release
+Called By:      SM9_exch_start,SM9_SelfCheck
+Input:          zzn12 w     //element of GT
+Output:         c[192]      //all zero when w=1
+Return:         0: success
+SM9_GT_COMPRESS_ERR: w=-1, not an element of GT
+Others:
+****************************************************************/
+int zzn12_to_bytes192(zzn12 w, unsigned char c[])
+{
+	big tmp;
+	zzn12 m;
+	int mark;
+
+	mark = SM9_arena_mark();
+	tmp = SM9_tmp();
+	zzn12_tmp(&m);
+
+	if (!zzn12_torus_compress(w, &m))
+	{
+		SM9_arena_release(mark);
+		if (!zzn4_isunity(&w.a))
+			return SM9_GT_COMPRESS_ERR;
+		memset(c, 0, GT_COMPRESSED_LEN);
+		return 0;
+	}
+	redc(m.c.a.b, tmp);
+	big_to_bytes(BNLEN, tmp, c, 1);
+	redc(m.c.a.a, tmp);
+	big_to_bytes(BNLEN, tmp, c + BNLEN, 1);
+	redc(m.b.b.b, tmp);
+	big_to_bytes(BNLEN, tmp, c + BNLEN * 2, 1);
+	redc(m.b.b.a, tmp);
+	big_to_bytes(BNLEN, tmp, c + BNLEN * 3, 1);
+	redc(m.a.a.b, tmp);
+	big_to_bytes(BNLEN, tmp, c + BNLEN * 4, 1);
+	redc(m.a.a.a, tmp);
+	big_to_bytes(BNLEN, tmp, c + BNLEN * 5, 1);
+	SM9_arena_release(mark);
+	return 0;
+}
+
+/****************************************************************
+Function:       bytes192_to_zzn12
+Description:    decompress 192 bytes written by zzn12_to_bytes192
+Calls:          MIRACL functions,zzn12_tmp,zzn12_torus_decompress,SM9_arena_mark,
+SM9_tmp,SM9_arena_release
+Called By:      SM9_exch_pair,SM9_SelfCheck
+Input:          c[192]
+Output:         zzn12 *w
+Return:         FALSE: a coordinate is not in [0,q-1]
+TRUE: execute correctly
+Others:         data read from an untrusted source should be checked with member()
+****************************************************************/
+BOOL bytes192_to_zzn12(unsigned char c[], zzn12 *w)
+{
+	big tmp;
+	zzn12 m;
+	big *coord[6];
+	int mark, i;
+
+	mark = SM9_arena_mark();
+	tmp = SM9_tmp();
+	zzn12_tmp(&m);
+	coord[0] = &m.c.a.b;
+	coord[1] = &m.c.a.a;
+	coord[2] = &m.b.b.b;
+	coord[3] = &m.b.b.a;
+	coord[4] = &m.a.a.b;
+	coord[5] = &m.a.a.a;
+
+	for (i = 0; i < 6; i++)
+	{
+		bytes_to_big(BNLEN, c + BNLEN * i, tmp);
+		if (mr_compare(tmp, para_q) >= 0)
+		{
+			SM9_arena_release(mark);
+			return FALSE;
+		}
+		nres(tmp, *coord[i]);
+	}
+
+	if (zzn4_iszero(&m.a) && zzn4_iszero(&m.b) && zzn4_iszero(&m.c))
+	{
+		zzn4_from_int(1, &w->a);
+		zzn4_zero(&w->b);
+		zzn4_zero(&w->c);
+		w->miller = FALSE;
+		w->unitary = TRUE;
+	}
+	else
+		zzn12_torus_decompress(m, w);
+	SM9_arena_release(mark);
+	return TRUE;
 }
 
 /****************************************************************
@@ -304,15 +647,22 @@ Output:         null
 Return:         0: success;
 7: base point P1 error
 8: base point P2 error
-Others:
+Others:         also the lines of P2, the constants of SM9_G1_mul_glv and the
+                arena of the calling thread
 ****************************************************************/
 int SM9_Init()
 {
 	big P1_x, P1_y;
+	miracl *mip;
 
+#ifdef MR_OS_THREADS
+	mr_init_threading(); //MIRACL keeps one mip per thread, SM9_coupon_worker makes its own
+#endif
 	mip = mirsys(1000, 16);
 	;
 	mip->IOBASE = 16;
+	if (SM9_arena_init() != 0)
+		return SM9_ASK_MEMORY_ERR;
 
 	para_q = mirvar(0);
 	N = mirvar(0);
@@ -352,13 +702,166 @@ int SM9_Init()
 
 	set_frobenius_constant(&X);
 
+	//GLV in G1: [lambda](x,y)=(beta*x,y) with beta=18t^3+18t^2+9t+1, and the
+	//short basis (-A,B), (C,A) of the pairs k0+k1*lambda=0 mod N
+	glv_beta = mirvar(0);
+	glv_A = mirvar(0);
+	glv_B = mirvar(0);
+	glv_C = mirvar(0);
+	premult(para_t, 2, glv_A);
+	multiply(para_t, para_t, glv_B);
+	premult(glv_B, 6, glv_B);
+	add(glv_B, glv_A, glv_B);               //B=6t^2+2t
+	add(glv_B, glv_A, glv_C);
+	incr(glv_C, 1, glv_C);                  //C=6t^2+4t+1
+	incr(glv_A, 1, glv_A);                  //A=2t+1
+	multiply(para_t, para_t, glv_beta);
+	premult(glv_beta, 2, glv_beta);
+	add(glv_beta, glv_A, glv_beta);         //2t^2+2t+1
+	multiply(glv_beta, para_t, glv_beta);
+	premult(glv_beta, 9, glv_beta);
+	incr(glv_beta, 1, glv_beta);            //beta=9t(2t^2+2t+1)+1
+
+	if (!ecap_prep(P2, para_t, X, &P2_lines))
+		return SM9_G2BASEPOINT_SET_ERR;
+
+	return 0;
+}
+
+/****************************************************************
+Function:       SM9_ctx_init
+Description:    context of the calling thread: the mip of the thread, made
+                here when the thread has none yet, a csprng seeded from the
+                OS and an empty cache of Ppub
+Calls:          MIRACL functions,SM9_os_random,SM9_arena_init,SM9_ctx_free
+Called By:      SM9_SelfCheck,SM9_coupon_worker,SM9_bcast_worker,SM9_batch_worker,
+                SM9_pool_worker
+Input:          null
+Output:         ctx
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_RNG_ERR: the random source of the OS can not be read
+Others:         after SM9_Init, which sets the curve constants for every thread
+****************************************************************/
+int SM9_ctx_init(SM9_CTX *ctx)
+{
+	unsigned char seed[SM9_RNG_SEED_LEN];
+
+	memset(ctx, 0, sizeof(SM9_CTX));
+	if (SM9_os_random(seed, sizeof(seed)) != 0)
+		return SM9_RNG_ERR;
+	strong_init(&ctx->rng, sizeof(seed), (char *)seed, (mr_unsign32)time(NULL));
+	memset(seed, 0, sizeof(seed));
+	if (get_mip() == NULL)
+	{
+		if (mirsys(1000, 16) == NULL)
+		{
+			SM9_ctx_free(ctx);
+			return SM9_ASK_MEMORY_ERR;
+		}
+		ctx->own = TRUE;
+		get_mip()->IOBASE = 16;
+		get_mip()->TWIST = MR_SEXTIC_M;
+		ecurve_init(para_a, para_b, para_q, MR_PROJECTIVE);
+	}
+	ctx->mip = get_mip();
+	if (SM9_arena_init() != 0)
+	{
+		SM9_ctx_free(ctx);
+		return SM9_ASK_MEMORY_ERR;
+	}
+	return 0;
+}
+
+/****************************************************************
+Function:       SM9_ctx_free
+Description:    release the cache of Ppub and the csprng, and the mip of the
+                thread with its arena when SM9_ctx_init made them
+Calls:          MIRACL functions,ecap_lines_free,zzn12_kill,SM9_arena_free
+Called By:      SM9_SelfCheck,SM9_ctx_init
+Input:          ctx
+Output:         null
+Return:         null
+Others:         in the thread of SM9_ctx_init
+****************************************************************/
+void SM9_ctx_free(SM9_CTX *ctx)
+{
+	if (ctx->pub_ok)
+	{
+		ecap_lines_free(&ctx->L);
+		zzn12_kill(&ctx->g);
+	}
+	strong_kill(&ctx->rng);
+	if (ctx->own)
+	{
+		SM9_arena_free();
+		mirexit();
+	}
+	memset(ctx, 0, sizeof(SM9_CTX));
+}
+
+/****************************************************************
+Function:       SM9_H_init
+Description:    start H1 (prefix 0x01) or H2 (prefix 0x02) of SM9 standard
+5.4.2, Z is then fed with SM3_KDF_absorb in as many pieces as needed
+Calls:          SM3_KDF_init,SM3_KDF_absorb
+Called By:      SM9_H1,SM9_H2
+Input:          prefix:0x01 for H1, 0x02 for H2
+Output:         kdf:KDF state that has absorbed the prefix
+Return:         NULL
+Others:
+****************************************************************/
+void SM9_H_init(SM3_KDF_CTX *kdf, unsigned char prefix)
+{
+	SM3_KDF_init(kdf);
+	SM3_KDF_absorb(kdf, &prefix, 1);
+}
+
+/****************************************************************
+Function:       SM9_H_final
+Description:    finish H1 or H2: Ha=KDF(prefix||Z,hlen), hlen=8*ceil(5*log2(n)/32)
+bits, and h=(Ha mod (n-1))+1
+Calls:          MIRACL functions,SM3_KDF_squeeze
+Called By:      SM9_H1,SM9_H2
+Input:          kdf:KDF state that has absorbed prefix||Z
+n:order of the groups
+Output:         h:hash value in [1,n-1]
+Return:         0: success;
+1: asking for memory error
+Others:         Ha is reduced by one division instead of a reduction per byte,
+the two temporaries share one MIRACL memory block that is freed before returning
+****************************************************************/
+int SM9_H_final(SM3_KDF_CTX *kdf, big n, big h)
+{
+	unsigned char ha[BNLEN * 2];
+	big n1, q;
+	char *mem;
+	int hlen;
+
+	hlen = (5 * logb2(n) + 31) / 32;
+	if (hlen > BNLEN * 2)
+		return SM9_ASK_MEMORY_ERR;
+	mem = (char *)memalloc(2);
+	if (mem == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	n1 = mirvar_mem(mem, 0);
+	q = mirvar_mem(mem, 1);
+
+	SM3_KDF_squeeze(kdf, ha, hlen);
+	bytes_to_big(hlen, ha, h);
+	decr(n, 1, n1);
+	divide(h, n1, q); //h=Ha mod (n-1)
+	incr(h, 1, h);
+
+	memkill(mem, 2);
 	return 0;
 }
 
 /****************************************************************
 Function:       SM9_H1
 Description:    function H1 in SM9 standard 5.4.2.2
-Calls:          MIRACL functions,SM3_KDF
+Calls:          SM9_H_init,SM3_KDF_absorb,SM9_H_final
 Called By:      SM9_Verify
 Input:          Z:
 Zlen:the length of Z
@@ -366,50 +869,92 @@ n:Frobniues constant X
 Output:         h1=H1(Z,Zlen)
 Return:         0: success;
 1: asking for memory error
-Others:
+Others:         Z is hashed in place, the prefix is fed to SM3 separately
 ****************************************************************/
 int SM9_H1(unsigned char Z[], int Zlen, big n, big h1)
 {
-	int hlen, i, ZHlen;
-	big hh, i256, tmp, n1;
-	unsigned char *ZH = NULL, *ha = NULL;
+	SM3_KDF_CTX kdf;
 
-	hh = mirvar(0);
-	i256 = mirvar(0);
-	tmp = mirvar(0);
-	n1 = mirvar(0);
-	convert(1, i256);
-	ZHlen = Zlen + 1;
-
-	hlen = (int)ceil((5.0 * logb2(n)) / 32.0);
-	decr(n, 1, n1);//
-	ZH = (char *)malloc(sizeof(char) * (ZHlen + 1));
-	if (ZH == NULL)
+	SM9_H_init(&kdf, 0x01);
+	SM3_KDF_absorb(&kdf, Z, Zlen);
+	return SM9_H_final(&kdf, n, h1);
+}
+/****************************************************************
+Function:       SM9_H1_mb
+Description:    H1(ID_i||hid,n) of num identifications at once: the counter
+                blocks of every Ha=KDF(0x01||ID_i||hid,hlen) are jobs of
+                SM3_256_mb, so the identifications share the SIMD lanes
+Calls:          MIRACL functions,SM3_mb_job_init,SM3_mb_job_add,SM3_256_mb
+Called By:      SM9_verify_batch,Unsigncrypt_key,SM9_bcast_T
+Input:          ID:num identifications, C strings
+num:how many
+hid:one byte
+n:order of the groups
+Output:         h1:num values in [1,n-1]
+Return:         0: success;
+1: asking for memory error
+Others:         h1[i] is SM9_H1 of ID_i||hid, the pieces of a job are read
+in place so nothing is copied
+****************************************************************/
+int SM9_H1_mb(unsigned char *ID[], int num, unsigned char hid[], big n, big h1[])
+{
+	static const unsigned char prefix = 0x01;
+	unsigned char ctb[BNLEN * 2 / 32][4], *ha;
+	SM3_MB_JOB *jobs;
+	big n1, q;
+	char *mem;
+	int hlen, nb, i, k;
+
+	if (num <= 0)
+		return 0;
+	hlen = (5 * logb2(n) + 31) / 32;
+	if (hlen > BNLEN * 2)
 		return SM9_ASK_MEMORY_ERR;
-	memcpy(ZH + 1, Z, Zlen);
-	ZH[0] = 0x01;
-	ha = (char *)malloc(sizeof(char) * (hlen + 1));
-	if (ha == NULL)
+	nb = (hlen + 31) / 32;
+	jobs = (SM3_MB_JOB *)malloc(sizeof(SM3_MB_JOB) * num * nb);
+	ha = (unsigned char *)malloc((size_t)32 * num * nb);
+	mem = (char *)memalloc(2);
+	if (jobs == NULL || ha == NULL || mem == NULL)
+	{
+		if (mem != NULL)
+			memkill(mem, 2);
+		free(jobs);
+		free(ha);
 		return SM9_ASK_MEMORY_ERR;
-	SM3_KDF(ZH, ZHlen, hlen, ha);
+	}
+	n1 = mirvar_mem(mem, 0);
+	q = mirvar_mem(mem, 1);
+
+	for (k = 0; k < nb; k++)
+		SM3_STORE32(ctb[k], (uint32_t)(k + 1));
+	for (i = 0; i < num; i++)
+		for (k = 0; k < nb; k++)
+		{
+			SM3_mb_job_init(&jobs[i * nb + k], ha + 32 * (i * nb + k));
+			SM3_mb_job_add(&jobs[i * nb + k], &prefix, 1);
+			SM3_mb_job_add(&jobs[i * nb + k], ID[i], strlen((char *)ID[i]));
+			SM3_mb_job_add(&jobs[i * nb + k], hid, 1);
+			SM3_mb_job_add(&jobs[i * nb + k], ctb[k], 4);
+		}
+	SM3_256_mb(jobs, num * nb);
 
-	for (i = hlen - 1; i >= 0; i--) //key[???]
+	decr(n, 1, n1);
+	for (i = 0; i < num; i++)
 	{
-		premult(i256, ha[i], tmp);
-		add(hh, tmp, hh);//hh=tmp+hh
-		premult(i256, 256, i256);
-		divide(i256, n1, tmp);
-		divide(hh, n1, tmp);
+		bytes_to_big(hlen, ha + 32 * nb * i, h1[i]);
+		divide(h1[i], n1, q); //h=Ha mod (n-1)
+		incr(h1[i], 1, h1[i]);
 	}
-	incr(hh, 1, h1);
-	free(ZH);
+
+	memkill(mem, 2);
+	free(jobs);
 	free(ha);
 	return 0;
 }
 /****************************************************************
 Function:       SM9_H2
 Description:    function H2 in SM9 standard 5.4.2.3
-Calls:          MIRACL functions,SM3_KDF
+Calls:          SM9_H_init,SM3_KDF_absorb,SM9_H_final
 Called By:      SM9_Sign,SM9_Verify
 Input:          Z:
 Zlen:the length of Z
@@ -417,45 +962,15 @@ n:Frobniues constant X
 Output:         h2=H2(Z,Zlen)
 Return:         0: success;
 1: asking for memory error
-Others:
+Others:         Z is hashed in place, the prefix is fed to SM3 separately
 ****************************************************************/
 int SM9_H2(unsigned char Z[], int Zlen, big n, big h2)
 {
-	int hlen, ZHlen, i;
-	big hh, i256, tmp, n1;
-	unsigned char *ZH = NULL, *ha = NULL;
+	SM3_KDF_CTX kdf;
 
-	hh = mirvar(0);
-	i256 = mirvar(0);
-	tmp = mirvar(0);
-	n1 = mirvar(0);
-	convert(1, i256);
-	ZHlen = Zlen + 1;
-
-	hlen = (int)ceil((5.0 * logb2(n)) / 32.0);
-	decr(n, 1, n1);
-	ZH = (char *)malloc(sizeof(char) * (ZHlen + 1));
-	if (ZH == NULL)
-		return SM9_ASK_MEMORY_ERR;
-	memcpy(ZH + 1, Z, Zlen);
-	ZH[0] = 0x02;
-	ha = (char *)malloc(sizeof(char) * (hlen + 1));
-	if (ha == NULL)
-		return SM9_ASK_MEMORY_ERR;
-	SM3_KDF(ZH, ZHlen, hlen, ha);
-
-	for (i = hlen - 1; i >= 0; i--) //key[???]
-	{
-		premult(i256, ha[i], tmp);
-		add(hh, tmp, hh);
-		premult(i256, 256, i256);
-		divide(i256, n1, tmp);
-		divide(hh, n1, tmp);
-	}
-	incr(hh, 1, h2);
-	free(ZH);
-	free(ha);
-	return 0;
+	SM9_H_init(&kdf, 0x02);
+	SM3_KDF_absorb(&kdf, Z, Zlen);
+	return SM9_H_final(&kdf, n, h2);
 }
 
 /****************************************************************
@@ -464,6 +979,7 @@ Description:    Generate Signed key
 Calls:          MIRACL functions,SM9_H1,xgcd,ecn2_Bytes128_Print
 Called By:      SM9_SelfCheck
 Input:          
+0	ctx:context of the calling thread
 1	hid:0x01
 2	ID:identification
 3	IDlen:the length of ID
@@ -473,17 +989,20 @@ Output:
 2	dSA: signature private key
 Return:         0: success;
 1: asking for memory error
+SM9_CTX_ERR: ctx belongs to another thread
 Others:
 ****************************************************************/
-int SM9_GenerateSignKey(unsigned char hid[], unsigned char *ID, int IDlen, big ks, 
+int SM9_GenerateSignKey(SM9_CTX *ctx, unsigned char hid[], unsigned char *ID, int IDlen, big ks, 
 	unsigned char Ppubs[], unsigned char dsa[], unsigned char skid[])
 {
 	big h1, t1, t2, rem, xdSA, ydSA, tmp;
 	unsigned char *Z = NULL;
 	int Zlen = IDlen + 1, buf;
-	ecn2 Ppub; //in G2
+	ecn2 Ppub, skIDr; //in G2
 	epoint *dSA; //in G1
 
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
 	h1 = mirvar(0);
 	t1 = mirvar(0);
 	t2 = mirvar(0);
@@ -513,6 +1032,7 @@ int SM9_GenerateSignKey(unsigned char hid[], unsigned char *ID, int IDlen, big k
 	memcpy(Z, ID, IDlen);//Z=ID ַ
 	memcpy(Z + IDlen, hid, 1); //hid׷ӵID
 	buf = SM9_H1(Z, Zlen, N, h1);//h1ϣõbuf=H1(IDR||hid,N)
+	free(Z);
 	cotnum(h1, stdout);
 	if (buf != 0)
 		return buf;
@@ -550,7 +1070,6 @@ int SM9_GenerateSignKey(unsigned char hid[], unsigned char *ID, int IDlen, big k
 	redc(Ppub.y.a, tmp);
 	big_to_bytes(BNLEN, tmp, Ppubs + BNLEN * 3, 1);
 
-	free(Z);
 	return 0;
 }
 
@@ -823,8 +1342,8 @@ int SM9_GenerateSignKey(unsigned char hid[], unsigned char *ID, int IDlen, big k
 
 
 /****************************************************************
-Function:Signcrypt
-Description: SM9 encryption algorithm Calls:
+Function:Signcrypt_work
+Description: SM9 encryption algorithm, the body of Signcrypt Calls:
 Called By:
 Input:MIRACL functions,zzn12_init(),ecap(),member(),zzn12_ElementPrint(), zzn12_pow(),LinkCharZzn12(),SM3_KDF(),SM9_Enc_MAC(),SM4_Block_Encrypt() SM9_SelfCheck()
 hid:0x03 IDB
@@ -833,80 +1352,44 @@ rand EncID
 k1_len k2_len Ppubs
 Output: Return:
 0: success 1: asking for memory error 2: element is out of order q 3: R-ate calculation error A: K1 equals 0
-Others:
+Others: its bigs, points and zzn12 are taken from the arena, Signcrypt gives them back
 ****************************************************************/
-int Signcrypt(unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int IDlen, 
-	unsigned char *message, int mlen,unsigned char H[], unsigned char S[], unsigned char T[], unsigned char C[],
+static int Signcrypt_work(SM9_CTX *ctx, unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int IDlen, 
+	unsigned char *message, size_t mlen,unsigned char H[], unsigned char S[], unsigned char T[], unsigned char C[],
 	unsigned char skID[], big ks, unsigned char Ppub[])
 {
-	printf("-----------------------------------begin----------------------------\n");
-	big h1, r, h, l, xQB, yQB,x,y,t1,t2,rem,C2_b;
+	big h1, r, h, l, t1, t2, rem;
 	big xS, yS, xT, yT, tmp, zero;
 	zzn12 g, w;
-	epoint  *dSA, *QB,*skID_s,*P_temp;//skIDs:˽Կ s:ǩ
-	ecn2 Ppube;
-	ecn2 skIDs;
-	int Zlen,Zlens=IDlen+1, buf,klen;//ZlensΪIDSַ
-	unsigned char *Z = NULL,*Z1 = NULL,*C2 = NULL, *K = NULL;
+	ecap_lines *L;
+	epoint s, t, QB, P_temp;
+	int buf;
+	SM3_KDF_CTX kdf, hv;
 
 	//initiate
-	h1 = mirvar(0);
-	x = mirvar(0);
-	y = mirvar(0);
-	r = mirvar(0);
-	h = mirvar(0);
-	l = mirvar(0);
-	t1 = mirvar(0); 
-	t2  = mirvar(0);
-	rem = mirvar(0);
-	tmp = mirvar(0);
-	zero = mirvar(0);
-	xS = mirvar(0);
-	yS = mirvar(0);
-	xT = mirvar(0);
-	yT = mirvar(0);
-	xQB = mirvar(0);
-	yQB = mirvar(0);
-	C2_b = mirvar(0);
-	s = epoint_init();
-	t = epoint_init();
-	dSA = epoint_init();
-	QB = epoint_init();
-	P_temp = epoint_init();
-	skID_s = epoint_init();
-	Ppube.x.a = mirvar(0);
-	Ppube.x.b = mirvar(0);
-	Ppube.y.a = mirvar(0);
-	Ppube.y.b = mirvar(0);
-	Ppube.z.a = mirvar(0);
-	Ppube.z.b = mirvar(0);
-	Ppube.marker = MR_EPOINT_INFINITY;
-
-	skIDs.x.a = mirvar(0);
-	skIDs.x.b = mirvar(0);
-	skIDs.y.a = mirvar(0);
-	skIDs.y.b = mirvar(0);
-	skIDs.z.a = mirvar(0);
-	skIDs.z.b = mirvar(0);
-	skIDs.marker = MR_EPOINT_INFINITY;
-
-	bytes128_to_ecn2(Ppub, &Ppube);
-
-	zzn12_init(&g);
-	zzn12_init(&w);
-	bytes_to_big(BNLEN, Ppub, x); 
-	bytes_to_big(BNLEN, Ppub + BNLEN, y);
-	//Ppub=[ks]P2
-	ecn2_copy(&P2, &Ppube);
-	ecn2_mul(ks, &Ppube);
-	//skIDs
-	Z1 = (char *)malloc(sizeof(char) * (Zlens + 1));
-	if (!(Z1))
-		return 1;
-	memcpy(Z1, IDS, IDlen);//Z=ID ַ
-	memcpy(Z1 + IDlen, hid, 1); //hid׷ӵID
-
-	buf = SM9_H1(Z1, Zlens, N, h1);//h1ϣõbuf=H1(IDR||hid,N)
+	h1 = SM9_tmp();
+	r = SM9_tmp();
+	h = SM9_tmp();
+	l = SM9_tmp();
+	t1 = SM9_tmp();
+	t2 = SM9_tmp();
+	rem = SM9_tmp();
+	tmp = SM9_tmp();
+	zero = SM9_tmp();
+	xS = SM9_tmp();
+	yS = SM9_tmp();
+	xT = SM9_tmp();
+	yT = SM9_tmp();
+	SM9_tmp_point(&s);
+	SM9_tmp_point(&t);
+	SM9_tmp_point(&QB);
+	SM9_tmp_point(&P_temp);
+
+	//t2=ks*(H1(IDS||hid,N)+ks)^(-1), dSA=[t2]P1 is the signing key of IDS
+	SM9_H_init(&hv, 0x01);
+	SM3_KDF_absorb(&hv, IDS, IDlen);
+	SM3_KDF_absorb(&hv, hid, 1);
+	buf = SM9_H_final(&hv, N, h1);
 	if (buf != 0)
 		return buf;
 	add(h1, ks, t1);         //t1=H1(IDS||hid,N)+ks
@@ -914,67 +1397,55 @@ int Signcrypt(unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int I
 	multiply(ks, t1, t2);
 	divide(t2, N, rem); //t2=ks*t1(-1)
 
-	ecn2_copy(&P2, &skIDs);
-	ecn2_mul(t2, &skIDs); //skID=[ks]P2
-	printf("\n*********************The encrypted private  key skIDs = (xskID, yskID): *********************\n");
-	ecn2_Bytes128_Print(skIDs);//˽Կ
-	free(Z1);
-
-	
 	//A0:  g=e(P1,Ppub)
-	printf("\n================testppub=====================\n");
-	ecn2_Bytes128_Print(Ppube);
 
-	if (!ecap(Ppube, P1, para_t, X, &g)) 
-		return SM9_MY_ECAP_12A_ERR;
-	//test if a ZZn12 element is of order q 
-	if(!member(g, para_t, X)) 
-		return SM9_MEMBER_ERR; 
-	printf("\n***********************g=e(P1,Ppub):****************************\n"); 
-	zzn12_ElementPrint(g);
+	//g only depends on Ppub, it is kept in the context with the lines of Ppub
+	buf = SM9_pub_lines(ctx, Ppub, &L, &g);
+	if (buf != 0)
+		return buf;
 
 	//A1: calculate QB=H1(idR||hid,N))P1+[ks]p1
-	Zlen = strlen(IDR) + 1;
-	Z = (char *)malloc(sizeof(char)*(Zlen + 1));
-	if (Z == NULL) 
-		return SM9_ASK_MEMORY_ERR;
-	memcpy(Z, IDR, strlen(IDR)); //ַ
-	memcpy(Z + strlen(IDR), hid, 1); //hid׷ӵID 
-	buf = SM9_H1(Z, Zlen, N, h); //h1ϣõbuf=h=H1(IDR||hid,N)
-	//if (buf)
-	//	return buf;
-	ecurve_mult(h, P1, QB); //QB=[h]P1
-	ecurve_mult(ks, P1, P_temp);//P_temp=[ks]P1
-	ecurve_add(P_temp, QB);//QB=H1(idR||hid,N))P1+[ks]p1
-	printf("\n*******************QB=H1(idR||hid,N))P1+[ks]p1*****************\n");
-	epoint_get(QB, xQB, yQB);
-	cotnum(xQB, stdout);
-	cotnum(yQB, stdout);
-	free(Z);
+	SM9_H_init(&hv, 0x01);
+	SM3_KDF_absorb(&hv, IDR, strlen(IDR));
+	SM3_KDF_absorb(&hv, hid, 1);
+	buf = SM9_H_final(&hv, N, h);
+	if (buf != 0)
+		return buf;
+	ecurve_mult(h, P1, &QB); //QB=[h]P1
+	ecurve_mult(ks, P1, &P_temp);//P_temp=[ks]P1
+	ecurve_add(&P_temp, &QB);//QB=H1(idR||hid,N))P1+[ks]p1
 
 	//A2: randnom
-	bytes_to_big(BNLEN, rand, r); 
-	bigrand(N, r);
-	printf("\n***********************randnum r:********************************\n"); 
-	cotnum(r, stdout);
+	do
+		strong_bigrand(&ctx->rng, N, r);
+	while (size(r) == 0);
 	
 	//A3: w=g^r
 	w = zzn12_pow(g, r);
-	printf("\n***************************w=g^r:**********************************\n"); 
-	zzn12_ElementPrint(w);
 	
-	//A4: calculate h=H2(M||w,N)
-	Zlen = mlen + 32 * 12;
-	Z = (char *)malloc(sizeof(char) * (Zlen + 1));
-	if (Z == NULL)
-		return SM9_ASK_MEMORY_ERR;
+	//A7: G1ԪT = rQ
+	ecurve_mult(r, &QB, &t);
+	epoint_get(&t, xT, yT);
+	big_to_bytes(32, xT, T, 1);
+	big_to_bytes(32, yT, T + 32, 1);
 
-	LinkCharZzn12(message, mlen, w, Z, Zlen);//Z=w||message
-	buf = SM9_H2(Z, Zlen, N, h);
+	//A4 and A8 share one pass over M, T does not depend on h so it is computed first
+	//A4: calculate h=H2(M||w,N)
+	//A8: C=M XOR KDF(T||w||IDR,mlen), or from SM9_DEM_THRESHOLD bytes on
+	//    C=SM4-GCM(K1,K2,M)||tag with K1||K2=KDF(T||w||IDR,28)
+	SM3_KDF_init(&kdf);
+	SM3_KDF_absorb(&kdf, T, BNLEN * 2);
+	SM9_absorb_zzn12(&kdf, w);
+	SM3_KDF_absorb(&kdf, IDR, strlen(IDR));
+	SM9_H_init(&hv, 0x02);
+	if (mlen >= SM9_DEM_THRESHOLD)
+		SM9_DEM_encrypt(&kdf, &hv, message, mlen, C);
+	else
+		SM3_KDF_xor(&kdf, &hv, message, C, mlen, 0);
+	SM9_absorb_zzn12(&hv, w);
+	buf = SM9_H_final(&hv, N, h);
 	if (buf != 0)
 		return buf;
-	printf("\n****************************h:*************************************\n");
-	cotnum(h, stdout);
 
 	//A5: l=(r-h)mod N
 	subtract(r, h, l);
@@ -983,213 +1454,417 @@ int Signcrypt(unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int I
 		add(l, N, l);
 	if (mr_compare(l, zero) == 0)
 		return SM9_L_error;
-	printf("\n**************************l=(r-h)mod N:****************************\n");
-	cotnum(l, stdout);
 	
 	//A6: G1ԪS=[l][t2]p1
-	ecurve_mult(t2, P1, s);//s= [t2]P1
-	ecurve_mult(l, s, s);//s= l*[t2]P1
-	epoint_get(s, xS, yS);
-	printf("\n**************************S=[l]dSA=(xS,yS):*************************\n");
-	cotnum(xS, stdout);
-	cotnum(yS, stdout);
+	ecurve_mult(t2, P1, &s);//s= [t2]P1
+	ecurve_mult(l, &s, &s);//s= l*[t2]P1
+	epoint_get(&s, xS, yS);
 	big_to_bytes(32, xS, S, 1);
 	big_to_bytes(32, yS, S + 32, 1);
-	
-	//A7: G1ԪT = rQ
-	ecurve_mult(r, QB, t);//s= l*[t2]P1
-	epoint_get(t, xT, yT);
-	big_to_bytes(32, xT, T, 1);
-	big_to_bytes(32, yT, T + 32, 1);
-	printf("\n**************************T = [r]Q=(xT,yT):*************************\n");
-	cotnum(xT, stdout);
-	cotnum(yT, stdout);
-	free(Z);
+	return 0;
 
-	//A8: ش c XOR H3(T||w||IDR)
-	klen= mlen+32; 
-	Zlen=strlen(IDR) + BNLEN*14; 
-	Z=(char *)malloc(sizeof(char)*(Zlen+1)); 
-	K=(char *)malloc(sizeof(char)*(klen+1)); 
-	C2=(char *)malloc(sizeof(char)*(mlen+1)); 
-	if(Z==NULL|| K==NULL|| C2==NULL) 
-		return SM9_ASK_MEMORY_ERR;
-	LinkCharZzn12(t, BNLEN * 2, w, Z, (Zlen - strlen(IDR))); 
-	memcpy(Z + BNLEN * 14, IDR, strlen(IDR)); 
-	SM3_KDF(Z, Zlen, klen, K); 
-	printf("\n*****************K=KDF(T||w||IDR),klen):***********************\n"); 
-	for (int i = 0; i<klen; i++) 
-		printf("%02x", K[i]);
-	printf("\n   calculate C2=M^K1   \n");
-
-
-	printf("\n*****************c XOR H3(T||w||IDR) :***********************\n");
-	for (int i = 0; i<mlen; i++) {
-		int j = 0;
-		if (K[i] == 0) j = j + 1;
-		C2[i] = message[i] ^ K[i];
+}
+
+/****************************************************************
+Function:       Signcrypt
+Description:    SM9 signcryption, Signcrypt_work between a mark of the arena
+                and its release, so that a call leaves no temporary behind
+Calls:          Signcrypt_work,SM9_arena_mark,SM9_arena_release
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                hid,IDR,IDS,IDlen,message,mlen,skID,ks,Ppub  //as Signcrypt_work
+Output:
+                H,S,T,C      //the signcryption
+Return:
+                as Signcrypt_work
+                SM9_ASK_MEMORY_ERR: the arena ran out, see SM9_ARENA_NO_HEAP
+                SM9_CTX_ERR: ctx belongs to another thread
+Others:
+****************************************************************/
+int Signcrypt(SM9_CTX *ctx, unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int IDlen,
+	unsigned char *message, size_t mlen, unsigned char H[], unsigned char S[], unsigned char T[], unsigned char C[],
+	unsigned char skID[], big ks, unsigned char Ppub[])
+{
+	int mark, buf;
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	mark = SM9_arena_mark();
+	buf = Signcrypt_work(ctx, hid, IDR, IDS, IDlen, message, mlen, H, S, T, C, skID, ks, Ppub);
+	if (!SM9_arena_release(mark) && buf == 0)
+		buf = SM9_ASK_MEMORY_ERR;
+	return buf;
+}
+
+
+/****************************************************************
+Function:       SM9_G1_mul_glv
+Description:    R=[k]P in G1 with the endomorphism (x,y)->(beta*x,y), which is
+                [lambda] on G1: k=k0+k1*lambda mod N with k0,k1 of half the
+                length of N, and one double multiplication [k0]P+[k1](beta*x,y)
+Calls:          MIRACL functions,SM9_arena_mark,SM9_tmp,SM9_tmp_point,SM9_arena_release
+Called By:      Unsigncrypt_work,SM9_sc_branch,Signcrypt_parallel
+Input:
+                k            //0<=k<N
+                P            //point of G1
+Output:
+                R
+Return:
+                NULL
+Others:         c1=floor(k*A/N), c2=floor(k*B/N), k0=k-c1*A-c2*C, k1=c1*B-c2*A
+                with the basis set up by SM9_Init
+****************************************************************/
+void SM9_G1_mul_glv(big k, epoint *P, epoint *R)
+{
+	big c1, c2, k0, k1, x, y, tmp;
+	epoint P0, Q;
+	int mark;
+
+	if (point_at_infinity(P))
+	{
+		epoint_copy(P, R);
+		return;
 	}
-	for (int i = 0; i < strlen(message); i++)
+	mark = SM9_arena_mark();
+	c1 = SM9_tmp();
+	c2 = SM9_tmp();
+	k0 = SM9_tmp();
+	k1 = SM9_tmp();
+	x = SM9_tmp();
+	y = SM9_tmp();
+	tmp = SM9_tmp();
+	SM9_tmp_point(&P0);
+	SM9_tmp_point(&Q);
+
+	multiply(k, glv_A, tmp);
+	divide(tmp, N, c1);
+	multiply(k, glv_B, tmp);
+	divide(tmp, N, c2);
+	multiply(c1, glv_A, tmp);
+	subtract(k, tmp, k0);
+	multiply(c2, glv_C, tmp);
+	subtract(k0, tmp, k0);
+	multiply(c1, glv_B, k1);
+	multiply(c2, glv_A, tmp);
+	subtract(k1, tmp, k1);
+
+	epoint_copy(P, &P0);
+	epoint_get(P, x, y);
+	multiply(x, glv_beta, x);
+	divide(x, para_q, tmp);
+	epoint_set(x, y, 0, &Q);
+	if (size(k0) < 0)
 	{
-		printf("%02x", message[i]);
+		negify(k0, k0);
+		epoint_negate(&P0);
 	}
-	printf("\n");
-	//C = (char *)malloc(sizeof(char)*(mlen + 1));
-	memcpy(C,C2,strlen(message));
-	for (int i = 0; i < strlen(message); i++)
+	if (size(k1) < 0)
 	{
-		printf("%02x", C[i]);
+		negify(k1, k1);
+		epoint_negate(&Q);
 	}
+	ecurve_mult2(k0, &P0, k1, &Q, R);
 
-	free(Z); 
-	free(K); 
-	free(C2);
-//	free(C);
-	return 0;
-
+	SM9_arena_release(mark);
 }
 
+/****************************************************************
+Function:       SM9_pub_lines
+Description:    lines of the Miller loop of Ppub and g=e(P1,Ppub), they only
+                depend on the master public key and are kept until Ppub changes
+Calls:          MIRACL functions,bytes128_to_ecn2,ecap_prep,ecap_fixed,member,
+                ecap_lines_free,zzn12_init,zzn12_kill
+Called By:      Signcrypt_work,Unsigncrypt_work,Signcrypt_parallel,SM9_pool_pairing
+Input:
+                ctx          //context of the calling thread, keeps the result
+                Ppub         //master public key [ks]P2, 128 bytes
+Output:
+                L            //the lines of Ppub
+                g            //e(P1,Ppub)
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_GEPUB_ERR: Ppub is not a point of G2
+                SM9_MY_ECAP_12A_ERR: R-ate calculation error
+                SM9_MEMBER_ERR: the order of g is error
+Others:         *L and g are only valid until the next call on ctx with another
+                Ppub, or SM9_ctx_free
+****************************************************************/
+int SM9_pub_lines(SM9_CTX *ctx, unsigned char Ppub[], ecap_lines **L, zzn12 *g)
+{
+	ecn2 Ppubs;
+	char *mem;
+	int buf = 0;
 
-int Unsigncrypt(unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int IDlen,
-	unsigned char *message, int mlen,  unsigned char S[], unsigned char T[], unsigned char C[],
-	unsigned char skID[], big ks, unsigned char Ppub[])
+	if (!ctx->pub_ok || memcmp(ctx->Ppub, Ppub, BNLEN * 4) != 0)
+	{
+		if (ctx->pub_ok)
+		{
+			ecap_lines_free(&ctx->L);
+			zzn12_kill(&ctx->g);
+			ctx->pub_ok = FALSE;
+		}
+		mem = (char *)memalloc(6);
+		if (mem == NULL)
+			return SM9_ASK_MEMORY_ERR;
+		Ppubs.x.a = mirvar_mem(mem, 0);
+		Ppubs.x.b = mirvar_mem(mem, 1);
+		Ppubs.y.a = mirvar_mem(mem, 2);
+		Ppubs.y.b = mirvar_mem(mem, 3);
+		Ppubs.z.a = mirvar_mem(mem, 4);
+		Ppubs.z.b = mirvar_mem(mem, 5);
+		Ppubs.marker = MR_EPOINT_INFINITY;
+		zzn12_init(&ctx->g);
+
+		if (!bytes128_to_ecn2(Ppub, &Ppubs) || !ecap_prep(Ppubs, para_t, X, &ctx->L))
+			buf = SM9_GEPUB_ERR;
+		else if (!ecap_fixed(&ctx->L, P1, para_t, X, &ctx->g))
+			buf = SM9_MY_ECAP_12A_ERR;
+		else if (!member(ctx->g, para_t, X))
+			buf = SM9_MEMBER_ERR;
+		memkill(mem, 6);
+		if (buf != 0)
+		{
+			ecap_lines_free(&ctx->L);
+			zzn12_kill(&ctx->g);
+			return buf;
+		}
+		memcpy(ctx->Ppub, Ppub, BNLEN * 4);
+		ctx->pub_ok = TRUE;
+	}
+	*L = &ctx->L;
+	*g = ctx->g;
+	return 0;
+}
+
+/****************************************************************
+Function:       Unsigncrypt_work
+Description:    SM9 unsigncryption, M' is written to the buffer of the caller
+                and the signature part is checked: [e(S,P)]g^h' must be w'
+Calls:          MIRACL functions,bytes128_to_ecn2,ecap,zzn12_pow,zzn12_mul,
+                SM9_pub_lines,SM9_G1_mul_glv,ecap_multi,SM9_H_init,SM9_H_final,
+                SM3_KDF_init,SM3_KDF_absorb,SM3_KDF_xor,SM9_DEM_decrypt,
+                SM9_absorb_zzn12,zzn12_to_bytes384,SM9_tmp_point
+Called By:      Unsigncrypt_w
+Input:
+                ctx,hid,IDR,IDS,mlen,S,T,C,skID,Ppub  //as Unsigncrypt
+Output:
+                M_           //M', mlen bytes, Unsigncrypt_w zeroes it on error
+                w            //zzn12_to_bytes384 of the checked w', not written when NULL
+Return:
+                0: success
+                SM9_ASK_MEMORY_ERR: can not get memory
+                SM9_T_NOT_VALID_G1: T is not on the curve
+                SM9_S_NOT_VALID_G1: S is not on the curve
+                SM9_GEPRI_ERR: skID is not a point of G2
+                SM9_GEPUB_ERR: Ppub is not a point of G2
+                SM9_MY_ECAP_12A_ERR: R-ate calculation error
+                SM9_MEMBER_ERR: the order of g is error
+                SM9_DEM_TAG_ERR: SM4-GCM tag of C does not match
+                SM9_DATA_MEMCMP_ERR: [e(S,P)]g^h' is not w'
+Others:         the bigs, points and zzn12 are taken from the arena, and ID||hid is
+                hashed in place, so a call makes no heap allocation
+****************************************************************/
+static int Unsigncrypt_work(SM9_CTX *ctx, unsigned char hid[], unsigned char *IDR, unsigned char *IDS,
+	size_t mlen, unsigned char S[], unsigned char T[], unsigned char C[], unsigned char skID[],
+	unsigned char Ppub[], unsigned char M_[], unsigned char w[])
 {
-	big h_,h;
+	big h_, h, x, y;
+	ecn2 de;
 	zzn12 g_, w_,w_1, t_, w_fin;			//ڼw't=g^(h')
-	ecn2 P,Ppubs;
-	int klen,Zlen,buf;
-	unsigned char *Z = NULL, *Z1 = NULL, *C2 = NULL, *K = NULL, *M_ = NULL;
-	printf("\n--------------------------------begin B------------------------------------\n");
+	ecap_lines *L[2];
+	epoint Qp[2], *Q[2], t;
+	int buf;
+	unsigned char wb[BNLEN * 12], wb_fin[BNLEN * 12];
+	SM3_KDF_CTX kdf, hv;
 		
 	//init
-	h = mirvar(0);
-	h_ = mirvar(0);
-	zzn12_init(&g_);
-	zzn12_init(&w_);
-	zzn12_init(&w_1);
-	zzn12_init(&t_);
-	zzn12_init(&w_fin);
-	P.x.a = mirvar(0);
-	P.x.b = mirvar(0);
-	P.y.a = mirvar(0);
-	P.y.b = mirvar(0);
-	P.z.a = mirvar(0);
-	P.z.b = mirvar(0);
-	Ppubs.x.a = mirvar(0);
-	Ppubs.x.b = mirvar(0);
-	Ppubs.y.a = mirvar(0);
-	Ppubs.y.b = mirvar(0);
-	Ppubs.z.a = mirvar(0);
-	Ppubs.z.b = mirvar(0);
-	Ppubs.marker = MR_EPOINT_INFINITY;
-	P.marker = MR_EPOINT_INFINITY;
-
-	bytes128_to_ecn2(Ppub, &Ppubs);
-
-
-
-	//B1: w' = e(T, skIDr)
-	if (!ecap(skIDr, t, para_t, X, &w_))
+	h = SM9_tmp();
+	h_ = SM9_tmp();
+	x = SM9_tmp();
+	y = SM9_tmp();
+	de.x.a = SM9_tmp();
+	de.x.b = SM9_tmp();
+	de.y.a = SM9_tmp();
+	de.y.b = SM9_tmp();
+	de.z.a = SM9_tmp();
+	de.z.b = SM9_tmp();
+	de.marker = MR_EPOINT_INFINITY;
+	zzn12_tmp(&w_);
+	zzn12_tmp(&w_1);
+	zzn12_tmp(&t_);
+	zzn12_tmp(&w_fin);
+	SM9_tmp_point(&t);
+	SM9_tmp_point(&Qp[0]);
+	SM9_tmp_point(&Qp[1]);
+	Q[0] = &Qp[0];
+	Q[1] = &Qp[1];
+
+	//B1: w' = e(T, skIDr), T and skID come as bytes, nothing is left by the sender
+	if (!bytes128_to_ecn2(skID, &de))
+		return SM9_GEPRI_ERR;
+	bytes_to_big(BNLEN, T, x);
+	bytes_to_big(BNLEN, T + BNLEN, y);
+	if (!epoint_set(x, y, 0, &t))
+		return SM9_T_NOT_VALID_G1;
+	if (!ecap(de, &t, para_t, X, &w_))
 		return SM9_MY_ECAP_12A_ERR;
-	printf("\n=====================w' = e(T, skIDr):====================\n");
-	zzn12_ElementPrint(w_);
-
-	//B2: M'=c XOR H3(T||w'||IDR)
-	klen = mlen + 32;
-	Zlen = strlen(IDR) + BNLEN * 14;
-	Z = (char *)malloc(sizeof(char)*(Zlen + 1));
-	K = (char *)malloc(sizeof(char)*(klen + 1));
-	M_ = (char *)malloc(sizeof(char)*(mlen + 1));
-	//if (Z == NULL || K == NULL || C2 == NULL)
-	//	return SM9_ASK_MEMORY_ERR;
-	LinkCharZzn12(t, BNLEN * 2, w_, Z, (Zlen - strlen(IDR)));
-	memcpy(Z + BNLEN * 14, IDR, strlen(IDR));
-	SM3_KDF(Z, Zlen, klen, K);
-	printf("\n=====================K=KDF(T||w||IDR),klen):=====================\n");
-	for (int i = 0; i<klen; i++)
-		printf("%02x", K[i]);
-	//printf("\n   calculate C2=M^K1   \n");
-
-
-	printf("\n=====================c XOR H3(T||w||IDR) :=====================\n");
-	for (int i = 0; i<mlen; i++) {
-		int j = 0;
-		if (K[i] == 0) j = j + 1;
-		M_[i] = C[i] ^ K[i];
-	}
-	for (int i = 0; i < strlen(M_); i++)
+
+	//B2: M'=c XOR H3(T||w'||IDR), or SM4-GCM decryption of c and its tag from SM9_DEM_THRESHOLD bytes on
+	SM3_KDF_init(&kdf);
+	SM3_KDF_absorb(&kdf, T, BNLEN * 2);
+	SM9_absorb_zzn12(&kdf, w_);
+	SM3_KDF_absorb(&kdf, IDR, strlen(IDR));
+
+	//B3: h'=H2(M'||w',N), M' is hashed in the same pass that computes it
+	SM9_H_init(&hv, 0x02);
+	if (mlen >= SM9_DEM_THRESHOLD)
 	{
-		printf("%02x", M_[i]);
+		buf = SM9_DEM_decrypt(&kdf, &hv, C, mlen, M_);
+		if (buf != 0)
+			return buf;
 	}
-	printf("\n");
-	//C = (char *)malloc(sizeof(char)*(mlen + 1));
-	//memcpy(C, C2, strlen(message));
-	//for (int i = 0; i < strlen(message); i++)
-	//{
-	//	printf("%02x", C[i]);
-	//}
-	free(Z);
-	free(K);
-	
-
-	//B3: h'=H2(M'||w',N)
-	Zlen = mlen + 32 * 12;
-	Z = (char *)malloc(sizeof(char) * (Zlen + 1));
-	if (Z == NULL)
-		return SM9_ASK_MEMORY_ERR;
-	LinkCharZzn12(M_, mlen, w_, Z, Zlen);//Z=w||message
-	buf = SM9_H2(Z, Zlen, N, h_);
+	else
+		SM3_KDF_xor(&kdf, &hv, C, M_, mlen, 1);
+	SM9_absorb_zzn12(&hv, w_);
+	buf = SM9_H_final(&hv, N, h_);
 	if (buf != 0)
 		return buf;
-	printf("\n****************************h':*************************************\n");
-	cotnum(h_, stdout);
-	free(Z);
 
-	//A0:  g=e(P1,Ppub)
-	printf("\n================testppub=====================\n");
-	ecn2_Bytes128_Print(Ppubs);
-	if (!ecap(Ppubs, P1, para_t, X, &g_))
-		return SM9_MY_ECAP_12A_ERR;
-	//test if a ZZn12 element is of order q 
-	if (!member(g_, para_t, X))
-		return SM9_MEMBER_ERR;
-	printf("\n***********************g=e(P1,Ppub):****************************\n");
-	zzn12_ElementPrint(g_);
+	//A0: g=e(P1,Ppub) and the lines of Ppub, kept from the last call with the same Ppub
+	buf = SM9_pub_lines(ctx, Ppub, &L[1], &g_);
+	if (buf != 0)
+		return buf;
+	L[0] = &P2_lines;
 
 	//B4: GTԪt=g^(h')
 	t_ = zzn12_pow(g_, h_);
-	printf("\n***************************t=g^(h'):**********************************\n");
-	zzn12_ElementPrint(t_);
 
-	//B5: G2ԪP = H1(IDS||hid,N)+Ppub
-	Zlen = strlen(IDS) + 1;
-	Z = (char *)malloc(sizeof(char)*(Zlen + 1));
-	if (Z == NULL)
-		return SM9_ASK_MEMORY_ERR;
-	memcpy(Z, IDS, strlen(IDS)); //ַ
-	memcpy(Z + strlen(IDS), hid, 1); //hid׷ӵID 
-	buf = SM9_H1(Z, Zlen, N, h); //h1ϣõbuf=h=H1(IDS||hid,N)
-	 if (buf)
-		 	return buf;
-
-	ecn2_copy(&P2, &P);
-	ecn2_mul(h, &P); //skID=[H1(IDS||hid,N)]P2
-	ecn2_add(&Ppubs, &P);//P = [H1(IDS||hid,N)]P2+Ppub
-	printf("\n*******************P = [H1(IDS||hid,N)]P2+Ppub*****************\n");
-	ecn2_Bytes128_Print(P);
-	free(Z);
-	
-	//B6: [e(S,P)]t=w'Ƿ
-	ecap(P, s, para_t, X, &w_1);
+	//B5: h1=H1(IDS||hid,N), P=[h1]P2+Ppub itself is never formed, see B6
+	SM9_H_init(&hv, 0x01);
+	SM3_KDF_absorb(&hv, IDS, strlen(IDS));
+	SM3_KDF_absorb(&hv, hid, 1);
+	buf = SM9_H_final(&hv, N, h);
+	if (buf)
+		return buf;
+
+	//B6: e(S,P) = e(S,[h1]P2+Ppub) = e([h1]S,P2)*e(S,Ppub), both G2 points are fixed
+	//and their lines are ready, [h1]S is one GLV multiplication in G1
+	bytes_to_big(BNLEN, S, x);
+	bytes_to_big(BNLEN, S + BNLEN, y);
+	if (!epoint_set(x, y, 0, Q[1]))
+		return SM9_S_NOT_VALID_G1;
+	SM9_G1_mul_glv(h, Q[1], Q[0]);
+	if (!ecap_multi(2, L, Q, para_t, X, &w_1))
+		return SM9_MY_ECAP_12A_ERR;
 	zzn12_mul(w_1,t_,&w_fin);
-	printf("\n*******************FINAL-WFIN*****************\n");
 
-	zzn12_ElementPrint(w_fin);
-	printf("\n*******************FINAL-W    *****************\n");
+	zzn12_to_bytes384(w_fin, wb_fin);
+	zzn12_to_bytes384(w_, wb);
+	if (memcmp(wb_fin, wb, BNLEN * 12) != 0)
+		return SM9_DATA_MEMCMP_ERR;
+	if (w != NULL)
+		memcpy(w, wb, BNLEN * 12);
+	memset(wb, 0, sizeof(wb));
+	return 0;
+}
+
+/****************************************************************
+Function:       Unsigncrypt_w
+Description:    SM9 unsigncryption into a buffer of the caller that also gives
+                out w' once the signature part is checked, Unsigncrypt_work
+                between a mark of the arena and its release
+Calls:          Unsigncrypt_work,SM9_arena_mark,SM9_arena_release
+Called By:      Unsigncrypt_into,SM9_session_accept
+Input:
+                ctx,hid,IDR,IDS,IDlen,message,mlen,S,T,C,skID,ks,Ppub  //as Unsigncrypt
+Output:
+                M_           //M', mlen bytes, zeroed on every error
+                w            //zzn12_to_bytes384 of w', BNLEN*12 bytes, may be NULL
+Return:
+                as Unsigncrypt_work
+                SM9_ASK_MEMORY_ERR: the arena ran out, see SM9_ARENA_NO_HEAP
+                SM9_CTX_ERR: ctx belongs to another thread
+Others:         M' and w' are only released with a valid tag and a valid signature part
+****************************************************************/
+int Unsigncrypt_w(SM9_CTX *ctx, unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int IDlen,
+	unsigned char *message, size_t mlen, unsigned char S[], unsigned char T[], unsigned char C[],
+	unsigned char skID[], big ks, unsigned char Ppub[], unsigned char M_[], unsigned char w[])
+{
+	int mark, buf;
+
+	if (ctx->mip != get_mip())
+		return SM9_CTX_ERR;
+	mark = SM9_arena_mark();
+	buf = Unsigncrypt_work(ctx, hid, IDR, IDS, mlen, S, T, C, skID, Ppub, M_, w);
+	if (!SM9_arena_release(mark) && buf == 0)
+		buf = SM9_ASK_MEMORY_ERR;
+	if (buf != 0)
+	{
+		memset(M_, 0, mlen);
+		if (w != NULL)
+			memset(w, 0, BNLEN * 12);
+	}
+	return buf;
+}
+
+/****************************************************************
+Function:       Unsigncrypt_into
+Description:    SM9 unsigncryption into a buffer of the caller
+Calls:          Unsigncrypt_w
+Called By:      Unsigncrypt,Unsigncrypt_bundle
+Input:
+                ctx,hid,IDR,IDS,IDlen,message,mlen,S,T,C,skID,ks,Ppub  //as Unsigncrypt
+Output:
+                M_           //M', mlen bytes, zeroed on every error
+Return:
+                as Unsigncrypt_w
+Others:         M' is only released with a valid tag and a valid signature part
+****************************************************************/
+int Unsigncrypt_into(SM9_CTX *ctx, unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int IDlen,
+	unsigned char *message, size_t mlen, unsigned char S[], unsigned char T[], unsigned char C[],
+	unsigned char skID[], big ks, unsigned char Ppub[], unsigned char M_[])
+{
+	return Unsigncrypt_w(ctx, hid, IDR, IDS, IDlen, message, mlen, S, T, C, skID, ks, Ppub, M_, NULL);
+}
+
+/****************************************************************
+Function:       Unsigncrypt
+Description:    SM9 unsigncryption, M' is only checked
+Calls:          Unsigncrypt_into
+Called By:      SM9_SelfCheck
+Input:
+                ctx          //context of the calling thread
+                hid          //0x03
+                IDR          //identification of the receiver
+                IDS          //identification of the sender
+                IDlen        //the length of IDS
+                message      //not used
+                mlen         //the length of the message
+                S, T, C      //the signcryption
+                skID         //private key of IDR, 128 bytes
+                ks, Ppub
+Output:
+                NULL
+Return:
+                as Unsigncrypt_into
+Others:
+****************************************************************/
+int Unsigncrypt(SM9_CTX *ctx, unsigned char hid[], unsigned char *IDR, unsigned char *IDS, int IDlen,
+	unsigned char *message, size_t mlen,  unsigned char S[], unsigned char T[], unsigned char C[],
+	unsigned char skID[], big ks, unsigned char Ppub[])
+{
+	unsigned char *M_;
+	int buf;
 
-	zzn12_ElementPrint(w_);
+	M_ = (unsigned char *)malloc(mlen + 1);
+	if (M_ == NULL)
+		return SM9_ASK_MEMORY_ERR;
+	buf = Unsigncrypt_into(ctx, hid, IDR, IDS, IDlen, message, mlen, S, T, C, skID, ks, Ppub, M_);
+	memset(M_, 0, mlen);
 	free(M_);
-	return 0;
+	return buf;
 }
 
 /****************************************************************
@@ -1217,13 +1892,6 @@ Others:
 ****************************************************************/
 int SM9_SelfCheck()
 {
-	//the master private key
-	unsigned char dA[32] = { 0x00, 0x01, 0x30, 0xE7, 0x84, 0x59, 0xD7, 0x85, 0x45, 0xCB, 0x54, 0xC5, 0x87, 0xE0, 0x2C, 0xF4,
-		0x80, 0xCE, 0x0B, 0x66, 0x34, 0x0F, 0x31, 0x9F, 0x34, 0x8A, 0x1D, 0x5B, 0x1F, 0x2D, 0xC5, 0xF4 };
-
-	unsigned char rand[32] = { 0x00, 0x03, 0x3C, 0x86, 0x16, 0xB0, 0x67, 0x04, 0x81, 0x32, 0x03, 0xDF, 0xD0, 0x09, 0x65, 0x02,
-		0x2E, 0xD1, 0x59, 0x75, 0xC6, 0x62, 0x33, 0x7A, 0xED, 0x64, 0x88, 0x35, 0xDC, 0x4B, 0x1C, 0xBE };
-
 	unsigned char h[32], S[64], T[64], C[64]; // Signature
 	unsigned char Ppub[128], dSA[64], skID[128];
 
@@ -1253,37 +1921,467 @@ int SM9_SelfCheck()
 	unsigned char *IDR = "Cuiyan";
 	unsigned char *IDS = "Pulang";
 	unsigned char *message = "This is a test message"; //the message to be signed
-	int mlen = strlen(message), tmp;                 //the length of message
+	size_t mlen = strlen(message);                   //the length of message
+	int tmp;
 	big ks;
+	unsigned char *dem_M, *dem_C, *dem_R, dem_or; //signcryptions with SM4-GCM
+	size_t dem_len[2] = { SM9_DEM_THRESHOLD, 70000 }; //at the threshold and beyond 64 KB
+	SM9_COUPON_POOL pool;
+	unsigned char *IDRs[2], Tb[128], Cb[128]; //two receivers of Signcrypt_broadcast
+	SM9_SESSION sess_s, sess_r;
+	unsigned char rec[128], rec_M[64];          //one record of the session
+	size_t rec_len;
+	SM9_BUNDLE bundle;                           //three records under one signcryption
+	SM9_BUNDLE_VIEW bundle_v;
+	unsigned char bundle_buf[256], bundle_C[256], bundle_M[256];
+	const unsigned char *rec_p;
+	size_t bundle_len;
+	unsigned char enc_C[128], enc_M[64], enc_K[32], enc_K_[32]; //SM9 encryption and KEM to IDR
+	size_t enc_len;
+	SM9_EXCH_KEY exch_a, exch_b;                 //key exchange, IDS is A and IDR is B
+	SM9_EXCH_PEER peer_a, peer_b;
+	SM9_EXCH st_a, st_b;
+	unsigned char skID_A[128], Ppube[64], RA[64], RB[64], SA[32], SB[32], SKA[16], SKB[16];
+	big ke_x, ke_y;
+	epoint *ke_P;
+	SM9_RECV_KEY rkey;                           //three signcryptions from IDS unsigncrypted as one batch
+	SM9_UNSC_ITEM items[3];
+	unsigned char bat_S[3][64], bat_T[3][64], bat_C[3][64], bat_M[3][64];
+	int bat_res[3];
+	zzn12 gt_w, gt_v;                            //g^ks through zzn12_to_bytes192 and back
+	ecap_lines *gt_L;
+	unsigned char gt_c[GT_COMPRESSED_LEN], gt_a[BNLEN * 12], gt_b[BNLEN * 12];
+	int mark;
+	SM9_POOL tp;                                 //2 workers against the serial code
+	SM9_SC_ITEM sc_items[1];
+	epoint *pool_Q[1];
+	SM9_CTX ctx;                                 //context of this thread
 
 	tmp = SM9_Init();
 
+	if (tmp != 0)
+		return tmp;
+	tmp = SM9_ctx_init(&ctx);
 	if (tmp != 0)
 		return tmp;
 	ks = mirvar(0);
-
-	//bytes_to_big(32, dA, ks);
-	bigrand(N, ks);
+	do
+		strong_bigrand(&ctx.rng, N, ks);
+	while (size(ks) == 0);
 
 	printf("\n***********************  SM9 key Generation    ***************************\n");
 	printf("The master private key [ks] : \n");
 	cotnum(ks,stdout);
-	tmp = SM9_GenerateSignKey(hid, IDR, strlen(IDR), ks,Ppub, dSA,skID);
+	tmp = SM9_GenerateSignKey(&ctx, hid, IDR, strlen(IDR), ks,Ppub, dSA,skID);
 	if (tmp != 0)
+	{
+		SM9_ctx_free(&ctx);
 		return tmp;
+	}
 
 
-	//printf("\n**********************  SM9 signature algorithm***************************\n");
-	//tmp = SM9_Sign(hid, IDR, message, mlen, rand, dSA, Ppub, h, S,skID,ks);
-	//if (tmp != 0)
-	//	return tmp;
-
-	//printf("\n*******************  SM9 verification algorithm *************************\n");
-	//tmp = SM9_Verify(h, S, hid, IDR, message, mlen, Ppub);
-	//if (tmp != 0)
-	//	return tmp;
 	printf("-----------------------------------------TEST----------------------------------------\n");
-	Signcrypt(hid, IDR,IDS, strlen(IDR), message, mlen, h, S,T,C, skID,ks, Ppub);
-	Unsigncrypt(hid, IDR, IDS, strlen(IDR), message, mlen, S, T, C, skID, ks, Ppub);
+	tmp = Signcrypt(&ctx, hid, IDR, IDS, strlen(IDS), message, mlen, h, S, T, C, skID, ks, Ppub);
+	if (tmp == 0)
+		tmp = Unsigncrypt(&ctx, hid, IDR, IDS, strlen(IDS), message, mlen, S, T, C, skID, ks, Ppub);
+	if (tmp != 0)
+	{
+		SM9_ctx_free(&ctx);
+		return tmp;
+	}
+
+	printf("\n-------------------------------------DEM--------------------------------------\n");
+	//from SM9_DEM_THRESHOLD bytes on C is SM4-GCM and a tag: a round trip, then the
+	//same C with one bit of the tag flipped must be refused and M' wiped
+	dem_M = (unsigned char *)malloc(dem_len[1]);
+	dem_C = (unsigned char *)malloc(SM9_C_LEN(dem_len[1]));
+	dem_R = (unsigned char *)malloc(dem_len[1]);
+	if (dem_M == NULL || dem_C == NULL || dem_R == NULL)
+		tmp = SM9_ASK_MEMORY_ERR;
+	for (size_t j = 0; tmp == 0 && j < dem_len[1]; j++)
+		dem_M[j] = (unsigned char)(j * 131 + 7);
+	for (int i = 0; tmp == 0 && i < 2; i++)
+	{
+		tmp = Signcrypt(&ctx, hid, IDR, IDS, strlen(IDS), dem_M, dem_len[i], h, S, T, dem_C, skID, ks, Ppub);
+		if (tmp == 0)
+			tmp = Unsigncrypt_into(&ctx, hid, IDR, IDS, strlen(IDS), NULL, dem_len[i], S, T, dem_C, skID, ks,
+				Ppub, dem_R);
+		if (tmp == 0 && memcmp(dem_R, dem_M, dem_len[i]) != 0)
+			tmp = SM9_DATA_MEMCMP_ERR;
+		if (tmp == 0)
+		{
+			dem_C[dem_len[i]] ^= 0x01;
+			if (Unsigncrypt_into(&ctx, hid, IDR, IDS, strlen(IDS), NULL, dem_len[i], S, T, dem_C, skID, ks,
+				Ppub, dem_R) != SM9_DEM_TAG_ERR)
+				tmp = SM9_DATA_MEMCMP_ERR;
+			dem_or = 0;
+			for (size_t j = 0; j < dem_len[i]; j++)
+				dem_or |= dem_R[j];
+			if (tmp == 0 && dem_or != 0)
+				tmp = SM9_DATA_MEMCMP_ERR;
+		}
+	}
+	free(dem_M);
+	free(dem_C);
+	free(dem_R);
+	if (tmp != 0)
+	{
+		SM9_ctx_free(&ctx);
+		return tmp;
+	}
+
+	printf("\n-----------------------------------ONLINE-------------------------------------\n");
+	tmp = SM9_coupon_pool_init(&ctx, &pool, 16, hid, IDS, strlen(IDS), ks);
+	if (tmp != 0)
+	{
+		SM9_ctx_free(&ctx);
+		return tmp;
+	}
+	if (SM9_coupon_pool_start(&pool, 0) == 0)
+		SM9_coupon_fill(&ctx, &pool, 4);
+	tmp = Signcrypt_online(&ctx, &pool, hid, IDR, message, mlen, S, T, C);
+	if (tmp == 0)
+		tmp = Unsigncrypt(&ctx, hid, IDR, IDS, strlen(IDS), message, mlen, S, T, C, skID, ks, Ppub);
+	if (tmp != 0)
+	{
+		SM9_coupon_pool_free(&pool);
+		SM9_ctx_free(&ctx);
+		return tmp;
+	}
+
+	printf("\n----------------------------------BROADCAST-----------------------------------\n");
+	IDRs[0] = IDR;
+	IDRs[1] = IDS;
+	tmp = Signcrypt_broadcast(&ctx, &pool, hid, IDRs, 2, message, mlen, S, Tb, Cb);
+	if (tmp == 0)
+		tmp = Unsigncrypt(&ctx, hid, IDR, IDS, strlen(IDS), message, mlen, S, Tb, Cb, skID, ks, Ppub);
+	if (tmp != 0)
+	{
+		SM9_coupon_pool_free(&pool);
+		SM9_ctx_free(&ctx);
+		return tmp;
+	}
+
+	printf("\n-----------------------------------BUNDLE-------------------------------------\n");
+	SM9_bundle_init(&bundle, bundle_buf, sizeof(bundle_buf), 3);
+	while (SM9_bundle_add(&bundle, message, mlen) == 0);
+	tmp = Signcrypt_bundle(&ctx, &pool, hid, IDR, &bundle, S, T, bundle_C, &bundle_len);
+	if (tmp == 0)
+		tmp = Unsigncrypt_bundle(&ctx, hid, IDR, IDS, strlen(IDS), bundle_len, S, T, bundle_C, skID, ks, Ppub,
+			bundle_M, &bundle_v);
+	if (tmp == 0 && bundle_v.n != 3)
+		tmp = SM9_BUNDLE_FORMAT_ERR;
+	for (int i = 0; tmp == 0 && i < bundle_v.n; i++)
+	{
+		tmp = SM9_bundle_record(&bundle_v, i, &rec_p, &rec_len);
+		if (tmp == 0 && (rec_len != mlen || memcmp(rec_p, message, mlen) != 0))
+			tmp = SM9_DATA_MEMCMP_ERR;
+	}
+	if (tmp != 0)
+	{
+		SM9_coupon_pool_free(&pool);
+		SM9_ctx_free(&ctx);
+		return tmp;
+	}
+
+	printf("\n-----------------------------------ENCRYPT------------------------------------\n");
+	tmp = SM9_encrypt(&ctx, &pool, hid, IDR, message, mlen, enc_C);
+	if (tmp == 0)
+		tmp = SM9_decrypt(&ctx, IDR, skID, enc_C, SM9_ENC_C_LEN(mlen), enc_M, &enc_len);
+	if (tmp == 0 && (enc_len != mlen || memcmp(enc_M, message, mlen) != 0))
+		tmp = SM9_DATA_MEMCMP_ERR;
+	if (tmp == 0)
+	{
+		//K1 of more than 64 KB, the key stream is not capped
+		dem_M = (unsigned char *)malloc(dem_len[1]);
+		dem_C = (unsigned char *)malloc(SM9_ENC_C_LEN(dem_len[1]));
+		dem_R = (unsigned char *)malloc(dem_len[1]);
+		if (dem_M == NULL || dem_C == NULL || dem_R == NULL)
+			tmp = SM9_ASK_MEMORY_ERR;
+		for (size_t j = 0; tmp == 0 && j < dem_len[1]; j++)
+			dem_M[j] = (unsigned char)(j * 131 + 7);
+		if (tmp == 0)
+			tmp = SM9_encrypt(&ctx, &pool, hid, IDR, dem_M, dem_len[1], dem_C);
+		if (tmp == 0)
+			tmp = SM9_decrypt(&ctx, IDR, skID, dem_C, SM9_ENC_C_LEN(dem_len[1]), dem_R, &enc_len);
+		if (tmp == 0 && (enc_len != dem_len[1] || memcmp(dem_R, dem_M, enc_len) != 0))
+			tmp = SM9_DATA_MEMCMP_ERR;
+		free(dem_M);
+		free(dem_C);
+		free(dem_R);
+	}
+	if (tmp == 0)
+		tmp = SM9_encap(&ctx, &pool, hid, IDR, sizeof(enc_K), enc_K, enc_C);
+	if (tmp == 0)
+		tmp = SM9_decap(&ctx, IDR, skID, enc_C, sizeof(enc_K_), enc_K_);
+	if (tmp == 0 && memcmp(enc_K, enc_K_, sizeof(enc_K)) != 0)
+		tmp = SM9_DATA_MEMCMP_ERR;
+	if (tmp != 0)
+	{
+		SM9_coupon_pool_free(&pool);
+		SM9_ctx_free(&ctx);
+		return tmp;
+	}
+
+	printf("\n------------------------------------BATCH-------------------------------------\n");
+	for (int i = 0; tmp == 0 && i < 3; i++)
+	{
+		items[i].IDS = IDS;
+		items[i].mlen = mlen;
+		items[i].S = bat_S[i];
+		items[i].T = bat_T[i];
+		items[i].C = bat_C[i];
+		items[i].M = bat_M[i];
+		tmp = Signcrypt_online(&ctx, &pool, hid, IDR, message, mlen, bat_S[i], bat_T[i], bat_C[i]);
+	}
+	if (tmp == 0)
+		tmp = SM9_recv_key_init(&ctx, &rkey, hid, IDR, skID, Ppub);
+	if (tmp == 0)
+	{
+		tmp = Unsigncrypt_batch(&ctx, &rkey, items, 3, bat_res);
+		for (int i = 0; tmp == 0 && i < 3; i++)
+			if (memcmp(bat_M[i], message, mlen) != 0)
+				tmp = SM9_DATA_MEMCMP_ERR;
+		//a forged ciphertext is found by the bisection, the others still pass
+		bat_C[1][0] ^= 0x01;
+		if (tmp == 0 && (Unsigncrypt_batch(&ctx, &rkey, items, 3, bat_res) != SM9_DATA_MEMCMP_ERR ||
+			bat_res[0] != 0 || bat_res[1] == 0 || bat_res[2] != 0))
+			tmp = SM9_DATA_MEMCMP_ERR;
+		SM9_recv_key_free(&rkey);
+	}
+	if (tmp != 0)
+	{
+		SM9_coupon_pool_free(&pool);
+		SM9_ctx_free(&ctx);
+		return tmp;
+	}
+
+	printf("\n-------------------------------------POOL-------------------------------------\n");
+	//one signcryption of SM9_signcrypt_batch, one of Signcrypt and one of Signcrypt_parallel,
+	//each one unsigncrypted by Unsigncrypt and all three by both batches of the pool
+	SM9_pool_init(&tp, 2);
+	sc_items[0].IDR = IDR;
+	sc_items[0].message = message;
+	sc_items[0].mlen = mlen;
+	sc_items[0].S = bat_S[0];
+	sc_items[0].T = bat_T[0];
+	sc_items[0].C = bat_C[0];
+	tmp = SM9_signcrypt_batch(&tp, &ctx, &pool, hid, sc_items, 1, bat_res);
+	if (tmp == 0)
+		tmp = Signcrypt(&ctx, hid, IDR, IDS, strlen(IDS), message, mlen, h, bat_S[1], bat_T[1], bat_C[1], skID, ks,
+			Ppub);
+	if (tmp == 0)
+		tmp = Signcrypt_parallel(&tp, &ctx, hid, IDR, IDS, strlen(IDS), message, mlen, ks, Ppub, bat_S[2], bat_T[2],
+			bat_C[2], NULL);
+	for (int i = 0; tmp == 0 && i < 3; i++)
+		tmp = Unsigncrypt(&ctx, hid, IDR, IDS, strlen(IDS), message, mlen, bat_S[i], bat_T[i], bat_C[i], skID, ks,
+			Ppub);
+	if (tmp == 0)
+		tmp = SM9_recv_key_init(&ctx, &rkey, hid, IDR, skID, Ppub);
+	if (tmp == 0)
+	{
+		for (int k = 0; tmp == 0 && k < 2; k++)
+		{
+			memset(bat_M, 0, sizeof(bat_M));
+			if (k == 0)
+				tmp = SM9_unsigncrypt_batch(&tp, &ctx, &rkey, items, 3, bat_res);
+			else
+				tmp = SM9_verify_batch(&tp, &ctx, &rkey, items, 3, bat_res);
+			for (int i = 0; tmp == 0 && i < 3; i++)
+				if (memcmp(bat_M[i], message, mlen) != 0)
+					tmp = SM9_DATA_MEMCMP_ERR;
+		}
+		SM9_recv_key_free(&rkey);
+	}
+	//SM9_ecap_pool against the g=e(P1,Ppub) of ecap_fixed kept in ctx
+	if (tmp == 0)
+	{
+		mark = SM9_arena_mark();
+		zzn12_tmp(&gt_v);
+		pool_Q[0] = P1;
+		tmp = SM9_pub_lines(&ctx, Ppub, &gt_L, &gt_w);
+		if (tmp == 0 && !SM9_ecap_pool(&tp, &ctx, 1, &gt_L, pool_Q, &gt_v, NULL))
+			tmp = SM9_MY_ECAP_12A_ERR;
+		if (tmp == 0)
+		{
+			zzn12_to_bytes384(gt_w, gt_a);
+			zzn12_to_bytes384(gt_v, gt_b);
+			if (memcmp(gt_a, gt_b, sizeof(gt_a)) != 0)
+				tmp = SM9_DATA_MEMCMP_ERR;
+		}
+		SM9_arena_release(mark);
+	}
+	SM9_pool_free(&tp);
+	if (tmp != 0)
+	{
+		SM9_coupon_pool_free(&pool);
+		SM9_ctx_free(&ctx);
+		return tmp;
+	}
+
+	printf("\n-----------------------------------SESSION------------------------------------\n");
+	tmp = SM9_session_open(&ctx, &sess_s, SM9_SESSION_GCM, &pool, hid, IDR, IDS, message, mlen, S, T, C);
+	SM9_coupon_pool_free(&pool);
+	if (tmp == 0)
+		tmp = SM9_session_accept(&ctx, &sess_r, SM9_SESSION_GCM, hid, IDR, IDS, S, T, C, mlen, skID, Ppub, rec_M);
+	if (tmp == 0 && memcmp(rec_M, message, mlen) != 0)
+		tmp = SM9_DATA_MEMCMP_ERR;
+	if (tmp == 0)
+	{
+		SM9_session_seal(&sess_s, message, mlen, rec);
+		tmp = SM9_session_unseal(&sess_r, rec, SM9_SESSION_RECORD_LEN(SM9_SESSION_GCM, mlen), rec_M, &rec_len);
+		if (tmp == 0 && (rec_len != mlen || memcmp(rec_M, message, mlen) != 0))
+			tmp = SM9_DATA_MEMCMP_ERR;
+	}
+	SM9_session_free(&sess_s);
+	SM9_session_free(&sess_r);
+	if (tmp != 0)
+	{
+		SM9_ctx_free(&ctx);
+		return tmp;
+	}
+
+	printf("\n-------------------------------------GT---------------------------------------\n");
+	//g^ks kept in 192 bytes as SM9_exch_start keeps g^r, and read back into GT
+	mark = SM9_arena_mark();
+	zzn12_tmp(&gt_v);
+	tmp = SM9_pub_lines(&ctx, Ppub, &gt_L, &gt_w);
+	if (tmp == 0)
+	{
+		gt_w = zzn12_pow(gt_w, ks);
+		tmp = zzn12_to_bytes192(gt_w, gt_c);
+	}
+	if (tmp == 0 && (!bytes192_to_zzn12(gt_c, &gt_v) || !member(gt_v, para_t, X)))
+		tmp = SM9_MEMBER_ERR;
+	if (tmp == 0)
+	{
+		zzn12_to_bytes384(gt_w, gt_a);
+		zzn12_to_bytes384(gt_v, gt_b);
+		if (memcmp(gt_a, gt_b, sizeof(gt_a)) != 0)
+			tmp = SM9_DATA_MEMCMP_ERR;
+	}
+	SM9_arena_release(mark);
+	if (tmp != 0)
+	{
+		SM9_ctx_free(&ctx);
+		return tmp;
+	}
+
+	printf("\n----------------------------------EXCHANGE------------------------------------\n");
+	//Ppub-e=[ks]P1, the key of IDS replaces skID from here on
+	ke_x = mirvar(0);
+	ke_y = mirvar(0);
+	ke_P = epoint_init();
+	ecurve_mult(ks, P1, ke_P);
+	epoint_get(ke_P, ke_x, ke_y);
+	big_to_bytes(BNLEN, ke_x, Ppube, 1);
+	big_to_bytes(BNLEN, ke_y, Ppube + BNLEN, 1);
+	epoint_free(ke_P);
+	memset(&exch_a, 0, sizeof(SM9_EXCH_KEY));
+	memset(&exch_b, 0, sizeof(SM9_EXCH_KEY));
+	memset(&peer_a, 0, sizeof(SM9_EXCH_PEER));
+	memset(&peer_b, 0, sizeof(SM9_EXCH_PEER));
+	tmp = SM9_GenerateSignKey(&ctx, hid, IDS, strlen(IDS), ks, Ppub, dSA, skID_A);
+	if (tmp == 0)
+		tmp = SM9_exch_key_init(&ctx, &exch_a, hid, IDS, strlen(IDS), skID_A, Ppube);
+	if (tmp == 0)
+		tmp = SM9_exch_key_init(&ctx, &exch_b, hid, IDR, strlen(IDR), skID, Ppube);
+	if (tmp == 0)
+		tmp = SM9_exch_peer_init(&ctx, &exch_a, &peer_b, IDR, strlen(IDR));
+	if (tmp == 0)
+		tmp = SM9_exch_peer_init(&ctx, &exch_b, &peer_a, IDS, strlen(IDS));
+	if (tmp == 0)
+		tmp = SM9_exch_start(&ctx, &exch_a, &peer_b, &st_a, 1, RA);
+	if (tmp == 0)
+		tmp = SM9_exch_start(&ctx, &exch_b, &peer_a, &st_b, 0, RB);
+	if (tmp == 0)
+		tmp = SM9_exch_respond(&ctx, &exch_b, &peer_a, &st_b, RA, sizeof(SKB), SKB, SB);
+	if (tmp == 0)
+		tmp = SM9_exch_confirm(&ctx, &exch_a, &peer_b, &st_a, RB, SB, sizeof(SKA), SKA, SA);
+	if (tmp == 0)
+		tmp = SM9_exch_finish(&st_b, SA);
+	if (tmp == 0 && memcmp(SKA, SKB, sizeof(SKA)) != 0)
+		tmp = SM9_DATA_MEMCMP_ERR;
+	SM9_exch_peer_free(&peer_a);
+	SM9_exch_peer_free(&peer_b);
+	SM9_exch_key_free(&exch_a);
+	SM9_exch_key_free(&exch_b);
+	SM9_ctx_free(&ctx);
+	if (tmp != 0)
+		return tmp;
+
+	//ARENA: every operation above gave its temporaries back
+	printf("\n*********************arena: at most %d bigs in use*********************\n", SM9_arena_peak());
+	if (SM9_arena_mark() != 0)
+		return SM9_ARENA_ERR;
 	return 0;
+}
+
+/****************************************************************
+Function:       SM9_Bench
+Description:    benchmarks of the thread pool, kept out of SM9_SelfCheck so
+                that the self check stays short: the batches of SM9_pool_bench,
+                the latency of Signcrypt_parallel and the pairing cut over the
+                threads
+Calls:          SM9_Init,SM9_ctx_init,SM9_GenerateSignKey,SM9_coupon_pool_init,
+                SM9_recv_key_init,SM9_pool_bench,SM9_pool_latency,SM9_pool_pairing
+Called By:      main
+Input:          null
+Output:         the tables of the three benchmarks on stdout
+Return:
+                0: every benchmark gave back the right results
+                other: the error of the setup or of a benchmark
+Others:         run instead of SM9_SelfCheck, SM9_Init is called once per process
+****************************************************************/
+int SM9_Bench()
+{
+	unsigned char hid[] = { 0x01 };
+	unsigned char *IDR = "Cuiyan";
+	unsigned char *IDS = "Pulang";
+	unsigned char *message = "This is a test message";
+	unsigned char Ppub[128], dSA[64], skID[128];
+	size_t mlen = strlen(message);
+	SM9_COUPON_POOL pool;
+	SM9_RECV_KEY rkey;
+	SM9_CTX ctx;
+	big ks;
+	int tmp;
+
+	tmp = SM9_Init();
+	if (tmp != 0)
+		return tmp;
+	tmp = SM9_ctx_init(&ctx);
+	if (tmp != 0)
+		return tmp;
+	ks = mirvar(0);
+	do
+		strong_bigrand(&ctx.rng, N, ks);
+	while (size(ks) == 0);
+	tmp = SM9_GenerateSignKey(&ctx, hid, IDR, strlen(IDR), ks, Ppub, dSA, skID);
+	//no background threads, they would take processors from the pool
+	if (tmp == 0)
+		tmp = SM9_coupon_pool_init(&ctx, &pool, 16, hid, IDS, strlen(IDS), ks);
+	if (tmp != 0)
+	{
+		mirkill(ks);
+		SM9_ctx_free(&ctx);
+		return tmp;
+	}
+
+	tmp = SM9_recv_key_init(&ctx, &rkey, hid, IDR, skID, Ppub);
+	if (tmp == 0)
+	{
+		tmp = SM9_pool_bench(&ctx, &pool, &rkey, hid, IDS, message, mlen);
+		//the latency of one signcryption with its branches over up to four threads
+		if (tmp == 0)
+			tmp = SM9_pool_latency(&ctx, &rkey, hid, IDS, message, mlen, ks, Ppub);
+		//and of one pairing with its Miller loop and final exponentiation cut over the threads
+		if (tmp == 0)
+			tmp = SM9_pool_pairing(&ctx, Ppub);
+		SM9_recv_key_free(&rkey);
+	}
+	SM9_coupon_pool_free(&pool);
+	mirkill(ks);
+	SM9_ctx_free(&ctx);
+	return tmp;
 }
\ No newline at end of file
@@ -7,6 +7,7 @@ http://www.scctc.org.cn/Upload/accessory/20175/201755105494041082.pdf .
 The codes were slightly modified to pass the check of C complier.
 *************************************************************/
 
+#include <string.h>
 #include "zzn12_operation.h"
 
 zzn2 X; //Frobniues constant
@@ -42,6 +43,40 @@ void zzn12_init(zzn12 *x)
 	x->unitary = FALSE;
 }
 
+/****************************************************************
+Function:       zzn12_tmp
+Description:    as zzn12_init, with the bigs taken from the arena of the thread
+Calls:          SM9_tmp
+Called By:      zzn12_inverse,zzn12_pow,zzn12_torus_compress,zzn12_torus_decompress,
+                zzn12_fb_pow,zzn12_multi_pow,fast_pairing,final_exp,line,g,member,
+                ecap_multi,Signcrypt_work,Unsigncrypt_work,SM9_exch_pair
+Input:          zzn12 *x
+Output:         null
+Return:         null
+Others:         x is given back with the mark of the caller, never zzn12_kill it
+                for that, see SM9_arena.h
+****************************************************************/
+void zzn12_tmp(zzn12 *x)
+{
+	x->a.a.a = SM9_tmp();
+	x->a.a.b = SM9_tmp();
+	x->a.b.a = SM9_tmp();
+	x->a.b.b = SM9_tmp();
+	x->a.unitary = FALSE;
+	x->b.a.a = SM9_tmp();
+	x->b.a.b = SM9_tmp();
+	x->b.b.a = SM9_tmp();
+	x->b.b.b = SM9_tmp();
+	x->b.unitary = FALSE;
+	x->c.a.a = SM9_tmp();
+	x->c.a.b = SM9_tmp();
+	x->c.b.a = SM9_tmp();
+	x->c.b.b = SM9_tmp();
+	x->c.unitary = FALSE;
+	x->miller = FALSE;
+	x->unitary = FALSE;
+}
+
 /****************************************************************
 Function:       zzn12_copy
 Description:    copy y=x
@@ -64,7 +99,7 @@ void zzn12_copy(zzn12 *x, zzn12 *y)
 /****************************************************************
 Function:       zzn12_mul
 Description:    z=x*y,see zzn12a.h and zzn12a.cpp for details in MIRACL c++ source file
-Calls:          MIRACL functions
+Calls:          MIRACL functions,SM9_arena_mark,SM9_tmp,SM9_arena_release
 Called By:
 Input:          zzn12 x,y
 Output:         zzn12 *z
@@ -76,36 +111,38 @@ zzn12_mul(zzn12 x, zzn12 y, zzn12 *z)
 	// Karatsuba
 	zzn4 Z0, Z1, Z2, Z3, T0, T1;
 	BOOL zero_c, zero_b;
+	int mark;
 
-	Z0.a.a = mirvar(0);
-	Z0.a.b = mirvar(0);
-	Z0.b.a = mirvar(0);
-	Z0.b.b = mirvar(0);
+	mark = SM9_arena_mark();
+	Z0.a.a = SM9_tmp();
+	Z0.a.b = SM9_tmp();
+	Z0.b.a = SM9_tmp();
+	Z0.b.b = SM9_tmp();
 	Z0.unitary = FALSE;
-	Z1.a.a = mirvar(0);
-	Z1.a.b = mirvar(0);
-	Z1.b.a = mirvar(0);
-	Z1.b.b = mirvar(0);
+	Z1.a.a = SM9_tmp();
+	Z1.a.b = SM9_tmp();
+	Z1.b.a = SM9_tmp();
+	Z1.b.b = SM9_tmp();
 	Z1.unitary = FALSE;
-	Z2.a.a = mirvar(0);
-	Z2.a.b = mirvar(0);
-	Z2.b.a = mirvar(0);
-	Z2.b.b = mirvar(0);
+	Z2.a.a = SM9_tmp();
+	Z2.a.b = SM9_tmp();
+	Z2.b.a = SM9_tmp();
+	Z2.b.b = SM9_tmp();
 	Z2.unitary = FALSE;
-	Z3.a.a = mirvar(0);
-	Z3.a.b = mirvar(0);
-	Z3.b.a = mirvar(0);
-	Z3.b.b = mirvar(0);
+	Z3.a.a = SM9_tmp();
+	Z3.a.b = SM9_tmp();
+	Z3.b.a = SM9_tmp();
+	Z3.b.b = SM9_tmp();
 	Z3.unitary = FALSE;
-	T0.a.a = mirvar(0);
-	T0.a.b = mirvar(0);
-	T0.b.a = mirvar(0);
-	T0.b.b = mirvar(0);
+	T0.a.a = SM9_tmp();
+	T0.a.b = SM9_tmp();
+	T0.b.a = SM9_tmp();
+	T0.b.b = SM9_tmp();
 	T0.unitary = FALSE;
-	T1.a.a = mirvar(0);
-	T1.a.b = mirvar(0);
-	T1.b.a = mirvar(0);
-	T1.b.b = mirvar(0);
+	T1.a.a = SM9_tmp();
+	T1.a.b = SM9_tmp();
+	T1.b.a = SM9_tmp();
+	T1.b.b = SM9_tmp();
 	T1.unitary = FALSE;
 
 	zzn12_copy(&x, z);
@@ -251,6 +288,7 @@ zzn12_mul(zzn12 x, zzn12 y, zzn12 *z)
 		if (!y.unitary)
 			z->unitary = FALSE;
 	}
+	SM9_arena_release(mark);
 }
 
 /****************************************************************
@@ -278,33 +316,37 @@ void zzn12_conj(zzn12 *x, zzn12 *y)
 Function:       zzn12_inverse
 Description:    element inversion,
 see zzn12a.h and zzn1212.cpp for details in MIRACL c++ source file
-Calls:          MIRACL functions,zzn12_init,zzn12_conj
+Calls:          MIRACL functions,zzn12_tmp,zzn12_conj,SM9_arena_mark,SM9_tmp,
+SM9_arena_release
 Called By:
 Input:          zzn12 w
 Output:
 Return:         zzn12
-Others:
+Others:         the result is made of bigs of the arena
 ****************************************************************/
 zzn12 zzn12_inverse(zzn12 w)
 {
 	zzn4 tmp1, tmp2;
 	zzn12 res;
-
-	tmp1.a.a = mirvar(0);
-	tmp1.a.b = mirvar(0);
-	tmp1.b.a = mirvar(0);
-	tmp1.b.b = mirvar(0);
+	int mark;
+
+	zzn12_tmp(&res);
+	mark = SM9_arena_mark();
+	tmp1.a.a = SM9_tmp();
+	tmp1.a.b = SM9_tmp();
+	tmp1.b.a = SM9_tmp();
+	tmp1.b.b = SM9_tmp();
 	tmp1.unitary = FALSE;
-	tmp2.a.a = mirvar(0);
-	tmp2.a.b = mirvar(0);
-	tmp2.b.a = mirvar(0);
-	tmp2.b.b = mirvar(0);
+	tmp2.a.a = SM9_tmp();
+	tmp2.a.b = SM9_tmp();
+	tmp2.b.a = SM9_tmp();
+	tmp2.b.b = SM9_tmp();
 	tmp2.unitary = FALSE;
-	zzn12_init(&res);
 
 	if (w.unitary)
 	{
 		zzn12_conj(&w, &res);
+		SM9_arena_release(mark);
 		return res;
 	}
 	//res.a=w.a*w.a-tx(w.b*w.c);
@@ -338,6 +380,7 @@ zzn12 zzn12_inverse(zzn12 w)
 	zzn4_mul(&res.b, &tmp1, &res.b);
 	zzn4_mul(&res.c, &tmp1, &res.c);
 
+	SM9_arena_release(mark);
 	return res;
 }
 
@@ -345,7 +388,7 @@ zzn12 zzn12_inverse(zzn12 w)
 Function:       zzn12_powq
 Description:    Frobenius F=x^p. Assumes p=1 mod 6
 see zzn12a.h and zzn1212.cpp for details in MIRACL c++ source file
-Calls:          MIRACL functions
+Calls:          MIRACL functions,SM9_arena_mark,SM9_tmp,SM9_arena_release
 Called By:
 Input:          zzn2 F
 Output:         zzn12 *y
@@ -355,10 +398,13 @@ Others:
 void zzn12_powq(zzn2 F, zzn12 *y)
 {
 	zzn2 X2, X3;
-	X2.a = mirvar(0);
-	X2.b = mirvar(0);
-	X3.a = mirvar(0);
-	X3.b = mirvar(0);
+	int mark;
+
+	mark = SM9_arena_mark();
+	X2.a = SM9_tmp();
+	X2.b = SM9_tmp();
+	X3.a = SM9_tmp();
+	X3.b = SM9_tmp();
 	zzn2_mul(&F, &F, &X2);
 	zzn2_mul(&X2, &F, &X3);
 
@@ -367,13 +413,15 @@ void zzn12_powq(zzn2 F, zzn12 *y)
 	zzn4_powq(&X3, &y->c);
 	zzn4_smul(&y->b, &X, &y->b);
 	zzn4_smul(&y->c, &X2, &y->c);
+	SM9_arena_release(mark);
 }
 
 /****************************************************************
 Function:       zzn12_div
 Description:    z=x/y
 see zzn12a.h and zzn1212.cpp for details in MIRACL c++ source file
-Calls:          MIRACL functions,zzn12_inverse,zzn12_mul
+Calls:          MIRACL functions,zzn12_inverse,zzn12_mul,SM9_arena_mark,
+SM9_arena_release
 Called By:
 Input:          zzn12 x,y
 Output:         zzn12 *z
@@ -382,32 +430,38 @@ Others:
 ****************************************************************/
 void zzn12_div(zzn12 x, zzn12 y, zzn12 *z)
 {
+	int mark;
+
+	mark = SM9_arena_mark();
 	y = zzn12_inverse(y);
 	zzn12_mul(x, y, z);
+	SM9_arena_release(mark);
 }
 
 /****************************************************************
 Function:       zzn12_pow
 Description:    regular zzn12 powering,If k is low Hamming weight this will be just as good.
 see zzn12a.h and zzn1212.cpp for details in MIRACL c++ source file
-Calls:          MIRACL functions,zzn12_inverse,zzn12_mul,zzn12_copy,zzn12_init
+Calls:          MIRACL functions,zzn12_inverse,zzn12_mul,zzn12_copy,zzn12_tmp,
+SM9_arena_mark,SM9_tmp,SM9_arena_release
 Called By:
 Input:          zzn12 x,big k
 Output:
 Return:         zzn12
-Others:
+Others:         the result is made of bigs of the arena
 ****************************************************************/
 zzn12 zzn12_pow(zzn12 x, big k)
 {
 	big zero, tmp, tmp1;
-	int nb, i;
+	int nb, i, mark;
 	BOOL invert_it;
-	zzn12 res;
+	zzn12 res, inv;
 
-	zero = mirvar(0);
-	tmp = mirvar(0);
-	tmp1 = mirvar(0);
-	zzn12_init(&res);
+	zzn12_tmp(&res);
+	mark = SM9_arena_mark();
+	zero = SM9_tmp();
+	tmp = SM9_tmp();
+	tmp1 = SM9_tmp();
 	copy(k, tmp1);
 	invert_it = FALSE;
 
@@ -415,6 +469,7 @@ zzn12 zzn12_pow(zzn12 x, big k)
 	{
 		tmp = get_mip()->one;
 		zzn4_from_big(tmp, &res.a);
+		SM9_arena_release(mark);
 		return res;
 	}
 	if (mr_compare(tmp1, zero) < 0)
@@ -432,7 +487,330 @@ zzn12 zzn12_pow(zzn12 x, big k)
 				zzn12_mul(res, x, &res);
 		}
 	if (invert_it)
-		res = zzn12_inverse(res);
+	{
+		inv = zzn12_inverse(res);
+		zzn12_copy(&inv, &res);
+	}
 
+	SM9_arena_release(mark);
 	return res;
-}
\ No newline at end of file
+}
+
+/****************************************************************
+Function:       zzn12_torus_compress
+Description:    T2 torus compression of a unitary element (e.g. an element of GT).
+Fp12 is seen as Fp6[s], where s sits in x.a.b and conj(s)=-s.
+x=g+h*s is mapped to m=(1+g)/h=(2+x+conj(x))*s/(x-conj(x)),
+which lies in the Fp6 fixed by conjugation, so only
+m.a.a, m.b.b and m.c.a are non-zero
+Calls:          MIRACL functions,zzn12_tmp,zzn12_conj,zzn12_mul,zzn12_inverse,
+SM9_arena_mark,SM9_arena_release
+Called By:      zzn12_to_bytes192
+Input:          zzn12 x
+Output:         zzn12 *m
+Return:         FALSE: h=0, i.e. x=1 or x=-1, m is set to 0
+TRUE: m is the compressed value of x
+Others:         x must satisfy x*conj(x)=1
+****************************************************************/
+BOOL zzn12_torus_compress(zzn12 x, zzn12 *m)
+{
+	zzn12 xc, u, v, s;
+	int mark;
+
+	mark = SM9_arena_mark();
+	zzn12_tmp(&xc);
+	zzn12_tmp(&u);
+	zzn12_tmp(&v);
+	zzn12_tmp(&s);
+
+	zzn12_conj(&x, &xc);
+	//v=x-conj(x)=2*h*s
+	zzn4_sub(&x.a, &xc.a, &v.a);
+	zzn4_sub(&x.b, &xc.b, &v.b);
+	zzn4_sub(&x.c, &xc.c, &v.c);
+	if (zzn4_iszero(&v.a) && zzn4_iszero(&v.b) && zzn4_iszero(&v.c))
+	{
+		zzn4_zero(&m->a);
+		zzn4_zero(&m->b);
+		zzn4_zero(&m->c);
+		m->miller = FALSE;
+		m->unitary = FALSE;
+		SM9_arena_release(mark);
+		return FALSE;
+	}
+
+	//u=2+x+conj(x)=2*(1+g)
+	zzn4_add(&x.a, &xc.a, &u.a);
+	zzn4_add(&x.b, &xc.b, &u.b);
+	zzn4_add(&x.c, &xc.c, &u.c);
+	zzn4_from_int(2, &s.a);
+	zzn4_add(&u.a, &s.a, &u.a);
+
+	//m=u*s/v
+	zzn4_zero(&s.a);
+	zzn2_from_int(1, &s.a.b);
+	v = zzn12_inverse(v);
+	zzn12_mul(u, s, &u);
+	zzn12_mul(u, v, m);
+	m->miller = FALSE;
+	m->unitary = FALSE;
+	SM9_arena_release(mark);
+	return TRUE;
+}
+
+/****************************************************************
+Function:       zzn12_torus_decompress
+Description:    inverse map of zzn12_torus_compress, x=(m+s)/(m-s)
+Calls:          MIRACL functions,zzn12_tmp,zzn12_copy,zzn12_div,SM9_arena_mark,
+SM9_tmp,SM9_arena_release
+Called By:      bytes192_to_zzn12
+Input:          zzn12 m   //only m.a.a, m.b.b and m.c.a are used
+Output:         zzn12 *x
+Return:         NULL
+Others:         x is flagged unitary. Decompressing untrusted data gives an
+element of the torus but not necessarily of GT, check it with member()
+****************************************************************/
+void zzn12_torus_decompress(zzn12 m, zzn12 *x)
+{
+	zzn12 num, den;
+	zzn4 s;
+	int mark;
+
+	mark = SM9_arena_mark();
+	zzn12_tmp(&num);
+	zzn12_tmp(&den);
+	s.a.a = SM9_tmp();
+	s.a.b = SM9_tmp();
+	s.b.a = SM9_tmp();
+	s.b.b = SM9_tmp();
+	s.unitary = FALSE;
+	zzn2_from_int(1, &s.b);
+
+	zzn2_copy(&m.a.a, &num.a.a);
+	zzn2_copy(&m.b.b, &num.b.b);
+	zzn2_copy(&m.c.a, &num.c.a);
+	zzn12_copy(&num, &den);
+	zzn4_add(&num.a, &s, &num.a);
+	zzn4_sub(&den.a, &s, &den.a);
+
+	zzn12_div(num, den, x);
+	x->miller = FALSE;
+	x->unitary = TRUE;
+	SM9_arena_release(mark);
+}
+
+/****************************************************************
+Function:       zzn12_fb_init
+Description:    table of a fixed base for zzn12_fb_pow, T[i]=g^(16^i)
+Calls:          zzn12_init,zzn12_copy,zzn12_mul
+Called By:      SM9_coupon_pool_init
+Input:          zzn12 g
+Output:         zzn12_fb *fb
+Return:         null
+Others:         ZZN12_FB_DIGITS*4 squarings, release the table with zzn12_fb_free
+****************************************************************/
+void zzn12_fb_init(zzn12_fb *fb, zzn12 g)
+{
+	int i, j;
+
+	zzn12_init(&fb->T[0]);
+	zzn12_copy(&g, &fb->T[0]);
+	for (i = 1; i < ZZN12_FB_DIGITS; i++)
+	{
+		zzn12_init(&fb->T[i]);
+		zzn12_copy(&fb->T[i - 1], &fb->T[i]);
+		for (j = 0; j < ZZN12_FB_WINDOW; j++)
+			zzn12_mul(fb->T[i], fb->T[i], &fb->T[i]);
+	}
+}
+
+/****************************************************************
+Function:       zzn12_fb_free
+Description:    release the table made by zzn12_fb_init
+Calls:          zzn12_kill
+Called By:      SM9_coupon_pool_free
+Input:          zzn12_fb *fb
+Output:         null
+Return:         null
+Others:
+****************************************************************/
+void zzn12_fb_free(zzn12_fb *fb)
+{
+	int i;
+
+	for (i = 0; i < ZZN12_FB_DIGITS; i++)
+		zzn12_kill(&fb->T[i]);
+}
+
+/****************************************************************
+Function:       zzn12_fb_pow
+Description:    g^k with the table of g, Yao's method on the 4-bit digits k_i of k:
+                B_j is the product of the T[i] with k_i>=j and g^k=B_15*...*B_1,
+                so at most 64+15 multiplications and no squaring
+Calls:          MIRACL functions,zzn12_tmp,zzn12_copy,zzn12_mul,SM9_arena_mark,
+                SM9_arena_release
+Called By:      SM9_coupon_make
+Input:          zzn12_fb *fb, big k
+Output:         null
+Return:         g^k
+Others:         0<=k<2^256, the table is only read and may be shared by threads,
+                the result is made of bigs of the arena
+****************************************************************/
+zzn12 zzn12_fb_pow(zzn12_fb *fb, big k)
+{
+	unsigned char kb[ZZN12_FB_DIGITS / 2], dig[ZZN12_FB_DIGITS];
+	BOOL a_one = TRUE, b_one = TRUE;
+	zzn12 A, B;
+	int i, j, mark;
+
+	zzn12_tmp(&A);
+	mark = SM9_arena_mark();
+	zzn12_tmp(&B);
+	big_to_bytes(ZZN12_FB_DIGITS / 2, k, (char *)kb, TRUE);
+	for (i = 0; i < ZZN12_FB_DIGITS / 2; i++)
+	{
+		dig[ZZN12_FB_DIGITS - 2 - 2 * i] = kb[i] & 0x0F;
+		dig[ZZN12_FB_DIGITS - 1 - 2 * i] = kb[i] >> 4;
+	}
+
+	for (j = (1 << ZZN12_FB_WINDOW) - 1; j > 0; j--)
+	{
+		for (i = 0; i < ZZN12_FB_DIGITS; i++)
+		{
+			if (dig[i] != j)
+				continue;
+			if (b_one)
+				zzn12_copy(&fb->T[i], &B);
+			else
+				zzn12_mul(B, fb->T[i], &B);
+			b_one = FALSE;
+		}
+		if (b_one)
+			continue;
+		if (a_one)
+			zzn12_copy(&B, &A);
+		else
+			zzn12_mul(A, B, &A);
+		a_one = FALSE;
+	}
+	if (a_one)
+		zzn4_from_big(get_mip()->one, &A.a);
+
+	memset(kb, 0, sizeof(kb));
+	memset(dig, 0, sizeof(dig));
+	SM9_arena_release(mark);
+	return A;
+}
+
+/****************************************************************
+Function:       zzn12_kill
+Description:    release the 12 bigs of a zzn12 made by zzn12_init
+Calls:          MIRACL functions,SM9_arena_owns
+Called By:      zzn12_fb_free,Unsigncrypt_batch
+Input:          zzn12 *x
+Output:         null
+Return:         null
+Others:         a zzn12 of the arena, as returned by zzn12_pow and the like, is
+                left alone: its bigs go back with the mark of the caller
+****************************************************************/
+void zzn12_kill(zzn12 *x)
+{
+	if (SM9_arena_owns(x->a.a.a))
+		return;
+	mirkill(x->a.a.a); mirkill(x->a.a.b); mirkill(x->a.b.a); mirkill(x->a.b.b);
+	mirkill(x->b.a.a); mirkill(x->b.a.b); mirkill(x->b.b.a); mirkill(x->b.b.b);
+	mirkill(x->c.a.a); mirkill(x->c.a.b); mirkill(x->c.b.a); mirkill(x->c.b.b);
+}
+
+/****************************************************************
+Function:       zzn12_multi_pow
+Description:    w[0]^e[0]*...*w[n-1]^e[n-1] by buckets on the 4-bit digits:
+                for each digit position B_d is the product of the w[i] whose
+                digit is d, and B_15^15*...*B_1^1 costs 30 multiplications with
+                running products, so about n multiplications per digit position
+                and 4 squarings between positions
+Calls:          MIRACL functions,zzn12_tmp,zzn12_copy,zzn12_mul,SM9_arena_mark,
+                SM9_arena_release
+Called By:      SM9_batch_test
+Input:          int n, zzn12 w[], big e[]
+Output:         null
+Return:         the product
+Others:         0<=e[i], short exponents cost the fewest positions, the result
+                is made of bigs of the arena
+****************************************************************/
+zzn12 zzn12_multi_pow(int n, zzn12 w[], big e[])
+{
+	zzn12 B[(1 << ZZN12_FB_WINDOW) - 1], S, T, A;
+	BOOL b_one[(1 << ZZN12_FB_WINDOW) - 1], s_one, t_one, a_one = TRUE;
+	int nb = 0, lb, bit, i, j, k, d, mark;
+
+	zzn12_tmp(&A);
+	mark = SM9_arena_mark();
+	zzn12_tmp(&S);
+	zzn12_tmp(&T);
+	for (d = 0; d < (1 << ZZN12_FB_WINDOW) - 1; d++)
+		zzn12_tmp(&B[d]);
+	for (i = 0; i < n; i++)
+		if (logb2(e[i]) > nb)
+			nb = logb2(e[i]);
+
+	for (j = (nb + ZZN12_FB_WINDOW - 1) / ZZN12_FB_WINDOW - 1; j >= 0; j--)
+	{
+		if (!a_one)
+			for (i = 0; i < ZZN12_FB_WINDOW; i++)
+				zzn12_mul(A, A, &A);
+
+		for (d = 0; d < (1 << ZZN12_FB_WINDOW) - 1; d++)
+			b_one[d] = TRUE;
+		for (i = 0; i < n; i++)
+		{
+			lb = logb2(e[i]);
+			d = 0;
+			for (k = ZZN12_FB_WINDOW - 1; k >= 0; k--)
+			{
+				bit = j * ZZN12_FB_WINDOW + k;
+				d = (d << 1) | (bit < lb && mr_testbit(e[i], bit) ? 1 : 0);
+			}
+			if (d == 0)
+				continue;
+			if (b_one[d - 1])
+				zzn12_copy(&w[i], &B[d - 1]);
+			else
+				zzn12_mul(B[d - 1], w[i], &B[d - 1]);
+			b_one[d - 1] = FALSE;
+		}
+
+		//T = B_15^15*...*B_1: S runs over B_15*...*B_d, T multiplies the S
+		s_one = t_one = TRUE;
+		for (d = (1 << ZZN12_FB_WINDOW) - 2; d >= 0; d--)
+		{
+			if (!b_one[d])
+			{
+				if (s_one)
+					zzn12_copy(&B[d], &S);
+				else
+					zzn12_mul(S, B[d], &S);
+				s_one = FALSE;
+			}
+			if (s_one)
+				continue;
+			if (t_one)
+				zzn12_copy(&S, &T);
+			else
+				zzn12_mul(T, S, &T);
+			t_one = FALSE;
+		}
+		if (t_one)
+			continue;
+		if (a_one)
+			zzn12_copy(&T, &A);
+		else
+			zzn12_mul(A, T, &A);
+		a_one = FALSE;
+	}
+	if (a_one)
+		zzn4_from_big(get_mip()->one, &A.a);
+
+	SM9_arena_release(mark);
+	return A;
+}
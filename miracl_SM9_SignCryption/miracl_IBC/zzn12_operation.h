@@ -24,6 +24,14 @@ Function List:
 6.zzn12_powq           //
 7.zzn12_div            //division operation
 8.zzn12_pow            //regular zzn12 powering
+9.zzn12_torus_compress   //T2 torus compression of a unitary element
+10.zzn12_torus_decompress //inverse map of zzn12_torus_compress
+11.zzn12_fb_init          //table of a fixed base, g^(16^i)
+12.zzn12_fb_free          //release the table
+13.zzn12_fb_pow           //fixed-base powering with the table
+14.zzn12_kill             //release a zzn12
+15.zzn12_multi_pow        //product of powers of many elements
+16.zzn12_tmp              //zzn12_init with the bigs from the arena of the thread
 Notes:
 **************************************************************************/
 
@@ -31,6 +39,7 @@ Notes:
 #define HEADER_ZZN12_OPERATION_H
 
 #include "miracl.h"
+#include "SM9_arena.h"
 
 typedef struct
 {
@@ -40,6 +49,15 @@ typedef struct
 				  // or divisions by constants - as instance will eventually be raised to (p-1).
 } zzn12;
 
+#define ZZN12_FB_WINDOW 4
+#define ZZN12_FB_DIGITS 64 //4-bit digits of an exponent below 2^256
+
+//fixed-base powering table, T[i]=g^(16^i)
+typedef struct
+{
+	zzn12 T[ZZN12_FB_DIGITS];
+} zzn12_fb;
+
 void zzn12_init(zzn12 *x);
 void zzn12_copy(zzn12 *x, zzn12 *y);
 zzn12_mul(zzn12 x, zzn12 y, zzn12 *z);
@@ -48,5 +66,13 @@ zzn12 zzn12_inverse(zzn12 w);
 void zzn12_powq(zzn2 F, zzn12 *y);
 void zzn12_div(zzn12 x, zzn12 y, zzn12 *z);
 zzn12 zzn12_pow(zzn12 x, big k);
+BOOL zzn12_torus_compress(zzn12 x, zzn12 *m);
+void zzn12_torus_decompress(zzn12 m, zzn12 *x);
+void zzn12_fb_init(zzn12_fb *fb, zzn12 g);
+void zzn12_fb_free(zzn12_fb *fb);
+zzn12 zzn12_fb_pow(zzn12_fb *fb, big k);
+void zzn12_kill(zzn12 *x);
+zzn12 zzn12_multi_pow(int n, zzn12 w[], big e[]);
+void zzn12_tmp(zzn12 *x);
 
 #endif
\ No newline at end of file
@@ -27,4 +27,15 @@
 
 #define MAXBASE ((mr_small)1<<(MIRACL-1))
 
+                            /* one mip per thread, see SM9_CTX.   *
+                             * miracl.lib must be built with this *
+                             * same mirdef.h                      */
+#if !defined(MR_WINDOWS_MT) && !defined(MR_UNIX_MT)
+#ifdef _WIN32
+#define MR_WINDOWS_MT
+#else
+#define MR_UNIX_MT          /* ... for Unix/Linux                 */
+#endif
+#endif
+
 
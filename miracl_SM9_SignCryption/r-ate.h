@@ -11,6 +11,18 @@ extern "C"{
 #endif
 
 
+//lines of the Miller loop of fast_pairing for a fixed P in G2, in the order it
+//multiplies them in: line k at Q(x,y) is a[k]*y+b[k] in r.a and c[k]*x in r.c.b
+//(M-twist) or r.b.b (D-twist)
+typedef struct
+{
+    int n;        //number of lines
+    zzn2 *a, *b, *c;
+    BOOL negx;    //x<0, the Miller value is conjugated before the last two lines
+    char *mem;    //the bigs of a, b and c
+} ecap_lines;
+
+
 static zzn2 zzn2_pow(zzn2 x, big k)
 {
     int i, j, nb, n, nbw, nzs;
@@ -281,36 +293,13 @@ static zzn12 g(ecn2 *A, ecn2 *B, big Qx, big Qy)
 }
 
 
-static BOOL fast_pairing(ecn2 P, big Qx, big Qy, big x, zzn2 X, zzn12 *r)
+//the final exponentiation r=res^((p^12-1)/N), shared by fast_pairing and ecap_multi
+static void final_exp(zzn12 res, big x, zzn2 X, zzn12 *r)
 {
-    int i, nb;
-    big n, zero, negify_x;
-    ecn2 A, KA;
-    zzn12 t0, x0, x1, x2, x3, x4, x5, res;
-    
-    zero = mirvar(0);
-    n = mirvar(0);
-    negify_x = mirvar(0);
-    
-    A.x.a = mirvar(0);
-    A.x.b = mirvar(0); 
-    
-    A.y.a = mirvar(0);
-    A.y.b = mirvar(0);
-    
-    A.z.a = mirvar(0); 
-    A.z.b = mirvar(0); 
-    A.marker = MR_EPOINT_INFINITY;
+    big negify_x;
+    zzn12 t0, x0, x1, x2, x3, x4, x5;
 
-    KA.x.a = mirvar(0); 
-    KA.x.b = mirvar(0); 
-    
-    KA.y.a = mirvar(0);
-    KA.y.b = mirvar(0);
-    
-    KA.z.a = mirvar(0); 
-    KA.z.b = mirvar(0); 
-    KA.marker = MR_EPOINT_INFINITY;
+    negify_x = mirvar(0);
     zzn12_init(&t0);
     zzn12_init(&x0);
     zzn12_init(&x1);
@@ -318,44 +307,7 @@ static BOOL fast_pairing(ecn2 P, big Qx, big Qy, big x, zzn2 X, zzn12 *r)
     zzn12_init(&x3);
     zzn12_init(&x4);
     zzn12_init(&x5);
-    zzn12_init(&res);
 
-    premult(x, 6, n);
-    incr(n, 2, n);//n=(6*x+2);
-    if(mr_compare(x, zero) < 0) //x<0
-        negify(n, n); //n=-(6*x+2);
-    
-    ecn2_copy(&P, &A);
-    nb = logb2(n);
-    zzn4_from_int(1, &res.a);
-    res.unitary = TRUE; //res=1
-    // Short Miller loop
-    res.miller = TRUE;
-
-    for(i = nb - 2; i >= 0; i--)
-    {
-        zzn12_mul(res, res, &res);
-        zzn12_mul(res, g(&A, &A, Qx, Qy), &res);
-        if(mr_testbit(n, i))
-            zzn12_mul(res, g(&A, &P, Qx, Qy), &res);
-    }
-    // Combining ideas due to Longa, Aranha et al. and Naehrig
-    ecn2_copy(&P, &KA);
-    q_power_frobenius(KA, X);
-    if(mr_compare(x, zero) < 0)
-    {
-        ecn2_negate(&A, &A);
-        zzn12_conj(&res, &res);
-    }
-    zzn12_mul(res, g(&A, &KA, Qx, Qy), &res);
-    q_power_frobenius(KA, X);
-    ecn2_negate(&KA, &KA);
-    zzn12_mul(res, g(&A, &KA, Qx, Qy), &res);
-
-    if(zzn4_iszero(&res.a) && zzn4_iszero(&res.b) && zzn4_iszero(&res.c)) 
-        return FALSE;
-    
-    // The final exponentiation
     zzn12_copy(&res, &t0);//t0=r;
     zzn12_conj(&res, &res);
     zzn12_div(res, t0, &res);
@@ -420,6 +372,76 @@ static BOOL fast_pairing(ecn2 P, big Qx, big Qy, big x, zzn2 X, zzn12 *r)
     zzn12_mul(t0, res, &t0);//t0*=t0;t0*=res;
     
     zzn12_copy(&t0, r);//r= t0;
+}
+
+
+static BOOL fast_pairing(ecn2 P, big Qx, big Qy, big x, zzn2 X, zzn12 *r)
+{
+    int i, nb;
+    big n, zero;
+    ecn2 A, KA;
+    zzn12 res;
+    
+    zero = mirvar(0);
+    n = mirvar(0);
+    
+    A.x.a = mirvar(0);
+    A.x.b = mirvar(0); 
+    
+    A.y.a = mirvar(0);
+    A.y.b = mirvar(0);
+    
+    A.z.a = mirvar(0); 
+    A.z.b = mirvar(0); 
+    A.marker = MR_EPOINT_INFINITY;
+
+    KA.x.a = mirvar(0); 
+    KA.x.b = mirvar(0); 
+    
+    KA.y.a = mirvar(0);
+    KA.y.b = mirvar(0);
+    
+    KA.z.a = mirvar(0); 
+    KA.z.b = mirvar(0); 
+    KA.marker = MR_EPOINT_INFINITY;
+    zzn12_init(&res);
+
+    premult(x, 6, n);
+    incr(n, 2, n);//n=(6*x+2);
+    if(mr_compare(x, zero) < 0) //x<0
+        negify(n, n); //n=-(6*x+2);
+    
+    ecn2_copy(&P, &A);
+    nb = logb2(n);
+    zzn4_from_int(1, &res.a);
+    res.unitary = TRUE; //res=1
+    // Short Miller loop
+    res.miller = TRUE;
+
+    for(i = nb - 2; i >= 0; i--)
+    {
+        zzn12_mul(res, res, &res);
+        zzn12_mul(res, g(&A, &A, Qx, Qy), &res);
+        if(mr_testbit(n, i))
+            zzn12_mul(res, g(&A, &P, Qx, Qy), &res);
+    }
+    // Combining ideas due to Longa, Aranha et al. and Naehrig
+    ecn2_copy(&P, &KA);
+    q_power_frobenius(KA, X);
+    if(mr_compare(x, zero) < 0)
+    {
+        ecn2_negate(&A, &A);
+        zzn12_conj(&res, &res);
+    }
+    zzn12_mul(res, g(&A, &KA, Qx, Qy), &res);
+    q_power_frobenius(KA, X);
+    ecn2_negate(&KA, &KA);
+    zzn12_mul(res, g(&A, &KA, Qx, Qy), &res);
+
+    if(zzn4_iszero(&res.a) && zzn4_iszero(&res.b) && zzn4_iszero(&res.c)) 
+        return FALSE;
+    
+    final_exp(res, x, X, r);
     
     return TRUE;
 }
@@ -461,6 +483,287 @@ static BOOL member(zzn12 r, big x, zzn2 F)
     return FALSE;
 }
 
+
+static void ecap_lines_free(ecap_lines *L)
+{
+    if(L->mem != NULL)
+        memkill(L->mem, 6 * L->n);
+    if(L->a != NULL)
+        free(L->a);
+    memset(L, 0, sizeof(ecap_lines));
+}
+
+
+//the line of g(A,B) as a[k]*y+b[k], c[k]*x with A moved on to A+B, what line
+//computes from Qx and Qy is left for line_eval
+static BOOL line_prep(ecn2 *A, ecn2 *B, zzn2 *a, zzn2 *b, zzn2 *c)
+{
+    zzn2 lam, extra, X, Y, Z, Z2, CZ;
+    ecn2 P;
+    BOOL Doubling;
+    char *mem;
+
+    mem = (char *)memalloc(20);
+    lam.a = mirvar_mem(mem, 0);
+    lam.b = mirvar_mem(mem, 1);
+    extra.a = mirvar_mem(mem, 2);
+    extra.b = mirvar_mem(mem, 3);
+    X.a = mirvar_mem(mem, 4);
+    X.b = mirvar_mem(mem, 5);
+    Y.a = mirvar_mem(mem, 6);
+    Y.b = mirvar_mem(mem, 7);
+    Z.a = mirvar_mem(mem, 8);
+    Z.b = mirvar_mem(mem, 9);
+    Z2.a = mirvar_mem(mem, 10);
+    Z2.b = mirvar_mem(mem, 11);
+    CZ.a = mirvar_mem(mem, 12);
+    CZ.b = mirvar_mem(mem, 13);
+    P.x.a = mirvar_mem(mem, 14);
+    P.x.b = mirvar_mem(mem, 15);
+    P.y.a = mirvar_mem(mem, 16);
+    P.y.b = mirvar_mem(mem, 17);
+    P.z.a = mirvar_mem(mem, 18);
+    P.z.b = mirvar_mem(mem, 19);
+    P.marker = MR_EPOINT_INFINITY;
+
+    ecn2_copy(A, &P);
+    Doubling = ecn2_add2(B, A, &lam, &extra);
+    if(A->marker == MR_EPOINT_INFINITY)
+    {
+        memkill(mem, 20);
+        return FALSE;
+    }
+    ecn2_getz(A, &CZ);
+    if(Doubling)
+    {
+        //a=CZ*Z^2, b=slope*X-extra, c=-(Z^2*slope)
+        ecn2_get(&P, &X, &Y, &Z);
+        zzn2_mul(&Z, &Z, &Z2);
+        zzn2_mul(&lam, &X, b);
+        zzn2_sub(b, &extra, b);
+        zzn2_mul(&CZ, &Z2, a);
+        zzn2_mul(&Z2, &lam, c);
+        zzn2_negate(c, c);
+    }
+    else
+    {
+        //a=CZ, b=slope*X-Y*CZ, c=-slope
+        ecn2_getxy(B, &X, &Y);
+        zzn2_mul(&lam, &X, b);
+        zzn2_mul(&Y, &CZ, &Y);
+        zzn2_sub(b, &Y, b);
+        zzn2_copy(&CZ, a);
+        zzn2_negate(&lam, c);
+    }
+    if(get_mip()->TWIST == MR_SEXTIC_M)
+        zzn2_txx(a); // "multiplied across" by i, as line does with Qy
+
+    memkill(mem, 20);
+    return TRUE;
+}
+
+
+//lines of the Miller loop of fast_pairing for a fixed P, so that e(P,Q) for
+//many Q only evaluates them at Q. Release L with ecap_lines_free
+static BOOL ecap_prep(ecn2 P, big x, zzn2 X, ecap_lines *L)
+{
+    int i, k, nb;
+    big n;
+    ecn2 A, KA;
+    BOOL Ok = TRUE;
+    char *mem;
+
+    memset(L, 0, sizeof(ecap_lines));
+    mem = (char *)memalloc(13);
+    if(mem == NULL)
+        return FALSE;
+    n = mirvar_mem(mem, 0);
+    A.x.a = mirvar_mem(mem, 1);
+    A.x.b = mirvar_mem(mem, 2);
+    A.y.a = mirvar_mem(mem, 3);
+    A.y.b = mirvar_mem(mem, 4);
+    A.z.a = mirvar_mem(mem, 5);
+    A.z.b = mirvar_mem(mem, 6);
+    A.marker = MR_EPOINT_INFINITY;
+    KA.x.a = mirvar_mem(mem, 7);
+    KA.x.b = mirvar_mem(mem, 8);
+    KA.y.a = mirvar_mem(mem, 9);
+    KA.y.b = mirvar_mem(mem, 10);
+    KA.z.a = mirvar_mem(mem, 11);
+    KA.z.b = mirvar_mem(mem, 12);
+    KA.marker = MR_EPOINT_INFINITY;
+
+    premult(x, 6, n);
+    incr(n, 2, n);//n=(6*x+2);
+    L->negx = (size(x) < 0);
+    if(L->negx)
+        negify(n, n);
+    nb = logb2(n);
+
+    //one doubling per bit, one addition per bit set, two more at the end
+    L->n = nb - 1 + 2;
+    for(i = nb - 2; i >= 0; i--)
+        if(mr_testbit(n, i))
+            L->n++;
+    L->mem = (char *)memalloc(6 * L->n);
+    L->a = (zzn2 *)malloc(3 * L->n * sizeof(zzn2));
+    if(L->mem == NULL || L->a == NULL)
+    {
+        ecap_lines_free(L);
+        memkill(mem, 13);
+        return FALSE;
+    }
+    L->b = L->a + L->n;
+    L->c = L->b + L->n;
+    for(k = 0; k < L->n; k++)
+    {
+        L->a[k].a = mirvar_mem(L->mem, 6 * k);
+        L->a[k].b = mirvar_mem(L->mem, 6 * k + 1);
+        L->b[k].a = mirvar_mem(L->mem, 6 * k + 2);
+        L->b[k].b = mirvar_mem(L->mem, 6 * k + 3);
+        L->c[k].a = mirvar_mem(L->mem, 6 * k + 4);
+        L->c[k].b = mirvar_mem(L->mem, 6 * k + 5);
+    }
+
+    //the same steps as fast_pairing
+    ecn2_norm(&P);
+    ecn2_copy(&P, &A);
+    k = 0;
+    for(i = nb - 2; i >= 0 && Ok; i--)
+    {
+        Ok = line_prep(&A, &A, &L->a[k], &L->b[k], &L->c[k]);
+        k++;
+        if(Ok && mr_testbit(n, i))
+        {
+            Ok = line_prep(&A, &P, &L->a[k], &L->b[k], &L->c[k]);
+            k++;
+        }
+    }
+    if(Ok)
+    {
+        ecn2_copy(&P, &KA);
+        q_power_frobenius(KA, X);
+        if(L->negx)
+            ecn2_negate(&A, &A);
+        Ok = line_prep(&A, &KA, &L->a[k], &L->b[k], &L->c[k]);
+        k++;
+    }
+    if(Ok)
+    {
+        q_power_frobenius(KA, X);
+        ecn2_negate(&KA, &KA);
+        Ok = line_prep(&A, &KA, &L->a[k], &L->b[k], &L->c[k]);
+    }
+
+    memkill(mem, 13);
+    if(!Ok)
+        ecap_lines_free(L);
+    return Ok;
+}
+
+
+//line k of L at (Qx,Qy) in Montgomery form, only the parts of l a line fills
+//are written, the others must stay zero
+static void line_eval(ecap_lines *L, int k, big Qx, big Qy, zzn12 *l)
+{
+    zzn2_smul(&L->a[k], Qy, &l->a.a);
+    zzn2_copy(&L->b[k], &l->a.b);
+    if(get_mip()->TWIST == MR_SEXTIC_M)
+        zzn2_smul(&L->c[k], Qx, &l->c.b);
+    else
+        zzn2_smul(&L->c[k], Qx, &l->b.b);
+}
+
+
+//product of the R-ate pairings e(P_j,Q_j), j<m, with the lines of each P_j made
+//by ecap_prep: one Miller loop whose squarings are shared by all pairs and one
+//final exponentiation. A Q_j at infinity is left out as e(P_j,O)=1, the lines
+//are only read
+static BOOL ecap_multi(int m, ecap_lines *L[], epoint *Q[], big x, zzn2 X, zzn12 *r)
+{
+    int i, j, k, nb;
+    big n, *Qx, *Qy;
+    zzn12 res, l;
+    char *mem;
+
+    mem = (char *)memalloc(1 + 2 * m);
+    if(mem == NULL)
+        return FALSE;
+    Qx = (big *)malloc(sizeof(big) * 2 * m);
+    if(Qx == NULL)
+    {
+        memkill(mem, 1 + 2 * m);
+        return FALSE;
+    }
+    Qy = Qx + m;
+    n = mirvar_mem(mem, 0);
+    zzn12_init(&res);
+    zzn12_init(&l);
+
+    premult(x, 6, n);
+    incr(n, 2, n);
+    if(L[0]->negx)
+        negify(n, n);
+    nb = logb2(n);
+    for(j = 0; j < m; j++)
+    {
+        Qx[j] = mirvar_mem(mem, 1 + 2 * j);
+        Qy[j] = mirvar_mem(mem, 2 + 2 * j);
+        if(point_at_infinity(Q[j]))
+            continue;
+        epoint_get(Q[j], Qx[j], Qy[j]);
+        nres(Qx[j], Qx[j]);
+        nres(Qy[j], Qy[j]);
+    }
+
+    zzn4_from_int(1, &res.a);
+    res.unitary = TRUE;
+    res.miller = TRUE;
+    k = 0;
+    for(i = nb - 2; i >= -1; i--)
+    {
+        if(i >= 0)
+            zzn12_mul(res, res, &res);
+        else if(L[0]->negx)
+            zzn12_conj(&res, &res);
+        //i>=0: the doubling line, i=-1: the two lines of the end
+        do
+        {
+            for(j = 0; j < m; j++)
+            {
+                if(point_at_infinity(Q[j]))
+                    continue;
+                line_eval(L[j], k, Qx[j], Qy[j], &l);
+                zzn12_mul(res, l, &res);
+            }
+            k++;
+        } while(i < 0 && k < L[0]->n);
+        if(i >= 0 && mr_testbit(n, i))
+        {
+            for(j = 0; j < m; j++)
+            {
+                if(point_at_infinity(Q[j]))
+                    continue;
+                line_eval(L[j], k, Qx[j], Qy[j], &l);
+                zzn12_mul(res, l, &res);
+            }
+            k++;
+        }
+    }
+    memkill(mem, 1 + 2 * m);
+    free(Qx);
+    zzn12_kill(&l);
+
+    if(zzn4_iszero(&res.a) && zzn4_iszero(&res.b) && zzn4_iszero(&res.c))
+    {
+        zzn12_kill(&res);
+        return FALSE;
+    }
+    final_exp(res, x, X, r);
+    zzn12_kill(&res);
+    return TRUE;
+}
+
 #ifdef __cplusplus
 }
 #endif
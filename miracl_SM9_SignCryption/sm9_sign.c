@@ -1,5 +1,6 @@
 
 #include <math.h>
+#include <time.h>
 #include "miracl.h"
 #include "mirdef.h"
 #include "sm9_standard.h"
@@ -176,12 +177,56 @@ int SM9_sign(unsigned char hid[], unsigned char *IDA, unsigned char *message, in
 }
 
 
-int SM9_signVerify(unsigned char H[], unsigned char S[], unsigned char hid[], unsigned char* IDA, unsigned char* message, int len, unsigned char Ppub[])
+//lines of Ppub-s and g = e(P1, Ppub-s) with its member() check, paid once per
+//master public key. The key belongs to the caller, it is only read by the verifications
+int SM9_verify_key_init(SM9_VERIFY_KEY *key, unsigned char Ppub[])
+{
+    ecn2 Ppubs;
+    epoint *Q = P1;
+    ecap_lines *Lp = &key->L;
+    char *mem;
+    int buf = 0;
+
+    memset(key, 0, sizeof(SM9_VERIFY_KEY));
+    mem = (char *)memalloc(6);
+    if(mem == NULL)
+        return SM9_ASK_MEMORY_ERR;
+    Ppubs.x.a = mirvar_mem(mem, 0);
+    Ppubs.x.b = mirvar_mem(mem, 1);
+    Ppubs.y.a = mirvar_mem(mem, 2);
+    Ppubs.y.b = mirvar_mem(mem, 3);
+    Ppubs.z.a = mirvar_mem(mem, 4);
+    Ppubs.z.b = mirvar_mem(mem, 5);
+    Ppubs.marker = MR_EPOINT_INFINITY;
+    zzn12_init(&key->g);
+
+    if(!bytes128_to_ecn2(Ppub, &Ppubs) || !ecap_prep(Ppubs, para_t, X, &key->L))
+        buf = SM9_GEPUB_ERR;
+    else if(!ecap_multi(1, &Lp, &Q, para_t, X, &key->g))
+        buf = SM9_MY_ECAP_12A_ERR;
+    else if(!member(key->g, para_t, X))
+        buf = SM9_MEMBER_ERR;
+    memkill(mem, 6);
+    if(buf != 0)
+        SM9_verify_key_free(key);
+    return buf;
+}
+
+
+void SM9_verify_key_free(SM9_VERIFY_KEY *key)
+{
+    ecap_lines_free(&key->L);
+    zzn12_kill(&key->g);
+    memset(key, 0, sizeof(SM9_VERIFY_KEY));
+}
+
+
+int SM9_signVerify(SM9_VERIFY_KEY *key, unsigned char H[], unsigned char S[], unsigned char hid[], unsigned char* IDA, unsigned char* message, int len)
 {
     big h, xS, yS, h1, h2;
-    epoint *S1;
+    epoint *S1, *Q[2];
     zzn12 g, t, u, w;
-    ecn2 P, Ppubs;
+    ecap_lines *L[2];
     int Zlen1, Zlen2, buf;
     unsigned char * Z1 = NULL, *Z2 = NULL;
 
@@ -190,22 +235,9 @@ int SM9_signVerify(unsigned char H[], unsigned char S[], unsigned char hid[], un
     h2 = mirvar(0);
     xS = mirvar(0);
     yS = mirvar(0);
-    P.x.a = mirvar(0);
-    P.x.b = mirvar(0);
-    P.y.a = mirvar(0);
-    P.y.b = mirvar(0);
-    P.z.a = mirvar(0);
-    P.z.b = mirvar(0);
-    P.marker = MR_EPOINT_INFINITY;
-    Ppubs.x.a = mirvar(0);
-    Ppubs.x.b = mirvar(0);
-    Ppubs.y.a = mirvar(0);
-    Ppubs.y.b = mirvar(0);
-    Ppubs.z.a = mirvar(0);
-    Ppubs.z.b = mirvar(0);
-    Ppubs.marker = MR_EPOINT_INFINITY;
     S1 = epoint_init();
-    zzn12_init(&g);
+    Q[0] = epoint_init();
+    Q[1] = S1;
     zzn12_init(&t);
     zzn12_init(&u);
     zzn12_init(&w);
@@ -213,7 +245,6 @@ int SM9_signVerify(unsigned char H[], unsigned char S[], unsigned char hid[], un
     bytes_to_big(BNLEN, H, h);
     bytes_to_big(BNLEN, S, xS);
     bytes_to_big(BNLEN, S + BNLEN, yS);
-    bytes128_to_ecn2(Ppub, &Ppubs);
 
     //Step 1:test if h in the rangge [1,N-1]
     if(Test_Range(h))
@@ -224,20 +255,13 @@ int SM9_signVerify(unsigned char H[], unsigned char S[], unsigned char hid[], un
  //   if(Test_Point(S1))
   //      return SM9_S_NOT_VALID_G1;
 
-    //Step3:g = e(P1, Ppub-s)
-    if(!ecap(Ppubs, P1, para_t, X, &g))
-        return SM9_MY_ECAP_12A_ERR;
-    //test if a ZZn12 element is of order q
-    if(!member(g, para_t, X))
-        return SM9_MEMBER_ERR;
+    //Step3:g = e(P1, Ppub-s), made with the lines of Ppub-s by SM9_verify_key_init
+    g = key->g;
+    L[0] = &P2_lines;
+    L[1] = &key->L;
 
-    printf("\n***********************g=e(P1,Ppubs):****************************\n");
-    zzn12_ElementPrint(g);
-    
     //Step4:calculate t=g(h)
     t = zzn12_pow(g, h);
-    printf("\n***************************w=gh:**********************************\n");
-    zzn12_ElementPrint(t);
 
     //Step5:calculate h1=H1(IDA||hid,N)
     Zlen1 = strlen(IDA) + 1;
@@ -250,27 +274,19 @@ int SM9_signVerify(unsigned char H[], unsigned char S[], unsigned char hid[], un
     buf = SM9_standard_h1(Z1, Zlen1, N, h1);
     if(buf != 0) 
         return buf;
-    printf("\n****************************h1:**********************************\n");
-    cotnum(h1, stdout);
 
-    //Step6:P=[h1]P2+Ppubs
-    ecn2_copy(&P2, &P);
-    ecn2_mul(h1, &P);
-    ecn2_add(&Ppubs, &P);
-
-    //Step7:u=e(S1,P)
-    if(!ecap(P, S1, para_t, X, &u)) 
+    //Step6,7:u=e(S1,P) with P=[h1]P2+Ppubs, that is e([h1]S1,P2)*e(S1,Ppubs):
+    //P is never formed, both G2 points are fixed and their lines are ready
+    SM9_G1_mul_glv(h1, S1, Q[0]);
+    if(!ecap_multi(2, L, Q, para_t, X, &u))
         return SM9_MY_ECAP_12A_ERR;
+    epoint_free(Q[0]);
     //test if a ZZn12 element is of order q
     if(!member(u, para_t, X)) 
         return SM9_MEMBER_ERR;
-    printf("\n************************** u=e(S1,P):*****************************\n");
-    zzn12_ElementPrint(u);
 
     //Step8:w=u*t
     zzn12_mul(u, t, &w);
-    printf("\n************************* w=u*t: **********************************\n");
-    zzn12_ElementPrint(w);
 
     //Step9:h2=H2(M||w,N)
     Zlen2 = len + 32 * 12;
@@ -282,14 +298,10 @@ int SM9_signVerify(unsigned char H[], unsigned char S[], unsigned char hid[], un
     buf = SM9_h2(Z2, Zlen2, N, h2);
     if(buf != 0) 
         return buf;
-    printf("\n**************************** h2:***********************************\n");
-    cotnum(h2, stdout);
 
     free(Z1);
     free(Z2);
-    if (mr_compare(h2, h)==0)  //两者相等表明 通过验证
-        printf("After verifying,the message is from Cuiyan!\n");
-    else 
+    if (mr_compare(h2, h) != 0)  //两者相等表明 通过验证
         return SM9_DATA_MEMCMP_ERR;
 
     return 0;
@@ -332,3 +344,437 @@ int SM9_h2(unsigned char Z[], int Zlen, big n, big h2)
     free(ha);
     return 0;
 }
+
+
+//per message state of SM9_sign_batch
+typedef struct
+{
+    unsigned char r[BNLEN];      //r, then l
+    unsigned char w[BNLEN * 12]; //w = g^r as LinkCharZzn12 writes it
+    unsigned char ha[64];        //the two KDF blocks of H2
+    SM3_STATE mid;               //0x02||M, both blocks of H2 resume from it
+} SM9_SIGN_WORK;
+
+#if defined(_OPENMP) && defined(MR_OS_THREADS)
+#define SM9_SIGN_THREADS
+#endif
+
+
+int SM9_sign_key_init(SM9_SIGN_KEY *key, unsigned char dsa[], unsigned char Ppub[])
+{
+    unsigned char seed[SM9_SIGN_SEED_LEN];
+    big xdSA, ydSA;
+    epoint *dSA;
+    ecn2 Ppubs;
+    int buf = 0;
+
+    //every error goes through SM9_sign_key_free, which needs the parts not made yet at zero
+    memset(key, 0, sizeof(SM9_SIGN_KEY));
+
+    //the r of SM9_sign_batch come from a csprng of the key, not from irand
+    if(SM9_os_random(seed, sizeof(seed)) != 0)
+        return SM9_RNG_ERR;
+    strong_init(&key->rng, sizeof(seed), (char *)seed, (mr_unsign32)time(NULL));
+    memset(seed, 0, sizeof(seed));
+
+    xdSA = mirvar(0);
+    ydSA = mirvar(0);
+    dSA = epoint_init();
+    Ppubs.x.a = mirvar(0);
+    Ppubs.x.b = mirvar(0);
+    Ppubs.y.a = mirvar(0);
+    Ppubs.y.b = mirvar(0);
+    Ppubs.z.a = mirvar(0);
+    Ppubs.z.b = mirvar(0);
+    Ppubs.marker = MR_EPOINT_INFINITY;
+    zzn12_init(&key->g);
+
+    bytes_to_big(BNLEN, dsa, xdSA);
+    bytes_to_big(BNLEN, dsa + BNLEN, ydSA);
+    if(!epoint_set(xdSA, ydSA, 0, dSA))
+        buf = SM9_NOT_VALID_G1;
+    else if(!bytes128_to_ecn2(Ppub, &Ppubs))
+        buf = SM9_GEPUB_ERR;
+    //g = e(P1, Ppub-s) and its checks are paid once per key
+    else if(!ecap(Ppubs, P1, para_t, X, &key->g))
+        buf = SM9_MY_ECAP_12A_ERR;
+    else if(!member(key->g, para_t, X))
+        buf = SM9_MEMBER_ERR;
+    else
+    {
+        zzn12_fb_init(&key->gfb, key->g);
+        if(!ebrick_init(&key->dSA_b, xdSA, ydSA, para_a, para_b, para_q, SM9_SIGN_WINDOW, BNLEN * 8))
+            buf = SM9_ASK_MEMORY_ERR;
+    }
+
+    epoint_free(dSA);
+    mirkill(xdSA);
+    mirkill(ydSA);
+    mirkill(Ppubs.x.a);
+    mirkill(Ppubs.x.b);
+    mirkill(Ppubs.y.a);
+    mirkill(Ppubs.y.b);
+    mirkill(Ppubs.z.a);
+    mirkill(Ppubs.z.b);
+    if(buf != 0)
+        SM9_sign_key_free(key);
+    return buf;
+}
+
+
+//also for a key that SM9_sign_key_init left half made: mirkill and ebrick_end skip what is NULL
+void SM9_sign_key_free(SM9_SIGN_KEY *key)
+{
+    strong_kill(&key->rng);
+    ebrick_end(&key->dSA_b);
+    zzn12_fb_free(&key->gfb);
+    zzn12_kill(&key->g);
+    memset(key, 0, sizeof(SM9_SIGN_KEY));
+}
+
+
+//one item of a batch, i is the index of the item
+typedef void (*SM9_BATCH_FN)(void *arg, int i);
+
+//run fn over the n items of a batch. With OpenMP and a MIRACL built for threads
+//(MR_OPENMP_MT, or MR_UNIX_MT/MR_WINDOWS_MT of mirdef.h, set up by SM9_init) every
+//thread of the team that has no mip makes one on the curve of SM9_init
+static void SM9_batch_run(SM9_BATCH_FN fn, void *arg, int n)
+{
+#ifdef SM9_SIGN_THREADS
+#pragma omp parallel if(n >= SM9_SIGN_THREAD_MIN)
+#endif
+    {
+        miracl *own = NULL;
+        int i;
+
+        if(get_mip() == NULL)
+        {
+            own = mirsys(128, 0);
+            own->TWIST = MR_SEXTIC_M;
+            ecurve_init(para_a, para_b, para_q, MR_PROJECTIVE);
+        }
+#ifdef SM9_SIGN_THREADS
+#pragma omp for schedule(dynamic, 4)
+#endif
+        for(i = 0; i < n; i++)
+            fn(arg, i);
+        if(own != NULL)
+            mirexit();
+    }
+}
+
+
+typedef struct
+{
+    SM9_SIGN_KEY *key;
+    SM9_SIGN_WORK *wk;
+    SM9_SIGNATURE *out;
+} SM9_SIGN_BATCH;
+
+
+//w = g^r with the table of g
+static void SM9_sign_w(void *arg, int i)
+{
+    SM9_SIGN_BATCH *b = (SM9_SIGN_BATCH *)arg;
+    big r;
+    zzn12 w;
+
+    r = mirvar(0);
+    bytes_to_big(BNLEN, b->wk[i].r, r);
+    w = zzn12_fb_pow(&b->key->gfb, r);
+    LinkCharZzn12(b->wk[i].w, 0, w, b->wk[i].w, BNLEN * 12);
+    zzn12_kill(&w);
+    mirkill(r);
+}
+
+
+//S = [l]dSA with the table of dSA
+static void SM9_sign_S(void *arg, int i)
+{
+    SM9_SIGN_BATCH *b = (SM9_SIGN_BATCH *)arg;
+    big l, x, y;
+
+    l = mirvar(0);
+    x = mirvar(0);
+    y = mirvar(0);
+    bytes_to_big(BNLEN, b->wk[i].r, l);
+    mul_brick(&b->key->dSA_b, l, x, y);
+    big_to_bytes(BNLEN, x, b->out[i].S, 1);
+    big_to_bytes(BNLEN, y, b->out[i].S + BNLEN, 1);
+    mirkill(l);
+    mirkill(x);
+    mirkill(y);
+}
+
+
+int SM9_sign_batch(SM9_SIGN_KEY *key, SM9_SIGN_MSG msgs[], int n, SM9_SIGNATURE out[])
+{
+    unsigned char pre[1] = {0x02};
+    unsigned char ct[2][4] = {{0, 0, 0, 1}, {0, 0, 0, 2}};
+    SM9_SIGN_WORK *wk = NULL;
+    SM3_MB_JOB *jobs = NULL;
+    SM9_SIGN_BATCH b;
+    big r, h, l, n1, tmp, zero;
+    int hlen, i, j, buf = 0;
+
+    if(n <= 0)
+        return 0;
+    wk = (SM9_SIGN_WORK *)malloc(sizeof(SM9_SIGN_WORK) * n);
+    jobs = (SM3_MB_JOB *)malloc(sizeof(SM3_MB_JOB) * 2 * n);
+    if(wk == NULL || jobs == NULL)
+    {
+        free(wk);
+        free(jobs);
+        return SM9_ASK_MEMORY_ERR;
+    }
+    b.key = key;
+    b.wk = wk;
+    b.out = out;
+    r = mirvar(0);
+    h = mirvar(0);
+    l = mirvar(0);
+    n1 = mirvar(0);
+    tmp = mirvar(0);
+    zero = mirvar(0);
+    decr(N, 1, n1);
+    hlen = (int)ceil((5.0 * logb2(N)) / 32.0); //as SM9_h2, at most two KDF blocks
+
+    //Step1:r in [1,N-1] from the csprng of the key
+    for(i = 0; i < n; i++)
+    {
+        do
+            strong_bigrand(&key->rng, N, r);
+        while(mr_compare(r, zero) == 0);
+        big_to_bytes(BNLEN, r, wk[i].r, 1);
+    }
+
+    //Step2:w=g(r) with the table of g
+    SM9_batch_run(SM9_sign_w, &b, n);
+
+    //Step3:h=H2(M||w,N), the blocks Hv(0x02||M||w||ct) of all messages hashed together.
+    //M is absorbed once, both blocks of a message resume from that midstate
+    for(i = 0; i < n; i++)
+    {
+        SM3_init(&wk[i].mid);
+        SM3_process(&wk[i].mid, pre, 1);
+        SM3_process(&wk[i].mid, msgs[i].msg, msgs[i].len);
+        for(j = 0; j < 2; j++)
+        {
+            SM3_mb_job_resume(&jobs[2 * i + j], &wk[i].mid, wk[i].ha + 32 * j);
+            SM3_mb_job_add(&jobs[2 * i + j], wk[i].w, BNLEN * 12);
+            SM3_mb_job_add(&jobs[2 * i + j], ct[j], 4);
+        }
+    }
+    SM3_256_mb(jobs, 2 * n);
+
+    //Step4:l=(r-h)mod N, l takes the place of r
+    for(i = 0; i < n; i++)
+    {
+        bytes_to_big(hlen, wk[i].ha, h);
+        divide(h, n1, tmp);
+        incr(h, 1, h);
+        big_to_bytes(BNLEN, h, out[i].H, 1);
+
+        bytes_to_big(BNLEN, wk[i].r, r);
+        subtract(r, h, l);
+        divide(l, N, tmp);
+        while(mr_compare(l, zero) < 0)
+            add(l, N, l);
+        if(mr_compare(l, zero) == 0)
+        {
+            buf = SM9_L_error;
+            goto end;
+        }
+        big_to_bytes(BNLEN, l, wk[i].r, 1);
+    }
+
+    //Step5:S=[l]dSA with the table of dSA
+    SM9_batch_run(SM9_sign_S, &b, n);
+
+end:
+    memset(wk, 0, sizeof(SM9_SIGN_WORK) * n);
+    free(wk);
+    free(jobs);
+    mirkill(r);
+    mirkill(h);
+    mirkill(l);
+    mirkill(n1);
+    mirkill(tmp);
+    mirkill(zero);
+    return buf;
+}
+
+
+//per signature state of SM9_signVerify_batch
+typedef struct
+{
+    unsigned char w[BNLEN * 12]; //w = u*t as LinkCharZzn12 writes it
+    unsigned char ha[64];        //the two KDF blocks of H2
+    SM3_STATE mid;               //0x02||M, both blocks of H2 resume from it
+} SM9_VERIFY_WORK;
+
+typedef struct
+{
+    unsigned char *hid;
+    SM9_VERIFY_ITEM *items;
+    SM9_VERIFY_WORK *wk;
+    int *result;
+    ecap_lines *L[2]; //lines of P2 and Ppub-s
+    zzn12_fb gfb;     //fixed-base table of g = e(P1, Ppub-s)
+} SM9_VERIFY_BATCH;
+
+
+//w = e(S,P)*g^h of signature i, the steps 1-8 of SM9_signVerify
+static void SM9_verify_w(void *arg, int i)
+{
+    SM9_VERIFY_BATCH *b = (SM9_VERIFY_BATCH *)arg;
+    SM9_VERIFY_ITEM *it = &b->items[i];
+    unsigned char *Z;
+    int Zlen = strlen(it->IDA) + 1;
+    big h, h1, xS, yS;
+    epoint *Q[2];
+    zzn12 t, u, w;
+
+    Z = (unsigned char *)malloc(Zlen + 1);
+    if(Z == NULL)
+    {
+        b->result[i] = SM9_ASK_MEMORY_ERR;
+        return;
+    }
+    h = mirvar(0);
+    h1 = mirvar(0);
+    xS = mirvar(0);
+    yS = mirvar(0);
+    Q[0] = epoint_init();
+    Q[1] = epoint_init();
+    zzn12_init(&u);
+    zzn12_init(&w);
+
+    bytes_to_big(BNLEN, it->sig.H, h);
+    bytes_to_big(BNLEN, it->sig.S, xS);
+    bytes_to_big(BNLEN, it->sig.S + BNLEN, yS);
+    memcpy(Z, it->IDA, Zlen - 1);
+    memcpy(Z + Zlen - 1, b->hid, 1);
+
+    //h in [1,N-1], S on the curve, h1=H1(IDA||hid,N)
+    b->result[i] = 0;
+    if(size(h) < 1 || mr_compare(h, N) >= 0)
+        b->result[i] = SM9_H_OUTRANGE;
+    else if(!epoint_set(xS, yS, 0, Q[1]))
+        b->result[i] = SM9_S_NOT_VALID_G1;
+    else
+        b->result[i] = SM9_standard_h1(Z, Zlen, N, h1);
+    if(b->result[i] == 0)
+    {
+        //e(S,[h1]P2+Ppubs) = e([h1]S,P2)*e(S,Ppubs)
+        SM9_G1_mul_glv(h1, Q[1], Q[0]);
+        if(!ecap_multi(2, b->L, Q, para_t, X, &u))
+            b->result[i] = SM9_MY_ECAP_12A_ERR;
+        else if(!member(u, para_t, X))
+            b->result[i] = SM9_MEMBER_ERR;
+        else
+        {
+            t = zzn12_fb_pow(&b->gfb, h);
+            zzn12_mul(u, t, &w);
+            LinkCharZzn12(b->wk[i].w, 0, w, b->wk[i].w, BNLEN * 12);
+            zzn12_kill(&t);
+        }
+    }
+
+    free(Z);
+    zzn12_kill(&u);
+    zzn12_kill(&w);
+    epoint_free(Q[0]);
+    epoint_free(Q[1]);
+    mirkill(h);
+    mirkill(h1);
+    mirkill(xS);
+    mirkill(yS);
+}
+
+
+//verify n signatures under the Ppub-s of key. What SM9_signVerify pays per signature
+//and does not depend on it is paid once: e(P1,Ppub-s) and the lines of Ppub-s come
+//from the key, a fixed-base table for g^h is made for the batch. As P=[h1]P2+Ppubs only
+//enters as e(S,P) = e([h1]S,P2)*e(S,Ppubs), no signer needs any G2 arithmetic.
+//H2 of all signatures is hashed together. result[i] is 0 or the error
+//SM9_signVerify would give for signature i; the return is 0 when all of them
+//pass, SM9_DATA_MEMCMP_ERR when any fails, or an error of the batch
+int SM9_signVerify_batch(SM9_VERIFY_KEY *key, unsigned char hid[], SM9_VERIFY_ITEM items[], int n, int result[])
+{
+    unsigned char ct[2][4] = {{0, 0, 0, 1}, {0, 0, 0, 2}};
+    unsigned char pre[1] = {0x02};
+    SM9_VERIFY_BATCH b;
+    SM3_MB_JOB *jobs = NULL;
+    big h, h2, n1, tmp;
+    int hlen, nj = 0, i, j, buf = 0;
+
+    if(n <= 0)
+        return 0;
+    b.hid = hid;
+    b.items = items;
+    b.result = result;
+    b.wk = (SM9_VERIFY_WORK *)malloc(sizeof(SM9_VERIFY_WORK) * n);
+    jobs = (SM3_MB_JOB *)malloc(sizeof(SM3_MB_JOB) * 2 * n);
+    if(b.wk == NULL || jobs == NULL)
+    {
+        free(b.wk);
+        free(jobs);
+        return SM9_ASK_MEMORY_ERR;
+    }
+
+    b.L[0] = &P2_lines;
+    b.L[1] = &key->L;
+    h = mirvar(0);
+    h2 = mirvar(0);
+    n1 = mirvar(0);
+    tmp = mirvar(0);
+    zzn12_fb_init(&b.gfb, key->g);
+
+    SM9_batch_run(SM9_verify_w, &b, n);
+
+    //h2=H2(M||w,N) of the signatures still standing, hashed together, M absorbed once
+    for(i = 0; i < n; i++)
+    {
+        if(result[i] != 0)
+            continue;
+        SM3_init(&b.wk[i].mid);
+        SM3_process(&b.wk[i].mid, pre, 1);
+        SM3_process(&b.wk[i].mid, items[i].msg, items[i].len);
+        for(j = 0; j < 2; j++)
+        {
+            SM3_mb_job_resume(&jobs[nj], &b.wk[i].mid, b.wk[i].ha + 32 * j);
+            SM3_mb_job_add(&jobs[nj], b.wk[i].w, BNLEN * 12);
+            SM3_mb_job_add(&jobs[nj], ct[j], 4);
+            nj++;
+        }
+    }
+    SM3_256_mb(jobs, nj);
+
+    decr(N, 1, n1);
+    hlen = (int)ceil((5.0 * logb2(N)) / 32.0);
+    for(i = 0; i < n; i++)
+    {
+        if(result[i] == 0)
+        {
+            bytes_to_big(hlen, b.wk[i].ha, h2);
+            divide(h2, n1, tmp);
+            incr(h2, 1, h2);
+            bytes_to_big(BNLEN, items[i].sig.H, h);
+            if(mr_compare(h2, h) != 0)
+                result[i] = SM9_DATA_MEMCMP_ERR;
+        }
+        if(result[i] != 0)
+            buf = SM9_DATA_MEMCMP_ERR;
+    }
+
+    zzn12_fb_free(&b.gfb);
+    free(b.wk);
+    free(jobs);
+    mirkill(h);
+    mirkill(h2);
+    mirkill(n1);
+    mirkill(tmp);
+    return buf;
+}
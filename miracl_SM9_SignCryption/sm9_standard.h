@@ -14,6 +14,8 @@ extern "C"{
 #include "miracl.h"
 #include "r-ate.h"
 #include "kdf_standard.h"
+#include "miracl_IBC/SM9_err.h"
+#include "miracl_IBC/SM9_thread.h"
 
 
 #define BNLEN 32 //BN curve with 256bit is used in SM9 algorithm
@@ -25,20 +27,6 @@ extern "C"{
 #define SM9_G2BASEPOINT_SET_ERR 0x00000006 //base point of G2 seted error(G2基点设置错误)
 #define SM9_GEPUB_ERR 0x00000007 //pubkey error(生成公钥错误)
 #define SM9_GEPRI_ERR 0x00000008 //privare key error(生成私钥错误)
-#define SM9_ERR_CMP_S1SB 0x00000009 //S1!=SB
-#define SM9_ERR_CMP_S2SA 0x0000000A //S2!=SA
-#define SM9_ERR_RA 0x0000000B //RA error
-#define SM9_ERR_RB 0x0000000C //RB error
-#define SM9_ERR_SA 0x0000000D //SA error
-#define SM9_ERR_SB 0x0000000E //SB error
-#define SM9_C1_NOT_VALID_G1 0x0000000F //C1不属于群G1
-#define SM9_ENCRYPT_ERR 0x00000010 //加密错误
-#define SM9_ERR_K1_ZERO 0x00000011 //K1 equals 0(K1全0)
-#define SM9_C3_MEMCMP_ERR 0x00000012 //C3对比不一致
-#define SM9_DECRYPT_ERR 0x00000013 //解密错误
-#define SM9_ERR_Encap_C 0x00000014 //cipher error in key encapsulation
-#define SM9_ERR_Encap_K 0x00000015 //key to be encapsulated
-#define SM9_ERR_Decap_K 0x00000016 //key generated by decapsulation
 #define SM9_H_OUTRANGE 0x00000017 //签名H不属于[1,N-1]
 #define SM9_DATA_MEMCMP_ERR 0x00000018 //数据对比不一致
 #define SM9_S_NOT_VALID_G1 0x00000019 //S不属于群G1
@@ -74,6 +62,50 @@ epoint *P1;
 ecn2 P2;
 big N; //order of group, N(t)
 big para_a, para_b, para_t, para_q;
+ecap_lines P2_lines; //lines of the Miller loop of P2, e(S,[h1]P2+Ppub) = e([h1]S,P2)*e(S,Ppub)
+big glv_beta, glv_A, glv_B, glv_C; //cube root of unity of Fp and the lattice of the GLV method in G1
+
+//signing key prepared once for SM9_sign_batch
+typedef struct
+{
+    zzn12 g;      //e(P1, Ppub-s)
+    zzn12_fb gfb; //fixed-base table of g
+    ebrick dSA_b; //fixed-base table of dSA
+    csprng rng;   //r of every signature, seeded from the OS
+} SM9_SIGN_KEY;
+
+typedef struct
+{
+    unsigned char *msg;
+    int len;
+} SM9_SIGN_MSG;
+
+typedef struct
+{
+    unsigned char H[BNLEN];
+    unsigned char S[BNLEN * 2];
+} SM9_SIGNATURE;
+
+//what only depends on Ppub-s, made once by SM9_verify_key_init for SM9_signVerify
+//and SM9_signVerify_batch. Owned by the caller and only read while verifying
+typedef struct
+{
+    ecap_lines L; //lines of the Miller loop of Ppub-s
+    zzn12 g;      //e(P1, Ppub-s)
+} SM9_VERIFY_KEY;
+
+//one signature for SM9_signVerify_batch
+typedef struct
+{
+    unsigned char *IDA; //the signer, a C string as SM9_signVerify reads it
+    unsigned char *msg;
+    int len;
+    SM9_SIGNATURE sig;
+} SM9_VERIFY_ITEM;
+
+#define SM9_SIGN_WINDOW 8       //window of the fixed-base table of dSA
+#define SM9_SIGN_THREAD_MIN 16  //batches below this size stay in the calling thread
+#define SM9_SIGN_SEED_LEN 32    //bytes of the OS source that seed the csprng of a key
 
 
 static BOOL bytes128_to_ecn2(unsigned char Ppubs[], ecn2 *res);
@@ -83,13 +115,20 @@ static void LinkCharZzn12(unsigned char *message, int len, zzn12 w, unsigned cha
 static int Test_Point(epoint* point);
 static int SM9_standard_h1(unsigned char Z[], int Zlen, big n, big h1);
 static int SM9_init();
+static void SM9_G1_mul_glv(big k, epoint *P, epoint *R);
 
 
 static int Test_Range(big x);
 int SM9_h2(unsigned char Z[], int Zlen, big n, big h2);
 int SM9_generatesignkey(unsigned char hid[], unsigned char *ID, int IDlen, big ks, unsigned char Ppubs[], unsigned char dsa[]);
 int SM9_sign(unsigned char hid[], unsigned char *IDA, unsigned char *message, int len, unsigned char rand[], unsigned char dsa[], unsigned char Ppub[], unsigned char H[], unsigned char S[]);
-int SM9_signVerify(unsigned char H[], unsigned char S[], unsigned char hid[], unsigned char *IDA, unsigned char *message, int len, unsigned char Ppub[]);
+int SM9_verify_key_init(SM9_VERIFY_KEY *key, unsigned char Ppub[]);
+void SM9_verify_key_free(SM9_VERIFY_KEY *key);
+int SM9_signVerify(SM9_VERIFY_KEY *key, unsigned char H[], unsigned char S[], unsigned char hid[], unsigned char *IDA, unsigned char *message, int len);
+int SM9_sign_key_init(SM9_SIGN_KEY *key, unsigned char dsa[], unsigned char Ppub[]);
+void SM9_sign_key_free(SM9_SIGN_KEY *key);
+int SM9_sign_batch(SM9_SIGN_KEY *key, SM9_SIGN_MSG msgs[], int n, SM9_SIGNATURE out[]);
+int SM9_signVerify_batch(SM9_VERIFY_KEY *key, unsigned char hid[], SM9_VERIFY_ITEM items[], int n, int result[]);
 
 
 
@@ -282,7 +321,12 @@ static int SM9_standard_h1(unsigned char Z[], int Zlen, big n, big h1)
 static int SM9_init()
 {
     big P1_x, P1_y;
-    miracl* mip = mirsys(128, 0);
+    miracl* mip;
+
+#ifdef MR_OS_THREADS
+    mr_init_threading(); //mirdef.h builds MIRACL with one mip per thread
+#endif
+    mip = mirsys(128, 0);
 
     para_q = mirvar(0);
     N = mirvar(0);
@@ -320,6 +364,29 @@ static int SM9_init()
     if(!(bytes128_to_ecn2(SM9_P2, &P2))) 
         return SM9_G2BASEPOINT_SET_ERR;
     set_frobenius_constant(&X);
+
+    //GLV in G1: [lambda](x,y)=(beta*x,y) with beta=18t^3+18t^2+9t+1, and the
+    //short basis (-A,B), (C,A) of the pairs k0+k1*lambda=0 mod N
+    glv_beta = mirvar(0);
+    glv_A = mirvar(0);
+    glv_B = mirvar(0);
+    glv_C = mirvar(0);
+    premult(para_t, 2, glv_A);
+    multiply(para_t, para_t, glv_B);
+    premult(glv_B, 6, glv_B);
+    add(glv_B, glv_A, glv_B);            //B=6t^2+2t
+    add(glv_B, glv_A, glv_C);
+    incr(glv_C, 1, glv_C);               //C=6t^2+4t+1
+    incr(glv_A, 1, glv_A);               //A=2t+1
+    multiply(para_t, para_t, glv_beta);
+    premult(glv_beta, 2, glv_beta);
+    add(glv_beta, glv_A, glv_beta);      //2t^2+2t+1
+    multiply(glv_beta, para_t, glv_beta);
+    premult(glv_beta, 9, glv_beta);
+    incr(glv_beta, 1, glv_beta);         //beta=9t(2t^2+2t+1)+1
+
+    if(!ecap_prep(P2, para_t, X, &P2_lines))
+        return SM9_G2BASEPOINT_SET_ERR;
     printf("SM9 init done!\n");
     return 0;
 }
@@ -343,6 +410,67 @@ static int Test_Range(big x)
 }
 
 
+//R=[k]P in G1, 0<=k<N. (x,y)->(beta*x,y) is [lambda] on G1, so k=k0+k1*lambda
+//mod N with k0, k1 of half the length of N and R=[k0]P+[k1](beta*x,y) is one
+//double multiplication: c1=floor(k*A/N), c2=floor(k*B/N), k0=k-c1*A-c2*C and
+//k1=c1*B-c2*A with the basis of SM9_init
+static void SM9_G1_mul_glv(big k, epoint *P, epoint *R)
+{
+    big c1, c2, k0, k1, x, y, tmp;
+    epoint *P0, *Q;
+    char *mem;
+
+    if(point_at_infinity(P))
+    {
+        epoint_copy(P, R);
+        return;
+    }
+    mem = (char *)memalloc(7);
+    c1 = mirvar_mem(mem, 0);
+    c2 = mirvar_mem(mem, 1);
+    k0 = mirvar_mem(mem, 2);
+    k1 = mirvar_mem(mem, 3);
+    x = mirvar_mem(mem, 4);
+    y = mirvar_mem(mem, 5);
+    tmp = mirvar_mem(mem, 6);
+    P0 = epoint_init();
+    Q = epoint_init();
+
+    multiply(k, glv_A, tmp);
+    divide(tmp, N, c1);
+    multiply(k, glv_B, tmp);
+    divide(tmp, N, c2);
+    multiply(c1, glv_A, tmp);
+    subtract(k, tmp, k0);
+    multiply(c2, glv_C, tmp);
+    subtract(k0, tmp, k0);
+    multiply(c1, glv_B, k1);
+    multiply(c2, glv_A, tmp);
+    subtract(k1, tmp, k1);
+
+    epoint_copy(P, P0);
+    epoint_get(P, x, y);
+    multiply(x, glv_beta, x);
+    divide(x, para_q, tmp);
+    epoint_set(x, y, 0, Q);
+    if(size(k0) < 0)
+    {
+        negify(k0, k0);
+        epoint_negate(P0);
+    }
+    if(size(k1) < 0)
+    {
+        negify(k1, k1);
+        epoint_negate(Q);
+    }
+    ecurve_mult2(k0, P0, k1, Q, R);
+
+    epoint_free(P0);
+    epoint_free(Q);
+    memkill(mem, 7);
+}
+
+
 #ifdef __cplusplus
 }
 #endif
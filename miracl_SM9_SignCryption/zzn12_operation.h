@@ -2,6 +2,7 @@
 #define HEADER_ZZN12_OPERATION_H
 
 
+#include <string.h>
 #include "miracl.h"
 
 
@@ -19,6 +20,14 @@ typedef struct
                   // or divisions by constants - as instance will eventually be raised to (p-1).
 } zzn12;
 
+/* fixed-base table of one zzn12 g, T[i] = g^(16^i), for zzn12_fb_pow */
+#define ZZN12_FB_WINDOW 4
+#define ZZN12_FB_DIGITS 64
+typedef struct
+{
+    zzn12 T[ZZN12_FB_DIGITS];
+} zzn12_fb;
+
 
 static void zzn12_init(zzn12 *x)
 {
@@ -406,6 +415,88 @@ static zzn12 zzn12_pow(zzn12 x, big k)
     return res;
 }
 
+/* table of g for zzn12_fb_pow, ZZN12_FB_DIGITS * 4 squarings, release it with zzn12_fb_free */
+static void zzn12_fb_init(zzn12_fb *fb, zzn12 g)
+{
+    int i, j;
+
+    zzn12_init(&fb->T[0]);
+    zzn12_copy(&g, &fb->T[0]);
+    for(i = 1; i < ZZN12_FB_DIGITS; i++)
+    {
+        zzn12_init(&fb->T[i]);
+        zzn12_copy(&fb->T[i - 1], &fb->T[i]);
+        for(j = 0; j < ZZN12_FB_WINDOW; j++)
+            zzn12_mul(fb->T[i], fb->T[i], &fb->T[i]);
+    }
+}
+
+
+/* release the 12 bigs of a zzn12 made by zzn12_init */
+static void zzn12_kill(zzn12 *x)
+{
+    mirkill(x->a.a.a); mirkill(x->a.a.b); mirkill(x->a.b.a); mirkill(x->a.b.b);
+    mirkill(x->b.a.a); mirkill(x->b.a.b); mirkill(x->b.b.a); mirkill(x->b.b.b);
+    mirkill(x->c.a.a); mirkill(x->c.a.b); mirkill(x->c.b.a); mirkill(x->c.b.b);
+}
+
+
+static void zzn12_fb_free(zzn12_fb *fb)
+{
+    int i;
+
+    for(i = 0; i < ZZN12_FB_DIGITS; i++)
+        zzn12_kill(&fb->T[i]);
+}
+
+
+/* g^k with the table of g, 0 <= k < 2^256. Yao's method on the 4-bit digits k_i of k:
+   B_j is the product of the T[i] with k_i >= j and g^k = B_15 * ... * B_1, so at most
+   64 + 15 multiplications and no squaring. The table is only read and may be shared by threads */
+static zzn12 zzn12_fb_pow(zzn12_fb *fb, big k)
+{
+    unsigned char kb[ZZN12_FB_DIGITS / 2], dig[ZZN12_FB_DIGITS];
+    BOOL a_one = TRUE, b_one = TRUE;
+    zzn12 A, B;
+    int i, j;
+
+    zzn12_init(&A);
+    zzn12_init(&B);
+    big_to_bytes(ZZN12_FB_DIGITS / 2, k, (char *)kb, TRUE);
+    for(i = 0; i < ZZN12_FB_DIGITS / 2; i++)
+    {
+        dig[ZZN12_FB_DIGITS - 2 - 2 * i] = kb[i] & 0x0F;
+        dig[ZZN12_FB_DIGITS - 1 - 2 * i] = kb[i] >> 4;
+    }
+
+    for(j = (1 << ZZN12_FB_WINDOW) - 1; j > 0; j--)
+    {
+        for(i = 0; i < ZZN12_FB_DIGITS; i++)
+        {
+            if(dig[i] != j)
+                continue;
+            if(b_one)
+                zzn12_copy(&fb->T[i], &B);
+            else
+                zzn12_mul(B, fb->T[i], &B);
+            b_one = FALSE;
+        }
+        if(b_one)
+            continue;
+        if(a_one)
+            zzn12_copy(&B, &A);
+        else
+            zzn12_mul(A, B, &A);
+        a_one = FALSE;
+    }
+    if(a_one)
+        zzn4_from_big(get_mip()->one, &A.a);
+
+    memset(kb, 0, sizeof(kb));
+    memset(dig, 0, sizeof(dig));
+    return A;
+}
+
 #ifdef __cplusplus
 }
 #endif